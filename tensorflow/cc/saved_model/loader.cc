@@ -49,6 +49,7 @@ limitations under the License.
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/util/tensor_bundle/naming.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
 namespace tensorflow {
 namespace {
@@ -228,6 +229,26 @@ Status RunInitOp(const RunOptions& run_options, const string& export_dir,
   return absl::OkStatus();
 }
 
+// Starts reading the variables data files of the SavedModel in "export_dir"
+// into memory if the session config asks for it, so that the restore reads
+// them from there.  Returns nullptr otherwise.
+std::unique_ptr<BundlePrefetcher> MaybePrefetchVariables(
+    const SessionOptions& session_options, const string& export_dir) {
+  const ConfigProto::Experimental& experimental =
+      session_options.config.experimental();
+  // Mapped restores read the data files through their own mappings.
+  if (experimental.saved_model_checkpoint_prefetch_bytes() <= 0 ||
+      experimental.mmap_restored_variables()) {
+    return nullptr;
+  }
+  const string variables_path =
+      io::JoinPath(io::JoinPath(export_dir, kSavedModelVariablesDirectory),
+                   kSavedModelVariablesFilename);
+  return std::make_unique<BundlePrefetcher>(
+      Env::Default(), variables_path,
+      experimental.saved_model_checkpoint_prefetch_bytes());
+}
+
 Status RunRestore(const RunOptions& run_options, const string& export_dir,
                   const StringPiece restore_op_name,
                   const StringPiece variable_filename_const_op_name,
@@ -297,12 +318,21 @@ Status LoadSavedModelInternal(const SessionOptions& session_options,
                               const string& export_dir,
                               const std::unordered_set<string>& tags,
                               SavedModelBundle* const bundle) {
+  // Overlaps reading the checkpoint with importing the graph.
+  std::unique_ptr<BundlePrefetcher> prefetcher =
+      MaybePrefetchVariables(session_options, export_dir);
+  uint64 phase_start_microseconds = EnvTime::NowMicros();
   TF_RETURN_IF_ERROR(ReadMetaGraphDefFromSavedModel(export_dir, tags,
                                                     &bundle->meta_graph_def));
   TF_RETURN_IF_ERROR(
       ReadSavedModelDebugInfoIfPresent(export_dir, &bundle->debug_info));
+  metrics::SavedModelLoadPhaseDuration("read_meta_graph")
+      .Add(GetLatencyMicroseconds(phase_start_microseconds));
+  phase_start_microseconds = EnvTime::NowMicros();
   TF_RETURN_IF_ERROR(LoadMetagraphIntoSession(
       session_options, bundle->meta_graph_def, &bundle->session));
+  metrics::SavedModelLoadPhaseDuration("create_session")
+      .Add(GetLatencyMicroseconds(phase_start_microseconds));
   TF_RETURN_IF_ERROR(RestoreSession(run_options, bundle->meta_graph_def,
                                     export_dir, &bundle->session));
   return absl::OkStatus();
@@ -424,13 +454,22 @@ Status LoadSavedModelInternal(const SessionOptions& session_options,
                               const string& export_dir,
                               const std::unordered_set<string>& tags,
                               SavedModelBundleLite* const bundle) {
+  // Overlaps reading the checkpoint with importing the graph.
+  std::unique_ptr<BundlePrefetcher> prefetcher =
+      MaybePrefetchVariables(session_options, export_dir);
+  uint64 phase_start_microseconds = EnvTime::NowMicros();
   MetaGraphDef meta_graph_def;
   TF_RETURN_IF_ERROR(
       ReadMetaGraphDefFromSavedModel(export_dir, tags, &meta_graph_def));
+  metrics::SavedModelLoadPhaseDuration("read_meta_graph")
+      .Add(GetLatencyMicroseconds(phase_start_microseconds));
+  phase_start_microseconds = EnvTime::NowMicros();
   std::unique_ptr<Session> session;
   TF_RETURN_IF_ERROR(LoadGraphDefIntoSession(
       session_options, std::move(*meta_graph_def.mutable_graph_def()),
       &session));
+  metrics::SavedModelLoadPhaseDuration("create_session")
+      .Add(GetLatencyMicroseconds(phase_start_microseconds));
   TF_RETURN_IF_ERROR(
       RestoreSession(run_options, meta_graph_def, export_dir, &session));
   *bundle = SavedModelBundleLite(
@@ -506,11 +545,15 @@ Status RestoreSession(const RunOptions& run_options,
       internal::GetInitOp(export_dir, meta_graph, &init_op_name));
   TF_RETURN_IF_ERROR(RunInitOp(run_options, export_dir, meta_graph,
                                asset_file_defs, session->get(), init_op_name));
+  const uint64 init_graph_walltime =
+      GetLatencyMicroseconds(graph_init_start_microseconds);
   load_latency_by_stage->GetCell(export_dir, "restore_graph")
       ->Add(restore_graph_walltime);
   // Record wall time spent in init op.
   load_latency_by_stage->GetCell(export_dir, "init_graph")
-      ->Add(GetLatencyMicroseconds(graph_init_start_microseconds));
+      ->Add(init_graph_walltime);
+  metrics::SavedModelLoadPhaseDuration("restore").Add(restore_graph_walltime);
+  metrics::SavedModelLoadPhaseDuration("init").Add(init_graph_walltime);
   return absl::OkStatus();
 }
 
@@ -118,6 +118,11 @@ Status LoadMetagraphIntoSession(const SessionOptions& session_options,
 /// *bundle with a session and the requested MetaGraphDef, if found.
 ///
 /// NOTE: Prefer the overload that takes a SavedModelBundleLite* in new code.
+///
+/// For both overloads, the wall time of each phase of the load is reported in
+/// "/tensorflow/core/saved_model/read/phase_durations".  If
+/// ConfigProto.Experimental.saved_model_checkpoint_prefetch_bytes is positive,
+/// the variables are read into memory while the graph is imported.
 Status LoadSavedModel(const SessionOptions& session_options,
                       const RunOptions& run_options, const string& export_dir,
                       const std::unordered_set<string>& tags,
@@ -130,6 +135,11 @@ Status LoadSavedModel(const SessionOptions& session_options,
 ///
 /// This overload creates a SavedModelBundleLite, which consumes less RAM than
 /// an equivalent SavedModelBundle.
+///
+/// For models that are only served, setting
+/// `session_options.config.experimental.mmap_restored_variables` restores the
+/// variables as read-only memory mappings of the checkpoint instead of copies,
+/// which replicas of the model on the same host share.
 Status LoadSavedModel(const SessionOptions& session_options,
                       const RunOptions& run_options, const string& export_dir,
                       const std::unordered_set<string>& tags,
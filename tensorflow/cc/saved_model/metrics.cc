@@ -119,6 +119,17 @@ auto* saved_model_found_fingerprint_on_load =
         "Whether or not the fingerprint.pb file was found when loading the "
         "SavedModel.");
 
+// Distribution of the wall time of each phase of loading a SavedModel.
+auto* saved_model_load_phase_durations = monitoring::Sampler<1>::New(
+    {
+        "/tensorflow/core/saved_model/read/phase_durations",  // Metric name.
+        "Distribution of the wall time duration in microseconds of each phase "
+        "of loading a SavedModel.",  // Metric description.
+        "phase"                      // Cell label.
+    },
+    // Scale of 1000, growth factor of 1.5 with upper bound of ~184 minutes.
+    monitoring::Buckets::Exponential(1000, 1.5, 41));
+
 // Distribution of checkpoint write durations.
 auto* checkpoint_write_durations = monitoring::Sampler<1>::New(
     {
@@ -285,6 +296,10 @@ monitoring::GaugeCell<std::string>& SavedModelFoundFingerprintOnLoad() {
   return *saved_model_found_fingerprint_on_load->GetCell();
 }
 
+monitoring::SamplerCell& SavedModelLoadPhaseDuration(absl::string_view phase) {
+  return *saved_model_load_phase_durations->GetCell(std::string(phase));
+}
+
 monitoring::SamplerCell& CheckpointReadDuration(absl::string_view api_label) {
   return *checkpoint_read_durations->GetCell(std::string(api_label));
 }
@@ -105,6 +105,11 @@ ParseSavedModelPathAndSingleprint(std::string path_and_singleprint);
 // found when loading the SavedModel.
 monitoring::GaugeCell<std::string>& SavedModelFoundFingerprintOnLoad();
 
+// Returns "/tensorflow/core/saved_model/read/phase_durations" cell belonging to
+// field `phase`, one of the phases of loading a SavedModel, e.g.
+// "read_meta_graph", "create_session", "restore" or "init".
+monitoring::SamplerCell& SavedModelLoadPhaseDuration(absl::string_view phase);
+
 // Returns "/tensorflow/core/checkpoint/read/read_durations" cell belonging to
 // field `api_label`.
 monitoring::SamplerCell& CheckpointReadDuration(absl::string_view api_label);
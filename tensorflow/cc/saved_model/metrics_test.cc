@@ -53,6 +53,12 @@ TEST(MetricsTest, TestSavedModelRead) {
   EXPECT_EQ(SavedModelReadCount("2").value(), 2);
 }
 
+TEST(MetricsTest, TestSavedModelLoadPhaseDuration) {
+  EXPECT_EQ(SavedModelLoadPhaseDuration("foo").value().num(), 0);
+  SavedModelLoadPhaseDuration("foo").Add(100);
+  EXPECT_EQ(SavedModelLoadPhaseDuration("foo").value().num(), 1);
+}
+
 TEST(MetricsTest, TestCheckpointRead) {
   EXPECT_EQ(CheckpointReadDuration("foo").value().num(), 0);
   CheckpointReadDuration("foo").Add(100);
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/cc/saved_model/constants.h"
 #include "tensorflow/cc/saved_model/loader.h"
+#include "tensorflow/cc/saved_model/metrics.h"
 #include "tensorflow/cc/saved_model/signature_constants.h"
 #include "tensorflow/cc/saved_model/tag_constants.h"
 #include "tensorflow/core/example/example.pb.h"
@@ -24,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/protobuf/config.pb.h"
@@ -148,6 +150,60 @@ TEST_F(LoaderTest, TagMatch) {
   CheckSavedModelBundle(export_dir, bundle);
 }
 
+TEST_F(LoaderTest, MmapRestoredVariables) {
+  monitoring::testing::CellReader<int64_t> mapped_bytes(
+      "/tensorflow/core/checkpoint/restore_mapped_bytes");
+  SavedModelBundleLite bundle;
+  SessionOptions session_options;
+  session_options.config.mutable_experimental()->set_mmap_restored_variables(
+      true);
+  RunOptions run_options;
+
+  const string export_dir =
+      io::JoinPath(testing::TensorFlowSrcRoot(), kTestDataSharded);
+  TF_ASSERT_OK(LoadSavedModel(session_options, run_options, export_dir,
+                              {kSavedModelTagServe}, &bundle));
+  // The checkpoint was not written with aligned tensors, but the first tensor
+  // of its data file is at the start of the mapping and so is mapped.
+  EXPECT_GE(mapped_bytes.Delta(), static_cast<int64_t>(sizeof(float)));
+  CheckSavedModelBundle(export_dir, bundle);
+}
+
+TEST_F(LoaderTest, PrefetchVariables) {
+  SavedModelBundleLite bundle;
+  SessionOptions session_options;
+  session_options.config.mutable_experimental()
+      ->set_saved_model_checkpoint_prefetch_bytes(1 << 20);
+  RunOptions run_options;
+
+  const string export_dir =
+      io::JoinPath(testing::TensorFlowSrcRoot(), kTestDataSharded);
+  TF_ASSERT_OK(LoadSavedModel(session_options, run_options, export_dir,
+                              {kSavedModelTagServe}, &bundle));
+  CheckSavedModelBundle(export_dir, bundle);
+}
+
+TEST_F(LoaderTest, LoadPhaseDurations) {
+  const int64_t num_restores =
+      metrics::SavedModelLoadPhaseDuration("restore").value().num();
+  const int64_t num_imports =
+      metrics::SavedModelLoadPhaseDuration("create_session").value().num();
+  SavedModelBundleLite bundle;
+  SessionOptions session_options;
+  RunOptions run_options;
+
+  const string export_dir =
+      io::JoinPath(testing::TensorFlowSrcRoot(), kTestDataSharded);
+  TF_ASSERT_OK(LoadSavedModel(session_options, run_options, export_dir,
+                              {kSavedModelTagServe}, &bundle));
+  CheckSavedModelBundle(export_dir, bundle);
+  EXPECT_EQ(metrics::SavedModelLoadPhaseDuration("restore").value().num(),
+            num_restores + 1);
+  EXPECT_EQ(
+      metrics::SavedModelLoadPhaseDuration("create_session").value().num(),
+      num_imports + 1);
+}
+
 TEST_F(LoaderTest, NoTagMatch) {
   SavedModelBundleLite bundle;
   RunOptions run_options;
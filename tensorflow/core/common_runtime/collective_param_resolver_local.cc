@@ -68,7 +68,12 @@ const char* GetCollectiveName(const CollectiveParams* cp, bool nccl) {
       return nccl ? "NcclBroadcast" : "HierarchicalTreeBroadcast";
 
     case REDUCTION_COLLECTIVE:
-      return nccl ? "NcclReduce" : "RingReduce";
+      if (nccl) return "NcclReduce";
+      // HierarchicalRingReduce only handles groups of CPU devices.
+      return cp->instance.impl_details.communication_hint == "hierarchical" &&
+                     cp->group.device_type == DEVICE_CPU
+                 ? "HierarchicalRingReduce"
+                 : "RingReduce";
 
     case GATHER_COLLECTIVE:
       return nccl ? "NcclGather" : "RingGather";
@@ -153,6 +158,8 @@ void CollectiveParamResolverLocal::CompleteGroupLocal(
         gr->group.runtime_details.communicator_key =
             nccl_communicator_->GenerateCommunicatorKey();
       }
+      gr->group.runtime_details.residuals =
+          std::make_shared<CollGroupResiduals>();
       // Store GroupRec in group_table_ which is shared between all devices on
       // this worker.
       group_table_[gr->group.group_key].reset(gr);
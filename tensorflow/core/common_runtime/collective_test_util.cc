@@ -78,6 +78,10 @@ void FailTestRMA::PostToPeer(const string& peer_device, const string& peer_task,
                              CancellationManager* cancellation_manager,
                              const StatusCallback& done) {
   if (MaybeFail(done)) return;
+  {
+    mutex_lock l(mu_);
+    bytes_posted_ += from_tensor->TotalBytes();
+  }
   CollectiveRemoteAccessLocal::PostToPeer(
       peer_device, peer_task, key, from_device, from_device_ctx,
       from_alloc_attr, from_tensor, client_locality, cancellation_manager,
@@ -220,6 +224,8 @@ core::RefCountPtr<CollectiveParams> CreateCollectiveParams(
       test_env.num_workers * test_env.num_devices_per_worker;
   col_params->group.num_tasks = test_env.num_workers;
   col_params->group.device_type = test_env.device_type;
+  col_params->group.runtime_details.residuals =
+      std::make_shared<CollGroupResiduals>();
   for (int wi = 0; wi < test_env.num_workers; ++wi) {
     string task_name = strings::StrCat("/job:worker/replica:0/task:", wi);
     col_params->group.num_devices_per_task[task_name] =
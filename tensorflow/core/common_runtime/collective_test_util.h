@@ -46,6 +46,12 @@ class FailTestRMA : public CollectiveRemoteAccessLocal {
     fail_after_ = fail_after;
   }
 
+  // Returns the total size of the tensors passed to PostToPeer.
+  int64_t bytes_posted() {
+    mutex_lock l(mu_);
+    return bytes_posted_;
+  }
+
   void RecvFromPeer(const string& peer_device, const string& peer_task,
                     bool peer_is_local, const string& key, Device* to_device,
                     DeviceContext* to_device_ctx,
@@ -69,6 +75,7 @@ class FailTestRMA : public CollectiveRemoteAccessLocal {
 
   mutex mu_;
   int fail_after_ TF_GUARDED_BY(mu_);
+  int64_t bytes_posted_ TF_GUARDED_BY(mu_) = 0;
 };
 
 struct CollectiveTestEnv {
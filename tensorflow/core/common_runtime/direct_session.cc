@@ -56,6 +56,7 @@ limitations under the License.
 #include "tensorflow/core/graph/graph_partition.h"
 #include "tensorflow/core/graph/subgraph.h"
 #include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/grappler/costs/measured_cost_database.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/refcount.h"
@@ -159,6 +160,27 @@ string GetRendezvousKey(const string& tensor_name,
                          frame_iter.frame_id, ":", frame_iter.iter_id);
 }
 
+// Replaces the compute costs in `cost_graph`, which the session's cost models
+// set to the longest time of each node over all the measured steps, with the
+// times of the step in `step_stats`.
+void SetStepComputeCosts(const StepStats& step_stats,
+                         CostGraphDef* cost_graph) {
+  std::unordered_map<StringPiece, int64_t, StringPieceHasher> step_micros;
+  for (const DeviceStepStats& device_stats : step_stats.dev_stats()) {
+    // Skips the GPU hardware traces, which the cost models only use for the
+    // nodes with regular stats too.
+    if (device_stats.device().find("/stream:") != string::npos) continue;
+    for (const NodeExecStats& node_stats : device_stats.node_stats()) {
+      int64_t& micros = step_micros[node_stats.node_name()];
+      micros = std::max(micros, node_stats.op_end_rel_micros());
+    }
+  }
+  for (CostGraphDef::Node& node : *cost_graph->mutable_node()) {
+    auto it = step_micros.find(node.name());
+    node.set_compute_cost(it == step_micros.end() ? 0 : it->second);
+  }
+}
+
 }  // namespace
 
 class DirectSessionFactory : public SessionFactory {
@@ -326,6 +348,12 @@ DirectSession::DirectSession(const SessionOptions& options,
       factory_(factory),
       cancellation_manager_(new CancellationManager()),
       operation_timeout_in_ms_(options_.config.operation_timeout_in_ms()) {
+  const string& measured_op_costs_dir =
+      options_.config.experimental().measured_op_costs_dir();
+  if (!measured_op_costs_dir.empty()) {
+    measured_costs_ =
+        grappler::MeasuredCostDatabase::Open(measured_op_costs_dir);
+  }
   const int thread_pool_size =
       options_.config.session_inter_op_thread_pool_size();
   if (thread_pool_size > 0) {
@@ -806,17 +834,24 @@ Status DirectSession::RunInternal(
       device_to_graph[device] = graph;
     }
 
-    mutex_lock l(executor_lock_);
-    run_state.collector->BuildCostModel(&cost_model_manager_, device_to_graph);
-
-    if (run_metadata != nullptr) {
-      // annotate stats onto cost graph.
-      CostGraphDef* cost_graph = run_metadata->mutable_cost_graph();
-      for (const auto& item : executors_and_keys->items) {
-        TF_RETURN_IF_ERROR(cost_model_manager_.AddToCostGraphDef(
-            item.graph.get(), cost_graph));
+    {
+      mutex_lock l(executor_lock_);
+      run_state.collector->BuildCostModel(&cost_model_manager_,
+                                          device_to_graph);
+
+      if (run_metadata != nullptr) {
+        // annotate stats onto cost graph.
+        CostGraphDef* cost_graph = run_metadata->mutable_cost_graph();
+        for (const auto& item : executors_and_keys->items) {
+          TF_RETURN_IF_ERROR(cost_model_manager_.AddToCostGraphDef(
+              item.graph.get(), cost_graph));
+        }
       }
     }
+
+    if (measured_costs_ != nullptr && run_metadata != nullptr) {
+      RecordMeasuredCosts(*executors_and_keys, *run_metadata);
+    }
   }
 
   // If requested via RunOptions, output the partition graphs.
@@ -1787,9 +1822,34 @@ Status DirectSession::CreateGraphs(
     closed_ = true;
   }
   if (factory_ != nullptr) factory_->Deregister(this);
+  if (measured_costs_ != nullptr) {
+    Status s = measured_costs_->Flush();
+    if (!s.ok()) LOG(WARNING) << "Cannot save measured op costs: " << s;
+  }
   return absl::OkStatus();
 }
 
+void DirectSession::RecordMeasuredCosts(
+    const ExecutorsAndKeys& executors_and_keys,
+    const RunMetadata& run_metadata) {
+  // The cost graph of the session's cost models, which the step has just
+  // updated, provides the shapes of the inputs of each node.
+  CostGraphDef cost_graph = run_metadata.cost_graph();
+  SetStepComputeCosts(run_metadata.step_stats(), &cost_graph);
+  mutex_lock l(measured_costs_lock_);
+  for (const PerPartitionExecutorsAndLib& partition :
+       executors_and_keys.items) {
+    const Graph* graph = partition.graph.get();
+    auto it = measured_graph_defs_.find(graph);
+    if (it == measured_graph_defs_.end()) {
+      it = measured_graph_defs_.emplace(graph, GraphDef()).first;
+      graph->ToGraphDef(&it->second);
+    }
+    // The database saves the samples in the background.
+    measured_costs_->AddCostGraph(cost_graph, it->second);
+  }
+}
+
 DirectSession::RunState::RunState(int64_t step_id,
                                   const std::vector<Device*>* devices)
     : step_container(step_id, [devices, step_id](const string& name) {
@@ -52,6 +52,10 @@ class DebugGateway;
 class Device;
 class DirectSessionFactory;
 
+namespace grappler {
+class MeasuredCostDatabase;
+}  // namespace grappler
+
 class DirectSession : public Session {
  public:
   typedef std::function<void(Session*)> CloseCallback;
@@ -422,6 +426,20 @@ class DirectSession : public Session {
   // Manages all the cost models for the graphs executed in this session.
   CostModelManager cost_model_manager_;
 
+  // Records the op timings of a step that built a cost model in
+  // `measured_costs_`, which grappler's cost model prefers over its
+  // analytical estimates.
+  void RecordMeasuredCosts(const ExecutorsAndKeys& executors_and_keys,
+                           const RunMetadata& run_metadata)
+      TF_LOCKS_EXCLUDED(measured_costs_lock_);
+
+  // Set by ConfigProto.Experimental.measured_op_costs_dir. Not owned.
+  grappler::MeasuredCostDatabase* measured_costs_ = nullptr;
+  mutex measured_costs_lock_;
+  // The partition graphs whose costs were measured, as GraphDefs.
+  std::unordered_map<const Graph*, GraphDef> measured_graph_defs_
+      TF_GUARDED_BY(measured_costs_lock_);
+
   // For testing collective graph key generation.
   mutex collective_graph_key_lock_;
   int64_t collective_graph_key_ TF_GUARDED_BY(collective_graph_key_lock_) = -1;
@@ -18,6 +18,7 @@ limitations under the License.
 #include <algorithm>
 #include <atomic>
 #include <memory>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -1277,6 +1278,21 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
       tsl::profiler::GetTFTraceMeLevel(/*is_expensive=*/false));
   DCHECK(!ready->empty());
 
+  if (immutable_state_.has_schedule_priorities()) {
+    // Dispatch the most urgent nodes first. Ties are broken as in
+    // PrioritizedPropagatorState, which makes the order deterministic
+    // without the buffer std::stable_sort allocates.
+    std::sort(ready->begin(), ready->end(),
+              [](const TaggedNode& lhs, const TaggedNode& rhs) {
+                return std::make_tuple(lhs.node_item->schedule_priority,
+                                       lhs.get_iter_num(),
+                                       lhs.node_item->node_id) <
+                       std::make_tuple(rhs.node_item->schedule_priority,
+                                       rhs.get_iter_num(),
+                                       rhs.node_item->node_id);
+              });
+  }
+
   int64_t scheduled_nsec = 0;
   if (stats_collector_) {
     scheduled_nsec = nodestats::NowInNsec();
@@ -1516,6 +1532,16 @@ void ExecutorImpl::RunAsyncInternal(const Args& args, DoneCallback done) {
     (new ExecutorState<OrderedPropagatorState>(args, immutable_state_,
                                                &kernel_stats_))
         ->RunAsync(std::move(done));
+  } else if (immutable_state_.has_schedule_priorities()) {
+    if (immutable_state_.requires_control_flow_support()) {
+      (new ExecutorState<PrioritizedPropagatorState<PropagatorState>>(
+           args, immutable_state_, &kernel_stats_))
+          ->RunAsync(std::move(done));
+    } else {
+      (new ExecutorState<PrioritizedPropagatorState<SimplePropagatorState>>(
+           args, immutable_state_, &kernel_stats_))
+          ->RunAsync(std::move(done));
+    }
   } else if (immutable_state_.requires_control_flow_support()) {
     (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_))
         ->RunAsync(std::move(done));
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/executor.h"
 
 #include <algorithm>
+#include <unordered_map>
 
 #include "tensorflow/cc/framework/ops.h"
 #include "tensorflow/cc/ops/array_ops.h"
@@ -30,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/lower_functional_ops.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/local_rendezvous.h"
 #include "tensorflow/core/framework/op.h"
@@ -39,9 +41,14 @@ limitations under the License.
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/static_schedule.h"
+#include "tensorflow/core/grappler/optimizers/static_scheduler.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/strcat.h"
 #include "tensorflow/core/platform/test.h"
@@ -265,6 +272,28 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, RandomTreeWithSchedulePriorities) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  random::PhiloxRandom philox(testing::RandomSeed(), 17);
+  random::SimplePhilox rnd(&philox);
+  // The nodes left without a priority run last.
+  for (Node* n : g->op_nodes()) {
+    if (rnd.OneIn(4)) continue;
+    n->AddAttr("_schedule_priority", static_cast<int32>(rnd.Uniform(100)));
+  }
+  Create(std::move(g));
+  Rendezvous::Args args;
+  TF_ASSERT_OK(
+      rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args, V(1.0), false));
+  TF_ASSERT_OK(Run(rendez_));
+  Tensor out = V(-1);
+  bool is_dead = false;
+  TF_ASSERT_OK(
+      rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out, &is_dead));
+  EXPECT_EQ(4096.0, V(out));
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -493,6 +522,100 @@ BENCHMARK(BM_executor)->UseRealTime()->ArgPair(8192, 32);
 // Tall fat graph
 BENCHMARK(BM_executor)->UseRealTime()->ArgPair(1024, 1024);
 
+// Create a graph of 'width' chains of Square ops, of lengths 1 to 8, on a
+// 64kB tensor, each reduced to a scalar by a Sum. The nodes have no schedule
+// priorities for 'policy' 0. For 'policy' 1 and 2, the priorities are assigned
+// by Grappler's StaticScheduler with the critical path and memory policies
+// respectively. Alongside the wall time, reports the estimated critical path
+// of the graph as "critical_path_usecs", the peak memory estimated for the
+// order of the priorities as "estimated_peak_bytes", and the measured peak
+// memory as "peak_bytes".
+static void BM_executor_schedule_priorities(
+    ::testing::benchmark::State& state) {
+  const int width = state.range(0);
+  const int policy = state.range(1);
+  constexpr int kMaxLength = 8;
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor data(DT_FLOAT, TensorShape({16 * 1024}));
+  data.flat<float>().setConstant(0.5f);
+  Node* in = test::graph::Constant(g, data);
+  Node* axes = test::graph::Constant(g, VI(0));
+  grappler::GrapplerItem item;
+  for (int i = 0; i < width; ++i) {
+    const int length = 1 + i % kMaxLength;
+    Node* n = in;
+    for (int j = 0; j < length; ++j) {
+      n = test::graph::Unary(g, "Square", n);
+    }
+    item.fetch.push_back(test::graph::Reduce(g, "Sum", n, axes)->name());
+  }
+  g->ToGraphDef(&item.graph);
+
+  DeviceProperties cpu_device;
+  cpu_device.set_type("CPU");
+  cpu_device.set_frequency(1000);
+  cpu_device.set_num_cores(port::MaxParallelism());
+  cpu_device.set_bandwidth(32);
+  grappler::VirtualCluster cluster(
+      {{"/job:localhost/replica:0/task:0/cpu:0", cpu_device}});
+  std::unordered_map<const NodeDef*, grappler::Costs::NanoSeconds> times;
+  TF_CHECK_OK(
+      grappler::EstimateEarliestExecutionTimes(item, &cluster, &times));
+  int64_t critical_path_nsec = 0;
+  for (const auto& time : times) {
+    critical_path_nsec = std::max<int64_t>(critical_path_nsec,
+                                           time.second.count());
+  }
+
+  grappler::GrapplerItem scheduled_item = item;
+  if (policy != 0) {
+    grappler::StaticScheduler scheduler(
+        policy == 1 ? grappler::SchedulePolicy::kCriticalPath
+                    : grappler::SchedulePolicy::kMemory);
+    TF_CHECK_OK(scheduler.Optimize(&cluster, item, &scheduled_item.graph));
+  }
+  std::unordered_map<const NodeDef*, int> priorities;
+  std::unordered_map<string, int> priorities_by_name;
+  for (const NodeDef& node : scheduled_item.graph.node()) {
+    auto it = node.attr().find("_schedule_priority");
+    if (it != node.attr().end()) {
+      priorities[&node] = it->second.i();
+      priorities_by_name[node.name()] = it->second.i();
+    }
+  }
+  int64_t estimated_peak_bytes = 0;
+  TF_CHECK_OK(grappler::EstimatePeakMemoryUsage(scheduled_item, priorities,
+                                                &estimated_peak_bytes));
+  for (Node* n : g->op_nodes()) {
+    auto it = priorities_by_name.find(n->name());
+    if (it != priorities_by_name.end()) {
+      n->AddAttr("_schedule_priority", it->second);
+    }
+  }
+  FixupSourceAndSinkEdges(g);
+
+  EnableCPUAllocatorStats();
+  cpu_allocator()->ClearStats();
+  test::Benchmark("cpu", g, /*old_benchmark_api=*/false).Run(state);
+  const absl::optional<AllocatorStats> stats = cpu_allocator()->GetStats();
+  if (stats) {
+    state.counters["peak_bytes"] = stats->peak_bytes_in_use;
+  }
+  DisableCPUAllocatorStats();
+  state.counters["critical_path_usecs"] = critical_path_nsec / 1000.0;
+  state.counters["estimated_peak_bytes"] = estimated_peak_bytes;
+  const int num_nodes = item.graph.node_size();
+  state.SetLabel(strings::StrCat("Nodes = ", num_nodes));
+  state.SetItemsProcessed(num_nodes * static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_executor_schedule_priorities)
+    ->UseRealTime()
+    ->ArgPair(1024, 0)
+    ->ArgPair(1024, 1)
+    ->ArgPair(1024, 2);
+
 static void BM_const_identity(::testing::benchmark::State& state) {
   const int width = state.range(0);
   const int outputs_per_const = state.range(1);
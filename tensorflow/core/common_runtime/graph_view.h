@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_COMMON_RUNTIME_GRAPH_VIEW_H_
 #define TENSORFLOW_CORE_COMMON_RUNTIME_GRAPH_VIEW_H_
 
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -60,6 +61,11 @@ struct NodeItem {
   // The index of this node's item in its GraphView.
   int node_id = -1;
 
+  // The value of the "_schedule_priority" attr of this node. When several
+  // nodes are ready, those with the lowest priority run first, and those
+  // without the attr run last.
+  int32 schedule_priority = std::numeric_limits<int32>::max();
+
   // Cached attributes of this node for fast lookup.
   bool kernel_is_async : 1;     // True iff kernel->AsAsync() != nullptr
   bool is_merge : 1;            // True iff IsMerge(node)
@@ -0,0 +1,448 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_ring_reducer.h"
+
+#include <algorithm>
+#include <functional>
+#include <tuple>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+
+namespace tensorflow {
+namespace {
+
+// Phases of the algorithm, used to keep the BufRendezvous keys of the
+// transfers of different phases apart.
+enum Phase {
+  kIntraHostReduceScatter = 1,
+  kInterHostReduceScatter = 2,
+  kInterHostAllGather = 3,
+  kIntraHostAllGather = 4,
+};
+
+// Tracks the transfers started by one step of the algorithm.
+class PendingTransfers {
+ public:
+  // Returns the callback for one more transfer.
+  StatusCallback Add() {
+    {
+      mutex_lock l(mu_);
+      ++pending_;
+    }
+    return [this](const Status& s) {
+      mutex_lock l(mu_);
+      status_.Update(s);
+      if (--pending_ == 0) cv_.notify_all();
+    };
+  }
+
+  // Waits for every transfer to finish and returns the first error.
+  Status Wait() {
+    mutex_lock l(mu_);
+    while (pending_ > 0) cv_.wait(l);
+    return status_;
+  }
+
+ private:
+  mutex mu_;
+  condition_variable cv_;
+  int pending_ TF_GUARDED_BY(mu_) = 0;
+  Status status_ TF_GUARDED_BY(mu_);
+};
+}  // namespace
+
+HierarchicalRingReducer::HierarchicalRingReducer()
+    : col_ctx_(nullptr), col_params_(nullptr) {}
+
+Status HierarchicalRingReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  if (col_params->instance.type != REDUCTION_COLLECTIVE) {
+    return errors::Internal("HierarchicalRingReduce expects a reduction, got ",
+                            col_params->instance.type);
+  }
+  if (col_params->group.device_type != DEVICE_CPU) {
+    return errors::Unimplemented(
+        "HierarchicalRingReduce only supports CPU devices, got ",
+        col_params->group.device_type.type_string());
+  }
+  // Members of the same task are adjacent, see RingAlg, and share a host.
+  // Members whose locality doesn't name a host are grouped by task.
+  const std::vector<CollGroupMember>& members = col_params->group.members;
+  std::vector<std::vector<int>>& hosts =
+      col_params->instance.impl_details.subdiv_permutations;
+  hosts.clear();
+  std::vector<string> host_names;
+  absl::flat_hash_map<string, int> host_index;
+  absl::flat_hash_map<string, string> task_host;
+  for (int mi = 0; mi < members.size(); ++mi) {
+    const CollGroupMember& member = members[mi];
+    if (mi > 0 && member.task != members[mi - 1].task &&
+        task_host.contains(member.task)) {
+      return errors::Internal(
+          "HierarchicalRingReduce expects the members of each task to be "
+          "adjacent, but the members of ",
+          member.task, " are not");
+    }
+    const string& host = member.device.locality().host().empty()
+                             ? member.task
+                             : member.device.locality().host();
+    auto task_it = task_host.emplace(member.task, host).first;
+    if (task_it->second != host) {
+      return errors::InvalidArgument(
+          "HierarchicalRingReduce expects the devices of a task to share a "
+          "host, but the devices of ",
+          member.task, " are on ", task_it->second, " and ", host);
+    }
+    auto host_it = host_index.emplace(host, hosts.size());
+    if (host_it.second) {
+      hosts.emplace_back();
+      host_names.push_back(host);
+    }
+    hosts[host_it.first->second].push_back(mi);
+  }
+  for (int h = 1; h < hosts.size(); ++h) {
+    if (hosts[h].size() != hosts[0].size()) {
+      return errors::InvalidArgument(
+          "HierarchicalRingReduce needs the same number of devices on every "
+          "host, but ",
+          host_names[0], " has ", hosts[0].size(), " and ", host_names[h],
+          " has ", hosts[h].size());
+    }
+  }
+  for (std::vector<int>& host : hosts) {
+    std::stable_sort(host.begin(), host.end(), [&members](int a, int b) {
+      return std::make_tuple(members[a].device.locality().numa_node(),
+                             members[a].device.name()) <
+             std::make_tuple(members[b].device.locality().numa_node(),
+                             members[b].device.name());
+    });
+  }
+  return absl::OkStatus();
+}
+
+Status HierarchicalRingReducer::InitializeCollectiveContext(
+    std::shared_ptr<CollectiveContext> col_ctx) {
+  DCHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = col_ctx->col_params.get();
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+void HierarchicalRingReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  // Like RingReducer, this doesn't require non-overlapping collectives.
+  col_ctx_->col_exec->UnblockDependencies(*col_params_);
+
+  // Start by copying input to output if they're not already the same, i.e. if
+  // we're not computing in-place on the input tensor.
+  if ((col_ctx_->input != col_ctx_->output) &&
+      (DMAHelper::base(col_ctx_->input) != DMAHelper::base(col_ctx_->output))) {
+    Notification note;
+    Status status;
+    CollectiveRemoteAccessLocal::MemCpyAsync(
+        col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+        col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+        col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input,
+        col_ctx_->output, 0 /*dev_to_dev_stream_index*/,
+        [&note, &status](const Status& s) {
+          status.Update(s);
+          note.Notify();
+        });
+    note.WaitForNotification();
+    if (!status.ok()) {
+      done(status);
+      return;
+    }
+  }
+
+  Status s = RunPhases();
+  if (s.ok()) {
+    // Recover the output from the adaptor.
+    ca_->ConsumeFinalValue(col_ctx_->output);
+  }
+  // Give up Refs on the output tensor.
+  chunks_.clear();
+  temps_.clear();
+  ca_.reset();
+  done(s);
+}
+
+Status HierarchicalRingReducer::RunPhases() {
+  const std::vector<std::vector<int>>& hosts =
+      col_params_->instance.impl_details.subdiv_permutations;
+  if (hosts.empty()) {
+    return errors::Internal("HierarchicalRingReduce params not initialized");
+  }
+  num_hosts_ = hosts.size();
+  devices_per_host_ = hosts[0].size();
+  for (int h = 0; h < num_hosts_; ++h) {
+    for (int i = 0; i < devices_per_host_; ++i) {
+      if (hosts[h][i] == col_params_->default_rank) {
+        host_idx_ = h;
+        local_idx_ = i;
+      }
+    }
+  }
+  if (host_idx_ < 0) {
+    return errors::Internal("Rank ", col_params_->default_rank,
+                            " is missing from the HierarchicalRingReduce "
+                            "host groups");
+  }
+
+  const int num_chunks = num_hosts_ * devices_per_host_;
+  ca_.reset(MakeCollectiveAdapter(
+      col_ctx_->output, num_chunks,
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0))));
+  chunks_.reserve(num_chunks);
+  for (int sc = 0; sc < num_chunks; ++sc) {
+    chunks_.push_back(ca_->ChunkAlias(sc));
+  }
+  temps_.resize(num_hosts_);
+  for (int pos = 0; pos < num_hosts_; ++pos) {
+    const int sc = SubChunk(local_idx_, pos);
+    if (HasBytes(sc)) temps_[pos] = ca_->TempChunk(sc);
+  }
+  if (col_params_->final_op) {
+    group_size_tensor_ = ca_->Scalar(col_params_->group.group_size);
+  }
+
+  tsl::profiler::TraceMe activity("HierarchicalRingReduce",
+                                  tsl::profiler::TraceMeLevel::kInfo);
+  TF_RETURN_IF_ERROR(IntraHostReduceScatter());
+  TF_RETURN_IF_ERROR(InterHostAllReduce());
+  return IntraHostAllGather();
+}
+
+Status HierarchicalRingReducer::IntraHostReduceScatter() {
+  const std::vector<int>& local =
+      col_params_->instance.impl_details.subdiv_permutations[host_idx_];
+  // Hand every other local device our copy of the chunk it reduces.
+  PendingTransfers sends;
+  for (int i = 0; i < devices_per_host_; ++i) {
+    if (i == local_idx_) continue;
+    for (int pos = 0; pos < num_hosts_; ++pos) {
+      const int sc = SubChunk(i, pos);
+      if (!HasBytes(sc)) continue;
+      DispatchSend(kIntraHostReduceScatter, sc, local[i], &chunks_[sc],
+                   sends.Add());
+    }
+  }
+  // Fold in the other devices' copies of our chunk one device at a time,
+  // starting after ourselves so that the devices of a host don't all read
+  // from the same peer at once.
+  Status status;
+  for (int k = 1; k < devices_per_host_ && status.ok(); ++k) {
+    const int peer = (local_idx_ + k) % devices_per_host_;
+    PendingTransfers recvs;
+    for (int pos = 0; pos < num_hosts_; ++pos) {
+      const int sc = SubChunk(local_idx_, pos);
+      if (!HasBytes(sc)) continue;
+      DispatchRecv(kIntraHostReduceScatter, sc, local[peer], &temps_[pos],
+                   recvs.Add());
+    }
+    status = recvs.Wait();
+    for (int pos = 0; pos < num_hosts_ && status.ok(); ++pos) {
+      const int sc = SubChunk(local_idx_, pos);
+      if (HasBytes(sc)) status = Merge(&chunks_[sc], &temps_[pos]);
+    }
+    if (!status.ok()) StartAbort(status);
+  }
+  status.Update(sends.Wait());
+  return status;
+}
+
+Status HierarchicalRingReducer::InterHostAllReduce() {
+  if (num_hosts_ == 1) {
+    for (int pos = 0; pos < num_hosts_; ++pos) {
+      const int sc = SubChunk(local_idx_, pos);
+      if (HasBytes(sc)) TF_RETURN_IF_ERROR(Finalize(&chunks_[sc]));
+    }
+    return absl::OkStatus();
+  }
+  const std::vector<std::vector<int>>& hosts =
+      col_params_->instance.impl_details.subdiv_permutations;
+  const int next = hosts[(host_idx_ + 1) % num_hosts_][local_idx_];
+  const int prev = hosts[(host_idx_ + num_hosts_ - 1) % num_hosts_][local_idx_];
+  const int h = host_idx_;
+  const int n = num_hosts_;
+
+  // Reduce-scatter: in step k we pass on sub-chunk h - k and fold in
+  // sub-chunk h - k - 1, after which we hold the sum of sub-chunk h + 1.
+  for (int k = 0; k < n - 1; ++k) {
+    const int send_sc = SubChunk(local_idx_, (h - k + n) % n);
+    const int recv_pos = (h - k - 1 + 2 * n) % n;
+    const int recv_sc = SubChunk(local_idx_, recv_pos);
+    PendingTransfers step;
+    if (HasBytes(send_sc)) {
+      DispatchSend(kInterHostReduceScatter, send_sc, next, &chunks_[send_sc],
+                   step.Add());
+    }
+    if (HasBytes(recv_sc)) {
+      DispatchRecv(kInterHostReduceScatter, recv_sc, prev, &temps_[recv_pos],
+                   step.Add());
+    }
+    Status status = step.Wait();
+    if (status.ok() && HasBytes(recv_sc)) {
+      status = Merge(&chunks_[recv_sc], &temps_[recv_pos]);
+    }
+    if (!status.ok()) {
+      StartAbort(status);
+      return status;
+    }
+  }
+  const int owned_sc = SubChunk(local_idx_, (h + 1) % n);
+  if (HasBytes(owned_sc)) {
+    Status status = Finalize(&chunks_[owned_sc]);
+    if (!status.ok()) {
+      StartAbort(status);
+      return status;
+    }
+  }
+
+  // All-gather: in step k we pass on sub-chunk h + 1 - k and receive the
+  // final value of sub-chunk h - k.
+  for (int k = 0; k < n - 1; ++k) {
+    const int send_sc = SubChunk(local_idx_, (h + 1 - k + n) % n);
+    const int recv_sc = SubChunk(local_idx_, (h - k + n) % n);
+    PendingTransfers step;
+    if (HasBytes(send_sc)) {
+      DispatchSend(kInterHostAllGather, send_sc, next, &chunks_[send_sc],
+                   step.Add());
+    }
+    if (HasBytes(recv_sc)) {
+      DispatchRecv(kInterHostAllGather, recv_sc, prev, &chunks_[recv_sc],
+                   step.Add());
+    }
+    Status status = step.Wait();
+    if (!status.ok()) {
+      StartAbort(status);
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+Status HierarchicalRingReducer::IntraHostAllGather() {
+  const std::vector<int>& local =
+      col_params_->instance.impl_details.subdiv_permutations[host_idx_];
+  PendingTransfers transfers;
+  for (int i = 0; i < devices_per_host_; ++i) {
+    if (i == local_idx_) continue;
+    for (int pos = 0; pos < num_hosts_; ++pos) {
+      const int own_sc = SubChunk(local_idx_, pos);
+      if (HasBytes(own_sc)) {
+        DispatchSend(kIntraHostAllGather, own_sc, local[i], &chunks_[own_sc],
+                     transfers.Add());
+      }
+      const int peer_sc = SubChunk(i, pos);
+      if (HasBytes(peer_sc)) {
+        DispatchRecv(kIntraHostAllGather, peer_sc, local[i],
+                     &chunks_[peer_sc], transfers.Add());
+      }
+    }
+  }
+  Status status = transfers.Wait();
+  if (!status.ok()) StartAbort(status);
+  return status;
+}
+
+void HierarchicalRingReducer::DispatchSend(int phase, int sc_idx,
+                                           int dst_member, const Tensor* tensor,
+                                           const StatusCallback& done) {
+  string send_buf_key =
+      strings::StrCat("HierarchicalReduce|", col_ctx_->exec_key, "|", phase,
+                      "|", sc_idx, "|", col_params_->default_rank);
+  VLOG(3) << "DispatchSend " << send_buf_key << " to "
+          << col_params_->group.members[dst_member].device.name();
+  col_ctx_->col_exec->remote_access()->PostToPeer(
+      col_params_->group.members[dst_member].device.name(),
+      col_params_->group.members[dst_member].task, send_buf_key,
+      col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), tensor, col_ctx_->device_locality,
+      col_ctx_->op_ctx->cancellation_manager(), done);
+}
+
+void HierarchicalRingReducer::DispatchRecv(int phase, int sc_idx,
+                                           int src_member, Tensor* tensor,
+                                           const StatusCallback& done) {
+  string recv_buf_key =
+      strings::StrCat("HierarchicalReduce|", col_ctx_->exec_key, "|", phase,
+                      "|", sc_idx, "|", src_member);
+  VLOG(3) << "DispatchRecv " << recv_buf_key << " from "
+          << col_params_->group.members[src_member].device.name();
+  col_ctx_->col_exec->remote_access()->RecvFromPeer(
+      col_params_->group.members[src_member].device.name(),
+      col_params_->group.members[src_member].task,
+      col_params_->group.members[src_member].is_local, recv_buf_key,
+      col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), tensor, col_ctx_->device_locality,
+      0 /*dev_to_dev_stream_index*/, col_ctx_->op_ctx->cancellation_manager(),
+      done);
+}
+
+Status HierarchicalRingReducer::Merge(Tensor* output, Tensor* input) {
+  return collective_util::ComputeBinOp(col_ctx_->op_ctx, col_ctx_->op_params,
+                                       col_ctx_->device, col_params_->merge_op,
+                                       output, input);
+}
+
+Status HierarchicalRingReducer::Finalize(Tensor* output) {
+  if (col_params_->final_op == nullptr) return absl::OkStatus();
+  return collective_util::ComputeBinOp(col_ctx_->op_ctx, col_ctx_->op_params,
+                                       col_ctx_->device, col_params_->final_op,
+                                       output, &group_size_tensor_);
+}
+
+void HierarchicalRingReducer::StartAbort(const Status& s) {
+  {
+    mutex_lock l(status_mu_);
+    if (!status_.ok()) return;
+    LOG(ERROR) << "Aborting HierarchicalRingReduce with " << s;
+    status_.Update(s);
+  }
+  // As in RingAlg, a cancellation already stops the outstanding transfers.
+  CancellationManager* cm = col_ctx_->op_ctx->cancellation_manager();
+  if (cm == nullptr || (!cm->IsCancelled() && !cm->IsCancelling())) {
+    col_ctx_->col_exec->StartAbort(s);
+  }
+}
+
+namespace {
+REGISTER_COLLECTIVE(HierarchicalRingReduce, HierarchicalRingReducer);
+}  // namespace
+
+}  // namespace tensorflow
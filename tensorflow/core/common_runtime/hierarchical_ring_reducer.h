@@ -0,0 +1,99 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_RING_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_RING_REDUCER_H_
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+
+// Two-level all-reduce for groups that span several hosts with several
+// devices each.  Where RingReducer passes every chunk through every device
+// of one flat ring, this reducer
+//   1. reduce-scatters the tensor within each host, so that the device at
+//      local index j holds the host's partial sum of chunk j,
+//   2. all-reduces chunk j with a ring among the devices at local index j
+//      of every host, so that only one device per host handles the
+//      cross-host traffic of any given chunk, and
+//   3. all-gathers the chunks within each host.
+// Steps 1 and 3 exchange chunks directly between the devices of a host,
+// which CollectiveRemoteAccessLocal does by memcpy within a task.
+//
+// Hosts are named by DeviceLocality::host, which the CPU device factory
+// fills in; devices without a host are treated as one host per task.  The
+// devices of a task must be adjacent in the group and share a host, and
+// every host must have the same number of devices.  The devices of a host
+// are ordered by their DeviceLocality NUMA node, so that the devices that
+// handle the same chunk sit in matching positions on every host.  The
+// reducer is selected with communication_hint "hierarchical".
+class HierarchicalRingReducer : public CollectiveImplementationInterface {
+ public:
+  HierarchicalRingReducer();
+  ~HierarchicalRingReducer() override = default;
+
+  // Groups the members by host.  subdiv_permutations[h] lists the member
+  // indices of host h in local index order.
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(
+      std::shared_ptr<CollectiveContext> col_ctx) override;
+
+  // Begins execution of the hierarchical reduce.  Must be called in a
+  // blockable thread.
+  void Run(StatusCallback done) override;
+
+ private:
+  Status RunPhases();
+  Status IntraHostReduceScatter();
+  Status InterHostAllReduce();
+  Status IntraHostAllGather();
+
+  // Index of sub-chunk `pos` of the chunk handled by local index `local`.
+  int SubChunk(int local, int pos) const {
+    return local * num_hosts_ + pos;
+  }
+  bool HasBytes(int sc_idx) const { return ca_->ChunkBytes(sc_idx) > 0; }
+
+  void DispatchSend(int phase, int sc_idx, int dst_member, const Tensor* tensor,
+                    const StatusCallback& done);
+  void DispatchRecv(int phase, int sc_idx, int src_member, Tensor* tensor,
+                    const StatusCallback& done);
+  Status Merge(Tensor* output, Tensor* input);
+  Status Finalize(Tensor* output);
+  // Records the first error and aborts the outstanding transfers.
+  void StartAbort(const Status& s);
+
+  std::shared_ptr<CollectiveContext> col_ctx_;
+  const CollectiveParams* col_params_;  // Not owned
+  std::unique_ptr<CollectiveAdapter> ca_;
+  std::vector<Tensor> chunks_;  // aliases of every sub-chunk of the output
+  std::vector<Tensor> temps_;   // recv buffers for the sub-chunks we reduce
+  Tensor group_size_tensor_;
+  int num_hosts_ = 0;
+  int devices_per_host_ = 0;
+  int host_idx_ = -1;
+  int local_idx_ = -1;
+  mutex status_mu_;
+  Status status_ TF_GUARDED_BY(status_mu_);
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_RING_REDUCER_H_
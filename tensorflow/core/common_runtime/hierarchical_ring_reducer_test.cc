@@ -0,0 +1,233 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_ring_reducer.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+
+#include "tensorflow/core/common_runtime/collective_test_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/blocking_counter.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+std::unique_ptr<OpKernel> GetBinOp(const string& op, Device* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder(op + "_node", op)
+                  .Attr("T", DT_FLOAT)
+                  .Input(FakeInput(DT_FLOAT))
+                  .Input(FakeInput(DT_FLOAT))
+                  .Finalize(&node_def));
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()),
+      node_def, TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+// Places every devices_per_host consecutive members on one host.
+void SetHosts(CollectiveParams* cp, int devices_per_host) {
+  for (int mi = 0; mi < cp->group.members.size(); ++mi) {
+    cp->group.members[mi].device.mutable_locality()->set_host(
+        strings::StrCat("host", mi / devices_per_host));
+  }
+}
+
+Status InitializeReducer(CollectiveParams* cp) {
+  core::RefCountPtr<HierarchicalRingReducer> reducer(
+      new HierarchicalRingReducer());
+  return reducer->InitializeCollectiveParams(cp);
+}
+
+class HierarchicalRingReducerTest : public ::testing::Test {
+ protected:
+  // Runs a mean all-reduce of a tensor_len vector over num_workers tasks with
+  // num_devices devices each, and checks the result on every device.  If
+  // tasks_per_host is positive, consecutive tasks share a host.
+  void RunTest(int num_workers, int num_devices, int tensor_len,
+               int tasks_per_host = 0) {
+    auto test_env =
+        CreateCollectiveTestEnv(num_workers, num_devices, DEVICE_CPU);
+    const int group_size = num_workers * num_devices;
+    std::vector<core::RefCountPtr<CollectiveParams>> col_params;
+    std::vector<std::unique_ptr<OpKernel>> ops;
+    std::vector<Device*> devices(group_size);
+    std::vector<Tensor> tensors;
+    std::vector<float> expected(tensor_len);
+    for (int rank = 0; rank < group_size; ++rank) {
+      col_params.push_back(CreateCollectiveParams(
+          *test_env, rank, "HierarchicalRingReduce", REDUCTION_COLLECTIVE,
+          DT_FLOAT, TensorShape({tensor_len})));
+      CollectiveParams* cp = col_params.back().get();
+      if (tasks_per_host > 0) {
+        SetHosts(cp, num_devices * tasks_per_host);
+      }
+      TF_CHECK_OK(test_env->device_mgr->LookupDevice(
+          cp->group.members[rank].device.name(), &devices[rank]));
+      ops.push_back(GetBinOp("Add", devices[rank]));
+      cp->merge_op = ops.back().get();
+      ops.push_back(GetBinOp("Div", devices[rank]));
+      cp->final_op = ops.back().get();
+      tensors.emplace_back(DT_FLOAT, TensorShape({tensor_len}));
+      for (int i = 0; i < tensor_len; ++i) {
+        float value = rank * 10 + i;
+        tensors.back().flat<float>()(i) = value;
+        expected[i] += value;
+      }
+    }
+    for (int i = 0; i < tensor_len; ++i) {
+      expected[i] /= group_size;
+    }
+
+    std::vector<Status> statuses(group_size);
+    BlockingCounter counter(group_size);
+    for (int rank = 0; rank < group_size; ++rank) {
+      SchedClosure([&, rank] {
+        statuses[rank] =
+            RunCollective(test_env.get(), col_params[rank].get(),
+                          devices[rank], &tensors[rank], &tensors[rank]);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    for (int rank = 0; rank < group_size; ++rank) {
+      TF_EXPECT_OK(statuses[rank]);
+      test::ExpectTensorEqual<float>(test::AsTensor<float>(expected),
+                                     tensors[rank]);
+    }
+  }
+};
+
+TEST_F(HierarchicalRingReducerTest, SingleTask) { RunTest(1, 4, 1001); }
+
+TEST_F(HierarchicalRingReducerTest, OneDevicePerTask) { RunTest(2, 1, 7); }
+
+TEST_F(HierarchicalRingReducerTest, FewerElementsThanChunks) {
+  RunTest(2, 4, 1);
+}
+
+TEST_F(HierarchicalRingReducerTest, TwoTasks) { RunTest(2, 4, 1001); }
+
+TEST_F(HierarchicalRingReducerTest, ThreeTasks) { RunTest(3, 2, 4095); }
+
+TEST_F(HierarchicalRingReducerTest, FourTasks) { RunTest(4, 3, 9408); }
+
+TEST_F(HierarchicalRingReducerTest, OneDevicePerTaskTwoTasksPerHost) {
+  RunTest(4, 1, 1001, /*tasks_per_host=*/2);
+}
+
+TEST_F(HierarchicalRingReducerTest, TwoTasksPerHost) {
+  RunTest(4, 2, 4095, /*tasks_per_host=*/2);
+}
+
+TEST_F(HierarchicalRingReducerTest, GroupsByHost) {
+  auto test_env = CreateCollectiveTestEnv(4, 1, DEVICE_CPU);
+  auto cp = CreateCollectiveParams(*test_env, /*rank=*/0,
+                                   "HierarchicalRingReduce",
+                                   REDUCTION_COLLECTIVE, DT_FLOAT,
+                                   TensorShape({16}));
+  const char* hosts[] = {"a", "b", "a", "b"};
+  for (int mi = 0; mi < 4; ++mi) {
+    cp->group.members[mi].device.mutable_locality()->set_host(hosts[mi]);
+  }
+  TF_ASSERT_OK(InitializeReducer(cp.get()));
+  EXPECT_EQ(cp->instance.impl_details.subdiv_permutations,
+            std::vector<std::vector<int>>({{0, 2}, {1, 3}}));
+}
+
+TEST_F(HierarchicalRingReducerTest, GroupsByTaskAndNumaNode) {
+  auto test_env = CreateCollectiveTestEnv(2, 4, DEVICE_CPU);
+  auto cp = CreateCollectiveParams(*test_env, /*rank=*/0,
+                                   "HierarchicalRingReduce",
+                                   REDUCTION_COLLECTIVE, DT_FLOAT,
+                                   TensorShape({16}));
+  const int numa_nodes[] = {1, 0, 1, 0};
+  for (int di = 0; di < 4; ++di) {
+    cp->group.members[di].device.mutable_locality()->set_numa_node(
+        numa_nodes[di]);
+  }
+  TF_ASSERT_OK(InitializeReducer(cp.get()));
+  EXPECT_EQ(cp->instance.impl_details.subdiv_permutations,
+            std::vector<std::vector<int>>({{1, 3, 0, 2}, {4, 5, 6, 7}}));
+}
+
+TEST_F(HierarchicalRingReducerTest, UnevenTasks) {
+  auto test_env = CreateCollectiveTestEnv(2, 2, DEVICE_CPU);
+  auto cp = CreateCollectiveParams(*test_env, /*rank=*/0,
+                                   "HierarchicalRingReduce",
+                                   REDUCTION_COLLECTIVE, DT_FLOAT,
+                                   TensorShape({16}));
+  cp->group.members.pop_back();
+  cp->group.group_size = cp->group.members.size();
+  Status s = InitializeReducer(cp.get());
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST_F(HierarchicalRingReducerTest, UnevenHosts) {
+  auto test_env = CreateCollectiveTestEnv(3, 1, DEVICE_CPU);
+  auto cp = CreateCollectiveParams(*test_env, /*rank=*/0,
+                                   "HierarchicalRingReduce",
+                                   REDUCTION_COLLECTIVE, DT_FLOAT,
+                                   TensorShape({16}));
+  SetHosts(cp.get(), /*devices_per_host=*/2);
+  Status s = InitializeReducer(cp.get());
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  EXPECT_TRUE(absl::StrContains(s.message(), "host0 has 2 and host1 has 1"))
+      << s;
+}
+
+TEST_F(HierarchicalRingReducerTest, TaskOnSeveralHosts) {
+  auto test_env = CreateCollectiveTestEnv(1, 2, DEVICE_CPU);
+  auto cp = CreateCollectiveParams(*test_env, /*rank=*/0,
+                                   "HierarchicalRingReduce",
+                                   REDUCTION_COLLECTIVE, DT_FLOAT,
+                                   TensorShape({16}));
+  SetHosts(cp.get(), /*devices_per_host=*/1);
+  Status s = InitializeReducer(cp.get());
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST_F(HierarchicalRingReducerTest, NonAdjacentTaskMembers) {
+  auto test_env = CreateCollectiveTestEnv(2, 2, DEVICE_CPU);
+  auto cp = CreateCollectiveParams(*test_env, /*rank=*/0,
+                                   "HierarchicalRingReduce",
+                                   REDUCTION_COLLECTIVE, DT_FLOAT,
+                                   TensorShape({16}));
+  std::swap(cp->group.members[1], cp->group.members[2]);
+  Status s = InitializeReducer(cp.get());
+  EXPECT_TRUE(errors::IsInternal(s)) << s;
+  EXPECT_TRUE(absl::StrContains(s.message(), "are not")) << s;
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -99,6 +99,7 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
   // Preprocess every node in the graph to create an instance of op
   // kernel for each node.
   requires_control_flow_ = false;
+  has_schedule_priorities_ = false;
   for (const Node* n : graph.nodes()) {
     if (IsSink(n)) continue;
     if (IsSwitch(n) || IsMerge(n) || IsEnter(n) || IsExit(n)) {
@@ -196,6 +197,11 @@ Status ImmutableExecutorState::Initialize(const Graph& graph) {
     item->is_recv_or_switch = IsRecv(n) || IsSwitch(n);
     item->is_next_iteration = IsNextIteration(n);
     item->is_distributed_communication = IsDistributedCommunication(n);
+    int32_t schedule_priority;
+    if (TryGetNodeAttr(n->attrs(), "_schedule_priority", &schedule_priority)) {
+      item->schedule_priority = schedule_priority;
+      has_schedule_priorities_ = true;
+    }
 
     // Compute the maximum values we'll store for this node in the
     // pending counts data structure, and allocate a handle in
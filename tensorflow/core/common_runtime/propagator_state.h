@@ -16,6 +16,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_COMMON_RUNTIME_PROPAGATOR_STATE_H_
 
 #include <queue>
+#include <tuple>
 #include <vector>
 
 #include "tensorflow/core/common_runtime/entry.h"
@@ -593,6 +594,45 @@ class OrderedPropagatorState : public PropagatorState {
   };
 };
 
+// `PrioritizedPropagatorState` replaces the `TaggedNodeReadyQueue` of
+// `BasePropagatorState` with a priority queue that returns first the nodes with
+// the lowest `schedule_priority`, e.g. as assigned by Grappler's static
+// scheduler, then those of the earliest iterations.
+//
+// This codepath is enabled in executor.cc for graphs with schedule priorities.
+template <class BasePropagatorState>
+class PrioritizedPropagatorState : public BasePropagatorState {
+  using BasePropagatorState::BasePropagatorState;
+
+ public:
+  typedef typename BasePropagatorState::TaggedNode TaggedNode;
+
+  class TaggedNodeReadyQueue {
+   public:
+    TaggedNodeReadyQueue() : readyp_(compare) {}
+    void push_back(const TaggedNode& node) { readyp_.push(node); }
+    TaggedNode front() const { return readyp_.top(); }
+    void pop_front() { readyp_.pop(); }
+    bool empty() const { return readyp_.empty(); }
+    int size() const { return readyp_.size(); }
+
+   private:
+    // Returns true iff `lhs` should run after `rhs`.
+    static bool compare(TaggedNode const& lhs, TaggedNode const& rhs) {
+      std::tuple<int32, int64_t, int> lhs_prio{
+          lhs.node_item->schedule_priority, lhs.get_iter_num(),
+          lhs.node_item->node_id};
+      std::tuple<int32, int64_t, int> rhs_prio{
+          rhs.node_item->schedule_priority, rhs.get_iter_num(),
+          rhs.node_item->node_id};
+      return lhs_prio > rhs_prio;
+    }
+
+    std::priority_queue<TaggedNode, std::vector<TaggedNode>, decltype(&compare)>
+        readyp_;
+  };
+};
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_COMMON_RUNTIME_PROPAGATOR_STATE_H_
@@ -16,8 +16,13 @@ limitations under the License.
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <cstring>
 #include <functional>
+#include <limits>
+#include <numeric>
 #include <utility>
 
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
@@ -38,6 +43,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
 
 // Set true for greater intelligibility of debug mode log messages.
@@ -255,6 +261,64 @@ Status RingAlg::InitializeCollectiveParams(CollectiveParams* col_params) {
   return absl::OkStatus();
 }
 
+namespace {
+// Number of elements of a chunk of num_elements kept by top-k compression.
+int64_t TopKCount(int64_t num_elements, float ratio) {
+  int64_t k = static_cast<int64_t>(std::ceil(num_elements * ratio));
+  return std::min(std::max<int64_t>(k, 1), num_elements);
+}
+}  // namespace
+
+Status RingAlg::InitCompression() {
+  compression_ = Compression::kNone;
+  const CollImplDetails& impl_details = col_params_->instance.impl_details;
+  if (impl_details.compression.empty()) {
+    return absl::OkStatus();
+  }
+  Compression compression;
+  if (impl_details.compression == "bf16") {
+    compression = Compression::kBF16;
+  } else if (impl_details.compression == "fp16") {
+    compression = Compression::kFP16;
+  } else if (impl_details.compression == "topk") {
+    compression = Compression::kTopK;
+    if (!(impl_details.compression_topk_ratio > 0.0f &&
+          impl_details.compression_topk_ratio <= 1.0f)) {
+      return errors::InvalidArgument(
+          "compression_topk_ratio must be in (0, 1], got ",
+          impl_details.compression_topk_ratio);
+    }
+    // Dropped elements are treated as zeros, which is only right for sums.
+    const string merge_op = col_params_->merge_op == nullptr
+                                ? ""
+                                : col_params_->merge_op->type_string();
+    if (merge_op != "Add" && merge_op != "AddV2") {
+      return errors::InvalidArgument(
+          "topk compression requires an Add merge_op, got '", merge_op, "'");
+    }
+    if (col_params_->group.runtime_details.residuals == nullptr) {
+      return errors::Internal("Group ", col_params_->group.group_key,
+                              " has no residuals for topk compression");
+    }
+  } else {
+    return errors::InvalidArgument("Unknown Ring", name_, " compression '",
+                                   impl_details.compression, "'");
+  }
+  if (col_params_->group.num_tasks < 2 ||
+      col_params_->instance.data_type != DT_FLOAT ||
+      col_params_->group.device_type != DEVICE_CPU) {
+    VLOG(1) << "Ignoring Ring" << name_ << " compression "
+            << impl_details.compression << " for "
+            << col_params_->group.num_tasks << " tasks on "
+            << col_params_->group.device_type << " with "
+            << DataTypeString(col_params_->instance.data_type);
+    return absl::OkStatus();
+  }
+  compression_ = compression;
+  topk_ratio_ = impl_details.compression_topk_ratio;
+  return absl::OkStatus();
+}
+
 Status RingAlg::InitializeCollectiveContext(
     std::shared_ptr<CollectiveContext> col_ctx) {
   DCHECK(col_ctx->dev_mgr);
@@ -348,6 +412,10 @@ void RingAlg::InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
                          .subdiv_permutations[subdiv_idx][send_to_rank];
   rf->recv_is_remote = !col_params_->group.members[rf->recv_dev_idx].is_local;
   rf->send_is_remote = !col_params_->group.members[send_dev_idx].is_local;
+  const auto& members = col_params_->group.members;
+  const string& task = members[col_params_->default_rank].task;
+  rf->recv_crosses_task = members[rf->recv_dev_idx].task != task;
+  rf->send_crosses_task = members[send_dev_idx].task != task;
   if (ca_->ChunkBytes(rf->sc_idx) > 0) {
     // In pass 0 we skip Recv when rank = chunk_idx
     rf->do_recv = (rf->chunk_idx != rf->rank);
@@ -404,11 +472,25 @@ void RingAlg::DispatchSend(RingField* rf, const StatusCallback& done) {
   int send_to_rank = (rf->rank + 1) % group_size_;
   int send_to_dev_idx = col_params_->instance.impl_details
                             .subdiv_permutations[rf->subdiv_idx][send_to_rank];
+  const Tensor* send_tensor = &rf->chunk;
+  if (CompressesSend(*rf) || RoundsFinalValue(*rf)) {
+    Status s = CompressChunk(rf);
+    if (s.ok() && RoundsFinalValue(*rf)) {
+      s = DecompressChunk(rf->wire_chunk, &rf->chunk);
+    }
+    if (!s.ok()) {
+      done(s);
+      return;
+    }
+    if (CompressesSend(*rf)) {
+      send_tensor = &rf->wire_chunk;
+    }
+  }
   col_ctx_->col_exec->remote_access()->PostToPeer(
       col_params_->group.members[send_to_dev_idx].device.name(),
       col_params_->group.members[send_to_dev_idx].task, send_buf_key,
       col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
-      col_ctx_->op_ctx->output_alloc_attr(0), &rf->chunk,
+      col_ctx_->op_ctx->output_alloc_attr(0), send_tensor,
       col_ctx_->device_locality, col_ctx_->op_ctx->cancellation_manager(),
       done);
 }
@@ -424,14 +506,151 @@ void RingAlg::DispatchRecv(RingField* rf, const StatusCallback& done) {
   Tensor* dst_tensor = (!rf->second_pass && (col_params_->merge_op != nullptr))
                            ? &rf->tmp_chunk
                            : &rf->chunk;
+  Tensor* recv_tensor = dst_tensor;
+  StatusCallback recv_done = done;
+  if (CompressesRecv(*rf)) {
+    AllocateWireChunk(rf, *dst_tensor);
+    recv_tensor = &rf->wire_chunk;
+    recv_done = [this, rf, dst_tensor, done](const Status& s) {
+      if (!s.ok()) {
+        done(s);
+        return;
+      }
+      done(DecompressChunk(rf->wire_chunk, dst_tensor));
+    };
+  }
   col_ctx_->col_exec->remote_access()->RecvFromPeer(
       col_params_->group.members[rf->recv_dev_idx].device.name(),
       col_params_->group.members[rf->recv_dev_idx].task,
       col_params_->group.members[rf->recv_dev_idx].is_local, recv_buf_key,
       col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
-      col_ctx_->op_ctx->output_alloc_attr(0), dst_tensor,
+      col_ctx_->op_ctx->output_alloc_attr(0), recv_tensor,
       col_ctx_->device_locality, rf->subdiv_idx,
-      col_ctx_->op_ctx->cancellation_manager(), done);
+      col_ctx_->op_ctx->cancellation_manager(), recv_done);
+}
+
+bool RingAlg::CompressesSend(const RingField& rf) const {
+  return compression_ != Compression::kNone && rf.send_crosses_task &&
+         !(compression_ == Compression::kTopK && rf.second_pass);
+}
+
+bool RingAlg::CompressesRecv(const RingField& rf) const {
+  return compression_ != Compression::kNone && rf.recv_crosses_task &&
+         !(compression_ == Compression::kTopK && rf.second_pass);
+}
+
+bool RingAlg::RoundsFinalValue(const RingField& rf) const {
+  // In the second pass the only field that is sent without having been
+  // received holds the fully reduced chunk.
+  return (compression_ == Compression::kBF16 ||
+          compression_ == Compression::kFP16) &&
+         rf.second_pass && !rf.do_recv;
+}
+
+void RingAlg::AllocateWireChunk(RingField* rf, const Tensor& dst) {
+  Allocator* allocator =
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0));
+  switch (compression_) {
+    case Compression::kBF16:
+      rf->wire_chunk = Tensor(allocator, DT_BFLOAT16, dst.shape());
+      break;
+    case Compression::kFP16:
+      rf->wire_chunk = Tensor(allocator, DT_HALF, dst.shape());
+      break;
+    case Compression::kTopK: {
+      const int64_t k = TopKCount(dst.NumElements(), topk_ratio_);
+      rf->wire_chunk = Tensor(allocator, DT_INT32, TensorShape({2 * k}));
+      break;
+    }
+    case Compression::kNone:
+      LOG(FATAL) << "AllocateWireChunk called without compression";
+  }
+}
+
+Status RingAlg::CompressChunk(RingField* rf) {
+  AllocateWireChunk(rf, rf->chunk);
+  auto src = rf->chunk.flat<float>();
+  if (compression_ == Compression::kBF16) {
+    rf->wire_chunk.flat<bfloat16>() = src.cast<bfloat16>();
+    return absl::OkStatus();
+  }
+  if (compression_ == Compression::kFP16) {
+    rf->wire_chunk.flat<Eigen::half>() = src.cast<Eigen::half>();
+    return absl::OkStatus();
+  }
+
+  // Top-k: add the residual of the previous execution, send the k elements
+  // of largest magnitude and keep the rest as the next residual.
+  const int64_t n = src.size();
+  if (n > std::numeric_limits<int32>::max()) {
+    return errors::InvalidArgument("Chunk of ", n,
+                                   " elements is too large for topk "
+                                   "compression");
+  }
+  const int64_t k = rf->wire_chunk.NumElements() / 2;
+  // The residuals belong to the group rather than to the instance, so that
+  // eager collectives, which use a new instance key for every call, carry
+  // them over too.  Within the group they are kept per device, node and
+  // chunk.
+  CollGroupResiduals::Entry* entry =
+      col_params_->group.runtime_details.residuals->Get(strings::StrCat(
+          col_ctx_->device_name, ":", col_params_->name, ":", rf->sc_idx));
+  mutex_lock l(entry->mu);
+  if (entry->residual.NumElements() != n) {
+    entry->residual = Tensor(DT_FLOAT, TensorShape({n}));
+    entry->residual.flat<float>().setZero();
+  }
+  float* acc = entry->residual.flat<float>().data();
+  for (int64_t i = 0; i < n; ++i) {
+    acc[i] += src(i);
+  }
+  std::vector<int32> indices(n);
+  std::iota(indices.begin(), indices.end(), 0);
+  if (k < n) {
+    std::nth_element(indices.begin(), indices.begin() + k, indices.end(),
+                     [acc](int32 a, int32 b) {
+                       return std::abs(acc[a]) > std::abs(acc[b]);
+                     });
+    std::sort(indices.begin(), indices.begin() + k);
+  }
+  int32* wire = rf->wire_chunk.flat<int32>().data();
+  for (int64_t j = 0; j < k; ++j) {
+    wire[j] = indices[j];
+    std::memcpy(&wire[k + j], &acc[indices[j]], sizeof(float));
+    acc[indices[j]] = 0.0f;
+  }
+  return absl::OkStatus();
+}
+
+Status RingAlg::DecompressChunk(const Tensor& wire, Tensor* dst) {
+  auto out = dst->flat<float>();
+  switch (wire.dtype()) {
+    case DT_BFLOAT16:
+      out = wire.flat<bfloat16>().cast<float>();
+      return absl::OkStatus();
+    case DT_HALF:
+      out = wire.flat<Eigen::half>().cast<float>();
+      return absl::OkStatus();
+    case DT_INT32: {
+      const int64_t n = out.size();
+      const int64_t k = wire.NumElements() / 2;
+      const int32* indices = wire.flat<int32>().data();
+      out.setZero();
+      for (int64_t j = 0; j < k; ++j) {
+        if (indices[j] < 0 || indices[j] >= n) {
+          return errors::DataLoss("Index ", indices[j],
+                                  " of a topk compressed chunk is out of "
+                                  "range [0, ",
+                                  n, ")");
+        }
+        std::memcpy(&out(indices[j]), &indices[k + j], sizeof(float));
+      }
+      return absl::OkStatus();
+    }
+    default:
+      return errors::Internal("Unexpected compressed chunk type ",
+                              DataTypeString(wire.dtype()));
+  }
 }
 
 string RingAlg::FieldState() {
@@ -48,6 +48,21 @@ class RingAlg : public CollectiveImplementationInterface {
   void StartAbort(const Status& s);
   void Finish(bool ok);
 
+  // Lossy compression of the chunks sent between tasks, selected by
+  // CollImplDetails::compression.  The bf16 and fp16 modes cast every chunk
+  // crossing a task boundary; the owner of each fully reduced chunk rounds it
+  // to the same precision before the second pass so that all ranks finish
+  // with identical values.  The topk mode sends only the largest-magnitude
+  // fraction of each partial sum in the first pass, as (index, value) pairs,
+  // and adds what it did not send to the same chunk of the next execution by
+  // the same node in the group (error feedback); the second pass is sent
+  // uncompressed.
+  enum class Compression { kNone, kBF16, kFP16, kTopK };
+
+  // Sets compression_ from col_params_.  Compression stays off unless the
+  // instance spans tasks and reduces DT_FLOAT values in host memory.
+  Status InitCompression();
+
   // Current status of a RingField
   enum RingFieldAction {
     RF_INIT = 0,    // Just initialized for a pass
@@ -70,11 +85,14 @@ class RingAlg : public CollectiveImplementationInterface {
     bool second_pass;
     bool recv_is_remote = false;
     bool send_is_remote = false;
+    bool recv_crosses_task = false;  // is the recv peer in another task?
+    bool send_crosses_task = false;  // is the send peer in another task?
     bool do_send = false;   // is the value sent in this pass?
     bool do_recv = false;   // is the value recv'd in this pass?
     bool is_final = false;  // is the last field in the pass for this rank
     Tensor chunk;           // alias to field values
     Tensor tmp_chunk;
+    Tensor wire_chunk;  // compressed form of the value being sent or recv'd
     Status status;
     string DebugString() const;
   };
@@ -84,6 +102,18 @@ class RingAlg : public CollectiveImplementationInterface {
   void DispatchSend(RingField* rf, const StatusCallback& done);
   void DispatchRecv(RingField* rf, const StatusCallback& done);
 
+  // True if the value of rf exchanged in its current pass is compressed.
+  bool CompressesSend(const RingField& rf) const;
+  bool CompressesRecv(const RingField& rf) const;
+  // True if rf owns a fully reduced chunk that must be rounded to the
+  // compressed precision before it is distributed.
+  bool RoundsFinalValue(const RingField& rf) const;
+  // Encodes rf->chunk into rf->wire_chunk, and decodes wire into dst.
+  Status CompressChunk(RingField* rf);
+  Status DecompressChunk(const Tensor& wire, Tensor* dst);
+  // Allocates rf->wire_chunk to receive the compressed form of dst.
+  void AllocateWireChunk(RingField* rf, const Tensor& dst);
+
   // For constructing log messages for debugging.
   string FieldState();
   string TensorDebugString(const Tensor& tensor);
@@ -114,6 +144,8 @@ class RingAlg : public CollectiveImplementationInterface {
   mutex status_mu_;
   Status status_ TF_GUARDED_BY(status_mu_);
   std::vector<RingField> rfv_;
+  Compression compression_ = Compression::kNone;
+  float topk_ratio_ = 0.0f;
 };
 
 }  // namespace tensorflow
@@ -64,6 +64,12 @@ void RingReducer::Run(StatusCallback done) {
   num_subdivs_ = static_cast<int>(
       col_params_->instance.impl_details.subdiv_permutations.size());
   CHECK_GT(num_subdivs_, 0);
+  Status compression_status = InitCompression();
+  if (!compression_status.ok()) {
+    group_size_tensor_ready_.Notify();
+    done_(compression_status);
+    return;
+  }
 
   if (VLOG_IS_ON(1)) {
     string buf;
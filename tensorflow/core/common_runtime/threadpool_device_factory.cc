@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_state.h"
 #include "tensorflow/core/common_runtime/threadpool_device.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/host_info.h"
 #include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/public/session_options.h"
 
@@ -46,6 +47,8 @@ class ThreadPoolDeviceFactory : public DeviceFactory {
     for (int i = 0; i < n; i++) {
       string name = strings::StrCat(name_prefix, "/device:CPU:", i);
       std::unique_ptr<ThreadPoolDevice> tpd;
+      DeviceLocality dev_locality;
+      dev_locality.set_host(port::Hostname());
       if (options.config.experimental().use_numa_affinity()) {
         int numa_node = i % num_numa_nodes;
         if (numa_node != i) {
@@ -54,14 +57,13 @@ class ThreadPoolDeviceFactory : public DeviceFactory {
                     << " assigning device " << name << " to NUMA node "
                     << numa_node;
         }
-        DeviceLocality dev_locality;
         dev_locality.set_numa_node(numa_node);
         tpd = std::make_unique<ThreadPoolDevice>(
             options, name, Bytes(256 << 20), dev_locality,
             ProcessState::singleton()->GetCPUAllocator(numa_node));
       } else {
         tpd = std::make_unique<ThreadPoolDevice>(
-            options, name, Bytes(256 << 20), DeviceLocality(),
+            options, name, Bytes(256 << 20), dev_locality,
             ProcessState::singleton()->GetCPUAllocator(port::kNUMANoAffinity));
       }
       devices->push_back(std::move(tpd));
@@ -67,6 +67,12 @@ void BaseRendezvousMgr::RecvLocalAsync(int64_t step_id,
   FindOrCreate(step_id)->RecvLocalAsync(parsed, std::move(done));
 }
 
+void BaseRendezvousMgr::RecvLocalIfReadyAsync(
+    int64_t step_id, const Rendezvous::ParsedKey& parsed,
+    Rendezvous::DoneCallback done) {
+  FindOrCreate(step_id)->RecvLocalIfReadyAsync(parsed, std::move(done));
+}
+
 Status BaseRendezvousMgr::RecvLocal(int64_t step_id,
                                     const Rendezvous::ParsedKey& parsed,
                                     Tensor* val, bool* is_dead) {
@@ -376,6 +382,43 @@ void BaseRemoteRendezvous::RecvLocalAsyncInternal(const ParsedKey& parsed,
   local_.RecvAsync(parsed, Args(), std::move(done));
 }
 
+void BaseRemoteRendezvous::RecvLocalIfReadyAsync(const ParsedKey& parsed,
+                                                 DoneCallback done) {
+  VLOG(2) << "RemoteRendezvous RecvLocalIfReady " << this << " "
+          << parsed.FullKey();
+  // Nothing can have been sent before the rendezvous is initialized.
+  if (!is_initialized()) {
+    done(errors::Unavailable("Tensor not sent yet: ", parsed.FullKey()),
+         Args(), Args(), Tensor(), false);
+    return;
+  }
+  Status s = ValidateDevices(parsed, true /* is_src */);
+  if (!s.ok()) {
+    done(s, Args(), Args(), Tensor(), false);
+    return;
+  }
+  // With a cancellation manager that is already cancelled, local_ hands over
+  // a tensor that has been sent, and otherwise fails at once instead of
+  // queueing a waiter.  Either way "done" runs before RecvAsync returns.
+  CancellationManager cm;
+  cm.StartCancel();
+  Args recv_args;
+  recv_args.cancellation_manager = &cm;
+  local_.RecvAsync(
+      parsed, recv_args,
+      [this, &parsed, &done](const Status& s, const Args& send_args,
+                             const Args& recv_args, const Tensor& val,
+                             const bool is_dead) {
+        // Unless local_ was aborted, a Cancelled error comes from "cm".
+        if (errors::IsCancelled(s) && local_.status().ok()) {
+          done(errors::Unavailable("Tensor not sent yet: ", parsed.FullKey()),
+               send_args, Args(), val, is_dead);
+        } else {
+          done(s, send_args, Args(), val, is_dead);
+        }
+      });
+}
+
 void BaseRemoteRendezvous::StartAbort(const Status& s) {
   CHECK(!s.ok());
   // If the status passed in is a cancelled or aborted error, mark it as
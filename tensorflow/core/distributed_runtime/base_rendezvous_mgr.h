@@ -88,6 +88,10 @@ class BaseRendezvousMgr : public RendezvousMgrInterface {
   void RecvLocalAsync(int64_t step_id, const Rendezvous::ParsedKey& parsed,
                       Rendezvous::DoneCallback done) override;
 
+  void RecvLocalIfReadyAsync(int64_t step_id,
+                             const Rendezvous::ParsedKey& parsed,
+                             Rendezvous::DoneCallback done) override;
+
   // Synchronous wrapper for RecvLocalAsync.
   Status RecvLocal(int64_t step_id, const Rendezvous::ParsedKey& parsed,
                    Tensor* val, bool* is_dead) override;
@@ -160,6 +164,10 @@ class BaseRemoteRendezvous : public RemoteRendezvous {
   // REQUIRES: "parsed" is one that will be Saved into the local rendezvous.
   void RecvLocalAsync(const ParsedKey& parsed, DoneCallback done);
 
+  // Like RecvLocalAsync, but runs "done" right away with an Unavailable error
+  // if the tensor for "parsed" has not been sent yet.
+  void RecvLocalIfReadyAsync(const ParsedKey& parsed, DoneCallback done);
+
  protected:
   virtual void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
                                    const Rendezvous::Args& args,
@@ -241,6 +241,8 @@ Status CollectiveParamResolverDistributed::UpdateGroupCache(
       gr->incarnations_by_device_name[device.name()] = device.incarnation();
     }
     gr->group.runtime_details.communicator_key = resp.communicator_key();
+    gr->group.runtime_details.residuals =
+        std::make_shared<CollGroupResiduals>();
     FinishGroup(gr.get());
   }
   GroupRec* previous_gr = nullptr;
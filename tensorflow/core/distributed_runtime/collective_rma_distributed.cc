@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/distributed_runtime/collective_rma_distributed.h"
 
+#include <atomic>
 #include <memory>
 
 #include "absl/status/status.h"
@@ -24,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/distributed_runtime/call_options.h"
 #include "tensorflow/core/distributed_runtime/cancellable_call.h"
+#include "tensorflow/core/distributed_runtime/collective_rma_shm.h"
 #include "tensorflow/core/distributed_runtime/request_id.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/framework/cancellation.h"
@@ -138,6 +140,41 @@ void CollectiveRemoteAccessDistributed::RecvFromPeer(
     return;
   }
 
+  if (shm_transport_ != nullptr &&
+      !to_device->tensorflow_accelerator_device_info()) {
+    CancellationToken abortion_token =
+        abortion_cancel_mgr_.get_cancellation_token();
+    auto shm_id = std::make_shared<std::atomic<int64_t>>(0);
+    if (abortion_cancel_mgr_.RegisterCallback(abortion_token, [this, shm_id] {
+          shm_transport_->Cancel(
+              shm_id->load(),
+              errors::Cancelled("collective ops already aborted"));
+        })) {
+      auto shm_done = [this, abortion_token, done](const Status& s) {
+        // May run inside the abortion callback, so must not wait for it.
+        abortion_cancel_mgr_.TryDeregisterCallback(abortion_token);
+        done(s);
+      };
+      const int64_t id = shm_transport_->RecvBuf(
+          peer_task, step_id_, key, peer_device,
+          state->server_attributes.incarnation(), to_tensor,
+          cancellation_manager, shm_done);
+      if (id != 0) {
+        shm_id->store(id);
+        // An abort that ran before the store saw no receive to cancel.
+        if (abortion_cancel_mgr_.IsCancelling() ||
+            abortion_cancel_mgr_.IsCancelled()) {
+          shm_transport_->Cancel(
+              id, errors::Cancelled("collective ops already aborted"));
+        }
+        delete state;
+        return;
+      }
+      abortion_cancel_mgr_.TryDeregisterCallback(abortion_token);
+    }
+    // The peer is not on this host or the buffer does not fit; use RPC.
+  }
+
   Tensor* dst_tensor = nullptr;
   Device* cpu_dev = nullptr;
   if (to_device->tensorflow_accelerator_device_info()) {
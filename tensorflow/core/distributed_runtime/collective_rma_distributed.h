@@ -21,17 +21,22 @@ limitations under the License.
 #include "tensorflow/core/platform/unbounded_work_queue.h"
 
 namespace tensorflow {
+class CollectiveShmTransport;
 class WorkerCacheInterface;
 
-// Extend CollectiveRemoteAccessLocal with access to remote peers.
+// Extend CollectiveRemoteAccessLocal with access to remote peers.  Peers on
+// the same host are reached through `shm_transport`, if given, and all other
+// peers through RecvBuf RPCs.
 class CollectiveRemoteAccessDistributed : public CollectiveRemoteAccessLocal {
  public:
   CollectiveRemoteAccessDistributed(
       const DeviceMgr* dev_mgr, DeviceResolverInterface* dev_resolver,
       std::shared_ptr<UnboundedWorkQueue> work_queue,
-      WorkerCacheInterface* worker_cache, int64_t step_id, string task_name)
+      WorkerCacheInterface* worker_cache, int64_t step_id, string task_name,
+      CollectiveShmTransport* shm_transport = nullptr)
       : CollectiveRemoteAccessLocal(dev_mgr, dev_resolver, step_id),
         worker_cache_(worker_cache),
+        shm_transport_(shm_transport),
         work_queue_(std::move(work_queue)),
         task_name_(std::move(task_name)) {}
 
@@ -52,7 +57,8 @@ class CollectiveRemoteAccessDistributed : public CollectiveRemoteAccessLocal {
   void StartAbort(const Status& s) override;
 
  protected:
-  WorkerCacheInterface* worker_cache_;  // Not owned
+  WorkerCacheInterface* worker_cache_;     // Not owned
+  CollectiveShmTransport* shm_transport_;  // Not owned, may be null
   // Ownership of `work_queue_` is shared between `this` and
   // `CollectiveExecutorMgr`.
   std::shared_ptr<UnboundedWorkQueue> work_queue_;
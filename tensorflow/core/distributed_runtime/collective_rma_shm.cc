@@ -0,0 +1,697 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/distributed_runtime/collective_rma_shm.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/buf_rendezvous.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/strcat.h"
+
+namespace tensorflow {
+
+namespace {
+
+constexpr uint32 kInboxMagic = 0x54465348;  // "TFSH"
+constexpr uint32 kInboxVersion = 2;
+constexpr int kNumSlots = 16;
+constexpr int kMaxKeyBytes = 512;
+constexpr int kMaxDeviceBytes = 256;
+constexpr int kMaxMessageBytes = 256;
+constexpr int64_t kDefaultSlotBytes = 4 << 20;
+constexpr int64_t kPageBytes = 4096;
+// Futex waits time out periodically so that the waiting threads notice
+// shutdown, renew their leases and bump the heartbeat.
+constexpr int64_t kPollMicros = 100 * 1000;
+constexpr uint64 kPeerRetryMicros = 1000 * 1000;
+// A heartbeat or slot lease that has not been renewed for this long, i.e.
+// for 50 polls, belongs to a dead or hung task.
+constexpr uint64 kLeaseMicros = 5 * 1000 * 1000;
+
+// Life cycle of a slot.  The receiver moves a slot from kFree to kClaimed
+// and, once the request is written, to kRequested.  The owner of the inbox
+// moves it to kServing, to kCompleting while it writes the buffer or error,
+// and then to kDone, after which the receiver reads the result and frees the
+// slot.  A receiver that gives up frees a kRequested or kServing slot, and
+// the owner frees any slot but a kCompleting one whose lease expired.
+enum SlotState : uint32 {
+  kFree = 0,
+  kClaimed,
+  kRequested,
+  kServing,
+  kCompleting,
+  kDone,
+};
+
+// The state of a slot is packed with its generation into one word, so that
+// a transition made for one use of a slot fails once the slot was freed.
+uint64 SlotWord(uint32 generation, SlotState state) {
+  return (static_cast<uint64>(generation) << 32) | state;
+}
+uint32 Generation(uint64 word) { return static_cast<uint32>(word >> 32); }
+SlotState State(uint64 word) {
+  return static_cast<SlotState>(static_cast<uint32>(word));
+}
+
+static_assert(std::atomic<uint32>::is_always_lock_free,
+              "shared memory signaling needs lock-free 32-bit atomics");
+static_assert(std::atomic<uint64>::is_always_lock_free,
+              "shared memory signaling needs lock-free 64-bit atomics");
+
+struct SlotHeader {
+  std::atomic<uint64> state;  // See SlotWord().
+  std::atomic<uint64> lease;  // Bumped by the receiver holding the slot.
+  int32 code;
+  int64_t step_id;
+  uint64 incarnation;
+  uint64 num_bytes;
+  uint32 key_len;
+  uint32 device_len;
+  uint32 message_len;
+  char key[kMaxKeyBytes];
+  char device[kMaxDeviceBytes];
+  char message[kMaxMessageBytes];
+};
+
+struct InboxHeader {
+  uint32 magic;
+  uint32 version;
+  uint64 slot_bytes;
+  std::atomic<uint32> ready;        // 1 while the owner serves requests.
+  std::atomic<uint32> requests;     // Futex word, bumped per request.
+  std::atomic<uint32> completions;  // Futex word, bumped per completion.
+  std::atomic<uint64> heartbeat;    // Bumped by the owner while it serves.
+  SlotHeader slots[kNumSlots];
+};
+
+int64_t RoundUpToPage(int64_t n) {
+  return (n + kPageBytes - 1) / kPageBytes * kPageBytes;
+}
+
+int64_t DataOffset() { return RoundUpToPage(sizeof(InboxHeader)); }
+
+int64_t SegmentBytes(int64_t slot_bytes) {
+  return DataOffset() + kNumSlots * slot_bytes;
+}
+
+void FutexWait(std::atomic<uint32>* word, uint32 expected,
+               int64_t timeout_micros) {
+#if defined(__linux__)
+  struct timespec timeout;
+  timeout.tv_sec = timeout_micros / 1000000;
+  timeout.tv_nsec = (timeout_micros % 1000000) * 1000;
+  syscall(SYS_futex, reinterpret_cast<uint32*>(word), FUTEX_WAIT, expected,
+          &timeout, nullptr, 0);
+#endif
+}
+
+void FutexWake(std::atomic<uint32>* word, int count) {
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<uint32*>(word), FUTEX_WAKE, count,
+          nullptr, nullptr, 0);
+#endif
+}
+
+void CopyField(const string& value, char* field, uint32* len) {
+  *len = value.size();
+  memcpy(field, value.data(), value.size());
+}
+
+// Frees `slot` on behalf of the receiver that holds it in `generation`.
+// Returns false if the owner is writing or has written the result, in which
+// case the slot is left to the completion thread, or to the owner's lease
+// check if `force`.
+bool ReleaseSlot(SlotHeader* slot, uint32 generation, bool force) {
+  const uint64 freed = SlotWord(generation + 1, kFree);
+  for (SlotState state : {kClaimed, kRequested, kServing, kDone}) {
+    if (state == kDone && !force) continue;
+    uint64 word = SlotWord(generation, state);
+    if (slot->state.compare_exchange_strong(word, freed,
+                                            std::memory_order_acq_rel)) {
+      return true;
+    }
+    // Freed or reclaimed already.
+    if (Generation(word) != generation) return true;
+  }
+  return force;
+}
+
+}  // namespace
+
+struct CollectiveShmTransport::Segment {
+  string name;
+  char* base = nullptr;
+  int64_t size = 0;
+
+  ~Segment() {
+#if defined(__linux__)
+    if (base != nullptr) munmap(base, size);
+#endif
+  }
+
+  InboxHeader* header() const { return reinterpret_cast<InboxHeader*>(base); }
+  SlotHeader& slot(int idx) const { return header()->slots[idx]; }
+  char* data(int idx) const {
+    return base + DataOffset() + idx * header()->slot_bytes;
+  }
+};
+
+struct CollectiveShmTransport::Peer {
+  std::shared_ptr<Segment> segment;
+  uint64 retry_after_micros = 0;
+  // Last heartbeat seen, when it was seen and whether it ever advanced.
+  uint64 heartbeat = 0;
+  uint64 heartbeat_micros = 0;
+  bool heartbeat_advanced = false;
+  std::unique_ptr<Thread> thread;
+};
+
+struct CollectiveShmTransport::PendingRecv {
+  Peer* peer;
+  int slot_idx;
+  uint32 generation;
+  Tensor* to_tensor;
+  StatusCallback done;
+  CancellationManager* cancellation_manager;
+  CancellationToken cancellation_token;
+};
+
+struct CollectiveShmTransport::SlotLease {
+  uint64 word = 0;
+  uint64 lease = 0;
+  uint64 since_micros = 0;
+};
+
+/*static*/
+string CollectiveShmTransport::SegmentName(const string& name_space,
+                                           const string& task_name) {
+  string name = strings::StrCat("/tf_coll_", name_space, "_", task_name);
+  std::replace_if(
+      name.begin() + 1, name.end(),
+      [](char c) { return !isalnum(static_cast<unsigned char>(c)); }, '_');
+  return name;
+}
+
+/*static*/
+std::shared_ptr<CollectiveShmTransport::Segment>
+CollectiveShmTransport::MapSegment(const string& name, bool create,
+                                   int64_t slot_bytes) {
+#if defined(__linux__)
+  int fd;
+  int64_t size;
+  if (create) {
+    // A segment left behind by an earlier incarnation of this task is stale.
+    shm_unlink(name.c_str());
+    fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    size = SegmentBytes(slot_bytes);
+    if (fd >= 0 && ftruncate(fd, size) != 0) {
+      close(fd);
+      shm_unlink(name.c_str());
+      fd = -1;
+    }
+  } else {
+    fd = shm_open(name.c_str(), O_RDWR, 0);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) != 0) {
+      close(fd);
+      fd = -1;
+    }
+    size = fd >= 0 ? st.st_size : 0;
+  }
+  if (fd < 0) return nullptr;
+  if (size < SegmentBytes(0)) {
+    close(fd);
+    return nullptr;
+  }
+  void* base =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, /*offset=*/0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    if (create) shm_unlink(name.c_str());
+    return nullptr;
+  }
+  auto segment = std::make_shared<Segment>();
+  segment->name = name;
+  segment->base = static_cast<char*>(base);
+  segment->size = size;
+  InboxHeader* header = segment->header();
+  if (create) {
+    // ftruncate zero-fills the segment, so every slot starts out kFree.
+    header->magic = kInboxMagic;
+    header->version = kInboxVersion;
+    header->slot_bytes = slot_bytes;
+    header->ready.store(1, std::memory_order_release);
+  } else if (header->ready.load(std::memory_order_acquire) != 1 ||
+             header->magic != kInboxMagic ||
+             header->version != kInboxVersion ||
+             size < SegmentBytes(header->slot_bytes)) {
+    return nullptr;
+  }
+  return segment;
+#else
+  return nullptr;
+#endif
+}
+
+/*static*/
+std::unique_ptr<CollectiveShmTransport> CollectiveShmTransport::Create(
+    const ConfigProto& config, const string& task_name,
+    CollectiveExecutorMgrInterface* mgr) {
+  const string& name_space = config.experimental().collective_shm_namespace();
+  if (name_space.empty()) return nullptr;
+  int64_t slot_bytes = config.experimental().collective_shm_slot_bytes();
+  if (slot_bytes <= 0) slot_bytes = kDefaultSlotBytes;
+  const string name = SegmentName(name_space, task_name);
+  std::shared_ptr<Segment> inbox =
+      MapSegment(name, /*create=*/true, RoundUpToPage(slot_bytes));
+  if (inbox == nullptr) {
+    LOG(WARNING) << "Failed to create collective shared memory segment "
+                 << name << " for " << task_name
+                 << "; using RPC for all peers";
+    return nullptr;
+  }
+  VLOG(1) << "Serving collective buffers of " << task_name
+          << " through shared memory segment " << name;
+  auto transport = absl::WrapUnique(
+      new CollectiveShmTransport(mgr, name_space, std::move(inbox)));
+  CollectiveShmTransport* t = transport.get();
+  transport->serve_thread_.reset(Env::Default()->StartThread(
+      ThreadOptions(), "tf_coll_shm_serve", [t] { t->ServeLoop(); }));
+  return transport;
+}
+
+CollectiveShmTransport::CollectiveShmTransport(
+    CollectiveExecutorMgrInterface* mgr, const string& name_space,
+    std::shared_ptr<Segment> inbox)
+    : mgr_(mgr),
+      name_space_(name_space),
+      inbox_(std::move(inbox)),
+      slot_leases_(kNumSlots) {}
+
+CollectiveShmTransport::~CollectiveShmTransport() {
+  absl::flat_hash_map<string, std::unique_ptr<Peer>> peers;
+  absl::flat_hash_map<int64_t, std::unique_ptr<PendingRecv>> pending;
+  {
+    mutex_lock l(mu_);
+    shutdown_ = true;
+    peers.swap(peers_);
+    pending.swap(pending_);
+  }
+  InboxHeader* header = inbox_->header();
+  header->ready.store(0, std::memory_order_release);
+#if defined(__linux__)
+  shm_unlink(inbox_->name.c_str());
+#endif
+  header->requests.fetch_add(1, std::memory_order_release);
+  FutexWake(&header->requests, INT_MAX);
+  serve_thread_.reset();
+  for (auto& it : peers) {
+    if (it.second->segment != nullptr) {
+      FutexWake(&it.second->segment->header()->completions, INT_MAX);
+    }
+    it.second->thread.reset();
+  }
+  for (auto& it : pending) {
+    ReleaseSlot(&it.second->peer->segment->slot(it.second->slot_idx),
+                it.second->generation, /*force=*/true);
+    Finish(std::move(it.second),
+           errors::Cancelled("collective shared memory transport shut down"));
+  }
+  // Requests that are still waiting for their buffer keep the inbox mapped
+  // until the BufRendezvous of their step is aborted.
+}
+
+CollectiveShmTransport::Peer* CollectiveShmTransport::GetPeer(
+    const string& peer_task) {
+  std::unique_ptr<Peer>& peer = peers_[peer_task];
+  if (peer == nullptr) peer = std::make_unique<Peer>();
+  if (peer->segment != nullptr) {
+    return PeerAlive(peer.get()) ? peer.get() : nullptr;
+  }
+  const uint64 now = Env::Default()->NowMicros();
+  if (now < peer->retry_after_micros) return nullptr;
+  peer->segment = MapSegment(SegmentName(name_space_, peer_task),
+                             /*create=*/false, /*slot_bytes=*/0);
+  if (peer->segment == nullptr) {
+    peer->retry_after_micros = now + kPeerRetryMicros;
+    return nullptr;
+  }
+  VLOG(1) << "Receiving collective buffers from " << peer_task
+          << " through shared memory";
+  peer->heartbeat =
+      peer->segment->header()->heartbeat.load(std::memory_order_acquire);
+  peer->heartbeat_micros = now;
+  Peer* p = peer.get();
+  peer->thread.reset(Env::Default()->StartThread(
+      ThreadOptions(), "tf_coll_shm_recv", [this, p] { CompletionLoop(p); }));
+  // Use RPC until the heartbeat is seen to advance.
+  return nullptr;
+}
+
+bool CollectiveShmTransport::PeerAlive(Peer* peer) {
+  InboxHeader* header = peer->segment->header();
+  if (header->ready.load(std::memory_order_acquire) != 1) return false;
+  const uint64 now = Env::Default()->NowMicros();
+  const uint64 heartbeat = header->heartbeat.load(std::memory_order_acquire);
+  if (heartbeat != peer->heartbeat) {
+    peer->heartbeat = heartbeat;
+    peer->heartbeat_micros = now;
+    peer->heartbeat_advanced = true;
+    return true;
+  }
+  return peer->heartbeat_advanced &&
+         now - peer->heartbeat_micros < kLeaseMicros;
+}
+
+int64_t CollectiveShmTransport::RecvBuf(
+    const string& peer_task, int64_t step_id, const string& key,
+    const string& peer_device, uint64 peer_incarnation, Tensor* to_tensor,
+    CancellationManager* cancellation_manager, const StatusCallback& done) {
+  if (key.size() > kMaxKeyBytes || peer_device.size() > kMaxDeviceBytes ||
+      !DMAHelper::CanUseDMA(to_tensor)) {
+    return 0;
+  }
+  const uint64 num_bytes = to_tensor->TotalBytes();
+  mutex_lock l(mu_);
+  if (shutdown_) return 0;
+  Peer* peer = GetPeer(peer_task);
+  if (peer == nullptr) return 0;
+  Segment* segment = peer->segment.get();
+  InboxHeader* header = segment->header();
+  if (num_bytes > header->slot_bytes) return 0;
+  int slot_idx = -1;
+  uint32 generation = 0;
+  for (int i = 0; i < kNumSlots; ++i) {
+    uint64 word = segment->slot(i).state.load(std::memory_order_acquire);
+    if (State(word) != kFree) continue;
+    if (segment->slot(i).state.compare_exchange_strong(
+            word, SlotWord(Generation(word), kClaimed),
+            std::memory_order_acq_rel)) {
+      slot_idx = i;
+      generation = Generation(word);
+      break;
+    }
+  }
+  // All slots busy: RPC is likely faster than waiting for one.
+  if (slot_idx < 0) return 0;
+  SlotHeader& slot = segment->slot(slot_idx);
+  slot.lease.fetch_add(1, std::memory_order_relaxed);
+  slot.step_id = step_id;
+  slot.incarnation = peer_incarnation;
+  slot.num_bytes = num_bytes;
+  CopyField(key, slot.key, &slot.key_len);
+  CopyField(peer_device, slot.device, &slot.device_len);
+
+  const int64_t id = next_id_++;
+  auto recv = std::make_unique<PendingRecv>();
+  recv->peer = peer;
+  recv->slot_idx = slot_idx;
+  recv->generation = generation;
+  recv->to_tensor = to_tensor;
+  recv->done = done;
+  recv->cancellation_manager = cancellation_manager;
+  if (cancellation_manager != nullptr) {
+    recv->cancellation_token = cancellation_manager->get_cancellation_token();
+    if (!cancellation_manager->RegisterCallback(
+            recv->cancellation_token, [this, id] {
+              Cancel(id, errors::Cancelled("RecvBuf cancelled"));
+            })) {
+      // Already cancelled; let the RPC path report it.
+      ReleaseSlot(&slot, generation, /*force=*/true);
+      return 0;
+    }
+  }
+  pending_[id] = std::move(recv);
+  slot.state.store(SlotWord(generation, kRequested), std::memory_order_release);
+  header->requests.fetch_add(1, std::memory_order_release);
+  FutexWake(&header->requests, 1);
+  return id;
+}
+
+void CollectiveShmTransport::Cancel(int64_t id, const Status& s) {
+  std::unique_ptr<PendingRecv> recv;
+  {
+    mutex_lock l(mu_);
+    auto it = pending_.find(id);
+    if (it == pending_.end()) return;
+    // If the result is being written or is already in, CompletionLoop
+    // delivers it.
+    if (!ReleaseSlot(&it->second->peer->segment->slot(it->second->slot_idx),
+                     it->second->generation, /*force=*/false)) {
+      return;
+    }
+    recv = std::move(it->second);
+    pending_.erase(it);
+  }
+  Finish(std::move(recv), s);
+}
+
+/*static*/
+void CollectiveShmTransport::Finish(std::unique_ptr<PendingRecv> recv,
+                                    const Status& s) {
+  if (recv->cancellation_manager != nullptr) {
+    // May run inside the cancellation callback, so must not wait for it.
+    recv->cancellation_manager->TryDeregisterCallback(
+        recv->cancellation_token);
+  }
+  recv->done(s);
+}
+
+void CollectiveShmTransport::ServeLoop() {
+  InboxHeader* header = inbox_->header();
+  while (true) {
+    {
+      mutex_lock l(mu_);
+      if (shutdown_) return;
+    }
+    header->heartbeat.fetch_add(1, std::memory_order_release);
+    const uint32 seen = header->requests.load(std::memory_order_acquire);
+    bool served = false;
+    for (int i = 0; i < kNumSlots; ++i) {
+      uint64 word = inbox_->slot(i).state.load(std::memory_order_acquire);
+      if (State(word) != kRequested) continue;
+      if (inbox_->slot(i).state.compare_exchange_strong(
+              word, SlotWord(Generation(word), kServing),
+              std::memory_order_acq_rel)) {
+        Serve(i, Generation(word));
+        served = true;
+      }
+    }
+    ReclaimStaleSlots();
+    if (!served) FutexWait(&header->requests, seen, kPollMicros);
+  }
+}
+
+void CollectiveShmTransport::ReclaimStaleSlots() {
+  const uint64 now = Env::Default()->NowMicros();
+  for (int i = 0; i < kNumSlots; ++i) {
+    SlotHeader& slot = inbox_->slot(i);
+    SlotLease& lease = slot_leases_[i];
+    uint64 word = slot.state.load(std::memory_order_acquire);
+    const uint64 renewals = slot.lease.load(std::memory_order_relaxed);
+    if (word != lease.word || renewals != lease.lease) {
+      lease.word = word;
+      lease.lease = renewals;
+      lease.since_micros = now;
+      continue;
+    }
+    if (State(word) == kFree || State(word) == kCompleting ||
+        now - lease.since_micros < kLeaseMicros) {
+      continue;
+    }
+    // A request that is still being served completes into the void, as its
+    // generation no longer matches.
+    if (slot.state.compare_exchange_strong(
+            word, SlotWord(Generation(word) + 1, kFree),
+            std::memory_order_acq_rel)) {
+      LOG(WARNING) << "Freed collective shared memory slot " << i << " of "
+                   << inbox_->name << " whose receiver stopped renewing it";
+    }
+  }
+}
+
+void CollectiveShmTransport::Serve(int slot_idx, uint32 generation) {
+  SlotHeader& slot = inbox_->slot(slot_idx);
+  const string key(slot.key, slot.key_len);
+  const string device(slot.device, slot.device_len);
+  const int64_t step_id = slot.step_id;
+  const uint64 incarnation = slot.incarnation;
+  const uint64 num_bytes = slot.num_bytes;
+  // The receiver may have given up, and the slot been reused, while the
+  // request was read.
+  if (slot.state.load(std::memory_order_acquire) !=
+      SlotWord(generation, kServing)) {
+    return;
+  }
+  std::shared_ptr<Segment> inbox = inbox_;
+
+  CollectiveExecutor::Handle ce_handle(mgr_->FindOrCreate(step_id), true);
+  CollectiveRemoteAccess* rma = ce_handle.get()->remote_access();
+  auto consumer_callback = [inbox, slot_idx, generation, key, num_bytes](
+                               const Status& status,
+                               BufRendezvous::Hook* hook) {
+    Status s = status;
+    if (s.ok()) {
+      if (hook == nullptr) {
+        s = errors::Internal("Invalid null hook for key ", key);
+      } else if (!DMAHelper::CanUseDMA(hook->prod_value)) {
+        s = errors::Internal("Tensor value for key ", key,
+                             " is not of a type supported by RecvBuf");
+      } else if (hook->prod_value->TotalBytes() != num_bytes) {
+        s = errors::Internal("Tensor Size Mismatch: key ", key, " provides ",
+                             hook->prod_value->TotalBytes(),
+                             " bytes, expected: ", num_bytes);
+      }
+    }
+    if (s.ok() && num_bytes > 0) {
+      // Only host memory can be copied into the segment.
+      const bool on_host =
+          hook->prod_dev->attributes().device_type() == "CPU" ||
+          hook->prod_attr.on_host();
+      if (!on_host) {
+        Tensor* cpu_tensor =
+            new Tensor(cpu_allocator(), hook->prod_value->dtype(),
+                       hook->prod_value->shape());
+        hook->prod_ctx->CopyDeviceTensorToCPU(
+            hook->prod_value, "empty_name", hook->prod_dev, cpu_tensor,
+            [inbox, slot_idx, generation, hook, cpu_tensor](const Status& s) {
+              CompleteRequest(inbox.get(), slot_idx, generation, cpu_tensor,
+                              s);
+              BufRendezvous::DoneWithHook(hook);
+              delete cpu_tensor;
+            });
+        return;
+      }
+    }
+    CompleteRequest(inbox.get(), slot_idx, generation,
+                    hook != nullptr ? hook->prod_value : nullptr, s);
+    if (hook != nullptr) BufRendezvous::DoneWithHook(hook);
+  };
+  rma->buf_rendezvous()->ConsumeBuf(key, device, incarnation,
+                                    consumer_callback,
+                                    /*cancellation_manager=*/nullptr);
+}
+
+/*static*/
+void CollectiveShmTransport::CompleteRequest(Segment* inbox, int slot_idx,
+                                             uint32 generation,
+                                             const Tensor* value,
+                                             const Status& s) {
+  SlotHeader& slot = inbox->slot(slot_idx);
+  uint64 word = SlotWord(generation, kServing);
+  if (!slot.state.compare_exchange_strong(word,
+                                          SlotWord(generation, kCompleting),
+                                          std::memory_order_acq_rel)) {
+    // The receiver abandoned the request, or stopped renewing its lease.
+    return;
+  }
+  if (s.ok() && slot.num_bytes > 0) {
+    memcpy(inbox->data(slot_idx), DMAHelper::base(value), slot.num_bytes);
+  }
+  slot.code = static_cast<int32>(s.code());
+  const string message(s.message().substr(0, kMaxMessageBytes));
+  CopyField(message, slot.message, &slot.message_len);
+  slot.state.store(SlotWord(generation, kDone), std::memory_order_release);
+  InboxHeader* header = inbox->header();
+  header->completions.fetch_add(1, std::memory_order_release);
+  FutexWake(&header->completions, INT_MAX);
+}
+
+void CollectiveShmTransport::CompletionLoop(Peer* peer) {
+  Segment* segment = peer->segment.get();
+  InboxHeader* header = segment->header();
+  while (true) {
+    const uint32 seen = header->completions.load(std::memory_order_acquire);
+    std::vector<std::unique_ptr<PendingRecv>> completed;
+    std::vector<std::pair<std::unique_ptr<PendingRecv>, Status>> failed;
+    {
+      mutex_lock l(mu_);
+      if (shutdown_) return;
+      const bool alive = PeerAlive(peer);
+      for (auto it = pending_.begin(); it != pending_.end();) {
+        auto curr = it++;
+        PendingRecv* recv = curr->second.get();
+        if (recv->peer != peer) continue;
+        SlotHeader& slot = segment->slot(recv->slot_idx);
+        const uint64 word = slot.state.load(std::memory_order_acquire);
+        if (word == SlotWord(recv->generation, kDone)) {
+          completed.push_back(std::move(curr->second));
+        } else if (Generation(word) != recv->generation) {
+          failed.emplace_back(
+              std::move(curr->second),
+              errors::Unavailable("collective shared memory slot was "
+                                  "reclaimed by the peer"));
+        } else if (!alive) {
+          failed.emplace_back(
+              std::move(curr->second),
+              errors::Unavailable("collective shared memory peer went away"));
+        } else {
+          slot.lease.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        pending_.erase(curr);
+      }
+    }
+    for (auto& recv : completed) {
+      SlotHeader& slot = segment->slot(recv->slot_idx);
+      Status s(static_cast<absl::StatusCode>(slot.code),
+               absl::string_view(slot.message, slot.message_len));
+      if (s.ok() && slot.num_bytes > 0) {
+        memcpy(DMAHelper::base(recv->to_tensor), segment->data(recv->slot_idx),
+               slot.num_bytes);
+      }
+      // If the owner reclaimed the slot meanwhile, what was read may belong
+      // to the next request.
+      uint64 word = SlotWord(recv->generation, kDone);
+      if (!slot.state.compare_exchange_strong(
+              word, SlotWord(recv->generation + 1, kFree),
+              std::memory_order_acq_rel)) {
+        s = errors::Unavailable(
+            "collective shared memory slot was reclaimed by the peer");
+      }
+      Finish(std::move(recv), s);
+    }
+    for (auto& it : failed) {
+      Finish(std::move(it.first), it.second);
+    }
+    if (completed.empty()) {
+      FutexWait(&header->completions, seen, kPollMicros);
+    }
+  }
+}
+
+}  // namespace tensorflow
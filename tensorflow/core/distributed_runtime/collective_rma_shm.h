@@ -0,0 +1,150 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_COLLECTIVE_RMA_SHM_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_COLLECTIVE_RMA_SHM_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+
+// Moves collective buffers between tasks that run on the same host through
+// POSIX shared memory instead of RecvBuf RPCs.
+//
+// Every task that enables the transport creates an inbox segment named after
+// the task under /dev/shm, holding a fixed number of request slots with a
+// data area each.  To receive a buffer from a peer, a task claims a slot in
+// the peer's inbox, writes the BufRendezvous key into it and wakes the peer
+// through a futex.  The peer's service thread consumes the buffer from the
+// step's BufRendezvous, copies it into the slot and wakes the receiver, which
+// copies it out into the destination tensor.  A peer counts as co-located
+// when its inbox can be opened and its heartbeat advances, so tasks on other
+// hosts, tasks that have not enabled the transport and buffers larger than a
+// slot all fall back to RPC.
+//
+// Liveness is tracked with leases rather than process ids, which are not
+// comparable across PID namespaces.  The owner of an inbox bumps a heartbeat
+// counter while it serves requests, and receivers give up on a peer whose
+// heartbeat stops.  Receivers renew a lease counter in every slot they hold,
+// and the owner frees the slots whose lease stops, e.g. because the receiver
+// crashed.  Each slot carries a generation that is bumped whenever the slot
+// is freed, so a party that lost its slot cannot mistake the next use of the
+// slot for its own.
+//
+// The transport is enabled by setting ConfigProto.Experimental
+// .collective_shm_namespace to the same value in every task of a job.
+// Only Linux is supported.
+class CollectiveShmTransport {
+ public:
+  // Returns nullptr if the transport is disabled in `config` or unsupported,
+  // or if the inbox of `task_name` cannot be created.  `mgr` resolves the
+  // step of incoming requests and must outlive the transport.
+  static std::unique_ptr<CollectiveShmTransport> Create(
+      const ConfigProto& config, const string& task_name,
+      CollectiveExecutorMgrInterface* mgr);
+
+  // Stops serving requests, removes the inbox and fails the receives that
+  // are still outstanding.
+  ~CollectiveShmTransport();
+
+  // Starts receiving the buffer that `peer_device` in `peer_task` provides
+  // under `key` into the host memory of `to_tensor`.  Returns a non-zero id
+  // if the receive was started, in which case `done` is eventually called,
+  // or 0 if the peer cannot be reached through shared memory, in which case
+  // `done` is not called and the caller should use RPC instead.
+  int64_t RecvBuf(const string& peer_task, int64_t step_id, const string& key,
+                  const string& peer_device, uint64 peer_incarnation,
+                  Tensor* to_tensor, CancellationManager* cancellation_manager,
+                  const StatusCallback& done);
+
+  // Abandons the receive `id` and calls its `done` with `s`, unless it has
+  // already completed.
+  void Cancel(int64_t id, const Status& s);
+
+  // Returns the name of the inbox segment of `task_name`.
+  static string SegmentName(const string& name_space, const string& task_name);
+
+ private:
+  struct Segment;
+  struct Peer;
+  struct PendingRecv;
+  struct SlotLease;
+
+  CollectiveShmTransport(CollectiveExecutorMgrInterface* mgr,
+                         const string& name_space,
+                         std::shared_ptr<Segment> inbox);
+
+  // Creates the inbox `name` with slots of `slot_bytes` if `create`, else
+  // maps an existing one.  Returns nullptr on failure.
+  static std::shared_ptr<Segment> MapSegment(const string& name, bool create,
+                                             int64_t slot_bytes);
+
+  // Publishes the result of the request in `slot_idx` of `inbox`, copying
+  // `value` into the slot if `s` is OK.  Does nothing if the request of
+  // `generation` was abandoned in the meantime.
+  static void CompleteRequest(Segment* inbox, int slot_idx, uint32 generation,
+                              const Tensor* value, const Status& s);
+
+  // Returns the mapped inbox of `peer_task`, or nullptr if it is not
+  // available.  Failed lookups are retried at most once per second.
+  Peer* GetPeer(const string& peer_task) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Returns true if the heartbeat of `peer` advanced within the lease.  A
+  // newly mapped peer counts as alive only once its heartbeat was seen to
+  // advance, so that inboxes left behind by crashed tasks are not used.
+  bool PeerAlive(Peer* peer) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Waits for and dispatches the requests posted to our inbox.
+  void ServeLoop();
+  void Serve(int slot_idx, uint32 generation);
+
+  // Frees the slots of our inbox whose receiver stopped renewing its lease.
+  // Only called by the serve thread.
+  void ReclaimStaleSlots();
+
+  // Waits for the completions of our requests to `peer`.
+  void CompletionLoop(Peer* peer);
+
+  // Deregisters the cancellation callback of `recv` and calls its `done`.
+  static void Finish(std::unique_ptr<PendingRecv> recv, const Status& s);
+
+  CollectiveExecutorMgrInterface* const mgr_;  // Not owned.
+  const string name_space_;
+  std::shared_ptr<Segment> inbox_;
+  std::unique_ptr<Thread> serve_thread_;
+  std::vector<SlotLease> slot_leases_;  // Only used by the serve thread.
+
+  mutex mu_;
+  bool shutdown_ TF_GUARDED_BY(mu_) = false;
+  int64_t next_id_ TF_GUARDED_BY(mu_) = 1;
+  absl::flat_hash_map<string, std::unique_ptr<Peer>> peers_ TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<int64_t, std::unique_ptr<PendingRecv>> pending_
+      TF_GUARDED_BY(mu_);
+
+  CollectiveShmTransport(const CollectiveShmTransport&) = delete;
+  void operator=(const CollectiveShmTransport&) = delete;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_COLLECTIVE_RMA_SHM_H_
@@ -0,0 +1,335 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/distributed_runtime/collective_rma_shm.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+namespace {
+
+const char kServerTask[] = "/job:worker/replica:0/task:0";
+const char kClientTask[] = "/job:worker/replica:0/task:1";
+const char kDevice[] = "/job:worker/replica:0/task:0/device:CPU:0";
+const uint64 kIncarnation = 12345;
+const int64_t kStepId = 7;
+// The number of slots of an inbox.
+const int kNumSlots = 16;
+// Longer than the lease of a slot.
+const uint64 kDeadlineMicros = 30 * 1000 * 1000;
+
+class FakeDevice : public Device {
+ public:
+  explicit FakeDevice(const DeviceAttributes& attrs) : Device(nullptr, attrs) {}
+  Status Sync() override { return absl::OkStatus(); }
+  Allocator* GetAllocator(AllocatorAttributes) override {
+    return cpu_allocator();
+  }
+};
+
+ConfigProto ShmConfig() {
+  ConfigProto config;
+  config.mutable_experimental()->set_collective_shm_namespace(
+      strings::StrCat("test", getpid()));
+  config.mutable_experimental()->set_collective_shm_slot_bytes(65536);
+  return config;
+}
+
+// The device, BufRendezvous and transport of one task.
+struct Task {
+  Task(const ConfigProto& config, const string& task_name) {
+    DeviceAttributes attrs;
+    attrs.set_name(kDevice);
+    attrs.set_device_type(DEVICE_CPU);
+    attrs.set_incarnation(kIncarnation);
+    std::vector<std::unique_ptr<Device>> devices;
+    devices.push_back(std::make_unique<FakeDevice>(attrs));
+    dev_mgr = std::make_unique<StaticDeviceMgr>(std::move(devices));
+    TF_CHECK_OK(dev_mgr->LookupDevice(kDevice, &device));
+    rma = std::make_unique<CollectiveRemoteAccessLocal>(
+        dev_mgr.get(), /*dev_resolver=*/nullptr, kStepId);
+    cem = std::make_unique<TestCollectiveExecutorMgr>(
+        /*param_resolver=*/nullptr, rma.get());
+    transport = CollectiveShmTransport::Create(config, task_name, cem.get());
+  }
+
+  void Provide(const string& key, Tensor* value, Notification* consumed) {
+    rma->buf_rendezvous()->ProvideBuf(
+        key, device, /*dev_ctx=*/nullptr, value, AllocatorAttributes(),
+        [consumed](const Status& s) {
+          TF_EXPECT_OK(s);
+          consumed->Notify();
+        },
+        /*cancellation_manager=*/nullptr);
+  }
+
+  int64_t Recv(const string& key, uint64 incarnation, Tensor* to_tensor,
+               CancellationManager* cm, Status* status, Notification* done) {
+    return transport->RecvBuf(kServerTask, kStepId, key, kDevice, incarnation,
+                              to_tensor, cm, [status, done](const Status& s) {
+                                *status = s;
+                                done->Notify();
+                              });
+  }
+
+  // Retries until the transport takes the receive, e.g. once the heartbeat
+  // of the server was seen or a slot became free.
+  int64_t RecvWhenReady(const string& key, Tensor* to_tensor, Status* status,
+                        Notification* done) {
+    const uint64 deadline = Env::Default()->NowMicros() + kDeadlineMicros;
+    while (Env::Default()->NowMicros() < deadline) {
+      int64_t id = Recv(key, kIncarnation, to_tensor, nullptr, status, done);
+      if (id != 0) return id;
+      Env::Default()->SleepForMicroseconds(10 * 1000);
+    }
+    return 0;
+  }
+
+  std::unique_ptr<DeviceMgr> dev_mgr;
+  Device* device = nullptr;
+  std::unique_ptr<CollectiveRemoteAccessLocal> rma;
+  std::unique_ptr<TestCollectiveExecutorMgr> cem;
+  std::unique_ptr<CollectiveShmTransport> transport;
+};
+
+// Runs the serving side of kServerTask and the receiving side of kClientTask
+// in one process.  The segments of the two tasks are distinct, so requests
+// still go through shared memory and the futexes.
+class CollectiveShmTransportTest : public ::testing::Test {
+ protected:
+  CollectiveShmTransportTest()
+      : server_(ShmConfig(), kServerTask), client_(ShmConfig(), kClientTask) {}
+
+  void SetUp() override {
+    ASSERT_NE(server_.transport, nullptr);
+    ASSERT_NE(client_.transport, nullptr);
+    // Waits until the client saw the heartbeat of the server.
+    Tensor warmup = test::AsTensor<int32>({0});
+    Tensor received(DT_INT32, TensorShape({1}));
+    Status status;
+    Notification done, consumed;
+    server_.Provide("warmup", &warmup, &consumed);
+    ASSERT_NE(0, client_.RecvWhenReady("warmup", &received, &status, &done));
+    done.WaitForNotification();
+    consumed.WaitForNotification();
+    TF_ASSERT_OK(status);
+  }
+
+  void Provide(const string& key, Tensor* value, Notification* consumed) {
+    server_.Provide(key, value, consumed);
+  }
+
+  int64_t Recv(const string& key, uint64 incarnation, Tensor* to_tensor,
+               CancellationManager* cm, Status* status, Notification* done) {
+    return client_.Recv(key, incarnation, to_tensor, cm, status, done);
+  }
+
+  Task server_;
+  Task client_;
+};
+
+TEST(CollectiveShmTransportConfigTest, DisabledByDefault) {
+  Task task(ConfigProto(), kServerTask);
+  EXPECT_EQ(task.transport, nullptr);
+}
+
+TEST_F(CollectiveShmTransportTest, SegmentName) {
+  EXPECT_EQ("/tf_coll_ns_1__job_worker_replica_0_task_3",
+            CollectiveShmTransport::SegmentName("ns-1", "/job:worker/"
+                                                        "replica:0/task:3"));
+}
+
+TEST_F(CollectiveShmTransportTest, ConsumerFirst) {
+  Tensor expected = test::AsTensor<float>({1, 2, 3, 4, 5, 6, 7, 8});
+  Tensor received(DT_FLOAT, TensorShape({8}));
+  Status status;
+  Notification done, consumed;
+  EXPECT_NE(0, Recv("key0", kIncarnation, &received, nullptr, &status, &done));
+  Provide("key0", &expected, &consumed);
+  done.WaitForNotification();
+  consumed.WaitForNotification();
+  TF_EXPECT_OK(status);
+  test::ExpectTensorEqual<float>(expected, received);
+}
+
+TEST_F(CollectiveShmTransportTest, ProducerFirstManyTimes) {
+  // More transfers than slots, so slots must be recycled.
+  for (int i = 0; i < 40; ++i) {
+    const string key = strings::StrCat("key", i);
+    Tensor expected = test::AsTensor<int32>({i, i + 1, i + 2});
+    Tensor received(DT_INT32, TensorShape({3}));
+    Status status;
+    Notification done, consumed;
+    Provide(key, &expected, &consumed);
+    ASSERT_NE(0, Recv(key, kIncarnation, &received, nullptr, &status, &done));
+    done.WaitForNotification();
+    consumed.WaitForNotification();
+    TF_EXPECT_OK(status);
+    test::ExpectTensorEqual<int32>(expected, received);
+  }
+}
+
+TEST_F(CollectiveShmTransportTest, PropagatesErrors) {
+  Tensor received(DT_FLOAT, TensorShape({8}));
+  Status status;
+  Notification done;
+  EXPECT_NE(0, Recv("key0", kIncarnation + 1, &received, nullptr, &status,
+                    &done));
+  done.WaitForNotification();
+  EXPECT_TRUE(errors::IsFailedPrecondition(status)) << status;
+}
+
+TEST_F(CollectiveShmTransportTest, FallsBackToRpc) {
+  Status status;
+  Notification done;
+  // Larger than a slot.
+  Tensor large(DT_FLOAT, TensorShape({65536}));
+  EXPECT_EQ(0, Recv("key0", kIncarnation, &large, nullptr, &status, &done));
+  // No transport in the peer task.
+  Tensor small(DT_FLOAT, TensorShape({8}));
+  EXPECT_EQ(0, client_.transport->RecvBuf(
+                   "/job:worker/replica:0/task:9", kStepId, "key0", kDevice,
+                   kIncarnation, &small, nullptr, [](const Status&) {}));
+  EXPECT_FALSE(done.HasBeenNotified());
+}
+
+TEST_F(CollectiveShmTransportTest, Cancel) {
+  Tensor received(DT_FLOAT, TensorShape({8}));
+  Status status;
+  Notification done;
+  CancellationManager cm;
+  EXPECT_NE(0, Recv("never", kIncarnation, &received, &cm, &status, &done));
+  cm.StartCancel();
+  done.WaitForNotification();
+  EXPECT_TRUE(errors::IsCancelled(status)) << status;
+}
+
+// The server runs in a child process, so the transfer crosses processes.
+TEST(CollectiveShmTransportTwoProcessTest, Transfer) {
+  const ConfigProto config = ShmConfig();
+  int received_fds[2];
+  ASSERT_EQ(0, pipe(received_fds));
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    int exit_code = 1;
+    {
+      Task server(config, kServerTask);
+      if (server.transport != nullptr) {
+        Tensor value = test::AsTensor<float>({1, 2, 3, 4});
+        Notification consumed;
+        server.Provide("key0", &value, &consumed);
+        consumed.WaitForNotification();
+        // Keeps serving until the parent has read the buffer.
+        char c;
+        if (read(received_fds[0], &c, 1) == 1) exit_code = 0;
+      }
+    }
+    _exit(exit_code);
+  }
+  Task client(config, kClientTask);
+  ASSERT_NE(client.transport, nullptr);
+  Tensor received(DT_FLOAT, TensorShape({4}));
+  Status status;
+  Notification done;
+  EXPECT_NE(0, client.RecvWhenReady("key0", &received, &status, &done));
+  if (WaitForNotificationWithTimeout(&done, kDeadlineMicros)) {
+    TF_EXPECT_OK(status);
+    test::ExpectTensorEqual<float>(test::AsTensor<float>({1, 2, 3, 4}),
+                                   received);
+  } else {
+    ADD_FAILURE() << "receive did not complete";
+  }
+  const char c = 0;
+  ASSERT_EQ(1, write(received_fds[1], &c, 1));
+  int wstatus;
+  ASSERT_EQ(pid, waitpid(pid, &wstatus, 0));
+  EXPECT_TRUE(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0) << wstatus;
+  close(received_fds[0]);
+  close(received_fds[1]);
+}
+
+// A receiver in a child process claims every slot of the server and dies
+// without giving them back.  The server frees them once their leases expire.
+TEST(CollectiveShmTransportTwoProcessTest, ReclaimsSlotsOfDeadReceiver) {
+  const ConfigProto config = ShmConfig();
+  Task server(config, kServerTask);
+  ASSERT_NE(server.transport, nullptr);
+  int claimed_fds[2];
+  ASSERT_EQ(0, pipe(claimed_fds));
+  const pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    // Nothing is cleaned up on exit, as if the task crashed.
+    Task* client = new Task(config, kClientTask);
+    if (client->transport == nullptr) _exit(1);
+    for (int i = 0; i < kNumSlots; ++i) {
+      if (client->RecvWhenReady(strings::StrCat("never", i),
+                                new Tensor(DT_FLOAT, TensorShape({4})),
+                                new Status, new Notification) == 0) {
+        _exit(1);
+      }
+    }
+    const char c = 0;
+    _exit(write(claimed_fds[1], &c, 1) == 1 ? 0 : 1);
+  }
+  char c;
+  ASSERT_EQ(1, read(claimed_fds[0], &c, 1));
+  int wstatus;
+  ASSERT_EQ(pid, waitpid(pid, &wstatus, 0));
+  ASSERT_TRUE(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0) << wstatus;
+  close(claimed_fds[0]);
+  close(claimed_fds[1]);
+  shm_unlink(CollectiveShmTransport::SegmentName(
+                 config.experimental().collective_shm_namespace(), kClientTask)
+                 .c_str());
+
+  Task client(config, "/job:worker/replica:0/task:2");
+  ASSERT_NE(client.transport, nullptr);
+  Tensor expected = test::AsTensor<float>({5, 6, 7, 8});
+  Tensor received(DT_FLOAT, TensorShape({4}));
+  Status status;
+  Notification done, consumed;
+  server.Provide("key0", &expected, &consumed);
+  const uint64 start_micros = Env::Default()->NowMicros();
+  ASSERT_NE(0, client.RecvWhenReady("key0", &received, &status, &done));
+  // The slots stay busy for the lease.
+  EXPECT_GE(Env::Default()->NowMicros() - start_micros, 1000 * 1000);
+  done.WaitForNotification();
+  consumed.WaitForNotification();
+  TF_EXPECT_OK(status);
+  test::ExpectTensorEqual<float>(expected, received);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/worker_env.h"
 #include "tensorflow/core/framework/rendezvous.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/types.h"
 
@@ -90,6 +91,18 @@ class RendezvousMgrInterface {
                               const Rendezvous::ParsedKey& parsed,
                               Rendezvous::DoneCallback done) = 0;
 
+  // Like RecvLocalAsync, but does not wait for the tensor: if it has not been
+  // sent yet, runs "done" right away with an Unavailable error and leaves the
+  // rendezvous as it was.  Callers may then wait for it with RecvLocalAsync.
+  //
+  // This method is used by the rpc handler of BatchRecvTensor.
+  virtual void RecvLocalIfReadyAsync(int64_t step_id,
+                                     const Rendezvous::ParsedKey& parsed,
+                                     Rendezvous::DoneCallback done) {
+    done(errors::Unavailable("RecvLocalIfReadyAsync is not supported"),
+         Rendezvous::Args(), Rendezvous::Args(), Tensor(), false);
+  }
+
   // Synchronous wrapper for RecvLocalAsync.
   virtual Status RecvLocal(int64_t step_id, const Rendezvous::ParsedKey& parsed,
                            Tensor* val, bool* is_dead) = 0;
@@ -65,6 +65,7 @@ class GrpcRemoteWorker : public WorkerInterface {
         instancesource_(Method(GrpcWorkerMethod::kCompleteInstance)),
         getstepsequence_(Method(GrpcWorkerMethod::kGetStepSequence)),
         markrecvfinished_(Method(GrpcWorkerMethod::kMarkRecvFinished)),
+        batchrecvtensor_(Method(GrpcWorkerMethod::kBatchRecvTensor)),
         logger_(logger),
         target_(target) {}
 
@@ -257,6 +258,32 @@ class GrpcRemoteWorker : public WorkerInterface {
     IssueRequest(request, response, recvtensor_, callback, call_opts);
   }
 
+  void BatchRecvTensorAsync(CallOptions* call_opts,
+                            const BatchRecvTensorRequest* request,
+                            BatchRecvTensorResponse* response,
+                            StatusCallback done) override {
+    VLOG(1) << "BatchRecvTensorAsync for " << request->requests_size()
+            << " tensors";
+    auto callback = [this, request, response, done](Status s) {
+      if (s.ok() && response->responses_size() != request->requests_size()) {
+        s = errors::Internal("BatchRecvTensor returned ",
+                             response->responses_size(), " tensors for ",
+                             request->requests_size(), " requests");
+      }
+      if (s.ok()) {
+        for (int i = 0; i < response->responses_size(); ++i) {
+          if (response->responses(i).require_ack()) {
+            IssueMarkRecvFinishedRequest(request->requests(i).request_id());
+          }
+        }
+      }
+      // Note done() can delete this worker object, so we need to call done()
+      // last.
+      done(s);
+    };
+    IssueRequest(request, response, batchrecvtensor_, callback, call_opts);
+  }
+
   void LoggingAsync(const LoggingRequest* request, LoggingResponse* response,
                     StatusCallback done) override {
     IssueRequest(request, response, logging_, done);
@@ -332,6 +359,7 @@ class GrpcRemoteWorker : public WorkerInterface {
   const ::grpc::string instancesource_;
   const ::grpc::string getstepsequence_;
   const ::grpc::string markrecvfinished_;
+  const ::grpc::string batchrecvtensor_;
 
   // Support for logging.
   WorkerCacheLogger* logger_;
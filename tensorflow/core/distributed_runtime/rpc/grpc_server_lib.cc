@@ -92,8 +92,9 @@ class ReusePortOption : public ::grpc::ServerBuilderOption {
 };
 
 // static utility function
-RendezvousMgrInterface* NewRpcRendezvousMgr(const WorkerEnv* env) {
-  return new RpcRendezvousMgr(env);
+RendezvousMgrInterface* NewRpcRendezvousMgr(const WorkerEnv* env,
+                                            const ConfigProto& config) {
+  return new RpcRendezvousMgr(env, config);
 }
 
 }  // namespace
@@ -230,7 +231,9 @@ Status GrpcServer::Init(const GrpcServerOptions& opts) {
   worker_env_.experimental_num_shards = master_env_.experimental_num_shards;
 
   worker_env_.rendezvous_mgr = opts.rendezvous_mgr_func == nullptr
-                                   ? new RpcRendezvousMgr(&worker_env_)
+                                   ? new RpcRendezvousMgr(
+                                         &worker_env_,
+                                         server_def_.default_session_config())
                                    : opts.rendezvous_mgr_func(&worker_env_);
   string unused;
   string default_worker_name;
@@ -608,7 +611,10 @@ Status GrpcServer::Create(const ServerDef& server_def, Env* env,
   std::unique_ptr<GrpcServer> ret(
       new GrpcServer(server_def, env == nullptr ? Env::Default() : env));
   GrpcServerOptions options;
-  options.rendezvous_mgr_func = NewRpcRendezvousMgr;
+  options.rendezvous_mgr_func =
+      [config = server_def.default_session_config()](const WorkerEnv* env) {
+        return NewRpcRendezvousMgr(env, config);
+      };
   options.local_device_mgr = local_device_mgr;
   Status s = ret->Init(options);
   if (!s.ok()) {
@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
 
+#include <string>
+#include <vector>
+
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
@@ -22,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_reference.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/io/proto_encode_helper.h"
 #include "tensorflow/core/platform/env.h"
@@ -134,9 +138,109 @@ static void EncodeSkeleton(const Tensor& val, io::ProtoEncodeHelper* e) {
 #endif
 }
 
+// Tensor data, or string elements, larger than this are not copied into the
+// ByteBuffer: the slices holding them point into the tensor's buffer instead.
+static const int kLargeTensorBytes = 1024;
+
+// Encodes (A) through (D2) of the layout described above into "*space", for a
+// tensor "val" whose tensor_content is "content_bytes" long.  "header" is (A).
+// Returns the size of the complete encoding, including the content.
+static size_t EncodeUpToTensorContent(const string& header, const Tensor& val,
+                                      size_t content_bytes,
+                                      gtl::InlinedVector<char, 1024>* space) {
+  // skeleton is the encoded TensorProto contents (dtype and shape), but
+  // not the actual data
+  gtl::InlinedVector<char, 128> skeleton(SkeletonEncodingSizeUpperBound(val));
+  io::ProtoEncodeHelper e_skeleton(skeleton.data(), skeleton.size());
+  EncodeSkeleton(val, &e_skeleton);
+
+  uint32 overall_tensor_proto_bytesize =
+      (e_skeleton.size() +
+       VarLengthEncodingSize(TensorProto::kTensorContentFieldNumber,
+                             content_bytes));
+  size_t expected_size =
+      (header.size() +
+       VarLengthEncodingSize(RecvTensorResponse::kTensorFieldNumber,
+                             overall_tensor_proto_bytesize));
+
+  space->resize(expected_size - content_bytes);
+  io::ProtoEncodeHelper e(space->data(), space->size());
+  // (A)
+  e.WriteRawBytes(header);
+
+  // (B1) & (B2)
+  e.WriteVarlengthBeginning(RecvTensorResponse::kTensorFieldNumber,
+                            overall_tensor_proto_bytesize);
+  // (C)
+  e.WriteRawBytes(StringPiece(e_skeleton.data(), e_skeleton.size()));
+  // (D1) & (D2)
+  e.WriteVarlengthBeginning(TensorProto::kTensorContentFieldNumber,
+                            content_bytes);
+  DCHECK_EQ(e.size(), space->size());
+  return expected_size;
+}
+
+// Encodes the string tensor "val" with (E) in the format of
+// port::EncodeStringList, as used by TensorProto::tensor_content: the varint32
+// lengths of all elements followed by their bytes.  The lengths and the small
+// elements are copied into slices; elements of at least kLargeTensorBytes get
+// slices that point into "val" and keep its buffer alive.
+static void EncodeStringTensorToByteBuffer(const string& header,
+                                           const Tensor& val,
+                                           ::grpc::ByteBuffer* result) {
+  const auto strings = val.flat<tstring>();
+  const int64_t num_elements = strings.size();
+  size_t content_bytes = 0;
+  for (int64_t i = 0; i < num_elements; ++i) {
+    content_bytes += core::VarintLength(strings(i).size()) + strings(i).size();
+  }
+
+  gtl::InlinedVector<char, 1024> space;
+  const size_t expected_size =
+      EncodeUpToTensorContent(header, val, content_bytes, &space);
+
+  std::vector<::grpc::Slice> slices;
+  // Bytes of the slice being assembled.
+  string pending(space.data(), space.size());
+  for (int64_t i = 0; i < num_elements; ++i) {
+    core::PutVarint32(&pending, strings(i).size());
+  }
+  const TensorBuffer* buf = DMAHelper::buffer(&val);
+  for (int64_t i = 0; i < num_elements; ++i) {
+    const tstring& element = strings(i);
+    // Views do not live in the tensor's buffer, so they are always copied.
+    if (element.size() < kLargeTensorBytes ||
+        element.type() == tstring::VIEW) {
+      pending.append(element.data(), element.size());
+      continue;
+    }
+    if (!pending.empty()) {
+      slices.emplace_back(pending.data(), pending.size());
+      pending.clear();
+    }
+    buf->Ref();
+    slices.emplace_back(
+        const_cast<void*>(static_cast<const void*>(element.data())),
+        element.size(),
+        [](void* backing) { static_cast<TensorBuffer*>(backing)->Unref(); },
+        const_cast<TensorBuffer*>(buf));
+  }
+  if (!pending.empty()) {
+    slices.emplace_back(pending.data(), pending.size());
+  }
+
+  size_t total_bytes = 0;
+  for (const ::grpc::Slice& slice : slices) {
+    total_bytes += slice.size();
+  }
+  CHECK_EQ(total_bytes, expected_size);
+
+  ::grpc::ByteBuffer tmp(slices.data(), slices.size());
+  result->Swap(&tmp);
+}
+
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
                               ::grpc::ByteBuffer* result) {
-  const int kLargeTensorBytes = 1024;
   const int64_t kProtoBufLimitBytes = 1LL << 31;
 
   if (val.TotalBytes() > kProtoBufLimitBytes) {
@@ -153,7 +257,11 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
   }
   response.set_require_ack(require_ack);
   response.set_send_start_micros(Env::Default()->NowMicros());
-  if (!DataTypeCanUseMemcpy(val.dtype())) {
+  if (val.dtype() == DT_STRING) {
+    string header;  // All of RecvTensorResponse except the tensor() field
+    response.AppendToString(&header);
+    EncodeStringTensorToByteBuffer(header, val, result);
+  } else if (!DataTypeCanUseMemcpy(val.dtype())) {
     // Straightforward but slow path for complicated kinds of tensor data
     // TODO(jeff,sanjay): If this becomes an issue, we could
     // go directly from val -> ByteBuffer, with some effort.
@@ -162,24 +270,10 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
     // Encode full protocol buffer to a ByteBuffer
     EncodeRecvTensorResponseToByteBuffer(response, result);
   } else {
-    // skeleton is the encoded TensorProto contents (dtype and shape), but
-    // not the actual data
-    gtl::InlinedVector<char, 128> skeleton(SkeletonEncodingSizeUpperBound(val));
-    io::ProtoEncodeHelper e_skeleton(skeleton.data(), skeleton.size());
-    EncodeSkeleton(val, &e_skeleton);
-
     StringPiece tdata = val.tensor_data();
-    uint32 overall_tensor_proto_bytesize =
-        (e_skeleton.size() +
-         VarLengthEncodingSize(TensorProto::kTensorContentFieldNumber,
-                               tdata.size()));
     string header;  // All of RecvTensorResponse except the tensor() field
     response.AppendToString(&header);
 
-    size_t expected_size =
-        (header.size() +
-         VarLengthEncodingSize(RecvTensorResponse::kTensorFieldNumber,
-                               overall_tensor_proto_bytesize));
     // If "share_tensor_slice_memory == false", we copy the tensor data to
     // the end of the buffer we are preparing that holds the rest of the
     // RecvTensorResponse protocol buffer.
@@ -192,23 +286,11 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
     // We enable this behavior if the tensor is large.
     bool share_tensor_slice_memory = (tdata.size() > kLargeTensorBytes);
 
-    size_t encoder_size = expected_size - tdata.size();
-
     // Encode all but the actual "tdata", but including the tag and
     // varlength header for the "tdata"
-    gtl::InlinedVector<char, 1024> space(encoder_size);
-    io::ProtoEncodeHelper e(space.data(), space.size());
-    // (A)
-    e.WriteRawBytes(header);
-
-    // (B1) & (B2)
-    e.WriteVarlengthBeginning(RecvTensorResponse::kTensorFieldNumber,
-                              overall_tensor_proto_bytesize);
-    // (C)
-    e.WriteRawBytes(StringPiece(e_skeleton.data(), e_skeleton.size()));
-    // (D1) & (D2)
-    e.WriteVarlengthBeginning(TensorProto::kTensorContentFieldNumber,
-                              tdata.size());
+    gtl::InlinedVector<char, 1024> space;
+    const size_t expected_size =
+        EncodeUpToTensorContent(header, val, tdata.size(), &space);
 
     // All but the tensor backing store are serialized now
 
@@ -217,13 +299,14 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
     int num_slices = 0;
     {
       size_t slice_len =
-          e.size() + (share_tensor_slice_memory ? 0 : tdata.size());
+          space.size() + (share_tensor_slice_memory ? 0 : tdata.size());
       slices[0] = ::grpc::Slice(slice_len);
-      memcpy(const_cast<uint8_t*>(slices[0].begin()), e.data(), e.size());
+      memcpy(const_cast<uint8_t*>(slices[0].begin()), space.data(),
+             space.size());
       if (!share_tensor_slice_memory) {
         // (E)
-        memcpy(const_cast<uint8_t*>(slices[0].begin()) + e.size(), tdata.data(),
-               tdata.size());
+        memcpy(const_cast<uint8_t*>(slices[0].begin()) + space.size(),
+               tdata.data(), tdata.size());
       }
       num_slices += 1;
     }
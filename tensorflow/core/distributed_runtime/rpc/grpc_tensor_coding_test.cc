@@ -100,4 +100,21 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(GrpcTensorCodingTest, LargeStringElements) {
+  Tensor a(DT_STRING, TensorShape({4}));
+  test::FillValues<tstring>(&a, {"small", string(5000, 'a'), "",
+                                 string(2000, 'b')});
+  Validate(a, false);
+
+  // The two large elements are sent from the tensor's own buffer, each in a
+  // slice of its own.
+  ::grpc::ByteBuffer buf;
+  grpc::EncodeTensorToByteBuffer(false, a, false, &buf);
+  std::vector<::grpc::Slice> slices;
+  (void)buf.Dump(&slices);
+  ASSERT_EQ(slices.size(), 3);
+  EXPECT_EQ(slices[1].size(), 5000);
+  EXPECT_EQ(slices[2].size(), 2000);
+}
+
 }  // namespace tensorflow
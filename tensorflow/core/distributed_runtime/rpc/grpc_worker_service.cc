@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service.h"
 
+#include <atomic>
 #include <deque>
 #include <memory>
 #include <unordered_map>
@@ -38,6 +39,7 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service_impl.h"
+#include "tensorflow/core/distributed_runtime/rpc/rpc_encoded_response_cache.h"
 #include "tensorflow/core/distributed_runtime/rpc/rpc_response_cache.h"
 #include "tensorflow/core/distributed_runtime/worker.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
@@ -45,6 +47,7 @@ limitations under the License.
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
@@ -144,7 +147,6 @@ class GrpcWorkerServiceThread {
     SETUP_FOR_REQUEST(CompleteGroup, 10, true);
     SETUP_FOR_REQUEST(CompleteInstance, 10, true);
     SETUP_FOR_REQUEST(GetStepSequence, 10, true);
-    SETUP_FOR_REQUEST(RecvBuf, 500, true);
     SETUP_FOR_REQUEST(RunGraph, 100, true);
     SETUP_FOR_REQUEST(CleanupGraph, 100, false);
     SETUP_FOR_REQUEST(MarkRecvFinished, 10, false);
@@ -158,6 +160,20 @@ class GrpcWorkerServiceThread {
          ++i) {
       EnqueueRecvTensorRequestRaw();
     }
+    for (int i = 0;
+         i < gtl::FindWithDefault(
+                 queue_depth_,
+                 static_cast<int>(GrpcWorkerMethod::kBatchRecvTensor), 100);
+         ++i) {
+      EnqueueBatchRecvTensorRequestRaw();
+    }
+    for (int i = 0;
+         i < gtl::FindWithDefault(
+                 queue_depth_, static_cast<int>(GrpcWorkerMethod::kRecvBuf),
+                 500);
+         ++i) {
+      EnqueueRecvBufRequestRaw();
+    }
 
     void* tag;
     bool ok;
@@ -284,21 +300,43 @@ class GrpcWorkerServiceThread {
     EnqueueRecvTensorRequestRaw();
   }
 
-  void RecvBufHandler(WorkerCall<RecvBufRequest, RecvBufResponse>* call) {
+  void BatchRecvTensorHandlerRaw(
+      WorkerCall<BatchRecvTensorRequest, ::grpc::ByteBuffer>* call) {
     Schedule([this, call]() {
       CallOptions* call_opts = new CallOptions;
       call->SetCancelCallback([call_opts]() { call_opts->StartCancel(); });
-      worker_->RecvBufAsync(call_opts, &call->request, &call->response,
-                            [call, call_opts](const Status& s) {
-                              call->ClearCancelCallback();
-                              delete call_opts;
-                              if (!s.ok()) {
-                                VLOG(3) << "Bad response from RecvBuf:" << s;
-                              }
-                              call->SendResponse(ToGrpcStatus(s));
-                            });
+
+      worker_->GrpcBatchRecvTensorAsync(
+          call_opts, &call->request, &call->response,
+          [call, call_opts](const Status& s) {
+            call->ClearCancelCallback();
+            delete call_opts;
+            if (!s.ok()) {
+              VLOG(3) << "Bad response from BatchRecvTensor:" << s;
+            }
+            call->SendResponse(ToGrpcStatus(s));
+          });
     });
-    ENQUEUE_REQUEST(RecvBuf, true);
+    EnqueueBatchRecvTensorRequestRaw();
+  }
+
+  void RecvBufHandlerRaw(
+      WorkerCall<RecvBufRequest, ::grpc::ByteBuffer>* call) {
+    Schedule([this, call]() {
+      CallOptions* call_opts = new CallOptions;
+      call->SetCancelCallback([call_opts]() { call_opts->StartCancel(); });
+      worker_->GrpcRecvBufAsync(call_opts, &call->request, &call->response,
+                                [call, call_opts](const Status& s) {
+                                  call->ClearCancelCallback();
+                                  delete call_opts;
+                                  if (!s.ok()) {
+                                    VLOG(3) << "Bad response from RecvBuf:"
+                                            << s;
+                                  }
+                                  call->SendResponse(ToGrpcStatus(s));
+                                });
+    });
+    EnqueueRecvBufRequestRaw();
   }
 
   void CompleteGroupHandler(
@@ -353,6 +391,32 @@ class GrpcWorkerServiceThread {
     }
   }
 
+  void EnqueueBatchRecvTensorRequestRaw() {
+    mutex_lock l(shutdown_mu_);
+    if (!is_shutdown_) {
+      tsl::Call<GrpcWorkerServiceThread, grpc::WorkerService::AsyncService,
+                BatchRecvTensorRequest, ::grpc::ByteBuffer>::
+          EnqueueRequestForMethod(
+              worker_service_, cq_.get(),
+              static_cast<int>(GrpcWorkerMethod::kBatchRecvTensor),
+              &GrpcWorkerServiceThread::BatchRecvTensorHandlerRaw,
+              true /* supports cancel*/);
+    }
+  }
+
+  void EnqueueRecvBufRequestRaw() {
+    mutex_lock l(shutdown_mu_);
+    if (!is_shutdown_) {
+      tsl::Call<GrpcWorkerServiceThread, grpc::WorkerService::AsyncService,
+                RecvBufRequest, ::grpc::ByteBuffer>::
+          EnqueueRequestForMethod(
+              worker_service_, cq_.get(),
+              static_cast<int>(GrpcWorkerMethod::kRecvBuf),
+              &GrpcWorkerServiceThread::RecvBufHandlerRaw,
+              true /* supports cancel*/);
+    }
+  }
+
   GrpcWorker* const worker_ = nullptr;  // Not owned.
   std::unique_ptr<::grpc::ServerCompletionQueue> cq_;
   std::unique_ptr<Thread> thread_;
@@ -427,6 +491,10 @@ GrpcWorker::GrpcWorker(WorkerEnv* worker_env, const ConfigProto& config)
   if (config.rpc_options().cache_rpc_response()) {
     EnableResponseCache();
   }
+  if (config.experimental().rpc_encoded_response_cache_bytes() > 0) {
+    EnableEncodedResponseCache(
+        config.experimental().rpc_encoded_response_cache_bytes());
+  }
 }
 
 void GrpcWorker::EnableResponseCache() {
@@ -434,6 +502,13 @@ void GrpcWorker::EnableResponseCache() {
   response_cache_ = std::make_unique<RpcResponseCache>();
 }
 
+void GrpcWorker::EnableEncodedResponseCache(int64_t max_bytes) {
+  VLOG(3) << "Enabling gRPC encoded tensor response cache of " << max_bytes
+          << " bytes.";
+  encoded_response_cache_ =
+      std::make_unique<RpcEncodedResponseCache>(max_bytes);
+}
+
 // GrpcRecvTensorAsync: unlike the other Worker methods, which use protocol
 // buffers for a response object, to avoid extra protocol buffer serialization
 // overhead we generate our response directly into a ::grpc::ByteBuffer object
@@ -441,17 +516,34 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
                                      const RecvTensorRequest* request,
                                      ::grpc::ByteBuffer* response,
                                      StatusCallback done) {
+  RecvTensorInternal(opts, request, response, /*only_if_ready=*/false,
+                     std::move(done));
+}
+
+void GrpcWorker::RecvTensorInternal(CallOptions* opts,
+                                    const RecvTensorRequest* request,
+                                    ::grpc::ByteBuffer* response,
+                                    bool only_if_ready, StatusCallback done) {
   VLOG(3) << "GrpcRecvTensorAsync req: " << request->DebugString();
   const int64_t request_id = request->request_id();
   const int64_t step_id = request->step_id();
 
-  bool cache_enabled = (response_cache_ != nullptr && request_id != 0);
+  // A tensor that is not ready is not a response that can be replayed, so
+  // the response cache is only used for requests that may wait.
+  bool cache_enabled =
+      (response_cache_ != nullptr && request_id != 0 && !only_if_ready);
 
-  auto do_response = [response, done, cache_enabled](const Tensor& tensor,
-                                                     bool is_dead,
-                                                     const Status& status) {
+  auto do_response = [this, response, done, cache_enabled](
+                         const Tensor& tensor, bool is_dead,
+                         const Status& status) {
     if (status.ok()) {
-      grpc::EncodeTensorToByteBuffer(is_dead, tensor, cache_enabled, response);
+      if (encoded_response_cache_ != nullptr) {
+        encoded_response_cache_->EncodeRecvTensorResponse(
+            is_dead, tensor, cache_enabled, response);
+      } else {
+        grpc::EncodeTensorToByteBuffer(is_dead, tensor, cache_enabled,
+                                       response);
+      }
     }
     done(status);
   };
@@ -508,17 +600,22 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
   // failures, and the client might not observe any errors or cancellations but
   // simply waits for the responses. Aborting the step would report an error to
   // the client, and avoid permanent hanging in distributed function execution.
-  opts->SetCancelCallback([this, step_id]() {
-    LOG(WARNING) << "RecvTensor cancelled for " << step_id;
-    AbortStep(step_id);
-  });
-  env_->rendezvous_mgr->RecvLocalAsync(
-      step_id, parsed,
-      [opts, rendezvous_done, src_dev, request](
+  // A receive that does not wait has nothing to cancel, and "opts" may be
+  // null then.
+  if (!only_if_ready) {
+    opts->SetCancelCallback([this, step_id]() {
+      LOG(WARNING) << "RecvTensor cancelled for " << step_id;
+      AbortStep(step_id);
+    });
+  }
+  auto recv_local_done =
+      [opts, rendezvous_done, src_dev, request, only_if_ready](
           const Status& status, const Rendezvous::Args& send_args,
           const Rendezvous::Args& recv_args, const Tensor& val,
           const bool is_dead) {
-        opts->ClearCancelCallback();
+        if (!only_if_ready) {
+          opts->ClearCancelCallback();
+        }
         if (!status.ok()) {
           return rendezvous_done(val, is_dead, status);
         }
@@ -551,7 +648,88 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
 
         CopyDeviceToHost(&val, alloc, alloc, request->rendezvous_key(), src_dev,
                          copy, send_dev_context, copy_ready);
-      });
+      };
+  if (only_if_ready) {
+    env_->rendezvous_mgr->RecvLocalIfReadyAsync(step_id, parsed,
+                                                std::move(recv_local_done));
+  } else {
+    env_->rendezvous_mgr->RecvLocalAsync(step_id, parsed,
+                                         std::move(recv_local_done));
+  }
+}
+
+void GrpcWorker::GrpcBatchRecvTensorAsync(CallOptions* opts,
+                                          const BatchRecvTensorRequest* request,
+                                          ::grpc::ByteBuffer* response,
+                                          StatusCallback done) {
+  const int num_requests = request->requests_size();
+  if (num_requests == 0) {
+    response->Clear();
+    done(absl::OkStatus());
+    return;
+  }
+
+  // Each tensor is received into its own ByteBuffer, but only if it has
+  // already been sent.  Waiting for the others could deadlock, since they may
+  // depend on tensors that the caller receives with this very RPC, so they
+  // are reported as not ready and the caller receives them one by one.
+  // Nothing here waits, so there is nothing to cancel either.
+  struct BatchState {
+    explicit BatchState(int n)
+        : sub_responses(n), sub_statuses(n), pending(n) {}
+    std::vector<::grpc::ByteBuffer> sub_responses;
+    std::vector<Status> sub_statuses;
+    std::atomic<int> pending;
+  };
+  auto state = std::make_shared<BatchState>(num_requests);
+
+  auto finish = [state, response, done]() {
+    // Frame each encoded RecvTensorResponse as an element of the repeated
+    // `responses` field, and reference its slices as they are.  The index
+    // of each tensor that is not ready is framed as a `not_ready` varint.
+    std::vector<::grpc::Slice> slices;
+    for (size_t i = 0; i < state->sub_responses.size(); ++i) {
+      const Status& s = state->sub_statuses[i];
+      char header[1 + core::kMaxVarint64Bytes];
+      if (errors::IsUnavailable(s)) {
+        header[0] = (BatchRecvTensorResponse::kNotReadyFieldNumber << 3) |
+                    0;  // Varint wire type.
+        char* header_end = core::EncodeVarint64(header + 1, i);
+        slices.emplace_back(header, header_end - header);
+        continue;
+      }
+      if (!s.ok()) {
+        done(s);
+        return;
+      }
+      ::grpc::ByteBuffer& sub_response = state->sub_responses[i];
+      std::vector<::grpc::Slice> sub_slices;
+      if (!sub_response.Dump(&sub_slices).ok()) {
+        done(errors::Internal("Could not read an encoded RecvTensorResponse"));
+        return;
+      }
+      header[0] = (BatchRecvTensorResponse::kResponsesFieldNumber << 3) |
+                  2;  // Length-delimited wire type.
+      char* header_end =
+          core::EncodeVarint64(header + 1, sub_response.Length());
+      slices.emplace_back(header, header_end - header);
+      for (::grpc::Slice& slice : sub_slices) {
+        slices.push_back(std::move(slice));
+      }
+    }
+    ::grpc::ByteBuffer tmp(slices.data(), slices.size());
+    response->Swap(&tmp);
+    done(absl::OkStatus());
+  };
+
+  for (int i = 0; i < num_requests; ++i) {
+    RecvTensorInternal(opts, &request->requests(i), &state->sub_responses[i],
+                       /*only_if_ready=*/true,
+                       [state, finish, i](const Status& s) {
+                         state->sub_statuses[i] = s;
+                         if (state->pending.fetch_sub(1) == 1) finish();
+                       });
+  }
 }
 
 namespace {
@@ -567,7 +745,7 @@ namespace {
 // RecvBufRespExtra.tensor_content to a cord instead of a repeated string,
 // and remove this function.
 void SetTensorInRecvBufResp(int64_t max_chunk_bytes, const Tensor* tensor,
-                            RecvBufResponse* response) {
+                            ::google::protobuf::Any* transport_options) {
   RecvBufRespExtra extra;
   int64_t num_bytes = tensor->TotalBytes();
   const char* head = reinterpret_cast<const char*>(DMAHelper::base(tensor));
@@ -578,24 +756,88 @@ void SetTensorInRecvBufResp(int64_t max_chunk_bytes, const Tensor* tensor,
     head += bytes;
     num_bytes -= bytes;
   }
-  response->mutable_transport_options()->PackFrom(extra);
+  transport_options->PackFrom(extra);
+}
+
+// Returns a slice that owns the serialization of "msg".
+::grpc::Slice SerializeToSlice(const ::google::protobuf::Message& msg) {
+  auto* bytes = new string;
+  msg.SerializeToString(bytes);
+  return ::grpc::Slice(
+      const_cast<char*>(bytes->data()), bytes->size(),
+      [](void* backing) { delete static_cast<string*>(backing); }, bytes);
+}
+
+// Encodes a RecvBufResponse with the serialized "transport_options" into
+// "result", sharing rather than copying the slice.
+void EncodeRecvBufResponse(const ::grpc::Slice& transport_options,
+                           int64_t send_start_micros, bool require_ack,
+                           ::grpc::ByteBuffer* result) {
+  char header[1 + core::kMaxVarint64Bytes];
+  header[0] = (RecvBufResponse::kTransportOptionsFieldNumber << 3) |
+              2;  // Length-delimited wire type.
+  char* header_end =
+      core::EncodeVarint64(header + 1, transport_options.size());
+  RecvBufResponse rest;
+  rest.set_send_start_micros(send_start_micros);
+  rest.set_require_ack(require_ack);
+  ::grpc::Slice slices[] = {::grpc::Slice(header, header_end - header),
+                            transport_options, SerializeToSlice(rest)};
+  ::grpc::ByteBuffer tmp(slices, 3);
+  result->Swap(&tmp);
 }
 }  // namespace
 
 void GrpcWorker::RecvBufAsync(CallOptions* opts, const RecvBufRequest* request,
                               RecvBufResponse* response, StatusCallback done) {
+  RecvBufInternal(
+      opts, request,
+      [this, response](const Tensor& tensor, bool require_ack) {
+        SetTensorInRecvBufResp(recv_buf_max_chunk_, &tensor,
+                               response->mutable_transport_options());
+        response->set_send_start_micros(env_->env->NowMicros());
+        response->set_require_ack(require_ack);
+      },
+      std::move(done));
+}
+
+void GrpcWorker::GrpcRecvBufAsync(CallOptions* opts,
+                                  const RecvBufRequest* request,
+                                  ::grpc::ByteBuffer* response,
+                                  StatusCallback done) {
+  RecvBufInternal(
+      opts, request,
+      [this, response](const Tensor& tensor, bool require_ack) {
+        auto encode = [this, &tensor]() {
+          ::google::protobuf::Any transport_options;
+          SetTensorInRecvBufResp(recv_buf_max_chunk_, &tensor,
+                                 &transport_options);
+          return SerializeToSlice(transport_options);
+        };
+        EncodeRecvBufResponse(
+            encoded_response_cache_ != nullptr
+                ? encoded_response_cache_->EncodeRecvBufTransportOptions(
+                      tensor, encode)
+                : encode(),
+            env_->env->NowMicros(), require_ack, response);
+      },
+      std::move(done));
+}
+
+void GrpcWorker::RecvBufInternal(
+    CallOptions* opts, const RecvBufRequest* request,
+    std::function<void(const Tensor& tensor, bool require_ack)> respond,
+    StatusCallback done) {
   const int64_t request_id = request->request_id();
   const int64_t step_id = request->step_id();
   bool cache_enabled = (response_cache_ != nullptr && request_id != 0);
 
-  auto do_response = [this, response, done, cache_enabled](
-                         const Tensor& tensor, bool is_dead,
-                         const Status& status) {
+  auto do_response = [respond, done, cache_enabled](const Tensor& tensor,
+                                                    bool is_dead,
+                                                    const Status& status) {
     if (status.ok()) {
-      SetTensorInRecvBufResp(recv_buf_max_chunk_, &tensor, response);
+      respond(tensor, cache_enabled);
     }
-    response->set_send_start_micros(env_->env->NowMicros());
-    response->set_require_ack(cache_enabled);
     done(status);
   };
 
@@ -16,12 +16,14 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_WORKER_SERVICE_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_WORKER_SERVICE_H_
 
+#include <functional>
 #include <memory>
 #include <unordered_map>
 
 #include "grpcpp/server_builder.h"
 #include "xla/tsl/distributed_runtime/rpc/async_service_interface.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service_impl.h"
+#include "tensorflow/core/distributed_runtime/rpc/rpc_encoded_response_cache.h"
 #include "tensorflow/core/distributed_runtime/rpc/rpc_response_cache.h"
 #include "tensorflow/core/distributed_runtime/worker.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
@@ -51,12 +53,30 @@ class GrpcWorker : public Worker {
                                    ::grpc::ByteBuffer* response,
                                    StatusCallback done);
 
+  // Receives each of the tensors in "request" that has already been sent, as
+  // GrpcRecvTensorAsync does, and encodes them into "response" as a
+  // BatchRecvTensorResponse that shares the encoded tensors rather than
+  // copying them.  The tensors that have not been sent yet are listed as not
+  // ready instead of being waited for.
+  virtual void GrpcBatchRecvTensorAsync(CallOptions* opts,
+                                        const BatchRecvTensorRequest* request,
+                                        ::grpc::ByteBuffer* response,
+                                        StatusCallback done);
+
   void LoggingAsync(const LoggingRequest* request, LoggingResponse* response,
                     StatusCallback done) override;
 
   void RecvBufAsync(CallOptions* opts, const RecvBufRequest* request,
                     RecvBufResponse* response, StatusCallback done) override;
 
+  // Specialized version of RecvBuf for gRPC, which encodes the response
+  // directly so that it can share the transport options cached by the
+  // encoded response cache rather than copying them.
+  virtual void GrpcRecvBufAsync(CallOptions* opts,
+                                const RecvBufRequest* request,
+                                ::grpc::ByteBuffer* response,
+                                StatusCallback done);
+
   void CleanupGraphAsync(const CleanupGraphRequest* request,
                          CleanupGraphResponse* response,
                          StatusCallback done) override;
@@ -67,8 +87,28 @@ class GrpcWorker : public Worker {
 
   void RemoveCacheEntryForId(int64_t request_id);
 
+  // Shares the encoding of each tensor response among all the requests for
+  // the same contents of a tensor buffer, caching up to `max_bytes` of
+  // tensors.
+  void EnableEncodedResponseCache(int64_t max_bytes);
+
  private:
+  // Implements GrpcRecvTensorAsync.  If "only_if_ready" is true, fails with
+  // Unavailable rather than waiting if the tensor has not been sent yet; the
+  // response cache is then bypassed and "opts" is not used.
+  void RecvTensorInternal(CallOptions* opts, const RecvTensorRequest* request,
+                          ::grpc::ByteBuffer* response, bool only_if_ready,
+                          StatusCallback done);
+
+  // Implements RecvBufAsync and GrpcRecvBufAsync.  Calls "respond" with the
+  // tensor, and whether the receiver must ack it, before "done" succeeds.
+  void RecvBufInternal(
+      CallOptions* opts, const RecvBufRequest* request,
+      std::function<void(const Tensor& tensor, bool require_ack)> respond,
+      StatusCallback done);
+
   std::unique_ptr<RpcResponseCache> response_cache_;
+  std::unique_ptr<RpcEncodedResponseCache> encoded_response_cache_;
   const int32 recv_buf_max_chunk_;
 };
 
@@ -0,0 +1,189 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/rpc_encoded_response_cache.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+auto* tf_encoded_response_cache_hits = monitoring::Counter<0>::New(
+    "/tensorflow/rpc/service/encoded_response_cache_hits",
+    "Number of tensor responses that reused the encoding of an earlier "
+    "response for the same tensor.");
+
+namespace {
+
+Fprint128 FingerprintContents(const Tensor& val) {
+  if (val.dtype() != DT_STRING) return Fingerprint128(val.tensor_data());
+  Fprint128 fingerprint = {0, 0};
+  for (const tstring& element : val.flat<tstring>()) {
+    const Fprint128 f = Fingerprint128(element);
+    fingerprint = {FingerprintCat64(fingerprint.low64, f.low64),
+                   FingerprintCat64(fingerprint.high64, f.high64)};
+  }
+  return fingerprint;
+}
+
+// Returns a slice that owns a copy of the bytes of `buf`.
+::grpc::Slice Flatten(::grpc::ByteBuffer* buf) {
+  std::vector<::grpc::Slice> slices;
+  (void)buf->Dump(&slices);
+  auto* bytes = new string;
+  bytes->reserve(buf->Length());
+  for (const ::grpc::Slice& slice : slices) {
+    bytes->append(reinterpret_cast<const char*>(slice.begin()), slice.size());
+  }
+  return ::grpc::Slice(
+      const_cast<char*>(bytes->data()), bytes->size(),
+      [](void* backing) { delete static_cast<string*>(backing); }, bytes);
+}
+
+}  // namespace
+
+RpcEncodedResponseCache::RpcEncodedResponseCache(int64_t max_bytes)
+    : max_bytes_(max_bytes) {}
+
+std::shared_ptr<RpcEncodedResponseCache::Entry>
+RpcEncodedResponseCache::Lookup(Kind kind, const Tensor& val, bool is_dead,
+                                bool require_ack) {
+  if (!val.IsInitialized()) return nullptr;
+  const int64_t num_bytes = val.TotalBytes();
+  if (num_bytes == 0 || num_bytes > max_bytes_) return nullptr;
+  const auto dims = val.shape().dim_sizes();
+  Key key;
+  key.kind = kind;
+  key.data = val.tensor_data().data();
+  key.dims.assign(dims.begin(), dims.end());
+  key.dtype = val.dtype();
+  key.is_dead = is_dead;
+  key.require_ack = require_ack;
+  {
+    mutex_lock l(mu_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      // Most buffers are only ever sent once, so the first request for a
+      // buffer just records it, without paying for a fingerprint.
+      Insert(std::move(key), nullptr, num_bytes);
+      return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+  }
+  // Fingerprint outside of mu_, so that requests for other tensors don't
+  // wait for this one.
+  const Fprint128 fingerprint = FingerprintContents(val);
+  mutex_lock l(mu_);
+  int64_t generation = 0;
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    Slot& slot = it->second;
+    if (slot.entry != nullptr) {
+      if (slot.entry->fingerprint == fingerprint) {
+        tf_encoded_response_cache_hits->GetCell()->IncrementBy(1);
+        lru_.splice(lru_.begin(), lru_, slot.lru);
+        return slot.entry;
+      }
+      generation = slot.entry->generation + 1;
+      VLOG(2) << "RpcEncodedResponseCache: contents of buffer " << key.data
+              << " changed, starting generation " << generation;
+    }
+    Erase(it);
+  }
+  auto entry = std::make_shared<Entry>();
+  entry->fingerprint = fingerprint;
+  entry->generation = generation;
+  Insert(std::move(key), entry, num_bytes);
+  return entry;
+}
+
+void RpcEncodedResponseCache::Insert(Key key, std::shared_ptr<Entry> entry,
+                                     int64_t num_bytes) {
+  while (bytes_ + num_bytes > max_bytes_) {
+    Erase(entries_.find(lru_.back()));
+  }
+  lru_.push_front(key);
+  entries_.emplace(std::move(key),
+                   Slot{std::move(entry), num_bytes, lru_.begin()});
+  bytes_ += num_bytes;
+}
+
+void RpcEncodedResponseCache::Erase(
+    absl::flat_hash_map<Key, Slot>::iterator it) {
+  bytes_ -= it->second.num_bytes;
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+/*static*/
+::grpc::Slice RpcEncodedResponseCache::GetEncoding(
+    Entry* entry, const std::function<::grpc::Slice()>& encode) {
+  // Concurrent requesters wait for the first one to finish encoding.
+  mutex_lock l(entry->mu);
+  if (!entry->encoded) {
+    entry->encoding = encode();
+    entry->encoded = true;
+  }
+  // Copying a slice references its bytes rather than copying them.
+  return entry->encoding;
+}
+
+void RpcEncodedResponseCache::EncodeRecvTensorResponse(
+    bool is_dead, const Tensor& val, bool require_ack,
+    ::grpc::ByteBuffer* result) {
+  std::shared_ptr<Entry> entry =
+      val.dtype() == DT_STRING
+          ? Lookup(Kind::kRecvTensor, val, is_dead, require_ack)
+          : nullptr;
+  if (entry == nullptr) {
+    grpc::EncodeTensorToByteBuffer(is_dead, val, require_ack, result);
+    return;
+  }
+  ::grpc::Slice encoding = GetEncoding(entry.get(), [&]() {
+    // Large elements are referenced rather than copied by the encoding, so
+    // it is flattened to not keep the buffer alive.
+    ::grpc::ByteBuffer buf;
+    grpc::EncodeTensorToByteBuffer(is_dead, val, require_ack, &buf);
+    return Flatten(&buf);
+  });
+  ::grpc::ByteBuffer tmp(&encoding, 1);
+  result->Swap(&tmp);
+}
+
+::grpc::Slice RpcEncodedResponseCache::EncodeRecvBufTransportOptions(
+    const Tensor& val, const std::function<::grpc::Slice()>& encode) {
+  std::shared_ptr<Entry> entry = Lookup(Kind::kRecvBuf, val,
+                                        /*is_dead=*/false,
+                                        /*require_ack=*/false);
+  if (entry == nullptr) return encode();
+  return GetEncoding(entry.get(), encode);
+}
+
+int64_t RpcEncodedResponseCache::size() {
+  mutex_lock l(mu_);
+  return entries_.size();
+}
+
+int64_t RpcEncodedResponseCache::bytes() {
+  mutex_lock l(mu_);
+  return bytes_;
+}
+
+}  // namespace tensorflow
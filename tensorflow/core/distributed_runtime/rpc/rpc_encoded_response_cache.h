@@ -0,0 +1,145 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_RPC_ENCODED_RESPONSE_CACHE_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_RPC_ENCODED_RESPONSE_CACHE_H_
+
+#include <functional>
+#include <list>
+#include <memory>
+
+#include "grpcpp/support/byte_buffer.h"
+#include "grpcpp/support/slice.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/mutex.h"
+
+// Encode-once sharing of tensor responses.  When many workers fetch the same
+// tensor, e.g. a parameter from a parameter server, every RecvBuf response
+// carries the same bytes, yet each one is encoded anew.  This cache keeps the
+// encoding of a tensor and hands it to every later request for the same
+// tensor buffer.  Encodings are held in refcounted gRPC slices, so a cache
+// hit copies no tensor data.
+//
+// Each requester has its own rendezvous key, and workers that are not in
+// lockstep ask for the same tensor in different steps, so entries are keyed
+// by the identity of the sent tensor: its buffer, shape and dtype.  Entries
+// do not hold on to the tensor, so that a variable can still be updated in
+// place rather than copied on write.  Instead each entry records the
+// generation of the contents it encodes, identified by their fingerprint.  A
+// buffer that was updated in place, or freed and reused for another tensor,
+// starts a new generation and is encoded anew.  Fingerprinting reads the
+// whole tensor, so the first request for a buffer only records its identity
+// and is encoded without caching; the encoding is shared from the third
+// request on.
+namespace tensorflow {
+
+class RpcEncodedResponseCache {
+ public:
+  // Entries hold encodings of at most `max_bytes` of tensor data.  When
+  // full, the least recently used entries are dropped; a tensor that still
+  // does not fit is encoded without caching.
+  explicit RpcEncodedResponseCache(int64_t max_bytes);
+
+  // Sets `result` to the RecvTensorResponse encoding of `val`, as
+  // grpc::EncodeTensorToByteBuffer does.  Only string tensors are cached:
+  // the encoding of other tensors is either small or points into their
+  // buffer, and caching it would copy or pin the buffer.  A cached response
+  // carries the send_start_micros of the first one.
+  void EncodeRecvTensorResponse(bool is_dead, const Tensor& val,
+                                bool require_ack, ::grpc::ByteBuffer* result);
+
+  // Returns the serialized transport options of a RecvBufResponse for
+  // `val`.  `encode` produces them and only runs if no encoding of the
+  // current generation of `val` is cached.
+  ::grpc::Slice EncodeRecvBufTransportOptions(
+      const Tensor& val, const std::function<::grpc::Slice()>& encode);
+
+  // The number of tracked buffers, including those requested only once, and
+  // the bytes of tensor data they account for.
+  int64_t size();
+  int64_t bytes();
+
+ private:
+  enum class Kind { kRecvTensor, kRecvBuf };
+
+  struct Key {
+    Kind kind;
+    const void* data;
+    absl::InlinedVector<int64_t, 4> dims;
+    DataType dtype;
+    bool is_dead;
+    bool require_ack;
+
+    template <typename H>
+    friend H AbslHashValue(H h, const Key& k) {
+      return H::combine(std::move(h), k.kind, k.data, k.dims, k.dtype,
+                        k.is_dead, k.require_ack);
+    }
+    bool operator==(const Key& o) const {
+      return kind == o.kind && data == o.data && dims == o.dims &&
+             dtype == o.dtype && is_dead == o.is_dead &&
+             require_ack == o.require_ack;
+    }
+  };
+
+  struct Entry {
+    // The contents that were encoded, and how many times the contents of
+    // the buffer were seen to change.
+    Fprint128 fingerprint;
+    int64_t generation;
+
+    mutex mu;
+    bool encoded TF_GUARDED_BY(mu) = false;
+    ::grpc::Slice encoding TF_GUARDED_BY(mu);
+  };
+
+  struct Slot {
+    // Null if the buffer was requested only once so far.
+    std::shared_ptr<Entry> entry;
+    int64_t num_bytes;
+    std::list<Key>::iterator lru;
+  };
+
+  // Returns the entry of the current contents of `val`, creating it if
+  // needed, or nullptr if `val` cannot be cached.
+  std::shared_ptr<Entry> Lookup(Kind kind, const Tensor& val, bool is_dead,
+                                bool require_ack);
+
+  // Returns the encoding of `entry`, running `encode` to produce it if this
+  // is the first use of `entry`.
+  static ::grpc::Slice GetEncoding(
+      Entry* entry, const std::function<::grpc::Slice()>& encode);
+
+  // Adds a slot for `key`, dropping the least recently used ones to make
+  // room for `num_bytes`.
+  void Insert(Key key, std::shared_ptr<Entry> entry, int64_t num_bytes)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Erase(absl::flat_hash_map<Key, Slot>::iterator it)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int64_t max_bytes_;
+  mutex mu_;
+  int64_t bytes_ TF_GUARDED_BY(mu_) = 0;
+  absl::flat_hash_map<Key, Slot> entries_ TF_GUARDED_BY(mu_);
+  // Keys of entries_, most recently used first.
+  std::list<Key> lru_ TF_GUARDED_BY(mu_);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_RPC_ENCODED_RESPONSE_CACHE_H_
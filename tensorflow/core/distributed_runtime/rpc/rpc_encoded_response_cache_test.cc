@@ -0,0 +1,166 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/rpc_encoded_response_cache.h"
+
+#include <string>
+#include <vector>
+
+#include "grpcpp/support/byte_buffer.h"
+#include "grpcpp/support/slice.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+namespace {
+
+RecvTensorResponse Decode(::grpc::ByteBuffer* buf) {
+  std::vector<::grpc::Slice> slices;
+  (void)buf->Dump(&slices);
+  string bytes;
+  for (const auto& s : slices) {
+    bytes.append(reinterpret_cast<const char*>(s.begin()), s.size());
+  }
+  RecvTensorResponse response;
+  CHECK(response.ParseFromString(bytes));
+  return response;
+}
+
+string Bytes(const ::grpc::Slice& slice) {
+  return string(reinterpret_cast<const char*>(slice.begin()), slice.size());
+}
+
+::grpc::Slice ToSlice(const string& bytes) { return ::grpc::Slice(bytes); }
+
+TEST(RpcEncodedResponseCacheTest, SharesRecvBufEncoding) {
+  RpcEncodedResponseCache cache(1 << 20);
+  Tensor t = test::AsTensor<int32>({5, 6, 7});
+  int num_encodes = 0;
+  auto encode = [&num_encodes]() {
+    ++num_encodes;
+    return ToSlice("encoded");
+  };
+  // The first request only records the buffer.
+  cache.EncodeRecvBufTransportOptions(t, encode);
+  EXPECT_EQ(1, num_encodes);
+  EXPECT_EQ(1, cache.size());
+  ::grpc::Slice a = cache.EncodeRecvBufTransportOptions(t, encode);
+  ::grpc::Slice b = cache.EncodeRecvBufTransportOptions(t, encode);
+  EXPECT_EQ(2, num_encodes);
+  EXPECT_EQ("encoded", Bytes(b));
+  // The bytes are shared, not copied.
+  EXPECT_EQ(a.begin(), b.begin());
+  EXPECT_EQ(1, cache.size());
+  EXPECT_EQ(t.TotalBytes(), cache.bytes());
+  // The cache does not hold on to the tensor, so it can be updated in place.
+  EXPECT_TRUE(t.RefCountIsOne());
+
+  // Another shape of the same buffer is a different tensor.
+  Tensor reshaped;
+  ASSERT_TRUE(reshaped.CopyFrom(t, TensorShape({3, 1})));
+  cache.EncodeRecvBufTransportOptions(reshaped, encode);
+  cache.EncodeRecvBufTransportOptions(reshaped, encode);
+  EXPECT_EQ(4, num_encodes);
+  EXPECT_EQ(2, cache.size());
+}
+
+TEST(RpcEncodedResponseCacheTest, ReencodesAfterInPlaceUpdate) {
+  RpcEncodedResponseCache cache(1 << 20);
+  Tensor t = test::AsTensor<float>({1, 2, 3, 4});
+  int num_encodes = 0;
+  auto encode = [&t, &num_encodes]() {
+    ++num_encodes;
+    return ToSlice(string(t.tensor_data().data(), t.tensor_data().size()));
+  };
+  cache.EncodeRecvBufTransportOptions(t, encode);
+  EXPECT_EQ(string(t.tensor_data()),
+            Bytes(cache.EncodeRecvBufTransportOptions(t, encode)));
+  EXPECT_EQ(2, num_encodes);
+  const string before(t.tensor_data());
+  t.flat<float>()(0) = 9;
+  const string after(t.tensor_data());
+  EXPECT_NE(before, after);
+  EXPECT_EQ(after, Bytes(cache.EncodeRecvBufTransportOptions(t, encode)));
+  EXPECT_EQ(after, Bytes(cache.EncodeRecvBufTransportOptions(t, encode)));
+  EXPECT_EQ(3, num_encodes);
+  // The entry of the old contents was replaced.
+  EXPECT_EQ(1, cache.size());
+}
+
+TEST(RpcEncodedResponseCacheTest, CachesStringRecvTensorResponses) {
+  RpcEncodedResponseCache cache(1 << 20);
+  Tensor strings = test::AsTensor<tstring>({"a", string(2048, 'b'), "c"});
+  ::grpc::ByteBuffer a, b;
+  cache.EncodeRecvTensorResponse(false, strings, false, &a);
+  cache.EncodeRecvTensorResponse(false, strings, false, &a);
+  cache.EncodeRecvTensorResponse(false, strings, false, &b);
+  EXPECT_EQ(1, cache.size());
+  // The cached encoding does not reference the elements of the tensor.
+  EXPECT_TRUE(strings.RefCountIsOne());
+  RecvTensorResponse ra = Decode(&a);
+  RecvTensorResponse rb = Decode(&b);
+  EXPECT_EQ(ra.SerializeAsString(), rb.SerializeAsString());
+  Tensor decoded;
+  ASSERT_TRUE(decoded.FromProto(rb.tensor()));
+  test::ExpectTensorEqual<tstring>(strings, decoded);
+
+  // Other tensors are encoded directly.
+  Tensor t = test::AsTensor<float>({1, 2, 3, 4});
+  cache.EncodeRecvTensorResponse(false, t, false, &b);
+  EXPECT_EQ(1, cache.size());
+  ASSERT_TRUE(decoded.FromProto(Decode(&b).tensor()));
+  test::ExpectTensorEqual<float>(t, decoded);
+}
+
+TEST(RpcEncodedResponseCacheTest, EvictsLeastRecentlyUsed) {
+  Tensor t1 = test::AsTensor<float>({1, 2, 3, 4});
+  Tensor t2 = test::AsTensor<float>({5, 6, 7, 8});
+  Tensor t3 = test::AsTensor<float>({9, 10, 11, 12});
+  RpcEncodedResponseCache cache(2 * t1.TotalBytes());
+  int num_encodes = 0;
+  auto encode = [&num_encodes]() {
+    ++num_encodes;
+    return ToSlice("encoded");
+  };
+  // t1 and t2 are recorded, and t1 is cached on its second request.
+  cache.EncodeRecvBufTransportOptions(t1, encode);
+  cache.EncodeRecvBufTransportOptions(t2, encode);
+  cache.EncodeRecvBufTransportOptions(t1, encode);
+  cache.EncodeRecvBufTransportOptions(t1, encode);
+  EXPECT_EQ(3, num_encodes);
+  // t2 is dropped to make room.
+  cache.EncodeRecvBufTransportOptions(t3, encode);
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(2 * t1.TotalBytes(), cache.bytes());
+  cache.EncodeRecvBufTransportOptions(t1, encode);
+  EXPECT_EQ(4, num_encodes);
+  // t2 is recorded anew, dropping t3.
+  cache.EncodeRecvBufTransportOptions(t2, encode);
+  cache.EncodeRecvBufTransportOptions(t1, encode);
+  EXPECT_EQ(5, num_encodes);
+  // A tensor larger than the cache is encoded without caching.
+  Tensor large(DT_FLOAT, TensorShape({16}));
+  large.flat<float>().setZero();
+  cache.EncodeRecvBufTransportOptions(large, encode);
+  cache.EncodeRecvBufTransportOptions(large, encode);
+  cache.EncodeRecvBufTransportOptions(large, encode);
+  EXPECT_EQ(8, num_encodes);
+  EXPECT_EQ(2, cache.size());
+}
+
+}  // namespace
+}  // namespace tensorflow
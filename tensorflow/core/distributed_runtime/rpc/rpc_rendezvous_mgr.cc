@@ -15,6 +15,13 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
@@ -31,15 +38,40 @@ limitations under the License.
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/notification.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/config.pb.h"
 
 namespace tensorflow {
 
+struct RecvTensorBatchState {
+  // RecvTensor calls to the same worker are batched for this long; batching
+  // is disabled if this is 0.
+  int64_t window_micros = 0;
+
+  mutex mu;
+  // Workers that answered a BatchRecvTensor RPC with Unimplemented.
+  absl::flat_hash_set<string> unsupported_workers TF_GUARDED_BY(mu);
+
+  bool BatchingEnabledFor(const string& worker) {
+    if (window_micros <= 0) return false;
+    mutex_lock l(mu);
+    return !unsupported_workers.contains(worker);
+  }
+};
+
 namespace {
 
+// The most RecvTensor calls that are sent in one BatchRecvTensor RPC.
+constexpr size_t kMaxRecvTensorBatchSize = 256;
+
+class RpcRecvTensorCall;
+struct RpcRecvTensorBatch;
+
 class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  public:
-  RpcRemoteRendezvous(const WorkerEnv* env, int64_t step_id)
-      : BaseRemoteRendezvous(env, step_id) {}
+  RpcRemoteRendezvous(const WorkerEnv* env, int64_t step_id,
+                      std::shared_ptr<RecvTensorBatchState> batch_state)
+      : BaseRemoteRendezvous(env, step_id),
+        batch_state_(std::move(batch_state)) {}
 
  protected:
   void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
@@ -49,10 +81,45 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  private:
   ~RpcRemoteRendezvous() override {}
 
+  // Adds "call" to the batch pending for its source worker, which is sent
+  // when it is full or when the batch window has passed.  "recv_done" is
+  // run once "call" has finished.
+  void AddToBatch(RpcRecvTensorCall* call, std::function<void()> recv_done);
+
+  // Sends "batch" unless it has already been sent because it was full.
+  void FlushBatch(const std::shared_ptr<RpcRecvTensorBatch>& batch);
+
+  // Sends the calls in "batch" as one BatchRecvTensor RPC.
+  static void StartBatch(const std::shared_ptr<RpcRecvTensorBatch>& batch);
+
+  // Runs when the BatchRecvTensor RPC for "batch" has finished with "s".
+  static void FinishBatch(const std::shared_ptr<RpcRecvTensorBatch>& batch,
+                          const Status& s);
+
+  const std::shared_ptr<RecvTensorBatchState> batch_state_;
+
+  mutex batch_mu_;
+  // The batch being collected for each source worker.
+  std::unordered_map<string, std::shared_ptr<RpcRecvTensorBatch>>
+      pending_batches_ TF_GUARDED_BY(batch_mu_);
+
   RpcRemoteRendezvous(const RpcRemoteRendezvous&) = delete;
   void operator=(const RpcRemoteRendezvous&) = delete;
 };
 
+// RecvTensor calls to one remote worker that are sent together as a single
+// BatchRecvTensor RPC.
+struct RpcRecvTensorBatch {
+  string src_worker;
+  std::shared_ptr<RecvTensorBatchState> state;
+  std::vector<RpcRecvTensorCall*> calls;
+  std::vector<std::function<void()>> recv_dones;  // One for each call.
+  CallOptions opts;
+  BatchRecvTensorRequest req;
+  BatchRecvTensorResponse resp;
+  Status rpc_status;
+};
+
 // Used only to retrieve tensors from remote processes.
 class RpcRecvTensorCall : public BaseRecvTensorCall {
  public:
@@ -86,6 +153,7 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
     {
       mutex_lock l(mu_);
       status_ = absl::OkStatus();
+      batch_.reset();
     }
     done_ = nullptr;
   }
@@ -103,11 +171,19 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
   }
 
   void StartAbort(const Status& s) override {
+    std::shared_ptr<RpcRecvTensorBatch> batch;
     {
       mutex_lock l(mu_);
       status_.Update(s);
+      batch = batch_;
+    }
+    // Aborting any call of a batch cancels the whole BatchRecvTensor RPC,
+    // just as cancelling a RecvTensor RPC aborts the step on the sender.
+    if (batch != nullptr) {
+      batch->opts.StartCancel();
+    } else {
+      opts_.StartCancel();
     }
-    opts_.StartCancel();
   }
 
   Status status() const override {
@@ -126,6 +202,33 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
 
   bool is_dead() const { return resp_.metadata().is_dead(); }
 
+  // Makes aborting this call cancel "batch" from now on.  Returns false, and
+  // does not join, if this call has already been aborted.
+  bool JoinBatch(std::shared_ptr<RpcRecvTensorBatch> batch) {
+    mutex_lock l(mu_);
+    if (!status_.ok()) return false;
+    batch_ = std::move(batch);
+    return true;
+  }
+
+  void LeaveBatch() {
+    mutex_lock l(mu_);
+    batch_.reset();
+  }
+
+  // Finishes this call with its part of a BatchRecvTensor RPC that ended
+  // with "s".  "response" is only used if "s" is OK.
+  void FinishFromBatch(Status s, RecvTensorResponse* response) {
+    if (s.ok()) {
+      resp_.InitAlloc(dst_device_, alloc_attrs_);
+      s = resp_.InitFrom(response);
+    }
+    if (!s.ok()) {
+      mutex_lock l(mu_);
+      status_.Update(s);
+    }
+  }
+
   Device* dst_device() const { return dst_device_; }
   const Rendezvous::Args& recv_args() const { return recv_args_; }
   const Rendezvous::DoneCallback& done() const { return done_; }
@@ -180,6 +283,8 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
 
   mutable mutex mu_;
   Status status_ TF_GUARDED_BY(mu_);
+  // Set while this call is sent as part of a BatchRecvTensor RPC.
+  std::shared_ptr<RpcRecvTensorBatch> batch_ TF_GUARDED_BY(mu_);
 
   RpcRecvTensorCall(const RpcRecvTensorCall&) = delete;
   void operator=(const RpcRecvTensorCall&) = delete;
@@ -230,6 +335,105 @@ static RpcRecvTensorFreeList* get_call_freelist() {
   return call_freelist;
 }
 
+void RpcRemoteRendezvous::FinishBatch(
+    const std::shared_ptr<RpcRecvTensorBatch>& batch, const Status& s) {
+  if (errors::IsUnimplemented(s)) {
+    // The worker predates BatchRecvTensor: send these calls, and all later
+    // ones to the same worker, as separate RecvTensor RPCs.
+    {
+      mutex_lock l(batch->state->mu);
+      batch->state->unsupported_workers.insert(batch->src_worker);
+    }
+    for (size_t i = 0; i < batch->calls.size(); ++i) {
+      batch->calls[i]->LeaveBatch();
+      batch->calls[i]->Start(std::move(batch->recv_dones[i]));
+    }
+    return;
+  }
+  Status status = s;
+  const int num_calls = batch->calls.size();
+  if (status.ok() &&
+      batch->resp.responses_size() + batch->resp.not_ready_size() !=
+          num_calls) {
+    status = errors::Internal(
+        "BatchRecvTensor returned ", batch->resp.responses_size(),
+        " responses and ", batch->resp.not_ready_size(),
+        " tensors not ready for ", num_calls, " requests");
+  }
+  // The tensors that were not ready when the RPC reached the worker are
+  // received with RecvTensor RPCs, which do wait for them.
+  std::vector<bool> is_ready(num_calls, true);
+  if (status.ok()) {
+    for (int index : batch->resp.not_ready()) {
+      if (index < 0 || index >= num_calls || !is_ready[index]) {
+        status = errors::Internal("BatchRecvTensor returned an invalid index ",
+                                  index, " of a tensor not ready");
+        break;
+      }
+      is_ready[index] = false;
+    }
+  }
+  int response_index = 0;
+  for (int i = 0; i < num_calls; ++i) {
+    RpcRecvTensorCall* call = batch->calls[i];
+    if (!status.ok()) {
+      call->FinishFromBatch(status, nullptr);
+      batch->recv_dones[i]();
+    } else if (is_ready[i]) {
+      call->FinishFromBatch(
+          status, batch->resp.mutable_responses(response_index++));
+      batch->recv_dones[i]();
+    } else {
+      call->LeaveBatch();
+      // The worker has already seen the request id of this call.
+      call->req_.set_request_id(GetUniqueRequestId());
+      call->Start(std::move(batch->recv_dones[i]));
+    }
+  }
+}
+
+void RpcRemoteRendezvous::StartBatch(
+    const std::shared_ptr<RpcRecvTensorBatch>& batch) {
+  // Calls that were aborted while they waited for the batch to be sent
+  // finish right away.
+  std::vector<RpcRecvTensorCall*> calls;
+  std::vector<std::function<void()>> recv_dones;
+  for (size_t i = 0; i < batch->calls.size(); ++i) {
+    RpcRecvTensorCall* call = batch->calls[i];
+    if (call->JoinBatch(batch)) {
+      *batch->req.add_requests() = call->req_;
+      calls.push_back(call);
+      recv_dones.push_back(std::move(batch->recv_dones[i]));
+    } else {
+      batch->recv_dones[i]();
+    }
+  }
+  batch->calls = std::move(calls);
+  batch->recv_dones = std::move(recv_dones);
+  if (batch->calls.empty()) return;
+
+  // The calls are finished, and possibly released, only after both the RPC
+  // has completed and the abort check below is done.  Unlike StartRTCall this
+  // does not block in the callback, since workers without BatchRecvTensor
+  // may fail the call before it returns.
+  auto pending = std::make_shared<std::atomic<int>>(2);
+  batch->calls[0]->wi_->BatchRecvTensorAsync(
+      &batch->opts, &batch->req, &batch->resp,
+      [batch, pending](const Status& s) {
+        batch->rpc_status = s;
+        if (pending->fetch_sub(1) == 1) FinishBatch(batch, batch->rpc_status);
+      });
+  // A call may have been aborted before the RPC registered its cancellation
+  // with `batch->opts`, in which case the RPC must be cancelled here.
+  for (RpcRecvTensorCall* call : batch->calls) {
+    if (!call->status().ok()) {
+      batch->opts.StartCancel();
+      break;
+    }
+  }
+  if (pending->fetch_sub(1) == 1) FinishBatch(batch, batch->rpc_status);
+}
+
 void RpcRemoteRendezvous::RecvFromRemoteAsync(
     const Rendezvous::ParsedKey& parsed, const Rendezvous::Args& recv_args,
     DoneCallback done) {
@@ -289,7 +493,7 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
 
   // Start "call".
   Ref();
-  call->Start([this, call, recv_args, worker_cache]() {
+  auto recv_done = [this, call, recv_args, worker_cache]() {
     // Removes "call" from calls_. Prevent StartAbort().
     DeregisterCall(call, recv_args);
     // If StartAbort was called prior to DeregisterCall, then the
@@ -302,18 +506,77 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
     call->done()(s, Args(), call->recv_args(), call->tensor(), call->is_dead());
     get_call_freelist()->Release(call);
     Unref();
-  });
+  };
+  if (batch_state_->BatchingEnabledFor(call->src_worker_)) {
+    AddToBatch(call, std::move(recv_done));
+  } else {
+    call->Start(std::move(recv_done));
+  }
+}
+
+void RpcRemoteRendezvous::AddToBatch(RpcRecvTensorCall* call,
+                                     std::function<void()> recv_done) {
+  std::shared_ptr<RpcRecvTensorBatch> batch;
+  bool is_new_batch = false;
+  bool is_full = false;
+  {
+    mutex_lock l(batch_mu_);
+    std::shared_ptr<RpcRecvTensorBatch>& pending =
+        pending_batches_[call->src_worker_];
+    if (pending == nullptr) {
+      pending = std::make_shared<RpcRecvTensorBatch>();
+      pending->src_worker = call->src_worker_;
+      pending->state = batch_state_;
+      is_new_batch = true;
+    }
+    batch = pending;
+    batch->calls.push_back(call);
+    batch->recv_dones.push_back(std::move(recv_done));
+    if (batch->calls.size() >= kMaxRecvTensorBatchSize) {
+      pending_batches_.erase(call->src_worker_);
+      is_full = true;
+    }
+  }
+  if (is_full) {
+    StartBatch(batch);
+  } else if (is_new_batch) {
+    Ref();
+    env_->env->SchedClosureAfter(batch_state_->window_micros,
+                                 [this, batch]() {
+                                   FlushBatch(batch);
+                                   Unref();
+                                 });
+  }
+}
+
+void RpcRemoteRendezvous::FlushBatch(
+    const std::shared_ptr<RpcRecvTensorBatch>& batch) {
+  {
+    mutex_lock l(batch_mu_);
+    auto it = pending_batches_.find(batch->src_worker);
+    if (it == pending_batches_.end() || it->second != batch) return;
+    pending_batches_.erase(it);
+  }
+  StartBatch(batch);
 }
 
 }  // namespace
 
 RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env)
-    : BaseRendezvousMgr(env) {}
+    : RpcRendezvousMgr(env, ConfigProto()) {}
+
+RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env,
+                                   const ConfigProto& config)
+    : BaseRendezvousMgr(env),
+      batch_state_(std::make_shared<RecvTensorBatchState>()) {
+  batch_state_->window_micros =
+      config.experimental().recv_tensor_batch_window_us();
+}
 
 tsl::core::RefCountPtr<BaseRemoteRendezvous> RpcRendezvousMgr::Create(
     int64_t step_id, const WorkerEnv* worker_env) {
   return tsl::core::RefCountPtr<BaseRemoteRendezvous>(
-      new RpcRemoteRendezvous(worker_env, step_id));
+      new RpcRemoteRendezvous(worker_env, step_id, batch_state_));
 }
 
 }  // end namespace tensorflow
@@ -16,13 +16,17 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_RPC_RENDEZVOUS_MGR_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_RPC_RENDEZVOUS_MGR_H_
 
+#include <memory>
+
 #include "tensorflow/core/distributed_runtime/base_rendezvous_mgr.h"
 #include "tensorflow/core/distributed_runtime/worker_env.h"
 #include "tensorflow/core/platform/macros.h"
 
 namespace tensorflow {
 
+class ConfigProto;
 class DeviceMgr;
+struct RecvTensorBatchState;
 
 // RendezvousMgr keeps track of a set of local rendezvous instances.
 // All tensors sent by this worker are buffered in a RendezvousMgr
@@ -42,15 +46,25 @@ class DeviceMgr;
 //
 // Tensors sent and recved through rendezvous managed by this
 // RendezvousMgr must have keys generated by Rendezvous::CreateKey.
+//
+// If "config" sets experimental.recv_tensor_batch_window_us, tensors
+// requested from the same remote worker within that window are received with
+// a single BatchRecvTensor RPC rather than one RecvTensor RPC each.  The
+// remote worker only returns the tensors it has already sent, and the others
+// are then received with RecvTensor RPCs.  Workers that do not support
+// BatchRecvTensor are detected and then sent RecvTensor RPCs as before.
 class RpcRendezvousMgr : public BaseRendezvousMgr {
  public:
   explicit RpcRendezvousMgr(const WorkerEnv* env);
+  RpcRendezvousMgr(const WorkerEnv* env, const ConfigProto& config);
 
  protected:
   tsl::core::RefCountPtr<BaseRemoteRendezvous> Create(
       int64_t step_id, const WorkerEnv* worker_env) override;
 
  private:
+  const std::shared_ptr<RecvTensorBatchState> batch_state_;
+
   RpcRendezvousMgr(const RpcRendezvousMgr&) = delete;
   void operator=(const RpcRendezvousMgr&) = delete;
 };
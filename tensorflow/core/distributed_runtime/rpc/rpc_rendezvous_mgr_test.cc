@@ -15,18 +15,25 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <atomic>
+
+#include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/distributed_runtime/test_utils.h"
 #include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/control_flow.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/random.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/config.pb.h"
 
 namespace tensorflow {
 
@@ -57,6 +64,18 @@ class DummyWorker : public TestWorkerInterface {
  public:
   void RecvTensorAsync(CallOptions* opts, const RecvTensorRequest* request,
                        TensorResponse* response, StatusCallback done) override {
+    num_recv_tensor_calls.fetch_add(1);
+    if (track_produced) {
+      SchedClosure([this, key = request->rendezvous_key(),
+                    done = std::move(done)]() {
+        {
+          mutex_lock l(mu);
+          while (!produced.contains(key)) produced_cv.wait(l);
+        }
+        done(absl::OkStatus());
+      });
+      return;
+    }
     SchedClosure([done = std::move(done)]() {
       // Simulate a random delay for RPC. This is needed to fill the entire
       // object buffer in `RpcRecvTensorFreeList` and trigger the destruction of
@@ -66,6 +85,51 @@ class DummyWorker : public TestWorkerInterface {
       done(absl::OkStatus());
     });
   }
+
+  // Responds to each request with a string tensor holding its key.
+  void BatchRecvTensorAsync(CallOptions* opts,
+                            const BatchRecvTensorRequest* request,
+                            BatchRecvTensorResponse* response,
+                            StatusCallback done) override {
+    num_batch_recv_tensor_calls.fetch_add(1);
+    if (!supports_batching) {
+      done(errors::Unimplemented("BatchRecvTensorAsync"));
+      return;
+    }
+    SchedClosure([this, request, response, done = std::move(done)]() {
+      for (int i = 0; i < request->requests_size(); ++i) {
+        const string& key = request->requests(i).rendezvous_key();
+        if (track_produced) {
+          mutex_lock l(mu);
+          if (!produced.contains(key)) {
+            response->add_not_ready(i);
+            continue;
+          }
+        }
+        V(key).AsProtoTensorContent(
+            response->add_responses()->mutable_tensor());
+      }
+      done(absl::OkStatus());
+    });
+  }
+
+  // Marks the tensor for "key" as sent by this worker.
+  void Produce(const string& key) {
+    mutex_lock l(mu);
+    produced.insert(key);
+    produced_cv.notify_all();
+  }
+
+  bool supports_batching = false;
+  // If set, this worker has only sent the tensors passed to Produce():
+  // BatchRecvTensor reports the others as not ready, and RecvTensor waits
+  // for them.
+  bool track_produced = false;
+  mutex mu;
+  condition_variable produced_cv;
+  absl::flat_hash_set<string> produced TF_GUARDED_BY(mu);
+  std::atomic<int> num_recv_tensor_calls{0};
+  std::atomic<int> num_batch_recv_tensor_calls{0};
 };
 
 // Fake cache implementation for WorkerEnv.
@@ -74,11 +138,7 @@ class DummyWorkerCache : public WorkerCacheInterface {
   void ListWorkersInJob(const string& job_name,
                         std::vector<string>* workers) const override {}
   WorkerInterface* GetOrCreateWorker(const string& target) override {
-    if (dummy_remote_worker_ == nullptr) {
-      // Ownership transferred to WorkerFreeList
-      dummy_remote_worker_ = new DummyWorker;
-    }
-    return dummy_remote_worker_;
+    return worker();
   }
   Status GetEagerClientCache(
       std::unique_ptr<eager::EagerClientCache>* eager_client_cache) override {
@@ -95,6 +155,15 @@ class DummyWorkerCache : public WorkerCacheInterface {
   void GetDeviceLocalityAsync(const string& device, DeviceLocality* locality,
                               StatusCallback done) override {}
 
+ public:
+  DummyWorker* worker() {
+    if (dummy_remote_worker_ == nullptr) {
+      // Ownership transferred to WorkerFreeList
+      dummy_remote_worker_ = new DummyWorker;
+    }
+    return dummy_remote_worker_;
+  }
+
  private:
   DummyWorker* dummy_remote_worker_ = nullptr;
 };
@@ -104,7 +173,9 @@ static Device* CreateDevice(const char* type, const char* name) {
    public:
     explicit FakeDevice(const DeviceAttributes& attr) : Device(nullptr, attr) {}
     Status Sync() override { return absl::OkStatus(); }
-    Allocator* GetAllocator(AllocatorAttributes) override { return nullptr; }
+    Allocator* GetAllocator(AllocatorAttributes) override {
+      return cpu_allocator();
+    }
   };
   DeviceAttributes attr;
   attr.set_name(name);
@@ -342,4 +413,131 @@ TEST_F(RpcRendezvousMgrTest, RemoteRecvAsyncMany) {
   rmgr_.Cleanup(step_id);
 }
 
+ConfigProto BatchingConfig() {
+  ConfigProto config;
+  config.mutable_experimental()->set_recv_tensor_batch_window_us(10000);
+  return config;
+}
+
+// Receives "num_requests" distinct tensors from a remote worker with
+// `recv_tensor_batch_window_us` set, and checks that each one arrives.
+void RecvManyBatched(const WorkerEnv* env, WorkerSession* worker_session,
+                     int num_requests, bool check_values) {
+  RpcRendezvousMgr rmgr(env, BatchingConfig());
+
+  const int64_t step_id = 123;
+  {
+    tsl::core::RefCountPtr<RemoteRendezvous> rendez = rmgr.Find(step_id);
+    TF_ASSERT_OK(rendez->Initialize(worker_session));
+
+    mutex mu;
+    Status status;
+    std::vector<string> keys(num_requests);
+    std::vector<string> received(num_requests);
+    BlockingCounter counter(num_requests);
+    for (int i = 0; i < num_requests; ++i) {
+      keys[i] = Rendezvous::CreateKey(
+          "/job:worker/replica:1/task:2/cpu:0", 7890,
+          "/job:mnist/replica:1/task:2/cpu:1", strings::StrCat("foo", i),
+          FrameAndIter(0, 0));
+      rendez->RecvAsync(
+          MakeKey(keys[i]), Rendezvous::Args(),
+          [&mu, &status, &received, &counter, check_values, i](
+              const Status& s, const Rendezvous::Args&,
+              const Rendezvous::Args&, const Tensor& val, const bool) {
+            {
+              mutex_lock l(mu);
+              status.Update(s);
+              if (s.ok() && check_values) received[i] = V(val);
+            }
+            counter.DecrementCount();
+          });
+    }
+    counter.Wait();
+    TF_ASSERT_OK(status);
+    if (check_values) {
+      for (int i = 0; i < num_requests; ++i) {
+        EXPECT_EQ(received[i], keys[i]);
+      }
+    }
+  }
+  rmgr.Cleanup(step_id);
+}
+
+TEST_F(RpcRendezvousMgrTest, RemoteRecvAsyncBatched) {
+  DummyWorker* worker = cache_->worker();
+  worker->supports_batching = true;
+  const int num_requests = 1000;
+  RecvManyBatched(&env, &worker_session_, num_requests,
+                  /*check_values=*/true);
+  EXPECT_EQ(worker->num_recv_tensor_calls.load(), 0);
+  // No more than kMaxRecvTensorBatchSize (256) calls are sent in one RPC.
+  EXPECT_GE(worker->num_batch_recv_tensor_calls.load(), 4);
+  EXPECT_LT(worker->num_batch_recv_tensor_calls.load(), num_requests);
+}
+
+TEST_F(RpcRendezvousMgrTest, RemoteRecvAsyncBatchingUnsupported) {
+  DummyWorker* worker = cache_->worker();
+  const int num_requests = 1000;
+  RecvManyBatched(&env, &worker_session_, num_requests,
+                  /*check_values=*/false);
+  // Every call falls back to a RecvTensor RPC once the worker turns out not
+  // to support BatchRecvTensor.
+  EXPECT_EQ(worker->num_recv_tensor_calls.load(), num_requests);
+  EXPECT_GE(worker->num_batch_recv_tensor_calls.load(), 1);
+  EXPECT_LT(worker->num_batch_recv_tensor_calls.load(), num_requests);
+}
+
+// The remote worker sends "a" only once this worker has received "b", as
+// when "a" is computed from a tensor that this worker sends after receiving
+// "b".  Waiting for both in one BatchRecvTensor RPC would deadlock.
+TEST_F(RpcRendezvousMgrTest, RemoteRecvAsyncBatchedDependencyChain) {
+  DummyWorker* worker = cache_->worker();
+  worker->supports_batching = true;
+  worker->track_produced = true;
+  RpcRendezvousMgr rmgr(&env, BatchingConfig());
+  const string key_a = Rendezvous::CreateKey(
+      "/job:worker/replica:1/task:2/cpu:0", 7890,
+      "/job:mnist/replica:1/task:2/cpu:1", "a", FrameAndIter(0, 0));
+  const string key_b = Rendezvous::CreateKey(
+      "/job:worker/replica:1/task:2/cpu:0", 7890,
+      "/job:mnist/replica:1/task:2/cpu:1", "b", FrameAndIter(0, 0));
+  worker->Produce(key_b);
+
+  const int64_t step_id = 123;
+  {
+    tsl::core::RefCountPtr<RemoteRendezvous> rendez = rmgr.Find(step_id);
+    TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+    Notification a_received;
+    Notification b_received;
+    Status a_status;
+    Status b_status;
+    rendez->RecvAsync(MakeKey(key_a), Rendezvous::Args(),
+                      [&a_status, &a_received](
+                          const Status& s, const Rendezvous::Args&,
+                          const Rendezvous::Args&, const Tensor&, const bool) {
+                        a_status = s;
+                        a_received.Notify();
+                      });
+    rendez->RecvAsync(
+        MakeKey(key_b), Rendezvous::Args(),
+        [worker, &key_a, &key_b, &b_status, &b_received](
+            const Status& s, const Rendezvous::Args&, const Rendezvous::Args&,
+            const Tensor& val, const bool) {
+          b_status = s;
+          if (s.ok()) EXPECT_EQ(V(val), key_b);
+          worker->Produce(key_a);
+          b_received.Notify();
+        });
+    ASSERT_TRUE(b_received.WaitForNotificationWithTimeout(10 * 1000 * 1000));
+    ASSERT_TRUE(a_received.WaitForNotificationWithTimeout(10 * 1000 * 1000));
+    TF_EXPECT_OK(a_status);
+    TF_EXPECT_OK(b_status);
+  }
+  rmgr.Cleanup(step_id);
+  // "b" comes with the batch, and "a" with a RecvTensor RPC of its own.
+  EXPECT_EQ(worker->num_batch_recv_tensor_calls.load(), 1);
+  EXPECT_EQ(worker->num_recv_tensor_calls.load(), 1);
+}
+
 }  // namespace tensorflow
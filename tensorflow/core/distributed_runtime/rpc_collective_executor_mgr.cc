@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
 #include "tensorflow/core/distributed_runtime/collective_param_resolver_distributed.h"
 #include "tensorflow/core/distributed_runtime/collective_rma_distributed.h"
+#include "tensorflow/core/distributed_runtime/collective_rma_shm.h"
 #include "tensorflow/core/distributed_runtime/device_resolver_distributed.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/lib/random/random.h"
@@ -39,9 +40,12 @@ RpcCollectiveExecutorMgr::RpcCollectiveExecutorMgr(
   group_leader_ = (task_name == config.experimental().collective_group_leader())
                       ? ""
                       : config.experimental().collective_group_leader();
+  // Started last: the transport serves peers through FindOrCreate.
+  shm_transport_ = CollectiveShmTransport::Create(config, task_name_, this);
 }
 
 RpcCollectiveExecutorMgr::~RpcCollectiveExecutorMgr() {
+  shm_transport_.reset();
   for (auto it : sequence_table_) {
     delete it.second;
   }
@@ -51,7 +55,7 @@ CollectiveExecutor* RpcCollectiveExecutorMgr::Create(int64_t step_id) {
   CollectiveRemoteAccessDistributed* rma =
       new CollectiveRemoteAccessDistributed(dev_mgr_, dev_resolver_.get(),
                                             work_queue_, worker_cache_, step_id,
-                                            task_name_);
+                                            task_name_, shm_transport_.get());
   return new BaseCollectiveExecutor(this, rma, step_id, dev_mgr_, work_queue_);
 }
 
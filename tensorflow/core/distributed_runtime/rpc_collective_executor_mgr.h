@@ -20,6 +20,7 @@ limitations under the License.
 
 namespace tensorflow {
 class CollectiveParamResolverDistributed;
+class CollectiveShmTransport;
 class ConfigProto;
 class DeviceMgr;
 class DeviceResolverDistributed;
@@ -30,6 +31,9 @@ class StepSequenceResponse;
 // An implementation of CollectiveExecutorMgr for a distributed environment
 // that uses WorkerInterface::RecvBufAsync to route data transfers over RPCs.
 //
+// Transfers between tasks on the same host use shared memory instead when
+// the config sets collective_shm_namespace; see CollectiveShmTransport.
+//
 // In some execution environments it may be possible to implement a
 // higher-performance solution and use it in place of this class.
 class RpcCollectiveExecutorMgr : public CollectiveExecutorMgr {
@@ -62,6 +66,7 @@ class RpcCollectiveExecutorMgr : public CollectiveExecutorMgr {
   WorkerCacheInterface* const worker_cache_;  // Not owned.
   const string task_name_;
   string group_leader_;
+  std::unique_ptr<CollectiveShmTransport> shm_transport_;  // May be null.
   friend class RpcCollectiveExecutorMgrTest;
 
  private:
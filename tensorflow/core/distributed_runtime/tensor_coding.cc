@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
 
+#include <vector>
+
 #include "google/protobuf/any.pb.h"
 
 #include "tensorflow/core/common_runtime/device.h"
@@ -141,6 +143,29 @@ bool ReadNestedMessage(protobuf::io::CodedInputStream* input,
   return input->DecrementRecursionDepthAndPopLimit(p.first);
 }
 
+// Reads "num_bytes" of string tensor content, in the format written by
+// port::EncodeStringList, directly into the elements of "*t".
+bool ReadStringTensorContent(protobuf::io::CodedInputStream* input,
+                             int num_bytes, Tensor* t) {
+  auto strings = t->flat<tstring>();
+  const int64_t n = strings.size();
+  const int start = input->CurrentPosition();
+  std::vector<uint32> sizes(n);
+  int64_t total_size = 0;
+  for (uint32& size : sizes) {
+    if (!input->ReadVarint32(&size)) return false;
+    total_size += size;
+  }
+  if (input->CurrentPosition() - start + total_size != num_bytes) {
+    return false;
+  }
+  for (int64_t i = 0; i < n; ++i) {
+    strings(i).resize_uninitialized(sizes[i]);
+    if (!input->ReadRaw(strings(i).mdata(), sizes[i])) return false;
+  }
+  return true;
+}
+
 }  // namespace
 
 bool TensorResponse::ParseTensorSubmessage(
@@ -166,7 +191,10 @@ bool TensorResponse::ParseTensorSubmessage(
         if ((wt != WIRETYPE_VARINT) || !input->ReadVarint32(&v)) return false;
         if (seen_tensor_content) return false;
         tensor_meta->set_dtype(static_cast<DataType>(static_cast<int>(v)));
-        if (!DataTypeCanUseMemcpy(tensor_meta->dtype())) return false;
+        if (!DataTypeCanUseMemcpy(tensor_meta->dtype()) &&
+            tensor_meta->dtype() != DT_STRING) {
+          return false;
+        }
         break;
       }
       case TensorProto::kTensorShapeFieldNumber: {
@@ -196,6 +224,11 @@ bool TensorResponse::ParseTensorSubmessage(
         seen_tensor_content = true;
         TensorShape shape(tensor_meta->tensor_shape());
         Tensor t(allocator_, tensor_meta->dtype(), shape);
+        if (t.dtype() == DT_STRING) {
+          if (!ReadStringTensorContent(input, num_bytes, &t)) return false;
+          tensor_ = std::move(t);
+          break;
+        }
         StringPiece buf = t.tensor_data();
         if (static_cast<size_t>(num_bytes) != buf.size()) return false;
         // TODO(jeff,sanjay): Figure out a way to avoid this copy if
@@ -156,6 +156,30 @@ TEST_F(TensorResponseTest, Simple) {
 
 TEST_F(TensorResponseTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(TensorResponseTest, LargeStringTensor) {
+  Tensor a(DT_STRING, TensorShape({2, 2}));
+  test::FillValues<tstring>(&a, {string(100000, 'x'), "", "abc",
+                                 string(3000, 'y')});
+  Validate(a, false, true);
+}
+
+TEST_F(TensorResponseTest, CorruptStringTensorContent) {
+  Tensor a(DT_STRING, TensorShape({2}));
+  test::FillValues<tstring>(&a, {"abc", "defg"});
+  RecvTensorResponse proto;
+  a.AsProtoTensorContent(proto.mutable_tensor());
+  // Claim that the first element is longer than the content.
+  (*proto.mutable_tensor()->mutable_tensor_content())[0] = 100;
+  string encoded;
+  proto.AppendToString(&encoded);
+
+  StringSource source(&encoded, 1024);
+  TensorResponse response;
+  DummyDevice cpu_device(Env::Default());
+  response.InitAlloc(&cpu_device, AllocatorAttributes());
+  EXPECT_FALSE(response.ParseFrom(&source).ok());
+}
+
 string MakeFloatTensorTestCase(int num_elems) {
   std::vector<int8> v(num_elems);
   for (int i = 0; i < num_elems; i++) {
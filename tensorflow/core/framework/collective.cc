@@ -48,6 +48,13 @@ std::vector<RegistrationInfo>* MutableCollectiveRegistry() {
 }
 }  // namespace
 
+CollGroupResiduals::Entry* CollGroupResiduals::Get(const string& key) {
+  mutex_lock l(mu_);
+  std::unique_ptr<Entry>& entry = entries_[key];
+  if (entry == nullptr) entry = std::make_unique<Entry>();
+  return entry.get();
+}
+
 string CollGroupRuntimeDetails::ToString() const {
   return strings::StrCat("CollGroupRuntimeDetails {communicator_key=",
                          absl::CEscape(communicator_key), "}");
@@ -88,6 +95,9 @@ CollInstanceParams& CollInstanceParams::operator=(
         other.impl_details.subdiv_source_rank.begin(),
         other.impl_details.subdiv_source_rank.end());
     impl_details.dependencies = other.impl_details.dependencies;
+    impl_details.compression = other.impl_details.compression;
+    impl_details.compression_topk_ratio =
+        other.impl_details.compression_topk_ratio;
     devices.assign(other.devices.begin(), other.devices.end());
     permutation.assign(other.permutation.begin(), other.permutation.end());
   }
@@ -120,6 +130,13 @@ string CollInstanceParams::ToString() const {
     }
     strings::StrAppend(&v, "}");
   }  // all subdivs
+  if (!impl_details.compression.empty()) {
+    strings::StrAppend(&v, " compression=", impl_details.compression);
+    if (impl_details.compression == "topk") {
+      strings::StrAppend(&v, " topk_ratio=",
+                         impl_details.compression_topk_ratio);
+    }
+  }
   if (type == PERMUTE_COLLECTIVE) {
     strings::StrAppend(&v, "}, permute_devices {");
     for (const auto& d : devices) {
@@ -15,17 +15,21 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_FRAMEWORK_COLLECTIVE_H_
 #define TENSORFLOW_CORE_FRAMEWORK_COLLECTIVE_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
 #include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/refcount.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/intrusive_ptr.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 
@@ -52,11 +56,42 @@ enum CollectiveType {
   UNDEFINED_COLLECTIVE,
 };
 
+// Private attrs of CollectiveReduce and CollectiveReduceV2 nodes that select
+// the lossy compression RingReduce applies between tasks.  They set
+// CollImplDetails::compression and compression_topk_ratio, and must be the
+// same on every member of an instance.
+constexpr char kRingReduceCompressionAttr[] = "_ring_reduce_compression";
+constexpr char kRingReduceCompressionTopKRatioAttr[] =
+    "_ring_reduce_compression_topk_ratio";
+
+// Tensors that a collective implementation carries over from one instance of
+// a group to the next on this worker, such as the error-feedback residuals of
+// top-k compressed RingReduce.  Entries are keyed by the implementation, and
+// live as long as the group.
+class CollGroupResiduals {
+ public:
+  struct Entry {
+    mutex mu;
+    Tensor residual TF_GUARDED_BY(mu);
+  };
+
+  // Returns the entry for "key", creating an empty one if there is none.
+  Entry* Get(const string& key);
+
+ private:
+  mutex mu_;
+  absl::flat_hash_map<string, std::unique_ptr<Entry>> entries_
+      TF_GUARDED_BY(mu_);
+};
+
 // Some collective op implementations require runtime group configuration from
 // the OpKernel.  Currently, this struct is used to set communicator key for
 // NCCL-based collective implementation.
 struct CollGroupRuntimeDetails {
   string communicator_key;  // for communicator-based techniques e.g. NCCL
+  // Created with the group by the param resolver, and shared by every copy of
+  // the group's params.
+  std::shared_ptr<CollGroupResiduals> residuals;
   string ToString() const;
 };
 
@@ -116,6 +151,12 @@ struct CollImplDetails {
                               // e.g. ring or nccl
   float timeout_seconds;      // If non zero, set a completion timeout for the
                               // collective op to detect staleness.
+  // Lossy compression RingReduce applies to chunks sent between tasks: ""
+  // (none), "bf16", "fp16" or "topk".  Set from kRingReduceCompressionAttr;
+  // see RingAlg for details.
+  string compression;
+  // Fraction of the elements of each chunk sent when compression is "topk".
+  float compression_topk_ratio = 0.01;
 };
 
 // Data common to all members of a collective instance.
@@ -79,6 +79,11 @@ auto* graph_unused_outputs = tsl::monitoring::Counter<1>::New(
     "/tensorflow/core/graph_unused_outputs",
     "The number of unused outputs for ops of a given type.", "name");
 
+auto* checkpoint_restore_mapped_bytes = tsl::monitoring::Counter<0>::New(
+    "/tensorflow/core/checkpoint/restore_mapped_bytes",
+    "The number of bytes of restored tensors that alias a read-only memory "
+    "mapping of the checkpoint.");
+
 auto* tf_data_fetch_op_counter = tsl::monitoring::Counter<1>::New(
     "/tensorflow/data/fetch_op",
     "The number of times a tf.data operation that fetches output(s) of a "
@@ -925,6 +930,10 @@ void RecordUnusedOutput(const string& op_name) {
   graph_unused_outputs->GetCell(op_name)->IncrementBy(1);
 }
 
+void RecordCheckpointRestoreMappedBytes(int64_t num_bytes) {
+  checkpoint_restore_mapped_bytes->GetCell()->IncrementBy(num_bytes);
+}
+
 void RecordPipelineProcessingTime(const string& id,
                                   double pipeline_processing_time_usec) {
   GetTFDataPipelineProcessingTimeGauge(id)->Set(pipeline_processing_time_usec);
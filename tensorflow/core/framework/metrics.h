@@ -272,6 +272,10 @@ void UpdateGraphPendingQueueLength(uint64 len);
 // Records that one output of an op of type `op_name` was unused.
 void RecordUnusedOutput(const string& op_name);
 
+// Records that a restored tensor of `num_bytes` bytes aliases a read-only
+// memory mapping of its checkpoint instead of being copied.
+void RecordCheckpointRestoreMappedBytes(int64_t num_bytes);
+
 // Records the pipeline processing time in microseconds
 void RecordPipelineProcessingTime(const string& id,
                                   double pipeline_processing_time_usec);
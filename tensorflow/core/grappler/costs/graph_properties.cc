@@ -37,7 +37,10 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/topological_sort.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/flatset.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 namespace grappler {
@@ -643,6 +646,47 @@ static void NormalizeShapeForOutput(TensorShapeProto* shape) {
 // shape refiner which creates new handles every time it processes an unknown
 // shape/dimension, the symbolic shape refiner assigns a specific handle to each
 // unknown shape/dimension of a given node.
+// Caches the output properties of function calls across shape inferences. The
+// key is the function body specialized for the input shapes and values of the
+// call, so calls of the same function with the same inputs share an entry,
+// whether they are in the same graph or in the graphs that successive grappler
+// passes infer the shapes of.
+class FunctionShapeCache {
+ public:
+  static FunctionShapeCache* Global() {
+    static FunctionShapeCache* cache = new FunctionShapeCache();
+    return cache;
+  }
+
+  bool Lookup(uint64 key,
+              std::vector<OpInfo::TensorProperties>* outputs) const {
+    tf_shared_lock l(mu_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      return false;
+    }
+    *outputs = it->second;
+    return true;
+  }
+
+  void Insert(uint64 key,
+              const std::vector<OpInfo::TensorProperties>& outputs) {
+    mutex_lock l(mu_);
+    // Entries are cheap to recompute: start over rather than track recency.
+    if (entries_.size() >= kMaxEntries) {
+      entries_.clear();
+    }
+    entries_.emplace(key, outputs);
+  }
+
+ private:
+  static constexpr int kMaxEntries = 4096;
+
+  mutable mutex mu_;
+  absl::flat_hash_map<uint64, std::vector<OpInfo::TensorProperties>> entries_
+      TF_GUARDED_BY(mu_);
+};
+
 class SymbolicShapeRefiner {
  public:
   explicit SymbolicShapeRefiner(
@@ -817,10 +861,13 @@ class SymbolicShapeRefiner {
     MutableGraphView gv(&grappler_function_item.graph);
 
     // Forward shapes from function input nodes to argument nodes.
+    std::vector<const NodeDef*> arg_nodes;
+    arg_nodes.reserve(grappler_function_item.inputs().size());
     for (int i = 0, end = grappler_function_item.inputs().size(); i < end;
          ++i) {
       auto& fun_input = grappler_function_item.input(i);
       NodeDef* fun_node = gv.GetNode(fun_input.node_name);
+      arg_nodes.push_back(fun_node);
       const TensorId input_tensor = ParseTensorName(function_node->input(i));
 
       if (IsControlInput(input_tensor)) {
@@ -936,42 +983,61 @@ class SymbolicShapeRefiner {
       output_node->mutable_attr()->erase("index");
     }
 
-    // Perform inference on function body.
-    GraphProperties gp(grappler_function_item);
-    TF_RETURN_IF_ERROR(gp.InferStatically(
-        /*assume_valid_feeds=*/true,
-        /*aggressive_shape_inference=*/aggressive_shape_inference_,
-        /*include_tensor_values=*/true));
-
-    // Add return nodes for output shapes.
-    int output = 0;
-    ctx->output_tensors_as_shapes.resize(grappler_function_item.output_size());
-    ctx->output_tensor_protos.resize(grappler_function_item.output_size(),
-                                     nullptr);
-    for (auto const& out_arg : grappler_function_item.outputs()) {
-      // It is guaranteed that output_tensors does not contain any control
-      // inputs, so port_id >= 0.
-      TensorId out_tensor = ParseTensorName(out_arg.node_name);
-
-      if (output_nodes.count(out_tensor.node()) <= 0) {
-        return errors::FailedPrecondition(
-            "Unable to find return function_node ", out_tensor.node(), " for ",
-            function_node->name());
+    // Perform inference on function body, unless the same body was already
+    // inferred with the same input shapes and values. Only the argument nodes
+    // differ between the calls of a function, and ReplaceInputWithConst()
+    // rewrites them in place: the key combines the fingerprint of the
+    // instantiated body with theirs.
+    uint64 cache_key =
+        FingerprintCat64(fun_to_body_fingerprint_.at(function.name()),
+                         aggressive_shape_inference_ ? 1 : 0);
+    string serialized_arg;
+    for (const NodeDef* arg_node : arg_nodes) {
+      SerializeToStringDeterministic(*arg_node, &serialized_arg);
+      cache_key = FingerprintCat64(cache_key, Fingerprint64(serialized_arg));
+    }
+    std::vector<OpInfo::TensorProperties> function_outputs;
+    if (!FunctionShapeCache::Global()->Lookup(cache_key, &function_outputs)) {
+      GraphProperties gp(grappler_function_item);
+      TF_RETURN_IF_ERROR(gp.InferStatically(
+          /*assume_valid_feeds=*/true,
+          /*aggressive_shape_inference=*/aggressive_shape_inference_,
+          /*include_tensor_values=*/true));
+
+      for (auto const& out_arg : grappler_function_item.outputs()) {
+        // It is guaranteed that output_tensors does not contain any control
+        // inputs, so port_id >= 0.
+        TensorId out_tensor = ParseTensorName(out_arg.node_name);
+
+        if (output_nodes.count(out_tensor.node()) <= 0) {
+          return errors::FailedPrecondition(
+              "Unable to find return function_node ", out_tensor.node(),
+              " for ", function_node->name());
+        }
+        const NodeDef* retnode = output_nodes[out_tensor.node()];
+
+        auto output_properties = gp.GetOutputProperties(retnode->name());
+        int output_properties_size = output_properties.size();
+        if (out_tensor.index() >= output_properties_size) {
+          return errors::InvalidArgument(
+              out_tensor.ToString(), " has invalid position ",
+              out_tensor.index(),
+              " (output_properties.size() = ", output_properties.size(), ").");
+        }
+        function_outputs.push_back(output_properties[out_tensor.index()]);
+        NormalizeShapeForOutput(function_outputs.back().mutable_shape());
       }
-      const NodeDef* retnode = output_nodes[out_tensor.node()];
+      FunctionShapeCache::Global()->Insert(cache_key, function_outputs);
+    }
 
-      auto output_properties = gp.GetOutputProperties(retnode->name());
-      int output_properties_size = output_properties.size();
-      if (out_tensor.index() >= output_properties_size) {
-        return errors::InvalidArgument(
-            out_tensor.ToString(), " has invalid position ", out_tensor.index(),
-            " (output_properties.size() = ", output_properties.size(), ").");
-      }
-      auto& outprop = output_properties[out_tensor.index()];
-      TensorShapeProto shape = outprop.shape();
-      NormalizeShapeForOutput(&shape);
+    // Add return nodes for output shapes.
+    ctx->output_tensors_as_shapes.resize(function_outputs.size());
+    ctx->output_tensor_protos.resize(function_outputs.size(), nullptr);
+    for (int output = 0, end = function_outputs.size(); output < end;
+         ++output) {
+      const auto& outprop = function_outputs[output];
       ShapeHandle out;
-      TF_RETURN_IF_ERROR(ic->MakeShapeFromShapeProto(shape, &out));
+      TF_RETURN_IF_ERROR(ic->MakeShapeFromShapeProto(outprop.shape(), &out));
       ic->set_output(output, out);
       if (outprop.has_value()) {
         // Forward tensor value to output_tensors_as_shape.
@@ -980,7 +1046,6 @@ class SymbolicShapeRefiner {
         const_tensors_to_propagate_.push_back(outprop.value());
         ctx->output_tensor_protos[output] = &const_tensors_to_propagate_.back();
       }
-      output++;
     }
 
     return absl::OkStatus();
@@ -1345,6 +1410,13 @@ class SymbolicShapeRefiner {
       }
     }
 
+    // The body includes the functions it calls. Fingerprint it once, since
+    // UpdateFunction() looks up the shapes of every call in FunctionShapeCache.
+    string serialized_body;
+    SerializeToStringDeterministic(grappler_function_item.graph,
+                                   &serialized_body);
+    fun_to_body_fingerprint_[function_def->signature().name()] =
+        Fingerprint64(serialized_body);
     fun_to_grappler_function_item_[function_def->signature().name()] =
         grappler_function_item;
 
@@ -2051,6 +2123,9 @@ class SymbolicShapeRefiner {
   // instantiation failed it will have an `absl::nullopt`.
   absl::flat_hash_map<string, absl::optional<GrapplerFunctionItem>>
       fun_to_grappler_function_item_;
+  // Fingerprints of the bodies of the valid function instantiations, for the
+  // keys of FunctionShapeCache.
+  absl::flat_hash_map<string, uint64> fun_to_body_fingerprint_;
   FunctionLibraryDefinition function_library_;
   const absl::flat_hash_map<string, absl::flat_hash_set<int>>& fed_ports_;
   // Store TensorProtos for tensor value propagation. Note that we use deque,
@@ -2518,6 +2593,11 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
                                         bool aggressive_shape_inference,
                                         bool include_input_tensor_values,
                                         bool include_output_tensor_values) {
+  inferred_statically_ = false;
+  assume_valid_feeds_ = assume_valid_feeds;
+  aggressive_shape_inference_ = aggressive_shape_inference;
+  include_input_tensor_values_ = include_input_tensor_values;
+  include_output_tensor_values_ = include_output_tensor_values;
   FunctionLibraryDefinition function_library(OpRegistry::Global(),
                                              item_.graph.library());
   absl::flat_hash_map<string, absl::flat_hash_set<int>> fed_ports;
@@ -2756,9 +2836,196 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
   TF_RETURN_IF_ERROR(VerboseShapeInferenceLogging(item_.graph, refiner.get(),
                                                   shape_manager.get()));
 
+  inferred_statically_ = true;
   return absl::OkStatus();
 }
 
+Status GraphProperties::UpdateStatically(
+    const absl::flat_hash_set<string>& modified_nodes) {
+  if (!inferred_statically_) {
+    return errors::FailedPrecondition(
+        "UpdateStatically requires a previous call to InferStatically");
+  }
+  if (modified_nodes.empty()) {
+    return absl::OkStatus();
+  }
+  const auto infer_from_scratch = [this]() {
+    Clear();
+    return InferStatically(assume_valid_feeds_, aggressive_shape_inference_,
+                           include_input_tensor_values_,
+                           include_output_tensor_values_);
+  };
+
+  absl::flat_hash_set<string> fed_nodes;
+  for (const auto& feed : item_.feed) {
+    fed_nodes.insert(NodeName(feed.first));
+  }
+
+  // Collect the modified nodes still in the graph and their transitive fanout.
+  GraphView graph_view(&item_.graph);
+  std::vector<const NodeDef*> to_visit;
+  for (const string& node_name : modified_nodes) {
+    input_properties_.erase(node_name);
+    output_properties_.erase(node_name);
+    incompatible_shape_nodes_.erase(node_name);
+    const NodeDef* node = graph_view.GetNode(node_name);
+    if (node != nullptr) {
+      to_visit.push_back(node);
+    }
+  }
+  absl::flat_hash_set<const NodeDef*> updated_nodes;
+  while (!to_visit.empty()) {
+    const NodeDef* node = to_visit.back();
+    to_visit.pop_back();
+    if (!updated_nodes.insert(node).second) {
+      continue;
+    }
+    // Shapes flow through these in ways a partial inference does not capture.
+    if (IsControlFlow(*node) || IsQueue(*node) || IsEnqueue(*node) ||
+        IsDequeue(*node) || fed_nodes.contains(node->name())) {
+      VLOG(2) << "Inferring all shapes again since " << node->name()
+              << " is modified";
+      return infer_from_scratch();
+    }
+    for (const GraphView::InputPort& fanout : graph_view.GetFanouts(
+             *node, /*include_controlled_nodes=*/false)) {
+      to_visit.push_back(fanout.node);
+    }
+  }
+  if (static_cast<int>(updated_nodes.size()) * 2 > item_.graph.node_size()) {
+    return infer_from_scratch();
+  }
+
+  // Build a graph of the nodes to update, in which each of their fanins that is
+  // not updated is replaced with a Const node holding its value if known, and
+  // with a Placeholder of its shape otherwise.
+  GrapplerItem update_item;
+  update_item.id = item_.id;
+  *update_item.graph.mutable_versions() = item_.graph.versions();
+  *update_item.graph.mutable_library() = item_.graph.library();
+  absl::flat_hash_map<string, string> boundary_nodes;
+  for (const NodeDef& node : item_.graph.node()) {
+    if (!updated_nodes.contains(&node)) {
+      continue;
+    }
+    NodeDef* update_node = update_item.graph.add_node();
+    *update_node = node;
+    update_node->clear_input();
+    for (const string& input : node.input()) {
+      const TensorId tensor_id = ParseTensorName(input);
+      const NodeDef* fanin = graph_view.GetNode(tensor_id.node());
+      if (fanin != nullptr && updated_nodes.contains(fanin)) {
+        update_node->add_input(input);
+        continue;
+      }
+      // Control dependencies do not affect the shapes.
+      if (IsControlInput(tensor_id)) {
+        continue;
+      }
+      auto it = output_properties_.find(tensor_id.node());
+      if (fanin == nullptr || it == output_properties_.end() ||
+          tensor_id.index() >= static_cast<int>(it->second.size())) {
+        return infer_from_scratch();
+      }
+      const OpInfo::TensorProperties& fanin_properties =
+          it->second[tensor_id.index()];
+      // The shapes and types of the resources are not in the properties, and
+      // references cannot be fed from a boundary node.
+      if (fanin_properties.dtype() == DT_RESOURCE ||
+          fanin_properties.dtype() == DT_VARIANT ||
+          IsRefType(fanin_properties.dtype())) {
+        return infer_from_scratch();
+      }
+      const string tensor_name = tensor_id.ToString();
+      auto boundary = boundary_nodes.find(tensor_name);
+      if (boundary == boundary_nodes.end()) {
+        const string boundary_name =
+            strings::StrCat("GraphProperties/Boundary/", tensor_name);
+        if (graph_view.GetNode(boundary_name) != nullptr) {
+          return infer_from_scratch();
+        }
+        NodeDef* boundary_node = update_item.graph.add_node();
+        boundary_node->set_name(boundary_name);
+        boundary_node->set_device(fanin->device());
+        AttrValue dtype;
+        dtype.set_type(fanin_properties.dtype());
+        (*boundary_node->mutable_attr())["dtype"] = dtype;
+        if (fanin_properties.has_value()) {
+          boundary_node->set_op("Const");
+          *(*boundary_node->mutable_attr())["value"].mutable_tensor() =
+              fanin_properties.value();
+        } else {
+          boundary_node->set_op("Placeholder");
+          TensorShapeProto shape = fanin_properties.shape();
+          NormalizeShapeForOutput(&shape);
+          *(*boundary_node->mutable_attr())["shape"].mutable_shape() = shape;
+        }
+        boundary = boundary_nodes.emplace(tensor_name, boundary_name).first;
+      }
+      update_node->add_input(boundary->second);
+    }
+  }
+
+  GraphProperties update_properties(update_item);
+  TF_RETURN_IF_ERROR(update_properties.InferStatically(
+      assume_valid_feeds_, aggressive_shape_inference_,
+      include_input_tensor_values_, include_output_tensor_values_));
+
+  // Each inference numbers its symbolic dimensions from -2 down: renumber the
+  // new ones so they do not alias those of the nodes that were not updated.
+  int64_t next_symbolic_dim = MinSymbolicDim() - 1;
+  absl::flat_hash_map<int64_t, int64_t> symbolic_dims;
+  const auto renumber_symbolic_dims =
+      [&](std::vector<OpInfo::TensorProperties>* properties) {
+        for (OpInfo::TensorProperties& tensor : *properties) {
+          for (auto& dim : *tensor.mutable_shape()->mutable_dim()) {
+            if (dim.size() >= -1) {
+              continue;
+            }
+            auto it = symbolic_dims.emplace(dim.size(), next_symbolic_dim);
+            if (it.second) {
+              --next_symbolic_dim;
+            }
+            dim.set_size(it.first->second);
+          }
+        }
+      };
+  for (const NodeDef& node : item_.graph.node()) {
+    if (!updated_nodes.contains(&node) ||
+        !update_properties.HasInputProperties(node.name())) {
+      continue;
+    }
+    std::vector<OpInfo::TensorProperties> inputs =
+        update_properties.GetInputProperties(node.name());
+    std::vector<OpInfo::TensorProperties> outputs =
+        update_properties.GetOutputProperties(node.name());
+    renumber_symbolic_dims(&inputs);
+    renumber_symbolic_dims(&outputs);
+    input_properties_[node.name()] = std::move(inputs);
+    output_properties_[node.name()] = std::move(outputs);
+    if (update_properties.CheckShapeIncompatible(node.name())) {
+      incompatible_shape_nodes_.insert(node.name());
+    }
+  }
+  return absl::OkStatus();
+}
+
+int64_t GraphProperties::MinSymbolicDim() const {
+  int64_t min_dim = -1;
+  const auto visit = [&min_dim](const auto& properties) {
+    for (const auto& node_properties : properties) {
+      for (const OpInfo::TensorProperties& tensor : node_properties.second) {
+        for (const auto& dim : tensor.shape().dim()) {
+          min_dim = std::min<int64_t>(min_dim, dim.size());
+        }
+      }
+    }
+  };
+  visit(input_properties_);
+  visit(output_properties_);
+  return min_dim;
+}
+
 Status GraphProperties::InferDynamically(Cluster* cluster) {
   TF_RETURN_IF_ERROR(cluster->Initialize(item_));
 
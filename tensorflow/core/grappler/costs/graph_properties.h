@@ -21,6 +21,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/grappler/clusters/cluster.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
@@ -114,6 +115,16 @@ class GraphProperties {
                            /*aggressive_shape_inference=*/false,
                            /*include_tensor_values=*/true);
   }
+  // Updates the properties inferred by the last call to InferStatically after
+  // the nodes named in `modified_nodes` were added, deleted or modified, e.g.
+  // as tracked by MutableGraphView::modified_nodes(). Only the modified nodes
+  // and their transitive fanout are inferred again, starting from the
+  // properties of their other fanins, and with the same options as the last
+  // call. Symbolic dimensions are not related across the boundary of the
+  // update, so the result can be less precise than that of a full inference.
+  // Falls back to a full inference when the update reaches control flow,
+  // queues, fed nodes, resource or reference tensors, or most of the graph.
+  Status UpdateStatically(const absl::flat_hash_set<string>& modified_nodes);
   // Infer the shape by running the graph on the specified cluster and recording
   // the shapes of the processed tensors.
   Status InferDynamically(Cluster* cluster);
@@ -156,6 +167,7 @@ class GraphProperties {
   void Clear() {
     input_properties_.clear();
     output_properties_.clear();
+    incompatible_shape_nodes_.clear();
   }
 
  private:
@@ -200,6 +212,9 @@ class GraphProperties {
           resource_handles,
       int num_loops) const;
 
+  // Returns the smallest symbolic dimension in the inferred properties, or -1.
+  int64_t MinSymbolicDim() const;
+
   // Data members
   const GrapplerItem& item_;
   absl::flat_hash_map<string, std::vector<OpInfo::TensorProperties>>
@@ -211,6 +226,13 @@ class GraphProperties {
   // Nodes with output shape incompatible between shape inference and
   // annotation.
   std::unordered_set<string> incompatible_shape_nodes_;
+
+  // The options of the last static inference, reused by UpdateStatically.
+  bool inferred_statically_ = false;
+  bool assume_valid_feeds_ = false;
+  bool aggressive_shape_inference_ = false;
+  bool include_input_tensor_values_ = false;
+  bool include_output_tensor_values_ = false;
 };
 
 // Helper function for GraphProperties.
@@ -29,11 +29,13 @@ limitations under the License.
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
 #include "tensorflow/core/grappler/inputs/utils.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #ifdef INTEL_MKL
 #include "tensorflow/core/graph/mkl_graph_util.h"
 #endif
@@ -2007,6 +2009,56 @@ TEST_F(GraphPropertiesTest, SymbolicShapes) {
   EXPECT_EQ(shape_j.dim(0).size(), shape_a.dim(1).size());
 }
 
+TEST_F(GraphPropertiesTest, UpdateStatically) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output a = ops::Placeholder(s.WithOpName("a"), DT_FLOAT,
+                              ops::Placeholder::Shape(TensorShape({4, 3})));
+  Output b = ops::Identity(s.WithOpName("b"), a);
+  Output c = ops::Relu(s.WithOpName("c"), b);
+  Output d = ops::Placeholder(s.WithOpName("d"), DT_FLOAT,
+                              ops::Placeholder::Shape(TensorShape({5, 3})));
+  Output e = ops::Identity(s.WithOpName("e"), d);
+  Output f = ops::Identity(s.WithOpName("f"), e);
+
+  GrapplerItem item;
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+  GraphProperties properties(item);
+  EXPECT_FALSE(properties.UpdateStatically({"b"}).ok());
+  TF_ASSERT_OK(properties.InferStatically(false));
+  EXPECT_EQ("float: [4,3]",
+            PropToString(properties.GetOutputProperties("c").at(0)));
+
+  // Only b and its fanout are inferred again.
+  MutableGraphView graph(&item.graph);
+  TF_ASSERT_OK(graph.UpdateRegularFaninByPort("b", 0, {"d", 0}));
+  TF_ASSERT_OK(properties.UpdateStatically(graph.modified_nodes()));
+  EXPECT_EQ("float: [5,3]",
+            PropToString(properties.GetInputProperties("b").at(0)));
+  EXPECT_EQ("float: [5,3]",
+            PropToString(properties.GetOutputProperties("c").at(0)));
+  EXPECT_EQ("float: [4,3]",
+            PropToString(properties.GetOutputProperties("a").at(0)));
+  EXPECT_EQ("float: [5,3]",
+            PropToString(properties.GetOutputProperties("f").at(0)));
+
+  graph.ClearModifiedNodes();
+  NodeDef square;
+  square.set_name("square");
+  square.set_op("Square");
+  square.add_input("c");
+  (*square.mutable_attr())["T"].set_type(DT_FLOAT);
+  graph.AddNode(std::move(square));
+  TF_ASSERT_OK(properties.UpdateStatically(graph.modified_nodes()));
+  EXPECT_EQ("float: [5,3]",
+            PropToString(properties.GetOutputProperties("square").at(0)));
+
+  graph.ClearModifiedNodes();
+  TF_ASSERT_OK(graph.DeleteNodes({"square"}));
+  TF_ASSERT_OK(properties.UpdateStatically(graph.modified_nodes()));
+  EXPECT_FALSE(properties.HasOutputProperties("square"));
+  EXPECT_TRUE(properties.HasOutputProperties("c"));
+}
+
 TEST_F(GraphPropertiesTest, DoNotValidateColocationConstraints) {
   tensorflow::Scope s = tensorflow::Scope::NewRootScope();
   Output a = ops::Const(s.WithOpName("a"), 1.0f, {1});
@@ -2675,6 +2727,64 @@ TEST(HelperFunctions, IsShapeFullyDefinedIntegerVectorOrScalar) {
   EXPECT_FALSE(IsShapeFullyDefinedIntegerVectorOrScalar(
       &ic, fully_defined_vector, vector_with_unknown_from_const, DT_INT32));
 }
+
+// Builds a chain of `num_nodes` Relus, and an Identity "last" of its end that
+// can be switched to the Placeholder "other".
+GrapplerItem CreateChainItem(int num_nodes) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("a"), DT_FLOAT,
+                              ops::Placeholder::Shape(TensorShape({8, 8})));
+  for (int i = 0; i < num_nodes; ++i) {
+    x = ops::Relu(s.WithOpName(strings::StrCat("relu_", i)), x);
+  }
+  ops::Placeholder(s.WithOpName("other"), DT_FLOAT,
+                   ops::Placeholder::Shape(TensorShape({4, 8})));
+  ops::Identity(s.WithOpName("last"), x);
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  return item;
+}
+
+NodeDef* FindNode(const string& name, GraphDef* graph) {
+  for (NodeDef& node : *graph->mutable_node()) {
+    if (node.name() == name) return &node;
+  }
+  return nullptr;
+}
+
+// Infers the shapes again from scratch after each edit of the graph.
+void BM_InferStaticallyAfterEdit(::testing::benchmark::State& state) {
+  const int num_nodes = state.range(0);
+  GrapplerItem item = CreateChainItem(num_nodes);
+  NodeDef* last = FindNode("last", &item.graph);
+  const string inputs[] = {strings::StrCat("relu_", num_nodes - 1), "other"};
+  int edit = 0;
+  for (auto s : state) {
+    last->set_input(0, inputs[++edit % 2]);
+    GraphProperties properties(item);
+    TF_CHECK_OK(properties.InferStatically(/*assume_valid_feeds=*/false));
+  }
+}
+
+BENCHMARK(BM_InferStaticallyAfterEdit)->Arg(10)->Arg(100)->Arg(1000);
+
+// Updates the shapes of the edited node only.
+void BM_UpdateStaticallyAfterEdit(::testing::benchmark::State& state) {
+  const int num_nodes = state.range(0);
+  GrapplerItem item = CreateChainItem(num_nodes);
+  NodeDef* last = FindNode("last", &item.graph);
+  const string inputs[] = {strings::StrCat("relu_", num_nodes - 1), "other"};
+  GraphProperties properties(item);
+  TF_CHECK_OK(properties.InferStatically(/*assume_valid_feeds=*/false));
+  int edit = 0;
+  for (auto s : state) {
+    last->set_input(0, inputs[++edit % 2]);
+    TF_CHECK_OK(properties.UpdateStatically({"last"}));
+  }
+}
+
+BENCHMARK(BM_UpdateStaticallyAfterEdit)->Arg(10)->Arg(100)->Arg(1000);
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
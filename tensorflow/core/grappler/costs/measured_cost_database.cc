@@ -0,0 +1,273 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/measured_cost_database.h"
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/grappler/costs/utils.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/host_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/random.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kShardSuffix[] = ".op_costs";
+
+mutex global_mu(LINKER_INITIALIZED);
+MeasuredCostDatabase* global_database TF_GUARDED_BY(global_mu) = nullptr;
+
+string ShardPath(const string& dir) {
+  if (dir.empty()) return "";
+  return io::JoinPath(dir, absl::StrCat(port::Hostname(), ".",
+                                        Env::Default()->GetProcessId(), ".",
+                                        absl::Hex(random::New64()),
+                                        kShardSuffix));
+}
+
+bool HasKnownShapes(const OpInfo& op_info) {
+  for (const auto& input : op_info.inputs()) {
+    if (input.shape().unknown_rank()) return false;
+    for (const auto& dim : input.shape().dim()) {
+      if (dim.size() < 0) return false;
+    }
+  }
+  return true;
+}
+
+// The part of `op_info` that identifies the measurements of an op.
+OpInfo KeyOpInfo(const OpInfo& op_info) {
+  OpInfo key;
+  key.set_op(op_info.op());
+  for (const auto& attr : op_info.attr()) {
+    // Internal attributes, e.g. _class or _output_shapes, do not change what
+    // the op computes.
+    if (absl::StartsWith(attr.first, "_")) continue;
+    (*key.mutable_attr())[attr.first] = attr.second;
+  }
+  for (const auto& input : op_info.inputs()) {
+    OpInfo::TensorProperties* key_input = key.add_inputs();
+    key_input->set_dtype(input.dtype());
+    *key_input->mutable_shape() = input.shape();
+  }
+  const DeviceProperties& device = op_info.device();
+  DeviceProperties* key_device = key.mutable_device();
+  key_device->set_type(device.type());
+  key_device->set_vendor(device.vendor());
+  key_device->set_model(device.model());
+  key_device->set_num_cores(device.num_cores());
+  return key;
+}
+
+}  // namespace
+
+MeasuredCostDatabase::MeasuredCostDatabase(Env* env, const string& dir)
+    : env_(env), shard_path_(ShardPath(dir)) {}
+
+MeasuredCostDatabase* MeasuredCostDatabase::Open(const string& dir) {
+  static auto* databases =
+      new std::map<string, std::unique_ptr<MeasuredCostDatabase>>;
+  mutex_lock l(global_mu);
+  std::unique_ptr<MeasuredCostDatabase>& database = (*databases)[dir];
+  if (database == nullptr) {
+    database = std::make_unique<MeasuredCostDatabase>(Env::Default(), dir);
+    database->flush_interval_micros_ = kFlushIntervalMicros;
+    Status s = Env::Default()->RecursivelyCreateDir(dir);
+    if (s.ok()) s = database->LoadShards(dir);
+    if (!s.ok()) LOG(WARNING) << "Ignoring measured op costs: " << s;
+    LOG(INFO) << "Using " << database->size() << " measured op costs from "
+              << dir;
+    if (global_database == nullptr) global_database = database.get();
+  }
+  return database.get();
+}
+
+MeasuredCostDatabase* MeasuredCostDatabase::Global() {
+  mutex_lock l(global_mu);
+  return global_database;
+}
+
+string MeasuredCostDatabase::Key(const OpInfo& op_info) {
+  string key;
+  SerializeToStringDeterministic(KeyOpInfo(op_info), &key);
+  return key;
+}
+
+void MeasuredCostDatabase::Record(const OpInfo& op_info,
+                                  int64_t execution_time_ns) {
+  if (!HasKnownShapes(op_info) || execution_time_ns < 0) return;
+  OpPerformance perf;
+  *perf.mutable_op() = KeyOpInfo(op_info);
+  perf.mutable_execution_time_normal()->set_mu(execution_time_ns);
+  perf.set_num_samples(1);
+  const string key = Key(op_info);
+  mutex_lock l(mu_);
+  Merge(key, perf, &entries_);
+  Merge(key, perf, &recorded_);
+  dirty_ = true;
+  ScheduleFlush();
+}
+
+void MeasuredCostDatabase::AddCostGraph(const CostGraphDef& cost_graph,
+                                        const GraphDef& graph) {
+  const OpPerformanceList perf_list =
+      CostGraphToOpPerformanceData(cost_graph, graph);
+  for (const OpPerformance& perf : perf_list.op_performance()) {
+    // Nodes that did not run in the step have no time. The few ops that take
+    // less than the microsecond resolution of cost graphs are skipped too and
+    // keep their analytical estimate.
+    if (perf.compute_cost() <= 0) continue;
+    Record(perf.op(), perf.compute_cost());
+  }
+}
+
+bool MeasuredCostDatabase::Lookup(const OpInfo& op_info,
+                                  int64_t* execution_time_ns) const {
+  if (!HasKnownShapes(op_info)) return false;
+  const string key = Key(op_info);
+  tf_shared_lock l(mu_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) return false;
+  *execution_time_ns = std::llround(it->second.execution_time_normal().mu());
+  return true;
+}
+
+int MeasuredCostDatabase::size() const {
+  tf_shared_lock l(mu_);
+  return entries_.size();
+}
+
+void MeasuredCostDatabase::Merge(const string& key, const OpPerformance& perf,
+                                 Entries* entries) {
+  auto it = entries->find(key);
+  if (it == entries->end()) {
+    OpPerformance& entry = (*entries)[key];
+    entry = perf;
+    entry.set_compute_cost(std::llround(perf.execution_time_normal().mu()));
+    return;
+  }
+  // Combines the means and standard deviations of the two sets of samples.
+  OpPerformance& entry = it->second;
+  const double n1 = entry.num_samples();
+  const double n2 = perf.num_samples();
+  const double mu1 = entry.execution_time_normal().mu();
+  const double mu2 = perf.execution_time_normal().mu();
+  const double sigma1 = entry.execution_time_normal().sigma();
+  const double sigma2 = perf.execution_time_normal().sigma();
+  const double n = n1 + n2;
+  const double mu = (n1 * mu1 + n2 * mu2) / n;
+  const double variance = (n1 * (sigma1 * sigma1 + (mu1 - mu) * (mu1 - mu)) +
+                           n2 * (sigma2 * sigma2 + (mu2 - mu) * (mu2 - mu))) /
+                          n;
+  entry.mutable_execution_time_normal()->set_mu(mu);
+  entry.mutable_execution_time_normal()->set_sigma(std::sqrt(variance));
+  entry.set_num_samples(entry.num_samples() + perf.num_samples());
+  entry.set_compute_cost(std::llround(mu));
+}
+
+Status MeasuredCostDatabase::Load(const string& path) {
+  OpPerformanceList perf_list;
+  TF_RETURN_IF_ERROR(ReadBinaryProto(env_, path, &perf_list));
+  mutex_lock l(mu_);
+  for (const OpPerformance& perf : perf_list.op_performance()) {
+    if (perf.num_samples() <= 0 || !perf.has_execution_time_normal()) {
+      continue;
+    }
+    Merge(Key(perf.op()), perf, &entries_);
+  }
+  return absl::OkStatus();
+}
+
+Status MeasuredCostDatabase::LoadShards(const string& dir) {
+  std::vector<string> children;
+  TF_RETURN_IF_ERROR(env_->GetChildren(dir, &children));
+  for (const string& child : children) {
+    // Skips the temporary files of shards being written.
+    if (!absl::EndsWith(child, kShardSuffix)) continue;
+    const string path = io::JoinPath(dir, child);
+    if (path == shard_path_) continue;
+    Status s = Load(path);
+    if (!s.ok()) LOG(WARNING) << "Ignoring measured op costs: " << s;
+  }
+  return absl::OkStatus();
+}
+
+Status MeasuredCostDatabase::Save(const string& path) const {
+  OpPerformanceList perf_list;
+  {
+    tf_shared_lock l(mu_);
+    for (const auto& entry : entries_) {
+      *perf_list.add_op_performance() = entry.second;
+    }
+  }
+  // Other processes may read the file while it is written.
+  const string tmp_path = absl::StrCat(path, ".tmp.", random::New64());
+  Status s = WriteBinaryProto(env_, tmp_path, perf_list);
+  if (s.ok()) s = env_->RenameFile(tmp_path, path);
+  if (!s.ok()) env_->DeleteFile(tmp_path).IgnoreError();
+  return s;
+}
+
+Status MeasuredCostDatabase::Flush() {
+  if (shard_path_.empty()) return absl::OkStatus();
+  mutex_lock flush_lock(flush_mu_);
+  OpPerformanceList perf_list;
+  {
+    mutex_lock l(mu_);
+    if (!dirty_) return absl::OkStatus();
+    dirty_ = false;
+    for (const auto& entry : recorded_) {
+      *perf_list.add_op_performance() = entry.second;
+    }
+  }
+  // The shard is only written by this database, but other processes may
+  // read it while it is written.
+  const string tmp_path = absl::StrCat(shard_path_, ".tmp");
+  Status s = WriteBinaryProto(env_, tmp_path, perf_list);
+  if (s.ok()) s = env_->RenameFile(tmp_path, shard_path_);
+  if (!s.ok()) {
+    env_->DeleteFile(tmp_path).IgnoreError();
+    mutex_lock l(mu_);
+    dirty_ = true;
+  }
+  return s;
+}
+
+void MeasuredCostDatabase::ScheduleFlush() {
+  if (flush_interval_micros_ <= 0 || flush_scheduled_) return;
+  flush_scheduled_ = true;
+  env_->SchedClosureAfter(flush_interval_micros_, [this]() {
+    {
+      mutex_lock l(mu_);
+      flush_scheduled_ = false;
+    }
+    Status s = Flush();
+    if (!s.ok()) LOG(WARNING) << "Cannot save measured op costs: " << s;
+  });
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,126 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_COSTS_MEASURED_COST_DATABASE_H_
+#define TENSORFLOW_CORE_GRAPPLER_COSTS_MEASURED_COST_DATABASE_H_
+
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/cost_graph.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Execution times of ops measured on real devices, for the cost model to use
+// instead of its analytical estimates. Measurements are keyed by the op, its
+// attributes, the dtypes and shapes of its inputs, and the model of the
+// device it ran on, and averaged per key.
+//
+// The database is persisted in a directory shared by the processes that
+// measure, so that the timings collected by one process calibrate the
+// optimizations of the next ones. Each database saves the measurements it
+// recorded itself to its own shard, an OpPerformanceList named after the
+// host and process, and reads the shards of the others when it is opened.
+// Processes therefore never overwrite each other's samples. Shards are not
+// compacted; delete the directory to start over.
+// Thread-safe.
+class MeasuredCostDatabase {
+ public:
+  // `dir` is where Flush() saves the database; it may be empty.
+  explicit MeasuredCostDatabase(Env* env, const string& dir = "");
+
+  // Returns the database of the process for `dir`, loaded from the shards in
+  // it. Its measurements are saved in the background, at most once per
+  // `kFlushIntervalMicros`. The first database opened becomes Global().
+  static MeasuredCostDatabase* Open(const string& dir);
+
+  // Returns the database the cost model of the process uses, or nullptr if
+  // none was opened, e.g. by a session with
+  // ConfigProto.Experimental.measured_op_costs_dir set.
+  static MeasuredCostDatabase* Global();
+
+  static constexpr int64_t kFlushIntervalMicros = 60 * 1000 * 1000;
+
+  // Returns the key of the op described by `op_info`.
+  static string Key(const OpInfo& op_info);
+
+  // Records one execution of the op described by `op_info`. Ops with inputs
+  // of unknown shape are ignored, since they cannot be matched reliably.
+  void Record(const OpInfo& op_info, int64_t execution_time_ns);
+
+  // Records the execution times in `cost_graph`, a cost graph of one step of
+  // `graph` as built from the StepStats of the step.
+  void AddCostGraph(const CostGraphDef& cost_graph, const GraphDef& graph);
+
+  // Returns the average measured execution time of the op described by
+  // `op_info` in `execution_time_ns`, or false if it was not measured.
+  bool Lookup(const OpInfo& op_info, int64_t* execution_time_ns) const;
+
+  int size() const;
+
+  // Merges the measurements stored in `path` into the database.
+  Status Load(const string& path);
+  // Merges the measurements of every shard in `dir` into the database.
+  Status LoadShards(const string& dir);
+  // Saves the database to `path`, atomically replacing its contents.
+  Status Save(const string& path) const;
+  // Saves the measurements recorded by this database to its shard in the
+  // directory it was created with, if they changed.
+  Status Flush();
+
+  // Returns the path of the shard Flush() writes to, or "" if none.
+  const string& shard_path() const { return shard_path_; }
+
+ private:
+  using Entries = absl::flat_hash_map<string, OpPerformance>;
+
+  static void Merge(const string& key, const OpPerformance& perf,
+                    Entries* entries);
+
+  // Saves the recorded measurements after `flush_interval_micros_`, unless a
+  // flush is already scheduled.
+  void ScheduleFlush() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  Env* const env_;
+  const string shard_path_;
+  // If positive, Record schedules flushes. Only set for databases that live
+  // as long as the process.
+  int64_t flush_interval_micros_ = 0;
+
+  // Serializes writes of the shard.
+  mutex flush_mu_;
+  mutable mutex mu_;
+  // Keyed by Key(perf.op()). The average execution time is stored in
+  // execution_time_normal and the number of measurements in num_samples.
+  Entries entries_ TF_GUARDED_BY(mu_);
+  // The measurements recorded by this database, i.e. the contents of its
+  // shard.
+  Entries recorded_ TF_GUARDED_BY(mu_);
+  bool dirty_ TF_GUARDED_BY(mu_) = false;
+  bool flush_scheduled_ TF_GUARDED_BY(mu_) = false;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_COSTS_MEASURED_COST_DATABASE_H_
@@ -0,0 +1,162 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/measured_cost_database.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/grappler/costs/utils.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kCpu[] = "/job:localhost/replica:0/task:0/device:CPU:0";
+
+OpInfo MakeOpInfo(const string& op, const std::vector<int64_t>& dims) {
+  OpInfo op_info;
+  op_info.set_op(op);
+  SetAttrValue(DT_FLOAT, &(*op_info.mutable_attr())["T"]);
+  OpInfo::TensorProperties* input = op_info.add_inputs();
+  input->set_dtype(DT_FLOAT);
+  TensorShape(dims).AsProto(input->mutable_shape());
+  *op_info.mutable_device() = GetDeviceInfo(kCpu);
+  return op_info;
+}
+
+TEST(MeasuredCostDatabaseTest, RecordAndLookup) {
+  MeasuredCostDatabase database(Env::Default());
+  const OpInfo relu = MakeOpInfo("Relu", {2, 3});
+  int64_t time_ns = 0;
+  EXPECT_FALSE(database.Lookup(relu, &time_ns));
+
+  database.Record(relu, 100);
+  database.Record(relu, 300);
+  ASSERT_TRUE(database.Lookup(relu, &time_ns));
+  EXPECT_EQ(200, time_ns);
+  EXPECT_EQ(1, database.size());
+
+  // Internal attributes do not matter, shapes and devices do.
+  OpInfo annotated = relu;
+  SetAttrValue("loc:@x", &(*annotated.mutable_attr())["_class"]);
+  EXPECT_TRUE(database.Lookup(annotated, &time_ns));
+  EXPECT_FALSE(database.Lookup(MakeOpInfo("Relu", {3, 2}), &time_ns));
+  OpInfo on_gpu = relu;
+  on_gpu.mutable_device()->set_type("GPU");
+  EXPECT_FALSE(database.Lookup(on_gpu, &time_ns));
+}
+
+TEST(MeasuredCostDatabaseTest, IgnoresUnknownShapes) {
+  MeasuredCostDatabase database(Env::Default());
+  OpInfo relu = MakeOpInfo("Relu", {2, 3});
+  relu.mutable_inputs(0)->mutable_shape()->mutable_dim(0)->set_size(-1);
+  database.Record(relu, 100);
+  int64_t time_ns = 0;
+  EXPECT_FALSE(database.Lookup(relu, &time_ns));
+  EXPECT_EQ(0, database.size());
+}
+
+TEST(MeasuredCostDatabaseTest, AddCostGraph) {
+  GraphDef graph;
+  NodeDef* x = graph.add_node();
+  x->set_name("x");
+  x->set_op("Placeholder");
+  SetAttrValue(DT_FLOAT, &(*x->mutable_attr())["dtype"]);
+  NodeDef* y = graph.add_node();
+  y->set_name("y");
+  y->set_op("Relu");
+  y->add_input("x");
+  SetAttrValue(DT_FLOAT, &(*y->mutable_attr())["T"]);
+
+  CostGraphDef cost_graph;
+  CostGraphDef::Node* x_cost = cost_graph.add_node();
+  x_cost->set_name("x");
+  x_cost->set_id(0);
+  x_cost->set_device(kCpu);
+  CostGraphDef::Node::OutputInfo* x_output = x_cost->add_output_info();
+  x_output->set_dtype(DT_FLOAT);
+  TensorShape({2, 3}).AsProto(x_output->mutable_shape());
+  CostGraphDef::Node* y_cost = cost_graph.add_node();
+  y_cost->set_name("y");
+  y_cost->set_id(1);
+  y_cost->set_device(kCpu);
+  y_cost->set_compute_cost(7);  // Microseconds.
+
+  MeasuredCostDatabase database(Env::Default());
+  database.AddCostGraph(cost_graph, graph);
+  // The Placeholder has no measured time.
+  EXPECT_EQ(1, database.size());
+  int64_t time_ns = 0;
+  ASSERT_TRUE(database.Lookup(MakeOpInfo("Relu", {2, 3}), &time_ns));
+  EXPECT_EQ(7000, time_ns);
+}
+
+TEST(MeasuredCostDatabaseTest, SaveAndLoadShards) {
+  const string dir = io::JoinPath(testing::TmpDir(), "measured_costs");
+  TF_ASSERT_OK(Env::Default()->RecursivelyCreateDir(dir));
+  const OpInfo relu = MakeOpInfo("Relu", {2, 3});
+  const OpInfo tanh = MakeOpInfo("Tanh", {2, 3});
+
+  MeasuredCostDatabase database(Env::Default(), dir);
+  database.Record(relu, 100);
+  database.Record(tanh, 50);
+  TF_ASSERT_OK(database.Flush());
+  TF_EXPECT_OK(Env::Default()->FileExists(database.shard_path()));
+
+  // Another process writes its own shard.
+  MeasuredCostDatabase other(Env::Default(), dir);
+  EXPECT_NE(database.shard_path(), other.shard_path());
+  other.Record(relu, 400);
+  TF_ASSERT_OK(other.Flush());
+
+  MeasuredCostDatabase loaded(Env::Default(), dir);
+  TF_ASSERT_OK(loaded.LoadShards(dir));
+  EXPECT_EQ(2, loaded.size());
+  int64_t time_ns = 0;
+  ASSERT_TRUE(loaded.Lookup(relu, &time_ns));
+  EXPECT_EQ(250, time_ns);
+  ASSERT_TRUE(loaded.Lookup(tanh, &time_ns));
+  EXPECT_EQ(50, time_ns);
+
+  // Only the samples recorded by a database go to its shard, so loaded
+  // samples are not counted twice.
+  loaded.Record(tanh, 150);
+  TF_ASSERT_OK(loaded.Flush());
+  MeasuredCostDatabase reloaded(Env::Default(), dir);
+  TF_ASSERT_OK(reloaded.LoadShards(dir));
+  ASSERT_TRUE(reloaded.Lookup(tanh, &time_ns));
+  EXPECT_EQ(100, time_ns);
+  ASSERT_TRUE(reloaded.Lookup(relu, &time_ns));
+  EXPECT_EQ(250, time_ns);
+}
+
+TEST(MeasuredCostDatabaseTest, Open) {
+  const string dir = io::JoinPath(testing::TmpDir(), "opened_costs");
+  MeasuredCostDatabase* database = MeasuredCostDatabase::Open(dir);
+  ASSERT_NE(nullptr, database);
+  EXPECT_EQ(database, MeasuredCostDatabase::Open(dir));
+  EXPECT_EQ(database, MeasuredCostDatabase::Global());
+  EXPECT_NE(database, MeasuredCostDatabase::Open(dir + "_other"));
+  EXPECT_EQ(database, MeasuredCostDatabase::Global());
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
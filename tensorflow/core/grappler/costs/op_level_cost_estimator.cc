@@ -363,7 +363,8 @@ std::vector<int64_t> MaybeGetMinimumShape(
   return minimal_shape;
 }
 
-OpLevelCostEstimator::OpLevelCostEstimator() {
+OpLevelCostEstimator::OpLevelCostEstimator()
+    : measured_costs_(MeasuredCostDatabase::Global()) {
   // Syntactic sugar to build and return a lambda that takes an OpInfo and
   // returns a cost.
   typedef absl::Status (OpLevelCostEstimator::*CostImpl)(
@@ -658,6 +659,38 @@ OpLevelCostEstimator::OpLevelCostEstimator() {
 }
 
 Costs OpLevelCostEstimator::PredictCosts(const OpContext& op_context) const {
+  Costs costs = PredictAnalyticalCosts(op_context);
+  int64_t measured_ns;
+  if (measured_costs_ == nullptr ||
+      !measured_costs_->Lookup(op_context.op_info, &measured_ns)) {
+    return costs;
+  }
+  VLOG(1) << "Operation " << op_context.op_info.op() << " was measured at "
+          << measured_ns << " ns, estimated at "
+          << costs.execution_time.count() << " ns.";
+  // Keep the split between compute and memory time of the estimate, scaled
+  // to the measured time.
+  const double estimated_ns = costs.execution_time.count();
+  if (estimated_ns > 0) {
+    const double scale = measured_ns / estimated_ns;
+    costs.compute_time = Costs::NanoSeconds(costs.compute_time.count() * scale);
+    costs.memory_time = Costs::NanoSeconds(costs.memory_time.count() * scale);
+    costs.intermediate_memory_time =
+        Costs::NanoSeconds(costs.intermediate_memory_time.count() * scale);
+    costs.intermediate_memory_read_time =
+        Costs::NanoSeconds(costs.intermediate_memory_read_time.count() * scale);
+    costs.intermediate_memory_write_time = Costs::NanoSeconds(
+        costs.intermediate_memory_write_time.count() * scale);
+  } else {
+    costs.compute_time = Costs::NanoSeconds(measured_ns);
+  }
+  costs.execution_time = Costs::NanoSeconds(measured_ns);
+  costs.inaccurate = false;
+  return costs;
+}
+
+Costs OpLevelCostEstimator::PredictAnalyticalCosts(
+    const OpContext& op_context) const {
   Costs costs;
   NodeCosts node_costs;
   if (PredictNodeCosts(op_context, &node_costs).ok()) {
@@ -26,6 +26,7 @@ limitations under the License.
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "tensorflow/core/grappler/costs/cost_estimator.h"
+#include "tensorflow/core/grappler/costs/measured_cost_database.h"
 #include "tensorflow/core/grappler/costs/op_context.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
 #include "tensorflow/core/platform/types.h"
@@ -101,12 +102,25 @@ class OpLevelCostEstimator {
   OpLevelCostEstimator();
   virtual ~OpLevelCostEstimator() {}
 
+  // Returns the measured cost of the op if `measured_costs` has one, and the
+  // analytical estimate otherwise.
   virtual Costs PredictCosts(const OpContext& op_context) const;
 
   // Returns basic device performance info.
   virtual DeviceInfo GetDeviceInfo(const DeviceProperties& device) const;
 
+  // Sets the measured costs to prefer over the analytical estimates, or
+  // nullptr to only use the latter. Defaults to
+  // MeasuredCostDatabase::Global(). Not owned.
+  void set_measured_costs(const MeasuredCostDatabase* measured_costs) {
+    measured_costs_ = measured_costs;
+  }
+
  protected:
+  // Estimates the cost of the op from its operation count and the sizes of its
+  // inputs and outputs.
+  Costs PredictAnalyticalCosts(const OpContext& op_context) const;
+
   // TODO(dyoon): Consider to remove PredictOpCountBasedCosts() with OpInfo.
   // Naive cost estimate based on the given operations count and total
   // input/output tensor sizes of the given op_info combined.
@@ -337,6 +351,8 @@ class OpLevelCostEstimator {
   std::set<string> persistent_ops_;
 
  private:
+  const MeasuredCostDatabase* measured_costs_;  // Not owned.
+
   friend class OpLevelCostEstimatorTest;
 };
 
@@ -24,6 +24,8 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/costs/measured_cost_database.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/status_matchers.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/protobuf/device_properties.pb.h"
@@ -840,6 +842,25 @@ TEST_F(OpLevelCostEstimatorTest, BiasAddExecutionTime) {
   EXPECT_EQ(cost.persistent_memory, 0);
 }
 
+TEST_F(OpLevelCostEstimatorTest, PrefersMeasuredCosts) {
+  const OpContext op_context = DescribeBiasAdd(1000, 10);
+  MeasuredCostDatabase measured_costs(Env::Default());
+  measured_costs.Record(op_context.op_info, 4700);
+  estimator_.set_measured_costs(&measured_costs);
+
+  // Half of the estimate, split between memory and compute like the estimate.
+  auto cost = PredictCosts(op_context);
+  EXPECT_EQ(Costs::Duration(4200), cost.memory_time);
+  EXPECT_EQ(Costs::Duration(500), cost.compute_time);
+  EXPECT_EQ(Costs::Duration(4700), cost.execution_time);
+  EXPECT_FALSE(cost.inaccurate);
+
+  // Other shapes were not measured.
+  cost = PredictCosts(DescribeBiasAdd(1000, 20));
+  EXPECT_EQ(Costs::Duration(2000), cost.compute_time);
+  estimator_.set_measured_costs(nullptr);
+}
+
 TEST_F(OpLevelCostEstimatorTest, Conv2DExecutionTime) {
   auto cost = PredictCosts(DescribeConvolution(16, 19, 19, 48, 48, 5, 5, 256));
   EXPECT_EQ(Costs::Duration(233780), cost.memory_time);
@@ -459,6 +459,7 @@ NodeDef* MutableGraphView::AddNode(NodeDef&& node) {
   AddUniqueNodeOrDie(node_in_graph);
 
   AddAndDedupFanouts(node_in_graph);
+  MarkNodeModified(node_in_graph->name());
   return node_in_graph;
 }
 
@@ -506,6 +507,7 @@ Status MutableGraphView::AddSubgraph(GraphDef&& subgraph) {
   for (int i = node_size_before; i < graph()->node_size(); ++i) {
     NodeDef* node = graph()->mutable_node(i);
     AddAndDedupFanouts(node);
+    MarkNodeModified(node->name());
   }
 
   return absl::OkStatus();
@@ -539,6 +541,7 @@ Status MutableGraphView::UpdateNode(
         "(alternatively, we could add the identity node needed, but it seems "
         "like an unlikely event and probably a mistake)");
   }
+  MarkNodeModified(node_name);
 
   if (node->device() != device) {
     node->set_device(string(device));
@@ -602,6 +605,8 @@ Status MutableGraphView::UpdateNodeName(absl::string_view from_node_name,
     return error_status("can't update node name because node has fanouts");
   }
 
+  MarkNodeModified(from_node_name);
+  MarkNodeModified(to_node_name);
   nodes().erase(node->name());
   node->set_name(string(to_node_name));
   nodes().emplace(node->name(), node);
@@ -626,6 +631,8 @@ Status MutableGraphView::SwapNodeNames(absl::string_view from_node_name,
   }
   NodeDef* to_node = GetNode(to_node_name);
   TF_RETURN_IF_ERROR(CheckNodeExists(to_node_name, to_node, error_status));
+  MarkNodeModified(from_node_name);
+  MarkNodeModified(to_node_name);
 
   auto swap_names = [this, from_node, to_node]() {
     nodes().erase(from_node->name());
@@ -838,6 +845,7 @@ Status MutableGraphView::UpdateFanoutsInternal(NodeDef* from_node,
     input_port.node->set_input(
         input_port.port_id,
         TensorIdToString({to_node->name(), output_port.port_id}));
+    MarkNodeModified(input_port.node->name());
 
     // Remove old edge between the `from_node` and the fanout node.
     remove_edge(output_port, input_port);
@@ -927,6 +935,7 @@ Status MutableGraphView::AddRegularFanin(absl::string_view node_name,
   TF_RETURN_IF_ERROR(CheckNodeExists(fanin.node(), fanin_node, error_status));
 
   AddFaninInternal(node, {fanin_node, fanin.index()});
+  MarkNodeModified(node_name);
   return absl::OkStatus();
 }
 
@@ -950,6 +959,7 @@ Status MutableGraphView::AddRegularFaninByPort(absl::string_view node_name,
   NodeDef* fanin_node = GetNode(fanin.node());
   TF_RETURN_IF_ERROR(CheckNodeExists(fanin.node(), fanin_node, error_status));
 
+  MarkNodeModified(node_name);
   const int last_node_input = node->input_size();
   node->add_input(TensorIdToString(fanin));
   node->mutable_input()->SwapElements(num_regular_fanins, last_node_input);
@@ -1136,7 +1146,9 @@ Status MutableGraphView::RemoveRegularFanin(absl::string_view node_name,
   NodeDef* fanin_node = GetNode(fanin.node());
   TF_RETURN_IF_ERROR(CheckNodeExists(fanin.node(), fanin_node, error_status));
 
-  RemoveRegularFaninInternal(node, {fanin_node, fanin.index()});
+  if (RemoveRegularFaninInternal(node, {fanin_node, fanin.index()})) {
+    MarkNodeModified(node_name);
+  }
   return absl::OkStatus();
 }
 
@@ -1155,6 +1167,7 @@ Status MutableGraphView::RemoveRegularFaninByPort(absl::string_view node_name,
   TF_RETURN_IF_ERROR(
       CheckPortRange(port, /*min=*/0, last_regular_fanin_port, error_status));
 
+  MarkNodeModified(node_name);
   TensorId tensor_id = ParseTensorName(node->input(port));
   OutputPort fanin_port(nodes()[tensor_id.node()], tensor_id.index());
   fanouts()[fanin_port].erase({node, port});
@@ -1238,6 +1251,9 @@ Status MutableGraphView::RemoveAllFanins(absl::string_view node_name,
 
   const int num_regular_fanins =
       NumFanins(*node, /*include_controlling_nodes=*/false);
+  if (num_regular_fanins > 0) {
+    MarkNodeModified(node_name);
+  }
   RemoveFaninsInternal(node, keep_controlling_fanins);
   if (keep_controlling_fanins) {
     if (num_regular_fanins == 0) {
@@ -1293,6 +1309,9 @@ Status MutableGraphView::UpdateFanin(absl::string_view node_name,
   }
 
   bool from_fanin_is_control = IsTensorIdControlling(from_fanin);
+  if (!from_fanin_is_control || !to_fanin_is_control) {
+    MarkNodeModified(node_name);
+  }
   if (from_fanin_is_control || to_fanin_is_control) {
     bool modified = false;
     if (from_fanin_is_control) {
@@ -1368,6 +1387,7 @@ Status MutableGraphView::UpdateRegularFaninByPort(absl::string_view node_name,
     return absl::OkStatus();
   }
 
+  MarkNodeModified(node_name);
   InputPort input(node, port);
   OutputPort from_fanin_port(nodes()[tensor_id.node()], tensor_id.index());
   absl::flat_hash_set<InputPort>* from_fanouts = &fanouts()[from_fanin_port];
@@ -1427,6 +1447,7 @@ Status MutableGraphView::SwapRegularFaninsByPorts(absl::string_view node_name,
   to_fanouts->insert(from_input);
 
   node->mutable_input()->SwapElements(from_port, to_port);
+  MarkNodeModified(node_name);
 
   return absl::OkStatus();
 }
@@ -1464,6 +1485,10 @@ Status MutableGraphView::UpdateAllRegularFaninsToControlling(
     controlling_fanins.push_back(control_node);
   }
 
+  if (num_regular_fanins > 0) {
+    MarkNodeModified(node_name);
+  }
+
   // Replace regular fanins with controlling fanins and dedup.
   int pos = 0;
   InputPort input_port(node, Graph::kControlSlot);
@@ -1578,7 +1603,9 @@ Status MutableGraphView::DeleteNodes(
     }
   }
   for (const string& node_name_to_delete : nodes_to_delete) {
-    nodes().erase(node_name_to_delete);
+    if (nodes().erase(node_name_to_delete) > 0) {
+      MarkNodeModified(node_name_to_delete);
+    }
   }
 
   // Find nodes in graph and delete by partitioning into nodes to retain and
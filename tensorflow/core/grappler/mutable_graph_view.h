@@ -248,6 +248,20 @@ class MutableGraphView : public internal::GraphViewInternal<GraphDef, NodeDef> {
   // that can't be found are ignored.
   Status DeleteNodes(const absl::flat_hash_set<string>& nodes_to_delete);
 
+  // Returns the names of the nodes that were added, deleted or renamed, or
+  // whose op, attributes or regular fanins were updated through the view since
+  // it was created or ClearModifiedNodes() was last called. Analyses such as
+  // GraphProperties use them to update their results incrementally. Changes
+  // made to a NodeDef directly are not tracked, and must be recorded with
+  // MarkNodeModified().
+  const absl::flat_hash_set<string>& modified_nodes() const {
+    return modified_nodes_;
+  }
+  void MarkNodeModified(absl::string_view node_name) {
+    modified_nodes_.emplace(node_name);
+  }
+  void ClearModifiedNodes() { modified_nodes_.clear(); }
+
  private:
   // Adds fanouts for fanins of node to graph, while deduping control
   // dependencies from existing control dependencies and regular fanins. Note,
@@ -323,6 +337,8 @@ class MutableGraphView : public internal::GraphViewInternal<GraphDef, NodeDef> {
 
   // Removes fanouts of the deleted node from internal state.
   void RemoveFanoutsInternal(NodeDef* deleted_node);
+
+  absl::flat_hash_set<string> modified_nodes_;
 };
 
 }  // end namespace grappler
@@ -2313,6 +2313,35 @@ TEST(MutableGraphViewTest, NoDedupControllingFaninsOnUpdateFaninByPort) {
   CheckGraph(graph);
 }
 
+TEST(MutableGraphViewTest, ModifiedNodes) {
+  // Actual node.op() is not important in this test.
+  GraphDef graph_def = test::function::GDef(
+      {NDef("a", "NotImportant", {}, {}), NDef("b", "NotImportant", {"a"}),
+       NDef("c", "NotImportant", {"b"}), NDef("d", "NotImportant", {})},
+      /*funcs=*/{});
+
+  MutableGraphView graph(&graph_def);
+  EXPECT_TRUE(graph.modified_nodes().empty());
+
+  // Control dependencies do not change the node.
+  TF_EXPECT_OK(graph.AddControllingFanin("c", {"d", Graph::kControlSlot}));
+  EXPECT_TRUE(graph.modified_nodes().empty());
+
+  TF_EXPECT_OK(graph.AddRegularFanin("c", {"a", 0}));
+  TF_EXPECT_OK(graph.UpdateFanouts("b", "a"));
+  EXPECT_THAT(graph.modified_nodes(), ::testing::UnorderedElementsAre("c"));
+
+  graph.ClearModifiedNodes();
+  graph.AddNode(NDef("e", "NotImportant", {"c"}));
+  TF_EXPECT_OK(graph.DeleteNodes({"b"}));
+  EXPECT_THAT(graph.modified_nodes(),
+              ::testing::UnorderedElementsAre("b", "e"));
+
+  graph.ClearModifiedNodes();
+  graph.MarkNodeModified("a");
+  EXPECT_THAT(graph.modified_nodes(), ::testing::UnorderedElementsAre("a"));
+}
+
 TEST(MutableGraphViewTest, UpdateMaxRegularOutputPortOnAddFanin) {
   // Actual node.op() is not important in this test.
   GraphDef graph_def = test::function::GDef(
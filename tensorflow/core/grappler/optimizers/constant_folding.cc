@@ -17,8 +17,10 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/constant_folding.h"
 
+#include <algorithm>
 #include <cmath>
 
+#include "absl/algorithm/container.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
@@ -52,6 +54,9 @@ limitations under the License.
 #include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/denormal.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/random.h"
 #include "tensorflow/core/platform/setround.h"
 #include "tensorflow/core/platform/tensor_coding.h"
 #include "tensorflow/core/public/version.h"
@@ -65,6 +70,9 @@ using TensorVector = gtl::InlinedVector<TensorValue, 4>;
 
 // We only fold/materialize constants smaller than 100kB.
 const int64_t kMaxConstantSize = 100 * 1024;
+// Unless they are written to the folded constant store, which takes constants
+// smaller than 1GB.
+const int64_t kMaxStoredConstantSize = 1LL << 30;
 
 namespace {
 template <typename T>
@@ -193,21 +201,24 @@ float QuantizedTypeMaxAsFloat(DataType data_type) {
 ConstantFolding::ConstantFolding(RewriterConfig::Toggle opt_level,
                                  DeviceBase* cpu_device,
                                  bool disable_compressed_tensor_optimization,
-                                 bool fold_quantization_emulation)
+                                 bool fold_quantization_emulation,
+                                 const string& folded_constant_store_dir)
     : opt_level_(opt_level),
       cpu_device_(cpu_device),
       disable_compressed_tensor_optimization_(
           disable_compressed_tensor_optimization),
-      fold_quantization_emulation_(fold_quantization_emulation) {
+      fold_quantization_emulation_(fold_quantization_emulation),
+      folded_constant_store_dir_(folded_constant_store_dir) {
   resource_mgr_.reset(new ResourceMgr());
 }
 
 ConstantFolding::ConstantFolding(DeviceBase* cpu_device,
                                  bool disable_compressed_tensor_optimization,
-                                 bool fold_quantization_ops)
+                                 bool fold_quantization_ops,
+                                 const string& folded_constant_store_dir)
     : ConstantFolding(RewriterConfig::ON, cpu_device,
                       disable_compressed_tensor_optimization,
-                      fold_quantization_ops) {}
+                      fold_quantization_ops, folded_constant_store_dir) {}
 
 // static
 string ConstantFolding::AddControlDependency(const string& input_name,
@@ -1037,7 +1048,11 @@ bool ConstantFolding::IsFoldableUncached(
         if (num_bytes < 0) {  // Overflown
           return false;
         }
-        if (num_bytes > input_size_bytes && num_bytes > kMaxConstantSize) {
+        const int64_t max_constant_size =
+            CanStoreFoldedOutput(node, output_prop.dtype())
+                ? kMaxStoredConstantSize
+                : kMaxConstantSize;
+        if (num_bytes > input_size_bytes && num_bytes > max_constant_size) {
           // Do not fold nodes if the in-memory size of output is too large.
           // Notice that this is not exactly the same check used in
           // CreateNodeDef() where the actual encoded size is checked.
@@ -1053,7 +1068,7 @@ bool ConstantFolding::IsFoldableUncached(
 bool ConstantFolding::MaybeFoldable(const NodeDef& node,
                                     const GraphProperties* properties) const {
   // Skip constants, they're already folded
-  if (IsConstant(node)) {
+  if (IsConstant(node) || node.op() == "ImmutableConst") {
     return false;
   }
   // Don't fold stateful ops such as TruncatedNormal.
@@ -1394,7 +1409,6 @@ Status ConstantFolding::EvaluateOneFoldable(const NodeDef& node,
     inputs.emplace_back(value);
     total_inputs_size += value->TotalBytes();
   }
-
   TF_RETURN_IF_ERROR(EvaluateNode(node, inputs, &output_tensors));
   if (output_tensors.empty()) {
     return Status(absl::StatusCode::kInvalidArgument,
@@ -1410,6 +1424,15 @@ Status ConstantFolding::EvaluateOneFoldable(const NodeDef& node,
     if (output_tensors[i].tensor) {
       Status s = CreateNodeDef(node_name, output_tensors[i], &outputs->at(i),
                                total_inputs_size);
+      // Outputs too large for a Const go to the folded constant store right
+      // away, so that the graph never holds more than one of them at a time.
+      if (!s.ok() && CanStoreFoldedOutput(node, output_tensors[i]->dtype()) &&
+          output_tensors[i]->TotalBytes() <=
+              static_cast<size_t>(kMaxStoredConstantSize)) {
+        outputs->at(i) = NodeDef();
+        s = CreateStoredNodeDef(node_name, *output_tensors[i].tensor,
+                                &outputs->at(i));
+      }
       if (!s.ok()) {
         *result_too_large = true;
         return s;
@@ -1568,7 +1591,7 @@ Status ConstantFolding::FoldNode(NodeDef* node, GraphDef* output_graph,
     // We rewrite the existing node if it only has a single output, and
     // create new nodes otherwise.
     if (const_nodes.size() == 1) {
-      node->set_op("Const");
+      node->set_op(const_node->op());
       // Note we need to clear the inputs in NodeMap before we clear the inputs
       // in the node, otherwise NodeMap would see empty inputs and effectively
       // does nothing.
@@ -3958,6 +3981,70 @@ Status ConstantFolding::AddQuantizedMatMulMinMaxOutConstNodes(
   return absl::OkStatus();
 }
 
+namespace {
+
+// Writes the contents of `value` to the file of `store_dir` named after their
+// fingerprint, unless it already exists, and returns its path in `path`.
+Status StoreFoldedConstant(const string& store_dir, const Tensor& value,
+                           string* path) {
+  const StringPiece data = value.tensor_data();
+  const Fprint128 fingerprint = Fingerprint128(data);
+  *path = io::JoinPath(
+      store_dir, absl::StrCat(absl::Hex(fingerprint.high64, absl::kZeroPad16),
+                              absl::Hex(fingerprint.low64, absl::kZeroPad16),
+                              ".tensor"));
+  Env* env = Env::Default();
+  uint64 file_size;
+  if (env->GetFileSize(*path, &file_size).ok() && file_size == data.size()) {
+    // Folded by another replica or a previous run.
+    return absl::OkStatus();
+  }
+  TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(store_dir));
+  // Other processes may map the file while it is written.
+  const string tmp_path = absl::StrCat(*path, ".tmp.", random::New64());
+  Status s = WriteStringToFile(env, tmp_path, data);
+  if (s.ok()) s = env->RenameFile(tmp_path, *path);
+  if (!s.ok()) env->DeleteFile(tmp_path).IgnoreError();
+  return s;
+}
+
+}  // namespace
+
+bool ConstantFolding::CanStoreFoldedOutput(const NodeDef& node,
+                                           DataType dtype) const {
+  if (folded_constant_store_dir_.empty() || !DataTypeCanUseMemcpy(dtype)) {
+    return false;
+  }
+  // ImmutableConst only has a CPU kernel. An unplaced one would be pinned to
+  // the CPU and copied to the device of its consumers on every step.
+  if (!node.device().empty()) return NodeIsOnCpu(&node);
+  const auto& consumers = node_map_->GetOutputs(node.name());
+  return !consumers.empty() &&
+         absl::c_all_of(consumers, [](const NodeDef* consumer) {
+           return !consumer->device().empty() && NodeIsOnCpu(consumer);
+         });
+}
+
+Status ConstantFolding::CreateStoredNodeDef(const string& name,
+                                            const Tensor& value,
+                                            NodeDef* node) const {
+  string path;
+  TF_RETURN_IF_ERROR(
+      StoreFoldedConstant(folded_constant_store_dir_, value, &path));
+  node->set_name(name);
+  node->set_op("ImmutableConst");
+  AttrValue dtype;
+  dtype.set_type(value.dtype());
+  (*node->mutable_attr())["dtype"] = dtype;
+  AttrValue shape;
+  value.shape().AsProto(shape.mutable_shape());
+  (*node->mutable_attr())["shape"] = shape;
+  (*node->mutable_attr())["memory_region_name"].set_s(path);
+  VLOG(1) << "Stored " << name << " (" << value.TotalBytes() << " bytes) in "
+          << path;
+  return absl::OkStatus();
+}
+
 Status ConstantFolding::RunOptimizationPass(Cluster* cluster,
                                             GrapplerItem* item,
                                             GraphProperties* properties,
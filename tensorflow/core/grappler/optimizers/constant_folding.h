@@ -45,12 +45,22 @@ class ConstantFolding : public GraphOptimizer {
   static string AddControlDependency(const string& input_name, GraphDef* graph,
                                      NodeMap* node_map);
 
+  // If `folded_constant_store_dir` is not empty, folded tensors larger than
+  // kMaxConstantSize are written to content-addressed files in this directory
+  // and loaded by ImmutableConst nodes, which memory-map them, instead of
+  // being left unfolded. This only applies to tensors placed on the CPU, or
+  // not placed but only read on the CPU, whose type can be memcpy-ed. Stored
+  // tensors are not folded any further. The files are shared by every
+  // graph and process using the directory, so they are never deleted: the
+  // directory has to be cleaned up with the models it serves.
   explicit ConstantFolding(DeviceBase* cpu_device,
                            bool disable_compressed_tensor_optimization = false,
-                           bool fold_quantization_emulation = true);
+                           bool fold_quantization_emulation = true,
+                           const string& folded_constant_store_dir = "");
   ConstantFolding(RewriterConfig::Toggle opt_level, DeviceBase* cpu_device,
                   bool disable_compressed_tensor_optimization = false,
-                  bool fold_quantization_emulation = true);
+                  bool fold_quantization_emulation = true,
+                  const string& folded_constant_store_dir = "");
 
   ~ConstantFolding() override {}
 
@@ -95,6 +105,16 @@ class ConstantFolding : public GraphOptimizer {
   Status EvaluateOneFoldable(const NodeDef& node, std::vector<NodeDef>* outputs,
                              bool* result_too_large);
 
+  // Returns true if a folded output of `node` of type `dtype` can be moved to
+  // the folded constant store, and is thus allowed to be larger than
+  // kMaxConstantSize.
+  bool CanStoreFoldedOutput(const NodeDef& node, DataType dtype) const;
+
+  // Writes `value` to the folded constant store and sets `node` to an
+  // ImmutableConst named `name` reading it.
+  Status CreateStoredNodeDef(const string& name, const Tensor& value,
+                             NodeDef* node) const;
+
   Status FoldMergeNode(NodeDef* node, GraphDef* output_graph);
   Status FoldNode(NodeDef* node, GraphDef* output_graph,
                   bool* result_too_large);
@@ -340,6 +360,7 @@ class ConstantFolding : public GraphOptimizer {
   bool graph_contains_assign_or_inplace_op_;
   bool disable_compressed_tensor_optimization_;
   bool fold_quantization_emulation_;
+  string folded_constant_store_dir_;
 };
 
 }  // end namespace grappler
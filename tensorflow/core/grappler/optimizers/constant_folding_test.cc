@@ -33,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/tensor_coding.h"
 
 namespace tensorflow {
@@ -3246,6 +3247,131 @@ TEST_F(ConstantFoldingTest, LargeConstant) {
   test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
 }
 
+TEST_F(ConstantFoldingTest, LargeConstantInStore) {
+  tensorflow::Scope scope = tensorflow::Scope::NewRootScope();
+  // A 256kB non-compressible matrix, too large to fold into a Const.
+  Output mat_diag =
+      ops::Const(scope.WithOpName("mat_diag"), 3.14f, TensorShape({256}));
+  Output mat = ops::Diag(scope.WithOpName("mat"), mat_diag);
+  // `mat` is not placed, but only read on the CPU.
+  Output out = ops::Identity(
+      scope.WithOpName("out").WithDevice("/device:CPU:0"), mat);
+
+  GrapplerItem item;
+  TF_CHECK_OK(scope.ToGraphDef(&item.graph));
+  item.fetch.push_back("out");
+
+  const string store_dir =
+      io::JoinPath(testing::TmpDir(), "LargeConstantInStore");
+  ConstantFolding optimizer(/*cpu_device=*/nullptr,
+                            /*disable_compressed_tensor_optimization=*/false,
+                            /*fold_quantization_emulation=*/true, store_dir);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  string path;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "mat") {
+      EXPECT_EQ(node.op(), "ImmutableConst");
+      EXPECT_EQ(node.input_size(), 0);
+      EXPECT_EQ(node.attr().count("value"), 0);
+      EXPECT_EQ(node.attr().at("dtype").type(), DT_FLOAT);
+      path = node.attr().at("memory_region_name").s();
+    }
+  }
+  ASSERT_FALSE(path.empty());
+  EXPECT_TRUE(absl::StartsWith(path, store_dir));
+  uint64 file_size = 0;
+  TF_ASSERT_OK(Env::Default()->GetFileSize(path, &file_size));
+  EXPECT_EQ(file_size, 256 * 256 * sizeof(float));
+  EXPECT_LT(output.ByteSizeLong(), 2000);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+
+  // Folding the same tensor again reuses the stored file.
+  ConstantFolding other_optimizer(
+      /*cpu_device=*/nullptr,
+      /*disable_compressed_tensor_optimization=*/false,
+      /*fold_quantization_emulation=*/true, store_dir);
+  GraphDef other_output;
+  TF_EXPECT_OK(
+      other_optimizer.Optimize(/*cluster=*/nullptr, item, &other_output));
+  for (const NodeDef& node : other_output.node()) {
+    if (node.name() == "mat") {
+      EXPECT_EQ(node.attr().at("memory_region_name").s(), path);
+    }
+  }
+  std::vector<string> files;
+  TF_ASSERT_OK(Env::Default()->GetChildren(store_dir, &files));
+  EXPECT_EQ(files.size(), 1);
+}
+
+TEST_F(ConstantFoldingTest, LargeConstantNotStoredOffCpu) {
+  tensorflow::Scope scope = tensorflow::Scope::NewRootScope();
+  Output mat_diag =
+      ops::Const(scope.WithOpName("mat_diag"), 3.14f, TensorShape({256}));
+  // ImmutableConst has no GPU kernel, so this one is left unfolded.
+  Output mat = ops::Diag(
+      scope.WithOpName("mat").WithDevice("/device:GPU:0"), mat_diag);
+  Output out = ops::Identity(scope.WithOpName("out"), mat);
+
+  GrapplerItem item;
+  TF_CHECK_OK(scope.ToGraphDef(&item.graph));
+  item.fetch.push_back("out");
+
+  const string store_dir =
+      io::JoinPath(testing::TmpDir(), "LargeConstantNotStoredOffCpu");
+  ConstantFolding optimizer(/*cpu_device=*/nullptr,
+                            /*disable_compressed_tensor_optimization=*/false,
+                            /*fold_quantization_emulation=*/true, store_dir);
+  GraphDef output;
+  Status status = optimizer.Optimize(/*cluster=*/nullptr, item, &output);
+  if (status.ok()) {
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE(node.op(), "ImmutableConst");
+      if (node.name() == "mat") {
+        EXPECT_EQ(node.op(), "Diag");
+      }
+    }
+  }
+  EXPECT_FALSE(Env::Default()->FileExists(store_dir).ok());
+}
+
+TEST_F(ConstantFoldingTest, LargeConstantNotStoredForUnplacedConsumers) {
+  tensorflow::Scope scope = tensorflow::Scope::NewRootScope();
+  Output mat_diag =
+      ops::Const(scope.WithOpName("mat_diag"), 3.14f, TensorShape({256}));
+  // `out` may be placed on a GPU, which would copy an ImmutableConst over on
+  // every step, so this one is left unfolded.
+  Output mat = ops::Diag(scope.WithOpName("mat"), mat_diag);
+  Output out = ops::Identity(scope.WithOpName("out"), mat);
+
+  GrapplerItem item;
+  TF_CHECK_OK(scope.ToGraphDef(&item.graph));
+  item.fetch.push_back("out");
+
+  const string store_dir = io::JoinPath(
+      testing::TmpDir(), "LargeConstantNotStoredForUnplacedConsumers");
+  ConstantFolding optimizer(/*cpu_device=*/nullptr,
+                            /*disable_compressed_tensor_optimization=*/false,
+                            /*fold_quantization_emulation=*/true, store_dir);
+  GraphDef output;
+  Status status = optimizer.Optimize(/*cluster=*/nullptr, item, &output);
+  if (status.ok()) {
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE(node.op(), "ImmutableConst");
+      if (node.name() == "mat") {
+        EXPECT_EQ(node.op(), "Diag");
+      }
+    }
+  }
+  EXPECT_FALSE(Env::Default()->FileExists(store_dir).ok());
+}
+
 TEST_F(ConstantFoldingTest, SwitchIdenticalInputs) {
   tensorflow::Scope s = tensorflow::Scope::NewRootScope();
   Output x = ops::Placeholder(s.WithOpName("x"), DT_BOOL,
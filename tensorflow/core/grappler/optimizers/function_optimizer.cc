@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/function_optimizer.h"
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 #include "absl/algorithm/container.h"
@@ -48,6 +50,7 @@ limitations under the License.
 #include "tensorflow/core/graph/control_flow.h"
 #include "tensorflow/core/graph/graph_node_util.h"
 #include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/graph_view.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/op_types.h"
@@ -68,6 +71,19 @@ constexpr const char* const kNoSpecializeAttr = "_nospecialize";
 constexpr const char* const kGrapplerSpecializedFuncAttr =
     "_GrapplerSpecializedFunc";
 
+// Maximum number of specializations of a function for the static shapes of its
+// inputs in one optimizer pass. Beyond that, calls are specialized without
+// their input shapes, to bound the growth of the function library.
+//
+// The count is kept by FunctionOptimizerContext, which only lives for one pass,
+// and is not carried over to the next passes on purpose: the calls specialized
+// in a pass call the specialized functions in the next ones, whose arguments
+// already have the shapes of the call, so they are not specialized for them
+// again. A later pass only specializes the calls left unspecialized, or whose
+// input shapes were refined by the other optimizers, and is bounded by the
+// same limit.
+constexpr int kMaxShapeSpecializationsPerFunction = 8;
+
 // There are two ways of calling a Tensorflow function:
 //
 // 1. Direct function call: node.op() is the name of the function.
@@ -168,13 +184,17 @@ struct FunctionSpecializationSignature {
   absl::flat_hash_map<string, DataType> type_parameters;
   absl::flat_hash_map<string, AttrValue> body_parameters;
   absl::flat_hash_map<InputPort, string> const_inputs;
+  // Fully defined static shapes of the inputs, baked into the specialized
+  // function.
+  absl::flat_hash_map<InputPort, std::vector<int64_t>> input_shapes;
 
   bool operator==(const FunctionSpecializationSignature& other) const {
     bool equals = func_name == other.func_name &&
                   is_in_fetch_set == other.is_in_fetch_set &&
                   active_outputs == other.active_outputs &&
                   type_parameters == other.type_parameters &&
-                  const_inputs == other.const_inputs;
+                  const_inputs == other.const_inputs &&
+                  input_shapes == other.input_shapes;
 
     if (!equals) return false;
 
@@ -203,7 +223,8 @@ struct FunctionSpecializationSignature {
     hashes.reserve(s.active_outputs.size()         //
                    + s.type_parameters.size() * 2  //
                    + s.body_parameters.size() * 2  //
-                   + s.const_inputs.size() * 2);
+                   + s.const_inputs.size() * 2     //
+                   + s.input_shapes.size());
 
     absl::c_transform(s.active_outputs, std::back_inserter(hashes),
                       hash<OutputPort>());
@@ -228,6 +249,15 @@ struct FunctionSpecializationSignature {
       hashes.push_back(Hash64(const_input.second));
     });
 
+    using InputShape = std::pair<const InputPort, std::vector<int64_t>>;
+    absl::c_for_each(s.input_shapes, [&hashes](const InputShape& input_shape) {
+      uint64 shape_hash = hash<InputPort>()(input_shape.first);
+      for (int64_t dim : input_shape.second) {
+        shape_hash = Hash64Combine(shape_hash, static_cast<uint64>(dim));
+      }
+      hashes.push_back(shape_hash);
+    });
+
     // Combine all pre-computed hashes in a deterministic order.
     absl::c_sort(hashes);
     return H::combine_contiguous(std::move(base), hashes.data(), hashes.size());
@@ -255,17 +285,18 @@ struct FunctionSpecialization {
 // Function optimizer context initialized once for each optimization pass, and
 // it uses the latest available graph (for the first iteration it will be the
 // GrapplerItem.graph, for next iterations it will be the output of previous
-// function optimizer pass).
+// function optimizer pass), given as the graph of `graph_item`.
 class FunctionOptimizerContext {
  public:
   explicit FunctionOptimizerContext(const GrapplerItem& item,
                                     RewriterConfig::Toggle opt_level,
-                                    const GraphDef& graph)
+                                    const GrapplerItem& graph_item)
       : item_(&item),
+        graph_item_(&graph_item),
         opt_level_(opt_level),
-        function_library_(OpRegistry::Global(), graph.library()),
-        truly_const_nodes_(InferTrulyConstNodes(item, graph)),
-        graph_view_(&graph) {}
+        function_library_(OpRegistry::Global(), graph_item.graph.library()),
+        truly_const_nodes_(InferTrulyConstNodes(item, graph_item.graph)),
+        graph_view_(&graph_item.graph) {}
 
   const GrapplerItem& item() const { return *item_; }
 
@@ -314,6 +345,31 @@ class FunctionOptimizerContext {
   void AddSpecializedFunction(const FunctionSpecializationSignature& sig,
                               const FunctionSpecialization& specialized_func) {
     specialized_functions_.emplace(sig, specialized_func);
+    if (!sig.input_shapes.empty()) ++num_shape_specializations_[sig.func_name];
+  }
+
+  int NumShapeSpecializations(const string& func_name) const {
+    return gtl::FindWithDefault(num_shape_specializations_, func_name, 0);
+  }
+
+  // Returns the statically inferred properties of the inputs of the node. The
+  // shapes of the graph are only inferred on first use, and all properties are
+  // unknown if that fails. Like the rest of the context, they are only valid
+  // for the graph of the current pass.
+  const std::vector<OpInfo::TensorProperties>& GetInputProperties(
+      const string& node_name) {
+    if (graph_properties_ == nullptr) {
+      graph_properties_ = std::make_unique<GraphProperties>(*graph_item_);
+      const Status status = graph_properties_->InferStatically(
+          /*assume_valid_feeds=*/false,
+          /*aggressive_shape_inference=*/false,
+          /*include_tensor_values=*/false);
+      if (!status.ok()) {
+        VLOG(2) << "Failed to infer the shapes of function inputs: " << status;
+        graph_properties_->Clear();
+      }
+    }
+    return graph_properties_->GetInputProperties(node_name);
   }
 
   void AddTensorMapping(const SafeTensorId& from, const SafeTensorId& to) {
@@ -359,7 +415,8 @@ class FunctionOptimizerContext {
     return const_nodes;
   }
 
-  const GrapplerItem* item_;  // must outlive this object
+  const GrapplerItem* item_;        // must outlive this object
+  const GrapplerItem* graph_item_;  // must outlive this object
   RewriterConfig::Toggle opt_level_;
 
   // Function library constructed from current graph.
@@ -371,6 +428,10 @@ class FunctionOptimizerContext {
   absl::flat_hash_map<FunctionSpecializationSignature,
                       const FunctionSpecialization>
       specialized_functions_;
+  // Number of specializations of each function with input shapes.
+  absl::flat_hash_map<string, int> num_shape_specializations_;
+  // Shapes of the graph, inferred on first use.
+  std::unique_ptr<GraphProperties> graph_properties_;
 
   // After function specialization, the optimized graph might be in invalid
   // state, nodes can read from output index that is no longer valid after
@@ -448,6 +509,79 @@ bool HasUnusedOutputs(const NodeDef& func_node, const FunctionDef& func,
   return active_outputs_size != num_outputs;
 }
 
+// Returns the fully defined static shapes of the inputs of the function call
+// node, by input port, that are not truly const and not already known from the
+// argument attributes of the function. Returns no shapes if the function was
+// specialized for too many input shapes already.
+absl::flat_hash_map<int, std::vector<int64_t>> GetKnownInputShapes(
+    const NodeDef& func_node, const FunctionDef& func,
+    FunctionOptimizerContext* ctx) {
+  absl::flat_hash_map<int, std::vector<int64_t>> input_shapes;
+  if (ctx->NumShapeSpecializations(func.signature().name()) >=
+      kMaxShapeSpecializationsPerFunction) {
+    return input_shapes;
+  }
+
+  const std::vector<OpInfo::TensorProperties>& input_props =
+      ctx->GetInputProperties(func_node.name());
+  const int num_inputs =
+      std::min<int>(func_node.input_size(), input_props.size());
+  for (int i = 0; i < num_inputs; ++i) {
+    const string& input = func_node.input(i);
+    if (IsControlInput(input)) break;
+    if (ctx->IsTrulyConst(NodeName(input))) continue;
+
+    const OpInfo::TensorProperties& props = input_props[i];
+    if (props.dtype() == DT_RESOURCE || props.dtype() == DT_VARIANT) continue;
+    const PartialTensorShape shape(props.shape());
+    if (!shape.IsFullyDefined()) continue;
+
+    const auto arg_attr = func.arg_attr().find(i);
+    if (arg_attr != func.arg_attr().end()) {
+      const AttrValue* output_shapes =
+          AttrSlice(&arg_attr->second.attr()).Find("_output_shapes");
+      if (output_shapes != nullptr && output_shapes->list().shape_size() == 1 &&
+          PartialTensorShape(output_shapes->list().shape(0))
+              .IsIdenticalTo(shape)) {
+        continue;
+      }
+    }
+    const auto dims = shape.dim_sizes();
+    input_shapes[i].assign(dims.begin(), dims.end());
+  }
+
+  return input_shapes;
+}
+
+// Bake the input shapes of the specialization signature into the specialized
+// function, as the "_output_shapes" attributes of its arguments. The _Arg nodes
+// of the function body get them when it is instantiated.
+void AddInputShapeAttrs(const FunctionSpecializationSignature& sig,
+                        const NodeDef& func_node,
+                        const absl::flat_hash_set<string>& const_inputs,
+                        FunctionDef* specialized_func) {
+  if (sig.input_shapes.empty()) return;
+
+  // Pushed down const inputs are not function arguments anymore.
+  int arg_index = 0;
+  for (int i = 0; i < func_node.input_size(); ++i) {
+    const string& input = func_node.input(i);
+    if (IsControlInput(input)) break;
+    if (const_inputs.contains(input)) continue;
+
+    auto input_shape = sig.input_shapes.find(i);
+    if (input_shape != sig.input_shapes.end()) {
+      auto* attr = (*specialized_func->mutable_arg_attr())[arg_index]
+                       .mutable_attr();
+      AttrValue::ListValue* shapes = (*attr)["_output_shapes"].mutable_list();
+      shapes->clear_shape();
+      TensorShapeProto* shape = shapes->add_shape();
+      for (int64_t dim : input_shape->second) shape->add_dim()->set_size(dim);
+    }
+    ++arg_index;
+  }
+}
+
 // Return pruned FunctionDefLibrary with functions that are reachable from
 // the optimized graph.
 FunctionDefLibrary PruneFunctionLibrary(const FunctionLibraryDefinition& flib,
@@ -694,6 +828,7 @@ Status SpecializeFunction(const NodeDef& func_node, const FunctionDef& func,
   FunctionSpecializationSignature signature;
   TF_RETURN_IF_ERROR(InitializeFunctionSpecializationSignature(
       func_node, func, func_instantiation_attr, *ctx, &signature));
+  signature.input_shapes = GetKnownInputShapes(func_node, func, ctx);
 
   // Check if function was already specialized for identical context.
   const FunctionSpecialization* already_specialized =
@@ -746,10 +881,13 @@ Status SpecializeFunction(const NodeDef& func_node, const FunctionDef& func,
     TF_RETURN_IF_ERROR(RemoveFunctionOutputs(remove, &item, &output_mapping));
   }
 
-  // TODO(ezhulenev): Push down known input shapes.
   FunctionDef specialized_func;
   TF_RETURN_IF_ERROR(MakeFunctionDef(item, flib, &specialized_func));
 
+  // Push down known input shapes, so that the optimizers of the function body
+  // can rely on them.
+  AddInputShapeAttrs(signature, func_node, const_inputs, &specialized_func);
+
   // Find a name for specialized function.
   const string specialized_func_name =
       SpecializedFunctionName(*ctx, func, func_node);
@@ -1459,9 +1597,11 @@ Status FunctionOptimizer::RunFunctionOptimizerPass(
                                          &graph_after_inlining));
 
   // Specialize function calls that we could not inline.
-  FunctionOptimizerContext ctx(item, opt_level_, graph_after_inlining);
+  const GrapplerItem item_after_inlining =
+      item.WithGraph(std::move(graph_after_inlining));
+  FunctionOptimizerContext ctx(item, opt_level_, item_after_inlining);
 
-  for (const NodeDef& node : graph_after_inlining.node()) {
+  for (const NodeDef& node : item_after_inlining.graph.node()) {
     // Function specialization can modify optimized graph only by adding new
     // nodes, we can check node size to make sure that graph was not modified.
     const int num_nodes_before = optimized_graph->node_size();
@@ -1485,9 +1625,10 @@ Status FunctionOptimizer::RunFunctionOptimizerPass(
 
     // Specialize it to its instantiation context if it has something worth
     // specializing.
-    const bool specialization_worthy = IsParametrized(*func) ||
-                                       HasTrulyConstInputs(node, ctx) ||
-                                       HasUnusedOutputs(node, *func, ctx);
+    const bool specialization_worthy =
+        IsParametrized(*func) || HasTrulyConstInputs(node, ctx) ||
+        HasUnusedOutputs(node, *func, ctx) ||
+        !GetKnownInputShapes(node, *func, &ctx).empty();
 
     // Do not specialize if function has custom gradient or marked nospecialize.
     const string grad_func = ctx.function_library().FindGradient(func_name);
@@ -1496,8 +1637,8 @@ Status FunctionOptimizer::RunFunctionOptimizerPass(
         MarkedNoSpecialize(*func) || MarkedForXlaCompilation(node);
 
     if (specialization_worthy && !no_specialize) {
-      // TODO(ezhulenev): Specialize function call if input has a known shape.
-      // Specialize function body for its instantiation attributes and inputs.
+      // Specialize function body for its instantiation attributes, inputs and
+      // their known shapes.
       Status status = SpecializeFunction(node, *func, &ctx, optimized_graph);
       if (!status.ok() && is_graph_modified()) {
         return status;
@@ -21,6 +21,8 @@ limitations under the License.
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/algorithm/container.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "tensorflow/cc/ops/functional_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/framework/function.h"
@@ -1809,6 +1811,146 @@ TEST_F(FunctionOptimizerTest, SpecializeFunction_OncePerUniqueContext) {
   test::ExpectTensorEqual<float>(tensors_expected[5], tensors[5]);
 }
 
+TEST_F(FunctionOptimizerTest, SpecializeFunctionForInputShapes) {
+  using test::function::NDef;
+  using FDH = FunctionDefHelper;
+
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  // A function with fixed types, that is only worth specializing for the
+  // shapes of its inputs.
+  FunctionDef square_func = FDH::Create(
+      "MySquare", {"x:float"}, {"z:float"}, {},
+      {{{"square"}, "Square", {"x"}, {{"T", DT_FLOAT}}}},
+      /* Mapping between function returns and function node outputs. */
+      {{"z", "square:y:0"}});
+  (*square_func.mutable_attr())["_noinline"].set_b(true);
+  std::vector<FunctionDef> function_library = {square_func};
+
+  const TensorShape matrix_shape({2, 3});
+  const TensorShape vector_shape({4});
+
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.fetch = {"square_a", "square_b", "square_c", "square_d"};
+  item.graph = test::function::GDef(
+      {NDef("a", "Placeholder", {},
+            {{"dtype", DT_FLOAT}, {"shape", matrix_shape}}, kDevice),
+       NDef("b", "Placeholder", {},
+            {{"dtype", DT_FLOAT}, {"shape", matrix_shape}}, kDevice),
+       NDef("c", "Placeholder", {},
+            {{"dtype", DT_FLOAT}, {"shape", vector_shape}}, kDevice),
+       NDef("d", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+       NDef("square_a", "MySquare", {"a"}, {}, kDevice),
+       NDef("square_b", "MySquare", {"b"}, {}, kDevice),
+       NDef("square_c", "MySquare", {"c"}, {}, kDevice),
+       NDef("square_d", "MySquare", {"d"}, {}, kDevice)},
+      function_library);
+
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // Calls with the same input shapes share a specialization, and the call
+  // with an unknown input shape is not specialized.
+  const string matrix_func = "MySquare_specialized_for_square_a_at_tf_graph";
+  const string vector_func = "MySquare_specialized_for_square_c_at_tf_graph";
+  int count = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "square_a" && ++count) {
+      EXPECT_EQ(matrix_func, node.op());
+    } else if (node.name() == "square_b" && ++count) {
+      EXPECT_EQ(matrix_func, node.op());
+    } else if (node.name() == "square_c" && ++count) {
+      EXPECT_EQ(vector_func, node.op());
+    } else if (node.name() == "square_d" && ++count) {
+      EXPECT_EQ("MySquare", node.op());
+    }
+  }
+  EXPECT_EQ(4, count);
+
+  // The input shapes are baked into the specialized functions.
+  ASSERT_EQ(3, output.library().function_size());
+  count = 0;
+  for (const FunctionDef& func : output.library().function()) {
+    const string& name = func.signature().name();
+    if (name != matrix_func && name != vector_func) continue;
+    ++count;
+    ASSERT_EQ(1, func.arg_attr().count(0));
+    const AttrValue& shapes = func.arg_attr().at(0).attr().at("_output_shapes");
+    ASSERT_EQ(1, shapes.list().shape_size());
+    EXPECT_EQ(name == matrix_func ? "[2,3]" : "[4]",
+              PartialTensorShape(shapes.list().shape(0)).DebugString());
+  }
+  EXPECT_EQ(2, count);
+
+  // And that graph evaluation yields the same result.
+  item.feed = {{"a", test::AsTensor<float>({1, 2, 3, 4, 5, 6}, {2, 3})},
+               {"b", test::AsTensor<float>({-1, -2, -3, -4, -5, -6}, {2, 3})},
+               {"c", test::AsTensor<float>({1, 2, 3, 4}, {4})},
+               {"d", test::AsScalar<float>(3.14f)}};
+  auto tensors_expected = EvaluateFetchNodes(item);
+  GrapplerItem optimized = item.WithGraph(std::move(output));
+  auto tensors = EvaluateFetchNodes(optimized);
+  ASSERT_EQ(tensors_expected.size(), tensors.size());
+  for (int i = 0; i < tensors.size(); ++i) {
+    test::ExpectTensorEqual<float>(tensors_expected[i], tensors[i]);
+  }
+}
+
+TEST_F(FunctionOptimizerTest, SpecializeFunctionForTooManyInputShapes) {
+  using test::function::NDef;
+  using FDH = FunctionDefHelper;
+
+  FunctionOptimizer optimizer(RewriterConfig::DEFAULT, true);
+
+  FunctionDef square_func = FDH::Create(
+      "MySquare", {"x:float"}, {"z:float"}, {},
+      {{{"square"}, "Square", {"x"}, {{"T", DT_FLOAT}}}},
+      /* Mapping between function returns and function node outputs. */
+      {{"z", "square:y:0"}});
+  (*square_func.mutable_attr())["_noinline"].set_b(true);
+  std::vector<FunctionDef> function_library = {square_func};
+
+  // Calls with 10 different input shapes, more than the 8 specializations
+  // allowed per function and pass.
+  constexpr int kNumShapes = 10;
+  constexpr int kMaxSpecializations = 8;
+  std::vector<NodeDef> nodes;
+  GrapplerItem item;
+  item.id = "tf_graph";
+  for (int i = 0; i < kNumShapes; ++i) {
+    const string input = absl::StrCat("x", i);
+    const string call = absl::StrCat("square_", i);
+    nodes.push_back(NDef(input, "Placeholder", {},
+                         {{"dtype", DT_FLOAT}, {"shape", TensorShape({i + 1})}},
+                         kDevice));
+    nodes.push_back(NDef(call, "MySquare", {input}, {}, kDevice));
+    item.fetch.push_back(call);
+  }
+  item.graph = test::function::GDef(nodes, function_library);
+
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The calls past the limit are left unspecialized.
+  int num_specialized = 0;
+  int num_unspecialized = 0;
+  for (const NodeDef& node : output.node()) {
+    if (!absl::StartsWith(node.name(), "square_")) continue;
+    if (node.op() == "MySquare") {
+      ++num_unspecialized;
+    } else {
+      EXPECT_EQ(absl::StrCat("MySquare_specialized_for_", node.name(),
+                             "_at_tf_graph"),
+                node.op());
+      ++num_specialized;
+    }
+  }
+  EXPECT_EQ(kMaxSpecializations, num_specialized);
+  EXPECT_EQ(kNumShapes - kMaxSpecializations, num_unspecialized);
+  EXPECT_EQ(kMaxSpecializations + 1, output.library().function_size());
+}
+
 TEST_F(FunctionOptimizerTest, SpecializeFunctionForUsedOutputTensors) {
   using test::function::NDef;
 
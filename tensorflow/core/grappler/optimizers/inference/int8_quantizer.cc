@@ -0,0 +1,490 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/inference/int8_quantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/kernels/quantization_utils.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/util/util.h"
+#ifdef INTEL_MKL
+#include "tensorflow/core/graph/mkl_graph_util.h"
+#endif  // INTEL_MKL
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+constexpr char kInt8QuantizerConfigParamKey[] = "int8_quantizer_config";
+constexpr char kMatMul[] = "MatMul";
+constexpr char kConv2D[] = "Conv2D";
+constexpr char kInt8QuantizerCtrl[] = "Int8QuantizerCtrl";
+// Same as the default ensure_minimum_range of QuantizeV2.
+constexpr float kMinimumRange = 0.01f;
+
+// A node to quantize and its weights.
+struct Candidate {
+  const NodeDef* node;
+  const NodeDef* weights;
+};
+
+bool HasFloatType(const NodeDef& node, const string& attr_name) {
+  auto it = node.attr().find(attr_name);
+  return it != node.attr().end() && it->second.type() == DT_FLOAT;
+}
+
+bool IsSupportedConv2D(const NodeDef& node) {
+  auto it = node.attr().find("data_format");
+  if (it != node.attr().end() && it->second.s() != "NHWC") return false;
+  it = node.attr().find("padding");
+  if (it == node.attr().end() || it->second.s() == "EXPLICIT") return false;
+  it = node.attr().find("dilations");
+  if (it != node.attr().end()) {
+    for (int64_t dilation : it->second.list().i()) {
+      if (dilation != 1) return false;
+    }
+  }
+  return true;
+}
+
+std::vector<Candidate> FindCandidates(const GraphDef& graph) {
+  ImmutableNodeMap node_map(&graph);
+  std::vector<Candidate> candidates;
+  for (const NodeDef& node : graph.node()) {
+    if (node.op() != kMatMul && node.op() != kConv2D) continue;
+    if (!node.device().empty() && !NodeIsOnCpu(&node)) continue;
+    if (!HasFloatType(node, "T") || node.input_size() < 2) continue;
+    if (IsControlInput(node.input(0)) || IsControlInput(node.input(1))) {
+      continue;
+    }
+    if (node.op() == kConv2D && !IsSupportedConv2D(node)) continue;
+    const NodeDef* weights = node_map.GetNode(node.input(1));
+    if (weights == nullptr || weights->op() != "Const" ||
+        !HasFloatType(*weights, "dtype")) {
+      continue;
+    }
+    candidates.push_back({&node, weights});
+  }
+  return candidates;
+}
+
+string InputTensorName(const NodeDef& node) {
+  const TensorId input = ParseTensorName(node.input(0));
+  return absl::StrCat(input.node(), ":", input.index());
+}
+
+string OutputTensorName(const NodeDef& node) {
+  return absl::StrCat(node.name(), ":0");
+}
+
+// Widens [min, max] to contain zero, which the quantized kernels use for
+// padding, and to be at least as wide as QuantizeV2 requires.
+void AdjustRange(float* min, float* max) {
+  *min = std::min(*min, 0.0f);
+  *max = std::max(*max, 0.0f);
+  const float epsilon =
+      std::max(1.0f, std::max(std::fabs(*min), std::fabs(*max))) *
+      kMinimumRange;
+  *max = std::max(*max, *min + epsilon);
+}
+
+// Quantizes `weights` as a whole to quint8, as QuantizeV2 does in MIN_FIRST
+// mode.
+Tensor QuantizeWeights(const Tensor& weights, float* min, float* max) {
+  auto values = weights.flat<float>();
+  *min = 0.0f;
+  *max = 0.0f;
+  for (int64_t i = 0; i < values.size(); ++i) {
+    *min = std::min(*min, values(i));
+    *max = std::max(*max, values(i));
+  }
+  if (*max == *min) *max = *min + 1.0f;
+  Tensor quantized(DT_QUINT8, weights.shape());
+  auto quantized_values = quantized.flat<quint8>();
+  for (int64_t i = 0; i < values.size(); ++i) {
+    quantized_values(i) = FloatToQuantized<quint8>(values(i), *min, *max);
+  }
+  return quantized;
+}
+
+// Quantizes `filter`, in HWIO layout, to qint8 with one symmetric range per
+// output channel, as the oneDNN per-channel kernels expect.
+Tensor QuantizeFilterPerChannel(const Tensor& filter, Tensor* min,
+                                Tensor* max) {
+  const int64_t channels = filter.dim_size(filter.dims() - 1);
+  auto values = filter.flat<float>();
+  std::vector<float> ranges(channels, 0.0f);
+  for (int64_t i = 0; i < values.size(); ++i) {
+    float& range = ranges[i % channels];
+    range = std::max(range, std::fabs(values(i)));
+  }
+  *min = Tensor(DT_FLOAT, TensorShape({channels}));
+  *max = Tensor(DT_FLOAT, TensorShape({channels}));
+  for (int64_t c = 0; c < channels; ++c) {
+    if (ranges[c] == 0.0f) ranges[c] = 1.0f;
+    min->vec<float>()(c) = -ranges[c];
+    max->vec<float>()(c) = ranges[c];
+  }
+  Tensor quantized(DT_QINT8, filter.shape());
+  auto quantized_values = quantized.flat<qint8>();
+  for (int64_t i = 0; i < values.size(); ++i) {
+    const float scaled = std::round(values(i) * 127.0f / ranges[i % channels]);
+    quantized_values(i) = static_cast<int8>(
+        std::min(127.0f, std::max(-127.0f, scaled)));
+  }
+  return quantized;
+}
+
+// Returns a control dependency on the producer of `input`, which puts the
+// nodes it anchors in the same frame and branch as the consumers of `input`.
+// Like ConstantFolding::AddControlDependency(), anchors on an Identity of the
+// output of a Switch rather than on the Switch itself, since a control
+// dependency on a Switch is triggered whichever output is taken.
+string AddControlAnchor(const string& input, NodeMap* node_map,
+                        GraphDef* graph) {
+  const NodeDef* node = node_map->GetNode(input);
+  if (node == nullptr || !IsSwitch(*node)) {
+    return AsControlDependency(NodeName(input));
+  }
+  for (const NodeDef* output :
+       node_map->GetOutputsOrderedByNodeName(node->name())) {
+    if ((IsIdentity(*output) || IsIdentityNSingleInput(*output)) &&
+        IsSameInput(output->input(0), input)) {
+      return AsControlDependency(*output);
+    }
+  }
+  int port = 0;
+  string anchor_name = ParseNodeName(input, &port);
+  absl::StrAppend(&anchor_name, "_", port);
+  anchor_name = AddPrefixToNodeName(anchor_name, kInt8QuantizerCtrl);
+  if (node_map->GetNode(anchor_name) == nullptr) {
+    NodeDef* anchor = graph->add_node();
+    anchor->set_name(anchor_name);
+    anchor->set_op("Identity");
+    anchor->set_device(node->device());
+    (*anchor->mutable_attr())["T"] = node->attr().at("T");
+    anchor->add_input(input);
+    node_map->AddNode(anchor->name(), anchor);
+    node_map->AddOutput(node->name(), anchor->name());
+  }
+  return AsControlDependency(anchor_name);
+}
+
+// Builds the nodes that replace one candidate.
+class QuantizedNodeBuilder {
+ public:
+  // The constants are anchored on `anchor`, so that they end up in the same
+  // frame as the node in loops.
+  QuantizedNodeBuilder(const NodeDef& node, const string& anchor,
+                       GraphDef* graph)
+      : node_(node),
+        prefix_(absl::StrCat(node.name(), "/int8/")),
+        anchor_(anchor),
+        graph_(graph) {}
+
+  NodeDef* AddNode(const string& name, const string& op) {
+    NodeDef* node = graph_->add_node();
+    node->set_name(absl::StrCat(prefix_, name));
+    node->set_op(op);
+    node->set_device(node_.device());
+    return node;
+  }
+
+  string AddConst(const string& name, const Tensor& value) {
+    NodeDef* node = AddNode(name, "Const");
+    node->add_input(anchor_);
+    SetAttrValue(value.dtype(), &(*node->mutable_attr())["dtype"]);
+    value.AsProtoTensorContent(
+        (*node->mutable_attr())["value"].mutable_tensor());
+    return node->name();
+  }
+
+  string AddScalar(const string& name, float value) {
+    Tensor tensor(DT_FLOAT, TensorShape({}));
+    tensor.scalar<float>()() = value;
+    return AddConst(name, tensor);
+  }
+
+ private:
+  const NodeDef& node_;
+  const string prefix_;
+  const string anchor_;
+  GraphDef* graph_;
+};
+
+void CopyAttr(const NodeDef& from, const string& name, NodeDef* to) {
+  auto it = from.attr().find(name);
+  if (it != from.attr().end()) (*to->mutable_attr())[name] = it->second;
+}
+
+}  // namespace
+
+std::vector<string> GetInt8CalibrationTensors(const GraphDef& graph) {
+  std::vector<string> tensors;
+  for (const Candidate& candidate : FindCandidates(graph)) {
+    tensors.push_back(InputTensorName(*candidate.node));
+    tensors.push_back(OutputTensorName(*candidate.node));
+  }
+  std::sort(tensors.begin(), tensors.end());
+  tensors.erase(std::unique(tensors.begin(), tensors.end()), tensors.end());
+  return tensors;
+}
+
+Status UpdateInt8Calibration(const std::vector<string>& tensors,
+                             const std::vector<Tensor>& values,
+                             QuantizationCalibration* calibration) {
+  if (tensors.size() != values.size()) {
+    return errors::InvalidArgument("Got ", values.size(), " values for ",
+                                   tensors.size(), " tensors");
+  }
+  auto* ranges = calibration->mutable_ranges();
+  for (int i = 0, end = tensors.size(); i < end; ++i) {
+    if (values[i].dtype() != DT_FLOAT) {
+      return errors::InvalidArgument("Cannot calibrate ", tensors[i], " of ",
+                                     DataTypeString(values[i].dtype()));
+    }
+    auto flat = values[i].flat<float>();
+    bool found = false;
+    float min = 0.0f;
+    float max = 0.0f;
+    for (int64_t j = 0; j < flat.size(); ++j) {
+      if (!std::isfinite(flat(j))) continue;
+      min = found ? std::min(min, flat(j)) : flat(j);
+      max = found ? std::max(max, flat(j)) : flat(j);
+      found = true;
+    }
+    if (!found) continue;
+    auto it = ranges->find(tensors[i]);
+    if (it == ranges->end()) {
+      QuantizationCalibration::Range& range = (*ranges)[tensors[i]];
+      range.set_min(min);
+      range.set_max(max);
+    } else {
+      it->second.set_min(std::min(it->second.min(), min));
+      it->second.set_max(std::max(it->second.max(), max));
+    }
+  }
+  calibration->set_num_samples(calibration->num_samples() + 1);
+  return absl::OkStatus();
+}
+
+Status Int8Quantizer::Init(const RewriterConfig_CustomGraphOptimizer* config) {
+  if (config == nullptr) return absl::OkStatus();
+  auto it = config->parameter_map().find(kInt8QuantizerConfigParamKey);
+  if (it == config->parameter_map().end()) {
+    return errors::InvalidArgument(
+        "int8_quantizer_config param must be set in the rewriter config with "
+        "a serialized/encoded Int8QuantizerConfig.");
+  }
+  string unencoded;
+  if (!absl::Base64Unescape(it->second.s(), &unencoded)) {
+    return errors::InvalidArgument(
+        "Failed to unencode int8_quantizer_config from params.");
+  }
+  if (!config_.ParseFromString(unencoded)) {
+    return errors::InvalidArgument(
+        "Failed to parse int8_quantizer_config from params.");
+  }
+  return absl::OkStatus();
+}
+
+Status Int8Quantizer::Optimize(Cluster* cluster, const GrapplerItem& item,
+                               GraphDef* optimized_graph) {
+  *optimized_graph = item.graph;
+  if (!config_.calibration_file().empty()) {
+    QuantizationCalibration calibration;
+    TF_RETURN_IF_ERROR(ReadBinaryProto(
+        Env::Default(), config_.calibration_file(), &calibration));
+    *config_.mutable_calibration() = std::move(calibration);
+    config_.clear_calibration_file();
+  }
+  const auto& ranges = config_.calibration().ranges();
+  // The per-channel kernels are only registered in oneDNN builds.
+#ifdef INTEL_MKL
+  const bool per_channel = !config_.disable_per_channel() && IsMKLEnabled();
+#else
+  const bool per_channel = false;
+#endif  // INTEL_MKL
+
+  // The candidates point into item.graph, the nodes they replace are at the
+  // same positions in the optimized graph.
+  absl::flat_hash_map<string, int> node_index;
+  for (int i = 0; i < optimized_graph->node_size(); ++i) {
+    node_index[optimized_graph->node(i).name()] = i;
+  }
+  NodeMap node_map(optimized_graph);
+  int num_quantized = 0;
+  for (const Candidate& candidate : FindCandidates(item.graph)) {
+    const NodeDef& node = *candidate.node;
+    auto input_range = ranges.find(InputTensorName(node));
+    auto output_range = ranges.find(OutputTensorName(node));
+    if (input_range == ranges.end() || output_range == ranges.end()) {
+      VLOG(2) << "Not quantizing " << node.name() << ": no calibration";
+      continue;
+    }
+    auto value = candidate.weights->attr().find("value");
+    Tensor weights;
+    if (value == candidate.weights->attr().end() ||
+        !weights.FromProto(value->second.tensor()) ||
+        weights.dims() != (node.op() == kConv2D ? 4 : 2)) {
+      continue;
+    }
+    float input_min = input_range->second.min();
+    float input_max = input_range->second.max();
+    float output_min = output_range->second.min();
+    float output_max = output_range->second.max();
+    AdjustRange(&input_min, &input_max);
+    AdjustRange(&output_min, &output_max);
+    // The oneDNN kernels take quint8 inputs in SCALED mode, i.e. without
+    // offset, so only non-negative inputs can use them.
+    const bool quantize_per_channel =
+        per_channel && node.op() == kConv2D && input_range->second.min() >= 0;
+    const string mode = quantize_per_channel ? "SCALED" : "MIN_FIRST";
+
+    QuantizedNodeBuilder builder(
+        node, AddControlAnchor(node.input(0), &node_map, optimized_graph),
+        optimized_graph);
+    NodeDef* quantize = builder.AddNode("quantize", "QuantizeV2");
+    quantize->add_input(node.input(0));
+    quantize->add_input(builder.AddScalar("input_min", input_min));
+    quantize->add_input(builder.AddScalar("input_max", input_max));
+    for (int i = 2; i < node.input_size(); ++i) {
+      quantize->add_input(node.input(i));
+    }
+    SetAttrValue(DT_QUINT8, &(*quantize->mutable_attr())["T"]);
+    SetAttrValue(mode, &(*quantize->mutable_attr())["mode"]);
+
+    string weights_min;
+    string weights_max;
+    string weights_name;
+    if (quantize_per_channel) {
+      Tensor min, max;
+      weights_name = builder.AddConst(
+          "weights", QuantizeFilterPerChannel(weights, &min, &max));
+      weights_min = builder.AddConst("weights_min", min);
+      weights_max = builder.AddConst("weights_max", max);
+    } else {
+      float min, max;
+      weights_name =
+          builder.AddConst("weights", QuantizeWeights(weights, &min, &max));
+      weights_min = builder.AddScalar("weights_min", min);
+      weights_max = builder.AddScalar("weights_max", max);
+    }
+
+    string quantized_op = "QuantizedMatMul";
+    if (node.op() == kConv2D) {
+      quantized_op = "QuantizedConv2D";
+    }
+#ifdef INTEL_MKL
+    // QuantizedConv2DPerChannel only has a placeholder kernel, which the
+    // oneDNN layout pass replaces with the _Mkl op. Emit the _Mkl op directly,
+    // so that the graph also runs where that pass does not, e.g. when it is
+    // imported into another runtime.
+    if (quantize_per_channel) {
+      quantized_op =
+          mkl_op_registry::GetMklOpName("QuantizedConv2DPerChannel");
+    }
+#endif  // INTEL_MKL
+    NodeDef* quantized = builder.AddNode("compute", quantized_op);
+    quantized->add_input(quantize->name());
+    quantized->add_input(weights_name);
+    quantized->add_input(absl::StrCat(quantize->name(), ":1"));
+    quantized->add_input(absl::StrCat(quantize->name(), ":2"));
+    quantized->add_input(weights_min);
+    quantized->add_input(weights_max);
+    auto* attr = quantized->mutable_attr();
+    if (node.op() == kMatMul) {
+      SetAttrValue(DT_QUINT8, &(*attr)["T1"]);
+      SetAttrValue(DT_QUINT8, &(*attr)["T2"]);
+      SetAttrValue(DT_QINT32, &(*attr)["Toutput"]);
+      CopyAttr(node, "transpose_a", quantized);
+      CopyAttr(node, "transpose_b", quantized);
+    } else {
+      SetAttrValue(DT_QUINT8, &(*attr)["Tinput"]);
+      SetAttrValue(quantize_per_channel ? DT_QINT8 : DT_QUINT8,
+                   &(*attr)["Tfilter"]);
+      SetAttrValue(DT_QINT32, &(*attr)["out_type"]);
+      CopyAttr(node, "strides", quantized);
+      CopyAttr(node, "padding", quantized);
+      CopyAttr(node, "dilations", quantized);
+#ifdef INTEL_MKL
+      if (quantize_per_channel) {
+        SetAttrValue(true, &(*attr)["is_filter_const"]);
+        (*attr)["_kernel"].set_s(mkl_op_registry::kMklQuantizedOpLabel);
+      }
+#endif  // INTEL_MKL
+    }
+
+    // SCALED ranges are symmetric, unsigned ones start at zero.
+    DataType output_type = DT_QUINT8;
+    if (quantize_per_channel) {
+      if (output_range->second.min() < 0) {
+        output_type = DT_QINT8;
+        output_max = std::max(-output_min, output_max);
+        output_min = -output_max;
+      } else {
+        output_min = 0.0f;
+      }
+    }
+    NodeDef* requantize = builder.AddNode(
+        "requantize",
+        quantize_per_channel ? "RequantizePerChannel" : "Requantize");
+    requantize->add_input(quantized->name());
+    requantize->add_input(absl::StrCat(quantized->name(), ":1"));
+    requantize->add_input(absl::StrCat(quantized->name(), ":2"));
+    requantize->add_input(builder.AddScalar("output_min", output_min));
+    requantize->add_input(builder.AddScalar("output_max", output_max));
+    const char* input_type_attr = quantize_per_channel ? "T" : "Tinput";
+    SetAttrValue(DT_QINT32, &(*requantize->mutable_attr())[input_type_attr]);
+    SetAttrValue(output_type, &(*requantize->mutable_attr())["out_type"]);
+
+    // The Dequantize node replaces the original one in place.
+    NodeDef* dequantize =
+        optimized_graph->mutable_node(node_index.at(node.name()));
+    dequantize->set_op("Dequantize");
+    dequantize->clear_input();
+    dequantize->add_input(requantize->name());
+    dequantize->add_input(absl::StrCat(requantize->name(), ":1"));
+    dequantize->add_input(absl::StrCat(requantize->name(), ":2"));
+    dequantize->clear_attr();
+    SetAttrValue(output_type, &(*dequantize->mutable_attr())["T"]);
+    SetAttrValue(mode, &(*dequantize->mutable_attr())["mode"]);
+    SetAttrValue(DT_FLOAT, &(*dequantize->mutable_attr())["dtype"]);
+    ++num_quantized;
+  }
+  VLOG(1) << "Quantized " << num_quantized << " nodes to int8";
+  return absl::OkStatus();
+}
+
+REGISTER_GRAPH_OPTIMIZER_AS(Int8Quantizer, "int8_quantizer");
+
+}  // namespace grappler
+}  // namespace tensorflow
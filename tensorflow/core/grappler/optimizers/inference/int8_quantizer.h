@@ -0,0 +1,77 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_INFERENCE_INT8_QUANTIZER_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_INFERENCE_INT8_QUANTIZER_H_
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/inference/int8_quantizer.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Returns the float tensors of `graph` whose ranges Int8Quantizer needs to
+// quantize it: the activation input and the output of each MatMul and Conv2D
+// with constant weights placed on the CPU.
+std::vector<string> GetInt8CalibrationTensors(const GraphDef& graph);
+
+// Widens the ranges of `tensors` in `calibration` to cover `values`, their
+// values in one run of the graph.
+Status UpdateInt8Calibration(const std::vector<string>& tensors,
+                             const std::vector<Tensor>& values,
+                             QuantizationCalibration* calibration);
+
+// Post-training quantization of inference graphs for the int8 CPU kernels.
+//
+// Each MatMul or Conv2D with constant weights, for which `calibration` has the
+// range of the input and of the output, is rewritten into
+//
+//   QuantizeV2 -> QuantizedMatMul/QuantizedConv2D -> Requantize -> Dequantize
+//
+// with the weights quantized ahead of time. The input is quantized with its
+// calibrated range and the accumulators are requantized with the calibrated
+// range of the output. The Dequantize node takes the name of the original
+// node, so the following ops, e.g. BiasAdd and activations, still run in
+// float. In oneDNN builds, the filters of Conv2D with non-negative inputs are
+// quantized per output channel, for the _MklQuantizedConv2DPerChannel kernel.
+class Int8Quantizer : public CustomGraphOptimizer {
+ public:
+  Int8Quantizer() = default;
+  explicit Int8Quantizer(const Int8QuantizerConfig& config)
+      : config_(config) {}
+
+  Status Init(const RewriterConfig_CustomGraphOptimizer* config) override;
+
+  string name() const override { return "int8_quantizer"; }
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+ private:
+  Int8QuantizerConfig config_;
+};
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_INFERENCE_INT8_QUANTIZER_H_
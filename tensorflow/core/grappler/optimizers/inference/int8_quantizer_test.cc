@@ -0,0 +1,325 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/inference/int8_quantizer.h"
+
+#include <utility>
+#include <vector>
+
+#include "absl/strings/escaping.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+#include "tensorflow/core/util/util.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class Int8QuantizerTest : public GrapplerTest {
+ protected:
+  // x -> MatMul(w) -> BiasAdd(b) -> Relu, and an unquantizable MatMul with
+  // non-constant weights.
+  GrapplerItem MakeMatMulItem() {
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+    auto x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({2, 3}));
+    auto w = ops::Const(s.WithOpName("w"),
+                        {0.5f, -0.25f, 1.0f, 0.75f, -1.0f, 0.125f, 0.25f,
+                         -0.5f, 0.375f, 0.0f, 0.625f, -0.75f},
+                        {3, 4});
+    auto m = ops::MatMul(s.WithOpName("m"), x, w);
+    auto b = ops::Const(s.WithOpName("b"), {0.1f, 0.2f, 0.3f, 0.4f}, {4});
+    auto bias_add = ops::BiasAdd(s.WithOpName("bias_add"), m, b);
+    auto relu = ops::Relu(s.WithOpName("relu"), bias_add);
+    auto y = ops::Placeholder(s.WithOpName("y"), DT_FLOAT,
+                              ops::Placeholder::Shape({4, 2}));
+    auto other = ops::MatMul(s.WithOpName("other"), relu, y);
+
+    GrapplerItem item;
+    item.fetch = {"relu", "other"};
+    TF_CHECK_OK(s.ToGraphDef(&item.graph));
+    return item;
+  }
+
+  std::vector<std::pair<string, Tensor>> MakeFeeds(float scale) {
+    return {{"x", test::AsTensor<float>({0.1f * scale, -0.2f * scale,
+                                          0.3f * scale, -0.4f * scale,
+                                          0.5f * scale, 0.6f * scale},
+                                         {2, 3})},
+            {"y", test::AsTensor<float>(
+                      {1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, -1.0f, 0.5f},
+                      {4, 2})}};
+  }
+
+  QuantizationCalibration Calibrate(const GraphDef& graph) {
+    const std::vector<string> tensors = GetInt8CalibrationTensors(graph);
+    QuantizationCalibration calibration;
+    for (float scale : {1.0f, -2.0f}) {
+      TF_CHECK_OK(UpdateInt8Calibration(
+          tensors, EvaluateNodes(graph, tensors, MakeFeeds(scale)),
+          &calibration));
+    }
+    return calibration;
+  }
+};
+
+TEST_F(Int8QuantizerTest, CalibrationTensors) {
+  const GrapplerItem item = MakeMatMulItem();
+  EXPECT_EQ(GetInt8CalibrationTensors(item.graph),
+            std::vector<string>({"m:0", "x:0"}));
+}
+
+TEST_F(Int8QuantizerTest, UpdateCalibration) {
+  QuantizationCalibration calibration;
+  TF_ASSERT_OK(UpdateInt8Calibration(
+      {"a:0"}, {test::AsTensor<float>({1.0f, -2.0f})}, &calibration));
+  TF_ASSERT_OK(UpdateInt8Calibration(
+      {"a:0"}, {test::AsTensor<float>({3.0f, 0.0f})}, &calibration));
+  EXPECT_EQ(2, calibration.num_samples());
+  EXPECT_EQ(-2.0f, calibration.ranges().at("a:0").min());
+  EXPECT_EQ(3.0f, calibration.ranges().at("a:0").max());
+
+  EXPECT_FALSE(UpdateInt8Calibration({"a:0"}, {test::AsTensor<int>({1})},
+                                     &calibration)
+                   .ok());
+  EXPECT_FALSE(UpdateInt8Calibration({"a:0"}, {}, &calibration).ok());
+}
+
+TEST_F(Int8QuantizerTest, QuantizeMatMul) {
+  const GrapplerItem item = MakeMatMulItem();
+  Int8QuantizerConfig config;
+  *config.mutable_calibration() = Calibrate(item.graph);
+  EXPECT_EQ(2, config.calibration().num_samples());
+
+  RewriterConfig_CustomGraphOptimizer rewriter_config;
+  (*rewriter_config.mutable_parameter_map())["int8_quantizer_config"].set_s(
+      absl::Base64Escape(config.SerializeAsString()));
+  Int8Quantizer optimizer;
+  TF_ASSERT_OK(optimizer.Init(&rewriter_config));
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "m") {
+      EXPECT_EQ("Dequantize", node.op());
+      ASSERT_EQ(3, node.input_size());
+      EXPECT_EQ("m/int8/requantize", node.input(0));
+      ++found;
+    } else if (node.name() == "m/int8/compute") {
+      EXPECT_EQ("QuantizedMatMul", node.op());
+      EXPECT_EQ("m/int8/quantize", node.input(0));
+      EXPECT_EQ("m/int8/weights", node.input(1));
+      ++found;
+    } else if (node.name() == "m/int8/quantize") {
+      EXPECT_EQ("QuantizeV2", node.op());
+      EXPECT_EQ("x", node.input(0));
+      ++found;
+    } else if (node.name() == "m/int8/weights") {
+      EXPECT_EQ(DT_QUINT8, node.attr().at("dtype").type());
+      ++found;
+    } else if (node.name() == "other" || node.name() == "bias_add") {
+      EXPECT_NE("Dequantize", node.op());
+      ++found;
+    }
+  }
+  EXPECT_EQ(6, found);
+
+  const auto feeds = MakeFeeds(1.0f);
+  auto expected = EvaluateNodes(item.graph, item.fetch, feeds);
+  auto actual = EvaluateNodes(output, item.fetch, feeds);
+  ASSERT_EQ(2, actual.size());
+  test::ExpectClose(expected[0], actual[0], /*atol=*/0.05, /*rtol=*/0.05);
+  test::ExpectClose(expected[1], actual[1], /*atol=*/0.05, /*rtol=*/0.05);
+}
+
+TEST_F(Int8QuantizerTest, QuantizeConv2D) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  auto x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                            ops::Placeholder::Shape({1, 4, 4, 1}));
+  auto relu = ops::Relu(s.WithOpName("relu"), x);
+  auto filter = ops::Const(s.WithOpName("filter"),
+                           {0.5f, -1.0f, 0.25f, 0.75f, -0.5f, 0.125f, 1.0f,
+                            0.0f},
+                           {2, 2, 1, 2});
+  auto conv = ops::Conv2D(s.WithOpName("conv"), relu, filter, {1, 1, 1, 1},
+                          "SAME");
+  GrapplerItem item;
+  item.fetch = {"conv"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  const std::vector<string> tensors = GetInt8CalibrationTensors(item.graph);
+  EXPECT_EQ(tensors, std::vector<string>({"conv:0", "relu:0"}));
+  Tensor input(DT_FLOAT, TensorShape({1, 4, 4, 1}));
+  test::FillFn<float>(&input, [](int i) { return (i % 5) * 0.25f - 0.5f; });
+  Int8QuantizerConfig config;
+  TF_ASSERT_OK(UpdateInt8Calibration(
+      tensors, EvaluateNodes(item.graph, tensors, {{"x", input}}),
+      config.mutable_calibration()));
+
+  Int8Quantizer optimizer(config);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  // The input of the convolution is non-negative, so oneDNN builds quantize
+  // the filter per channel.
+  const bool per_channel = IsMKLEnabled();
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "conv/int8/compute") {
+      EXPECT_EQ(per_channel ? "_MklQuantizedConv2DPerChannel"
+                            : "QuantizedConv2D",
+                node.op());
+      ++found;
+    } else if (node.name() == "conv/int8/weights_min") {
+      EXPECT_EQ(per_channel ? 1 : 0,
+                node.attr().at("value").tensor().tensor_shape().dim_size());
+      ++found;
+    } else if (node.name() == "conv") {
+      EXPECT_EQ("Dequantize", node.op());
+      ++found;
+    }
+  }
+  EXPECT_EQ(3, found);
+
+  auto expected = EvaluateNodes(item.graph, item.fetch, {{"x", input}});
+  auto actual = EvaluateNodes(output, item.fetch, {{"x", input}});
+  ASSERT_EQ(1, actual.size());
+  test::ExpectClose(expected[0], actual[0], /*atol=*/0.05, /*rtol=*/0.05);
+}
+
+#ifdef INTEL_MKL
+TEST_F(Int8QuantizerTest, QuantizeConv2DPerChannelOneDNN) {
+  if (!IsMKLEnabled()) {
+    GTEST_SKIP() << "oneDNN is disabled";
+  }
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  auto x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                            ops::Placeholder::Shape({1, 3, 3, 2}));
+  auto relu = ops::Relu(s.WithOpName("relu"), x);
+  auto filter = ops::Const(s.WithOpName("filter"),
+                           {0.5f, -1.0f, 0.25f, 0.75f, -0.5f, 0.125f, 1.0f,
+                            0.0f, 0.375f, -0.25f, 0.625f, -0.75f, 0.875f,
+                            -0.125f, 0.5f, 0.25f},
+                           {2, 2, 2, 2});
+  auto conv = ops::Conv2D(s.WithOpName("conv"), relu, filter, {1, 1, 1, 1},
+                          "VALID");
+  // The input of this convolution is signed, so it is quantized per tensor.
+  auto signed_conv = ops::Conv2D(s.WithOpName("signed_conv"), x, filter,
+                                 {1, 1, 1, 1}, "VALID");
+  GrapplerItem item;
+  item.fetch = {"conv", "signed_conv"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  Tensor input(DT_FLOAT, TensorShape({1, 3, 3, 2}));
+  test::FillFn<float>(&input, [](int i) { return (i % 7) * 0.25f - 0.75f; });
+  const std::vector<string> tensors = GetInt8CalibrationTensors(item.graph);
+  Int8QuantizerConfig config;
+  TF_ASSERT_OK(UpdateInt8Calibration(
+      tensors, EvaluateNodes(item.graph, tensors, {{"x", input}}),
+      config.mutable_calibration()));
+
+  Int8Quantizer optimizer(config);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "conv/int8/compute") {
+      // The graph runs without the oneDNN layout pass.
+      EXPECT_EQ("_MklQuantizedConv2DPerChannel", node.op());
+      EXPECT_EQ("QuantizedMklOp", node.attr().at("_kernel").s());
+      EXPECT_TRUE(node.attr().at("is_filter_const").b());
+      EXPECT_EQ(DT_QINT8, node.attr().at("Tfilter").type());
+      ++found;
+    } else if (node.name() == "signed_conv/int8/compute") {
+      EXPECT_EQ("QuantizedConv2D", node.op());
+      ++found;
+    }
+  }
+  EXPECT_EQ(2, found);
+
+  auto expected = EvaluateNodes(item.graph, item.fetch, {{"x", input}});
+  auto actual = EvaluateNodes(output, item.fetch, {{"x", input}});
+  ASSERT_EQ(2, actual.size());
+  test::ExpectClose(expected[0], actual[0], /*atol=*/0.05, /*rtol=*/0.05);
+  test::ExpectClose(expected[1], actual[1], /*atol=*/0.05, /*rtol=*/0.05);
+}
+#endif  // INTEL_MKL
+
+TEST_F(Int8QuantizerTest, AnchorOnSwitchOutput) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  auto x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                            ops::Placeholder::Shape({2, 3}));
+  auto pred = ops::Placeholder(s.WithOpName("pred"), DT_BOOL,
+                               ops::Placeholder::Shape({}));
+  auto sw = ops::Switch(s.WithOpName("switch"), x, pred);
+  auto w = ops::Const(s.WithOpName("w"),
+                      {0.5f, -0.25f, 1.0f, 0.75f, -1.0f, 0.125f}, {3, 2});
+  auto m = ops::MatMul(s.WithOpName("m"), sw.output_true, w);
+  GrapplerItem item;
+  item.fetch = {"m"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  const std::vector<string> tensors = GetInt8CalibrationTensors(item.graph);
+  EXPECT_EQ(tensors, std::vector<string>({"m:0", "switch:1"}));
+  const std::vector<std::pair<string, Tensor>> feeds = {
+      {"x", test::AsTensor<float>({0.1f, -0.2f, 0.3f, -0.4f, 0.5f, 0.6f},
+                                  {2, 3})},
+      {"pred", test::AsScalar<bool>(true)}};
+  Int8QuantizerConfig config;
+  TF_ASSERT_OK(UpdateInt8Calibration(
+      tensors, EvaluateNodes(item.graph, tensors, feeds),
+      config.mutable_calibration()));
+
+  Int8Quantizer optimizer(config);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  // The constants only run when the true branch is taken.
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "Int8QuantizerCtrl/switch_1") {
+      EXPECT_EQ("Identity", node.op());
+      ASSERT_EQ(1, node.input_size());
+      EXPECT_EQ("switch:1", node.input(0));
+      ++found;
+    } else if (node.name() == "m/int8/weights") {
+      ASSERT_EQ(1, node.input_size());
+      EXPECT_EQ("^Int8QuantizerCtrl/switch_1", node.input(0));
+      ++found;
+    }
+  }
+  EXPECT_EQ(2, found);
+
+  auto expected = EvaluateNodes(item.graph, item.fetch, feeds);
+  auto actual = EvaluateNodes(output, item.fetch, feeds);
+  ASSERT_EQ(1, actual.size());
+  test::ExpectClose(expected[0], actual[0], /*atol=*/0.05, /*rtol=*/0.05);
+}
+
+TEST_F(Int8QuantizerTest, NoCalibration) {
+  const GrapplerItem item = MakeMatMulItem();
+  Int8Quantizer optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -16,12 +16,14 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/memory_optimizer.h"
 
 #include <algorithm>
+#include <memory>
 #include <queue>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/op.h"
@@ -30,6 +32,8 @@ limitations under the License.
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
 #include "tensorflow/core/grappler/costs/graph_memory.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/op_context.h"
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
 #include "tensorflow/core/grappler/costs/utils.h"
 #include "tensorflow/core/grappler/graph_topology_view.h"
 #include "tensorflow/core/grappler/grappler_item.h"
@@ -440,9 +444,177 @@ void RecomputeSubgraph(
   }
 }
 
-void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
-                                const string& recomputation_targets_name_scope,
-                                GraphDef* graph, const GrapplerItem& item) {
+// Nodes whose inputs we may want to recompute. This matches node names that
+// contain recomputation_targets_name_scope as a name scope, meaning it either
+// begins with or contains the name scope. Defaults to "gradients/" which will
+// match any node names that begins with "gradients/" or contains
+// "/gradients/".
+bool IsRecomputationTarget(const string& recomputation_targets_name_scope,
+                           const NodeDef& node) {
+  return absl::StartsWith(node.name(), recomputation_targets_name_scope) ||
+         static_cast<int>(
+             node.name().find("/" + recomputation_targets_name_scope)) != -1;
+}
+
+// A forward node whose outputs are kept in memory for backprop.
+struct RecomputeCandidate {
+  const NodeDef* node;
+  // The size of its outputs which are live at the peak and read by targets.
+  int64_t bytes = 0;
+  // The predicted time to compute the node again.
+  double compute_ns = 0;
+};
+
+// Selects forward nodes to recompute so that the estimated peak memory usage
+// of each device of `cluster` fits in `memory_budget_bytes`. The candidates
+// are the nodes with outputs live at the peak and read by target nodes, i.e.
+// the activations kept for backprop. Recomputing a node only frees memory if
+// its inputs stay live anyway, so each input must itself be read by a target
+// node, be persistent, or be recomputed. Candidates are selected in order of
+// predicted compute time per byte freed, which keeps the added FLOPs low.
+Status FindNodesToRecomputeUnderBudget(
+    Cluster* cluster, const GrapplerItem& item, int64_t memory_budget_bytes,
+    const std::function<bool(const NodeDef&)>& is_target,
+    std::unordered_set<string>* nodes_to_recompute) {
+  GraphMemory memory(item);
+  TF_RETURN_IF_ERROR(memory.InferStatically(cluster->GetDevices()));
+  GraphProperties properties(item);
+  TF_RETURN_IF_ERROR(properties.InferStatically(false));
+  ImmutableNodeMap node_map(&item.graph);
+  std::unordered_set<string> feeds;
+  for (const auto& feed : item.feed) {
+    feeds.insert(NodeName(feed.first));
+  }
+  const auto is_persistent = [&feeds](const NodeDef& node) {
+    return IsVariable(node) || IsConstant(node) || IsPlaceholder(node) ||
+           feeds.count(node.name()) > 0;
+  };
+  const auto is_read_by_target = [&node_map, &is_target](const NodeDef& node) {
+    for (const NodeDef* output : node_map.GetOutputs(node.name())) {
+      if (is_target(*output)) return true;
+    }
+    return false;
+  };
+
+  OpLevelCostEstimator estimator;
+  for (const auto& device : cluster->GetDevices()) {
+    const GraphMemory::MemoryUsage& mem_usage =
+        memory.GetPeakMemoryUsage(device.first);
+    if (mem_usage.used_memory <= memory_budget_bytes) {
+      continue;
+    }
+    int64_t required_savings = mem_usage.used_memory - memory_budget_bytes;
+
+    std::unordered_map<const NodeDef*, RecomputeCandidate> candidates;
+    for (const auto& live_tensor : mem_usage.live_tensors) {
+      if (live_tensor.memory_used == 0) {
+        continue;
+      }
+      const NodeDef* node = node_map.GetNode(live_tensor.node);
+      if (node == nullptr) {
+        // Skip nodes inserted by TF (e.g. _Send/_Recv nodes).
+        continue;
+      }
+      if (is_target(*node) || is_persistent(*node) || IsControlFlow(*node) ||
+          !IsFreeOfSideEffect(*node)) {
+        continue;
+      }
+      bool read_by_target = false;
+      for (const NodeDef* output : node_map.GetOutputs(node->name())) {
+        if (!is_target(*output)) continue;
+        for (const string& input : output->input()) {
+          int position;
+          if (ParseNodeName(input, &position) == node->name() &&
+              position == live_tensor.output_id) {
+            read_by_target = true;
+            break;
+          }
+        }
+      }
+      if (!read_by_target) {
+        continue;
+      }
+      RecomputeCandidate& candidate = candidates[node];
+      candidate.node = node;
+      candidate.bytes += live_tensor.memory_used;
+    }
+
+    std::vector<RecomputeCandidate> ordered_candidates;
+    for (auto& entry : candidates) {
+      RecomputeCandidate& candidate = entry.second;
+      const NodeDef& node = *candidate.node;
+      OpContext op_context;
+      op_context.name = node.name();
+      op_context.device_name = node.device();
+      op_context.op_info.set_op(node.op());
+      *op_context.op_info.mutable_attr() = node.attr();
+      *op_context.op_info.mutable_device() = device.second;
+      for (const auto& props : properties.GetInputProperties(node.name())) {
+        *op_context.op_info.add_inputs() = props;
+      }
+      for (const auto& props : properties.GetOutputProperties(node.name())) {
+        *op_context.op_info.add_outputs() = props;
+      }
+      // Recomputing also reads the inputs again, so the memory time counts
+      // as well as the FLOPs.
+      const Costs costs = estimator.PredictCosts(op_context);
+      candidate.compute_ns = costs.execution_time.count();
+      ordered_candidates.push_back(candidate);
+    }
+    std::sort(ordered_candidates.begin(), ordered_candidates.end(),
+              [](const RecomputeCandidate& a, const RecomputeCandidate& b) {
+                const double a_cost = a.compute_ns / a.bytes;
+                const double b_cost = b.compute_ns / b.bytes;
+                return a_cost < b_cost ||
+                       (a_cost == b_cost && a.node->name() < b.node->name());
+              });
+
+    // Selecting a node may make the nodes reading it eligible, so repeat
+    // until nothing more can be selected.
+    bool selected_node = true;
+    while (selected_node && required_savings > 0) {
+      selected_node = false;
+      for (const RecomputeCandidate& candidate : ordered_candidates) {
+        if (required_savings <= 0) break;
+        const NodeDef& node = *candidate.node;
+        if (nodes_to_recompute->count(node.name()) > 0) continue;
+        bool inputs_stay_live = true;
+        for (const string& input_name : node.input()) {
+          const NodeDef* input = node_map.GetNode(input_name);
+          if (IsControlInput(input_name) || input == nullptr) {
+            continue;
+          }
+          if (!is_persistent(*input) && !is_read_by_target(*input) &&
+              nodes_to_recompute->count(input->name()) == 0) {
+            inputs_stay_live = false;
+            break;
+          }
+        }
+        if (!inputs_stay_live) continue;
+        VLOG(1) << "Will recompute " << node.name() << " (" << candidate.bytes
+                << " bytes, " << candidate.compute_ns << "ns) on "
+                << device.first;
+        nodes_to_recompute->insert(node.name());
+        required_savings -= candidate.bytes;
+        selected_node = true;
+      }
+    }
+    if (required_savings > 0) {
+      VLOG(1) << "Recomputation cannot bring the peak memory usage of "
+              << device.first << " under " << memory_budget_bytes
+              << " bytes, " << required_savings << " bytes short";
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Recomputes the heuristically selected nodes, or `budgeted_nodes` instead if
+// it is not null, as well as the manually annotated ones.
+void RecomputationRewritingPass(
+    RewriterConfig::MemOptType optimization_level,
+    const string& recomputation_targets_name_scope,
+    const std::unordered_set<string>* budgeted_nodes, GraphDef* graph,
+    const GrapplerItem& item) {
   // The topological numberings and NodeMap will be stale as soon as we start
   // modifying the graph in RecomputeSubgraph. However, RecomputeSubgraph only
   // looks up nodes which were in the original graph, and preserves the graph
@@ -461,19 +633,22 @@ void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
   }
   std::function<bool(const NodeDef&)> is_target =
       [&recomputation_targets_name_scope](const NodeDef& node) {
-        // Nodes whose inputs we may want to recompute. This matches node names
-        // that contain recomputation_targets_name_scope as a name scope,
-        // meaning it either begins with or contains the name scope.
-        // Defaults to "gradients/" which will match any node names that begins
-        // with "gradients/" or contains "/gradients/".
-        return absl::StartsWith(node.name(),
-                                recomputation_targets_name_scope) ||
-               static_cast<int>(node.name().find(
-                   "/" + recomputation_targets_name_scope)) != -1;
+        return IsRecomputationTarget(recomputation_targets_name_scope, node);
       };
 
-  if (optimization_level == RewriterConfig::RECOMPUTATION_HEURISTICS ||
-      optimization_level == RewriterConfig::HEURISTICS) {
+  if (budgeted_nodes != nullptr &&
+      (optimization_level == RewriterConfig::RECOMPUTATION_HEURISTICS ||
+       optimization_level == RewriterConfig::HEURISTICS)) {
+    recomputed_subgraphs = GetOpGroupsToRecompute(
+        graph, node_map,
+        [budgeted_nodes, &feeds, &is_target](const NodeDef& node) {
+          return !is_target(node) && feeds.count(node.name()) == 0 &&
+                 (budgeted_nodes->count(node.name()) > 0 ||
+                  node.attr().count(kRecomputeHint) > 0);
+        },
+        is_target);
+  } else if (optimization_level == RewriterConfig::RECOMPUTATION_HEURISTICS ||
+             optimization_level == RewriterConfig::HEURISTICS) {
     // TODO(allenl): Handle ResNet-like architectures better. Right now all of
     // the cheap forward ops get grouped into a single subgraph which must
     // execute before gradients start executing (unless layers are manually
@@ -512,8 +687,60 @@ void RecomputationRewritingPass(RewriterConfig::MemOptType optimization_level,
   }
 }
 
+// The shapes inferred for the graph being rewritten by the scheduling and
+// swapping passes. They are inferred once, and then only updated for the nodes
+// each pass adds or modifies, since a pass usually rewrites a small part of
+// the graph.
+class MemoryOptimizerProperties {
+ public:
+  explicit MemoryOptimizerProperties(const GrapplerItem& item) : item_(item) {}
+
+  // Returns the properties of the current graph, inferred with the given
+  // assume_valid_feeds option.
+  Status Get(bool assume_valid_feeds, const GraphProperties** properties) {
+    Slot& slot = slots_[assume_valid_feeds ? 1 : 0];
+    Status s;
+    if (slot.properties == nullptr) {
+      slot.properties = std::make_unique<GraphProperties>(item_);
+      s = slot.properties->InferStatically(
+          assume_valid_feeds, /*aggressive_shape_inference=*/false,
+          /*include_tensor_values=*/false);
+    } else if (!slot.modified_nodes.empty()) {
+      VLOG(2) << "Updating the shapes of " << slot.modified_nodes.size()
+              << " modified nodes";
+      s = slot.properties->UpdateStatically(slot.modified_nodes);
+    }
+    slot.modified_nodes.clear();
+    if (!s.ok()) {
+      slot.properties.reset();
+      return s;
+    }
+    *properties = slot.properties.get();
+    return absl::OkStatus();
+  }
+
+  // Records that a node was added to the graph, or that its op, attributes or
+  // regular inputs were modified.
+  void RecordModifiedNode(const string& node_name) {
+    for (Slot& slot : slots_) {
+      if (slot.properties != nullptr) {
+        slot.modified_nodes.insert(node_name);
+      }
+    }
+  }
+
+ private:
+  struct Slot {
+    std::unique_ptr<GraphProperties> properties;
+    absl::flat_hash_set<string> modified_nodes;
+  };
+
+  const GrapplerItem& item_;
+  Slot slots_[2];
+};
+
 bool SchedulingPass(Cluster* cluster, std::unique_ptr<GraphMemory>* memory_ptr,
-                    GrapplerItem* item) {
+                    MemoryOptimizerProperties* shapes, GrapplerItem* item) {
   // Look for AddN nodes (and equivalent) and record input names.
   MutableGraphView view(&item->graph);
 
@@ -576,14 +803,13 @@ bool SchedulingPass(Cluster* cluster, std::unique_ptr<GraphMemory>* memory_ptr,
   if (addn_to_rewrite.empty()) {
     return false;
   }
-  GraphProperties properties(*item);
-  Status s = properties.InferStatically(/*assume_valid_feeds=*/false,
-                                        /*aggressive_shape_inference=*/false,
-                                        /*include_tensor_values=*/false);
+  const GraphProperties* properties_ptr;
+  Status s = shapes->Get(/*assume_valid_feeds=*/false, &properties_ptr);
   if (!s.ok()) {
     VLOG(1) << "Failed to infer shapes: " << s.message();
     return false;
   }
+  const GraphProperties& properties = *properties_ptr;
 
   // It's ok to use immutable GraphTopologyView here, because we do not destroy
   // any of the nodes in the underlying graph, we only add new nodes.
@@ -734,6 +960,13 @@ bool SchedulingPass(Cluster* cluster, std::unique_ptr<GraphMemory>* memory_ptr,
       *node->add_input() = ctrl_dep;
     }
 
+    shapes->RecordModifiedNode(tmp_var->name());
+    shapes->RecordModifiedNode(zeros->name());
+    shapes->RecordModifiedNode(initialize->name());
+    for (const NodeDef* accum : accumulates) {
+      shapes->RecordModifiedNode(accum->name());
+    }
+    shapes->RecordModifiedNode(node->name());
     updated_graph = true;
   }
 
@@ -1148,7 +1381,8 @@ static bool IdentifySwappingCandidates(
 
 bool SwappingPass(RewriterConfig::MemOptType optimization_level,
                   Cluster* cluster, std::unique_ptr<GraphMemory>* memory,
-                  GrapplerItem* item, std::unordered_set<string>* skip_list) {
+                  MemoryOptimizerProperties* shapes, GrapplerItem* item,
+                  std::unordered_set<string>* skip_list) {
   std::unordered_map<NodeDef*, SwapInfo> nodes_to_swap;
   if (optimization_level == RewriterConfig::DEFAULT_MEM_OPT ||
       optimization_level == RewriterConfig::SWAPPING_HEURISTICS ||
@@ -1178,18 +1412,14 @@ bool SwappingPass(RewriterConfig::MemOptType optimization_level,
   }
 
   // Estimate the size of the data to swap for each node.
-  GraphProperties properties(*item);
-  if (!properties
-           .InferStatically(/*assume_valid_feeds=*/true,
-                            /*aggressive_shape_inference=*/false,
-                            /*include_tensor_values=*/false)
-           .ok()) {
+  const GraphProperties* properties;
+  if (!shapes->Get(/*assume_valid_feeds=*/true, &properties).ok()) {
     return false;
   }
   for (auto& swap : nodes_to_swap) {
     const NodeDef* node = swap.first;
     const std::vector<OpInfo::TensorProperties>& props =
-        properties.GetInputProperties(node->name());
+        properties->GetInputProperties(node->name());
     SwapInfo& swap_info = swap.second;
     int64_t bytes_to_swap = 0;
     for (int64_t input_id : swap_info.inputs_to_swap) {
@@ -1257,6 +1487,9 @@ bool SwappingPass(RewriterConfig::MemOptType optimization_level,
       }
       *swap_nodes.first->add_input() = node->input(input_id);
       *node->mutable_input(input_id) = swap_nodes.second->name();
+      shapes->RecordModifiedNode(swap_nodes.first->name());
+      shapes->RecordModifiedNode(swap_nodes.second->name());
+      shapes->RecordModifiedNode(node->name());
 
       // Add the control dependencies needed to delay the execution of the swap.
       out_trigger->add_input(strings::StrCat("^", swap_nodes.first->name()));
@@ -1395,8 +1628,29 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
   RelaxAssignNodes(nodes_to_relax, &optimized_item.graph);
 
   if (run_recomputation_pass) {
+    // With a memory budget, the nodes to recompute are chosen with the cost
+    // model, which needs fetches to estimate the memory usage.
+    std::unordered_set<string> budgeted_nodes;
+    bool use_budget = false;
+    if (memory_budget_bytes_ > 0 &&
+        optimization_level_ != RewriterConfig::MANUAL && cluster != nullptr &&
+        !item.fetch.empty()) {
+      Status s = FindNodesToRecomputeUnderBudget(
+          cluster, optimized_item, memory_budget_bytes_,
+          [this](const NodeDef& node) {
+            return IsRecomputationTarget(recomputation_targets_name_scope_,
+                                         node);
+          },
+          &budgeted_nodes);
+      if (s.ok()) {
+        use_budget = true;
+      } else {
+        VLOG(1) << "Failed to select nodes to recompute: " << s.message();
+      }
+    }
     RecomputationRewritingPass(optimization_level_,
                                recomputation_targets_name_scope_,
+                               use_budget ? &budgeted_nodes : nullptr,
                                &optimized_item.graph, item);
   }
 
@@ -1406,6 +1660,7 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
   // SchedulingPass() and SwappingPass() rely on defined fetches in order to
   // infer the memory usage, so skip optimization if there are no fetches.
   std::unique_ptr<GraphMemory> memory;
+  MemoryOptimizerProperties shapes(optimized_item);
   if (!item.fetch.empty() && cluster != nullptr) {
     bool updated_graph = true;
     for (int i = 0; i < 25 && updated_graph; ++i) {
@@ -1415,7 +1670,7 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
            optimization_level_ == RewriterConfig::SCHEDULING_HEURISTICS ||
            optimization_level_ == RewriterConfig::HEURISTICS) &&
           cluster != nullptr) {
-        if (SchedulingPass(cluster, &memory, &optimized_item)) {
+        if (SchedulingPass(cluster, &memory, &shapes, &optimized_item)) {
           // Reset the inferred memory usage since the graph changed.
           memory.reset();
           updated_graph = true;
@@ -1428,8 +1683,8 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
            optimization_level_ == RewriterConfig::HEURISTICS ||
            optimization_level_ == RewriterConfig::MANUAL) &&
           cluster != nullptr) {
-        if (SwappingPass(optimization_level_, cluster, &memory, &optimized_item,
-                         &skip_list)) {
+        if (SwappingPass(optimization_level_, cluster, &memory, &shapes,
+                         &optimized_item, &skip_list)) {
           // Reset the inferred memory usage since the graph changed.
           memory.reset();
           updated_graph = true;
@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/costs/graph_memory.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/grappler/utils/grappler_test.h"
@@ -448,6 +449,58 @@ TEST_F(MemoryOptimizerTest, AccumulationRewrites) {
   }
 }
 
+TEST_F(MemoryOptimizerTest, RecomputationUnderBudget) {
+  // `a` and `b` are both kept for backprop and are the same size, but the
+  // MatMul costs far more to recompute than the Relu. `gradients/g2` is
+  // small, so once `b` is recomputed after it, `b` is no longer live at the
+  // peak.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice("/cpu:0");
+  Output x = ops::Variable(s.WithOpName("x"), {256, 256}, DT_FLOAT);
+  Output w = ops::Variable(s.WithOpName("w"), {256, 256}, DT_FLOAT);
+  Output a = ops::MatMul(s.WithOpName("a"), x, w);
+  Output b = ops::Relu(s.WithOpName("b"), a);
+  Output g1 = ops::MatMul(s.WithOpName("gradients/g1"), a, w);
+  Output g2 = ops::Sum(s.WithOpName("gradients/g2"), g1, {0},
+                       ops::Sum::KeepDims(true));
+  Output g3 = ops::MatMul(s.WithOpName("gradients/g3"), g2, b);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"gradients/g3"};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  GraphMemory memory(item);
+  TF_ASSERT_OK(memory.InferStatically(cluster->GetDevices()));
+  const int64_t peak_memory = memory.GetWorstCaseMemoryUsage();
+  ASSERT_GT(peak_memory, 0);
+
+  // The peak already fits in the budget.
+  MemoryOptimizer no_recomputation(RewriterConfig::RECOMPUTATION_HEURISTICS,
+                                   "gradients/", peak_memory);
+  GraphDef output;
+  TF_EXPECT_OK(no_recomputation.Optimize(cluster.get(), item, &output));
+  EXPECT_EQ(item.graph.node_size(), output.node_size());
+
+  // Freeing one activation is enough, and the Relu is the cheaper one to
+  // recompute per byte.
+  const int64_t budget = peak_memory - 1;
+  MemoryOptimizer optimizer(RewriterConfig::RECOMPUTATION_HEURISTICS,
+                            "gradients/", budget);
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+  NodeMap node_map(&output);
+  EXPECT_EQ(nullptr, node_map.GetNode("Recomputed/a"));
+  const NodeDef* recomputed_b = node_map.GetNode("Recomputed/b");
+  ASSERT_NE(nullptr, recomputed_b);
+  EXPECT_EQ("a", recomputed_b->input(0));
+  EXPECT_EQ("Recomputed/b", node_map.GetNode("gradients/g3")->input(1));
+  EXPECT_EQ("a", node_map.GetNode("gradients/g1")->input(0));
+
+  GrapplerItem optimized_item = item.WithGraph(std::move(output));
+  GraphMemory optimized_memory(optimized_item);
+  TF_ASSERT_OK(optimized_memory.InferStatically(cluster->GetDevices()));
+  EXPECT_LE(optimized_memory.GetWorstCaseMemoryUsage(), budget);
+}
+
 class RelaxAllocatorConstraintsTest : public GrapplerTest {};
 
 TEST_F(RelaxAllocatorConstraintsTest, SameDevice) {
@@ -49,6 +49,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/implementation_selector.h"
 #include "tensorflow/core/grappler/optimizers/loop_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/memory_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/meta_optimizer_result_cache.h"
 #include "tensorflow/core/grappler/optimizers/model_pruner.h"
 #include "tensorflow/core/grappler/optimizers/pin_to_host_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/remapper.h"
@@ -62,7 +63,9 @@ limitations under the License.
 #include "tensorflow/core/grappler/verifiers/structure_verifier.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/threadpool.h"
 #include "tensorflow/core/util/dump_graph.h"
 #include "tensorflow/core/util/util.h"
 #include "tensorflow/core/util/xla_config_registry.h"
@@ -218,7 +221,8 @@ std::unique_ptr<GraphOptimizer> MetaOptimizer::MakeNewOptimizer(
          new ConstantFolding(
              cpu_device_,
              cfg_.experimental_disable_compressed_tensor_optimization(),
-             !cfg_.experimental_disable_folding_quantization_emulation()));
+             !cfg_.experimental_disable_folding_quantization_emulation(),
+             cfg_.experimental_constant_folding_store_dir()));
   MK_OPT("shape", "shape_optimization", new ShapeOptimizer());
   MK_OPT("remap", "remapping",
          new Remapper(cfg_.remapping(), cfg_.cpu_layout_conversion(),
@@ -363,7 +367,8 @@ Status MetaOptimizer::InitializeOptimizers(
       optimizers->push_back(std::make_unique<ConstantFolding>(
           cfg_.constant_folding(), cpu_device_,
           cfg_.experimental_disable_compressed_tensor_optimization(),
-          !cfg_.experimental_disable_folding_quantization_emulation()));
+          !cfg_.experimental_disable_folding_quantization_emulation(),
+          cfg_.experimental_constant_folding_store_dir()));
     }
   }
   if (BOTH_NOT_OFF(shape_optimization)) {
@@ -475,11 +480,14 @@ Status MetaOptimizer::InitializeOptimizers(
     if (cfg_.memory_optimizer_target_node_name_scope().empty()) {
       optimizers->push_back(
           // Use the default target node name prefix "gradients/"
-          std::make_unique<MemoryOptimizer>(cfg_.memory_optimization()));
+          std::make_unique<MemoryOptimizer>(
+              cfg_.memory_optimization(), "gradients/",
+              cfg_.memory_optimizer_budget_bytes()));
     } else {
       optimizers->push_back(std::make_unique<MemoryOptimizer>(
           cfg_.memory_optimization(),
-          cfg_.memory_optimizer_target_node_name_scope()));
+          cfg_.memory_optimizer_target_node_name_scope(),
+          cfg_.memory_optimizer_budget_bytes()));
     }
   }
   if (cfg_.auto_parallel().enable() && PLUGIN_IS_ON(auto_parallel)) {
@@ -888,7 +896,10 @@ Status MetaOptimizer::OptimizeGraph(
                                    }) != optimization_result.results.end();
 
   // Record graph optimization result.
-  optimization_results_.push_back(optimization_result);
+  {
+    mutex_lock l(results_mu_);
+    optimization_results_.push_back(optimization_result);
+  }
 
   if (is_optimized) {
     TF_RETURN_IF_ERROR(TopologicalSort(optimized_graph));
@@ -1055,7 +1066,10 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
       {kGrapplerCategory, "*"});
 
   VLOG(1) << "Starting optimization for grappler item: " << item.id;
-  optimization_results_.clear();
+  {
+    mutex_lock l(results_mu_);
+    optimization_results_.clear();
+  }
 
   // Constructs a FunctionLibraryDefinition with functions that are reachable
   // from the nodes of the graph.
@@ -1166,13 +1180,13 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
 
   // Optimize each function only once.
   absl::flat_hash_set<string> optimized_funcs;
+  const int num_threads = cfg_.experimental_function_optimization_threads();
   while (optimize_function_library) {
     optimize_function_library = false;
 
-    int function_idx = 0;
+    // Functions to optimize in this pass over the library.
+    std::vector<const FunctionDef*> funcs;
     for (const FunctionDef& func : optimized_graph->library().function()) {
-      GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
-
       const string& func_name = func.signature().name();
 
       // Skip functions that are not reachable from the optimized graph.
@@ -1192,87 +1206,73 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
       // and in function instantiation.
       if (data::IsTFDataFunction(func)) continue;
 
-      VLOG(3) << "Optimize function: function=" << func_name << " ["
-              << function_idx++ << " of "
-              << optimized_graph->library().function_size() << "]";
-
       // Function optimization might specialize nested function calls, so we
       // have to reset the flag and do at least one more pass over the library.
       optimize_function_library = true;
       optimized_funcs.insert(func_name);
+      funcs.push_back(&func);
+    }
 
-      // Make a GrapplerItem from a FunctionDef.
-      GrapplerFunctionItem func_item;
-      TF_RETURN_IF_ERROR(
-          MakeGrapplerFunctionItem(func, flib, producer, &func_item));
-
-      // If we need to compute the gradient of optimized function at runtime, we
-      // can't perform non-differentiable rewrites.
-      func_item.optimization_options().allow_non_differentiable_rewrites =
-          !differentiable_functions.contains(func_name);
-
-      // Device set available to the function is defined only by the runtime,
-      // when we instantiate and execute the function. We can't use all devices
-      // available to the main graph, because after partitioning the function
-      // call node might execute on a remote worker.
-      if (!func_item.devices().empty()) {
-        return errors::Internal("GrapplerFunctionItem devices must be empty.");
+    if (num_threads > 1 && funcs.size() > 1) {
+      // Optimize the functions concurrently against the library as it was at
+      // the start of this pass, then merge the results in library order so
+      // that the outcome does not depend on scheduling.
+      std::vector<FunctionDef> optimized(funcs.size());
+      std::vector<FunctionDefLibrary> new_functions(funcs.size());
+      std::vector<Status> statuses(funcs.size());
+      VLOG(3) << "Optimize " << funcs.size() << " functions on " << num_threads
+              << " threads";
+      {
+        thread::ThreadPool pool(Env::Default(), "grappler_function_optimizer",
+                                std::min<int>(num_threads, funcs.size()));
+        for (int i = 0; i < funcs.size(); ++i) {
+          pool.Schedule([&, i]() {
+            if (DeadlineExceeded()) {
+              statuses[i] = absl::DeadlineExceededError(
+                  absl::StrCat(name(), " exceeded deadline."));
+              return;
+            }
+            statuses[i] = OptimizeFunction(
+                cluster, *funcs[i], flib, producer,
+                !differentiable_functions.contains(
+                    funcs[i]->signature().name()),
+                is_tpu_graph, &optimized[i], &new_functions[i]);
+          });
+        }
       }
-
-      // We are not allowed to prune certain types of ops from the graph
-      // instantiated by the function definition, because we must guarantee
-      // function execution semantics wrt side effects (see
-      // function_optimizer.cc).
-      func_item.optimization_options().allow_pruning_stateful_and_dataset_ops =
-          false;
-
-      // Optimize function body graph.
-      GraphDef optimized_func_graph;
-      if (is_tpu_graph) {
-        // Skip optimizing functions if this is a TPU graph. Currently, Grappler
-        // passes do not handle TPU functions correctly in a variety of ways
-        // (Note that due to the pre-placement TPU graph rewriting passes, the
-        // TPU-related ops are encapsulated away into functions). For example,
-        // TPU graphs contain TPUReplicateMetadata node that carries relevant
-        // TPU metadata and Grappler passes could prune that away. Grappler
-        // passes could also cause issues around shape inference. Since the
-        // desired and existing behavior is to not optimize TPU functions with
-        // Grappler, this check preserves that. The only exception is
-        // implementation selector what is required to swap in some TPU specific
-        // lowering code and is verified the work correctly on TPUs.
-        ImplementationSelector implementation_selector;
-
-        // Implementation selector needs to have access to valid function
-        // signature and attributes, and it doesn't need actual function body.
-        std::unique_ptr<FunctionDefLibrary> func_item_function_library(
-            func_item.graph.release_library());
-        *func_item.graph.mutable_library() =
-            GetFunctionDefLibraryStub(*func_item_function_library);
-
-        TF_RETURN_IF_ERROR(implementation_selector.Optimize(
-            cluster, func_item, &optimized_func_graph));
-      } else {
-        GrapplerFunctionItem func_item_copy = func_item;
-        TF_RETURN_IF_ERROR(OptimizeGraph(cluster, std::move(func_item_copy),
-                                         &optimized_func_graph));
+      for (int i = 0; i < funcs.size(); ++i) {
+        TF_RETURN_IF_ERROR(statuses[i]);
+        for (const FunctionDef& func_def : new_functions[i].function()) {
+          if (flib.Find(func_def.signature().name()) == nullptr) {
+            TF_RETURN_IF_ERROR(flib.AddFunctionDef(func_def));
+          }
+        }
+        TF_RETURN_IF_ERROR(
+            flib.ReplaceFunction(funcs[i]->signature().name(), optimized[i]));
       }
-
-      // Function body optimization might have created new specialized
-      // functions for each instantiation context. Add them to the library.
-      for (const FunctionDef& func_def :
-           optimized_func_graph.library().function()) {
-        if (flib.Find(func_def.signature().name()) == nullptr) {
-          TF_RETURN_IF_ERROR(flib.AddFunctionDef(func_def));
+    } else {
+      for (int i = 0; i < funcs.size(); ++i) {
+        GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
+        const string& func_name = funcs[i]->signature().name();
+        VLOG(3) << "Optimize function: function=" << func_name << " [" << i
+                << " of " << funcs.size() << "]";
+
+        FunctionDef optimized_func;
+        FunctionDefLibrary new_functions;
+        TF_RETURN_IF_ERROR(OptimizeFunction(
+            cluster, *funcs[i], flib, producer,
+            !differentiable_functions.contains(func_name), is_tpu_graph,
+            &optimized_func, &new_functions));
+
+        // Later functions see the specialized functions and the optimized
+        // body of this one.
+        for (const FunctionDef& func_def : new_functions.function()) {
+          if (flib.Find(func_def.signature().name()) == nullptr) {
+            TF_RETURN_IF_ERROR(flib.AddFunctionDef(func_def));
+          }
         }
+        TF_RETURN_IF_ERROR(flib.ReplaceFunction(func_name, optimized_func));
       }
-
-      // Convert optimized graph back to FunctionDef.
-      FunctionDef optimized_func;
-      func_item.SwapFunctionBody(std::move(optimized_func_graph));
-      TF_RETURN_IF_ERROR(MakeFunctionDef(func_item, flib, &optimized_func));
-
-      // Replace optimized function with a new FunctionDef.
-      TF_RETURN_IF_ERROR(flib.ReplaceFunction(func_name, optimized_func));
     }
 
     // If optimized at least one function, update the graph library.
@@ -1319,8 +1319,96 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
   return absl::OkStatus();
 }
 
+Status MetaOptimizer::OptimizeFunction(
+    Cluster* cluster, const FunctionDef& func,
+    const FunctionLibraryDefinition& flib, int producer,
+    bool allow_non_differentiable_rewrites, bool is_tpu_graph,
+    FunctionDef* optimized_func, FunctionDefLibrary* new_functions) {
+  // Make a GrapplerItem from a FunctionDef.
+  GrapplerFunctionItem func_item;
+  TF_RETURN_IF_ERROR(
+      MakeGrapplerFunctionItem(func, flib, producer, &func_item));
+
+  // If we need to compute the gradient of optimized function at runtime, we
+  // can't perform non-differentiable rewrites.
+  func_item.optimization_options().allow_non_differentiable_rewrites =
+      allow_non_differentiable_rewrites;
+
+  // Device set available to the function is defined only by the runtime,
+  // when we instantiate and execute the function. We can't use all devices
+  // available to the main graph, because after partitioning the function
+  // call node might execute on a remote worker.
+  if (!func_item.devices().empty()) {
+    return errors::Internal("GrapplerFunctionItem devices must be empty.");
+  }
+
+  // We are not allowed to prune certain types of ops from the graph
+  // instantiated by the function definition, because we must guarantee
+  // function execution semantics wrt side effects (see
+  // function_optimizer.cc).
+  func_item.optimization_options().allow_pruning_stateful_and_dataset_ops =
+      false;
+
+  // Optimize function body graph.
+  GraphDef optimized_func_graph;
+  if (is_tpu_graph) {
+    // Skip optimizing functions if this is a TPU graph. Currently, Grappler
+    // passes do not handle TPU functions correctly in a variety of ways
+    // (Note that due to the pre-placement TPU graph rewriting passes, the
+    // TPU-related ops are encapsulated away into functions). For example,
+    // TPU graphs contain TPUReplicateMetadata node that carries relevant
+    // TPU metadata and Grappler passes could prune that away. Grappler
+    // passes could also cause issues around shape inference. Since the
+    // desired and existing behavior is to not optimize TPU functions with
+    // Grappler, this check preserves that. The only exception is
+    // implementation selector what is required to swap in some TPU specific
+    // lowering code and is verified the work correctly on TPUs.
+    ImplementationSelector implementation_selector;
+
+    // Implementation selector needs to have access to valid function
+    // signature and attributes, and it doesn't need actual function body.
+    std::unique_ptr<FunctionDefLibrary> func_item_function_library(
+        func_item.graph.release_library());
+    *func_item.graph.mutable_library() =
+        GetFunctionDefLibraryStub(*func_item_function_library);
+
+    TF_RETURN_IF_ERROR(implementation_selector.Optimize(
+        cluster, func_item, &optimized_func_graph));
+  } else {
+    GrapplerFunctionItem func_item_copy = func_item;
+    TF_RETURN_IF_ERROR(OptimizeGraph(cluster, std::move(func_item_copy),
+                                     &optimized_func_graph));
+  }
+
+  // Function body optimization might have created new specialized
+  // functions for each instantiation context. Return them to the caller.
+  for (const FunctionDef& func_def :
+       optimized_func_graph.library().function()) {
+    if (flib.Find(func_def.signature().name()) == nullptr) {
+      *new_functions->add_function() = func_def;
+    }
+  }
+
+  // Convert optimized graph back to FunctionDef, resolving calls to the new
+  // functions as well as to those in `flib`.
+  FunctionLibraryDefinition func_flib(&flib, *new_functions);
+  func_item.SwapFunctionBody(std::move(optimized_func_graph));
+  return MakeFunctionDef(func_item, func_flib, optimized_func);
+}
+
+bool MetaOptimizer::AllOptimizersSucceeded() const {
+  tf_shared_lock l(results_mu_);
+  for (const GraphOptimizationResult& graph_result : optimization_results_) {
+    for (const OptimizerResult& result : graph_result.results) {
+      if (!result.status.ok()) return false;
+    }
+  }
+  return true;
+}
+
 string MetaOptimizer::GetResultString() const {
   std::string result_string;
+  tf_shared_lock l(results_mu_);
   for (const GraphOptimizationResult& graph_result : optimization_results_) {
     absl::StrAppend(&result_string,
                     "Optimization results for grappler item: ", graph_result.id,
@@ -1369,11 +1457,36 @@ bool MetaOptimizerEnabled(const ConfigProto& cfg) {
 Status RunMetaOptimizer(GrapplerItem&& item, const ConfigProto& cfg,
                         DeviceBase* cpu_device, Cluster* cluster,
                         GraphDef* optimized_graph) {
+  MetaOptimizerResultCache* cache = MetaOptimizerResultCache::ForConfig(
+      cfg.graph_options().rewrite_options());
+  string cache_key;
+  GraphDef cached_graph;
+  bool cache_hit = false;
+  if (cache != nullptr) {
+    cache_key = MetaOptimizerResultCache::ComputeKey(item, cfg, cluster);
+    cache_hit = cache->Lookup(cache_key, &cached_graph);
+    if (cache_hit && !cache->validate()) {
+      *optimized_graph = std::move(cached_graph);
+      return absl::OkStatus();
+    }
+  }
+
   MetaOptimizer optimizer(cpu_device, cfg);
   optimizer.set_deadline_usec(
       DeadlineMicroSeconds(cfg.graph_options().rewrite_options()));
-  return optimizer.OptimizeConsumeItem(cluster, std::move(item),
-                                       optimized_graph);
+  TF_RETURN_IF_ERROR(optimizer.OptimizeConsumeItem(cluster, std::move(item),
+                                                   optimized_graph));
+  // Results of runs in which an optimizer failed or ran out of time may be
+  // incomplete, so they are not cached.
+  if (cache == nullptr || !optimizer.AllOptimizersSucceeded()) {
+    return absl::OkStatus();
+  }
+  if (cache_hit) {
+    cache->Validate(cache_key, cached_graph, *optimized_graph);
+  } else {
+    cache->Insert(cache_key, *optimized_graph);
+  }
+  return absl::OkStatus();
 }
 
 Status OptimizeGraph(
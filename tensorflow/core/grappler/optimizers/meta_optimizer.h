@@ -24,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
 #include "tensorflow/core/grappler/verifiers/graph_verifier.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tensorflow/core/protobuf/rewriter_config.pb.h"
 #include "tensorflow/core/protobuf/verifier_config.pb.h"
@@ -52,6 +53,10 @@ class MetaOptimizer : public GraphOptimizer {
 
   string GetResultString() const;
 
+  // Returns true if no optimizer failed, e.g. by running out of time, in the
+  // last call to OptimizeConsumeItem.
+  bool AllOptimizersSucceeded() const;
+
   void PrintResult();
 
  private:
@@ -97,6 +102,17 @@ class MetaOptimizer : public GraphOptimizer {
   Status OptimizeGraph(Cluster* cluster, GrapplerItem&& item,
                        GraphDef* optimized_graph);
 
+  // Optimizes the body of the library function `func`, resolving the
+  // functions it calls in `flib`.  Sets `optimized_func` to the result and
+  // adds the specialized functions created for it that are not in `flib` to
+  // `new_functions`.  Does not modify `flib`, so it may run concurrently for
+  // different functions.
+  Status OptimizeFunction(Cluster* cluster, const FunctionDef& func,
+                          const FunctionLibraryDefinition& flib, int producer,
+                          bool allow_non_differentiable_rewrites,
+                          bool is_tpu_graph, FunctionDef* optimized_func,
+                          FunctionDefLibrary* new_functions);
+
   DeviceBase* const cpu_device_;  // may be NULL
   ConfigProto config_proto_;
   RewriterConfig& cfg_;
@@ -118,7 +134,10 @@ class MetaOptimizer : public GraphOptimizer {
                       GrapplerItem* optimized_item, GraphDef* optimized_graph,
                       GraphOptimizationResult* optimization_result);
 
-  std::vector<GraphOptimizationResult> optimization_results_;
+  // Functions of the library may be optimized concurrently.
+  mutable mutex results_mu_;
+  std::vector<GraphOptimizationResult> optimization_results_
+      TF_GUARDED_BY(results_mu_);
 };
 
 bool MetaOptimizerEnabled(const ConfigProto& cfg);
@@ -0,0 +1,391 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/meta_optimizer_result_cache.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/file_statistics.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/platform/raw_coding.h"
+#include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/util.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+auto* meta_optimizer_result_cache_counter = monitoring::Counter<1>::New(
+    "/tensorflow/core/grappler/meta_optimizer_result_cache",
+    "Number of MetaOptimizer result cache lookups and updates, by outcome: "
+    "hit, miss, corrupt, write_error, validation_mismatch or evicted.",
+    "outcome");
+
+constexpr char kMagic[] = "TFGMORC1";
+constexpr size_t kMagicSize = sizeof(kMagic) - 1;
+constexpr size_t kKeySize = 32;
+// Magic, key, payload size and payload fingerprint.
+constexpr size_t kHeaderSize = kMagicSize + kKeySize + 8 + 16;
+constexpr char kEntrySuffix[] = ".graph";
+// Bump to invalidate entries written by older versions of this file.
+constexpr char kKeyVersion[] = "2";
+constexpr int64_t kDefaultMaxBytes = 1LL << 30;
+
+void CountOutcome(const char* outcome) {
+  meta_optimizer_result_cache_counter->GetCell(outcome)->IncrementBy(1);
+}
+
+// Accumulates the fingerprints of the pieces of a key.  Fingerprinting each
+// piece separately keeps piece boundaries unambiguous without copying the
+// serialized graph.
+class KeyBuilder {
+ public:
+  void Add(StringPiece piece) {
+    const Fprint128 fp = Fingerprint128(piece);
+    core::PutFixed64(&digests_, fp.low64);
+    core::PutFixed64(&digests_, fp.high64);
+  }
+
+  void Add(const protobuf::MessageLite& proto) {
+    string serialized;
+    SerializeToStringDeterministic(proto, &serialized);
+    Add(serialized);
+  }
+
+  void Add(int64_t value) { Add(absl::StrCat(value)); }
+
+  void AddSorted(std::vector<string> strings) {
+    std::sort(strings.begin(), strings.end());
+    Add(static_cast<int64_t>(strings.size()));
+    for (const string& s : strings) Add(s);
+  }
+
+  string Finish() const {
+    const Fprint128 fp = Fingerprint128(digests_);
+    return absl::StrCat(absl::Hex(fp.high64, absl::kZeroPad16),
+                        absl::Hex(fp.low64, absl::kZeroPad16));
+  }
+
+ private:
+  string digests_;
+};
+
+string PayloadFingerprint(StringPiece payload) {
+  const Fprint128 fp = Fingerprint128(payload);
+  string result;
+  core::PutFixed64(&result, fp.low64);
+  core::PutFixed64(&result, fp.high64);
+  return result;
+}
+
+}  // namespace
+
+MetaOptimizerResultCache::MetaOptimizerResultCache(Env* env,
+                                                   const string& dir,
+                                                   int64_t max_bytes,
+                                                   bool validate)
+    : env_(env), dir_(dir), max_bytes_(max_bytes), validate_(validate) {}
+
+MetaOptimizerResultCache* MetaOptimizerResultCache::ForConfig(
+    const RewriterConfig& cfg) {
+  const string& dir = cfg.experimental_meta_optimizer_result_cache_dir();
+  if (dir.empty()) return nullptr;
+  const int64_t max_bytes =
+      cfg.experimental_meta_optimizer_result_cache_max_bytes() > 0
+          ? cfg.experimental_meta_optimizer_result_cache_max_bytes()
+          : kDefaultMaxBytes;
+  const bool validate = cfg.experimental_meta_optimizer_result_cache_validate();
+
+  using CacheKey = std::tuple<string, int64_t, bool>;
+  static mutex* mu = new mutex;
+  static auto* caches =
+      new std::map<CacheKey, std::unique_ptr<MetaOptimizerResultCache>>;
+  mutex_lock l(*mu);
+  std::unique_ptr<MetaOptimizerResultCache>& cache =
+      (*caches)[CacheKey(dir, max_bytes, validate)];
+  if (cache == nullptr) {
+    LOG(INFO) << "Caching MetaOptimizer results in " << dir << " up to "
+              << max_bytes << " bytes" << (validate ? " with validation" : "");
+    cache = std::make_unique<MetaOptimizerResultCache>(Env::Default(), dir,
+                                                       max_bytes, validate);
+  }
+  return cache.get();
+}
+
+string MetaOptimizerResultCache::ComputeKey(const GrapplerItem& item,
+                                            const ConfigProto& cfg,
+                                            const Cluster* cluster) {
+  KeyBuilder key;
+  key.Add(kKeyVersion);
+  key.Add(TF_VERSION_STRING);
+  key.Add(TF_GRAPH_DEF_VERSION);
+
+  // The graph, including its function library.
+  key.Add(item.graph);
+
+  // Feeds are keyed by name and value, since grappler may use fed values to
+  // infer shapes.
+  key.Add(static_cast<int64_t>(item.feed.size()));
+  for (const auto& feed : item.feed) {
+    key.Add(feed.first);
+    TensorProto value;
+    feed.second.AsProtoTensorContent(&value);
+    key.Add(value);
+  }
+  key.AddSorted(item.fetch);
+  key.AddSorted(item.init_ops);
+  key.AddSorted(item.keep_ops);
+  key.Add(item.save_op);
+  key.Add(item.restore_op);
+  key.Add(item.save_restore_loc_tensor);
+  key.Add(static_cast<int64_t>(item.queue_runners.size()));
+  for (const QueueRunnerDef& queue_runner : item.queue_runners) {
+    key.Add(queue_runner);
+  }
+  key.AddSorted(
+      std::vector<string>(item.devices().begin(), item.devices().end()));
+
+  const GrapplerItem::OptimizationOptions& options =
+      item.optimization_options();
+  key.Add(absl::StrCat(options.allow_non_differentiable_rewrites, ",",
+                       options.allow_pruning_stateful_and_dataset_ops, ",",
+                       options.optimize_function_library, ",",
+                       options.is_eager_mode, ",",
+                       options.intra_op_parallelism_threads));
+
+  // Only the parts of the config that the optimizers read.  The rest, e.g.
+  // the device filters, differs between the tasks of a job.  The settings of
+  // this cache do not change the result.
+  GraphOptions graph_options = cfg.graph_options();
+  RewriterConfig* rewrite_options = graph_options.mutable_rewrite_options();
+  rewrite_options->clear_experimental_meta_optimizer_result_cache_dir();
+  rewrite_options->clear_experimental_meta_optimizer_result_cache_max_bytes();
+  rewrite_options->clear_experimental_meta_optimizer_result_cache_validate();
+  key.Add(graph_options);
+  key.Add(cfg.experimental().executor_type());
+  key.Add(cfg.experimental().use_tfrt());
+
+  std::vector<string> cluster_devices;
+  if (cluster != nullptr) {
+    for (const auto& device : cluster->GetDevices()) {
+      string properties;
+      SerializeToStringDeterministic(device.second, &properties);
+      cluster_devices.push_back(absl::StrCat(device.first, "\n", properties));
+    }
+  }
+  key.AddSorted(std::move(cluster_devices));
+
+  key.AddSorted(CustomGraphOptimizerRegistry::GetRegisteredOptimizers());
+
+  // The oneDNN rewrites in the remapper and auto mixed precision depend on
+  // these, which differ between the hosts of a heterogeneous job.
+  string onednn = IsMKLEnabled() ? "onednn" : "no_onednn";
+  for (DataType dtype : {DT_BFLOAT16, DT_HALF, DT_QINT8}) {
+    absl::StrAppend(&onednn, ",", DataTypeString(dtype), ":",
+                    IsDataTypeSupportedByOneDNNOnThisCPU(dtype), ":",
+                    IsAMXDataTypeSupportedByOneDNNOnThisCPU(dtype));
+  }
+  key.Add(onednn);
+  return key.Finish();
+}
+
+string MetaOptimizerResultCache::EntryPath(const string& key) const {
+  return io::JoinPath(dir_, absl::StrCat(key, kEntrySuffix));
+}
+
+Status MetaOptimizerResultCache::ReadEntry(const string& path,
+                                           const string& key,
+                                           GraphDef* graph) {
+  string contents;
+  TF_RETURN_IF_ERROR(ReadFileToString(env_, path, &contents));
+  if (contents.size() < kHeaderSize ||
+      StringPiece(contents).substr(0, kMagicSize) != kMagic) {
+    return errors::DataLoss("Bad header in ", path);
+  }
+  StringPiece header(contents.data() + kMagicSize, kHeaderSize - kMagicSize);
+  StringPiece entry_key = header.substr(0, kKeySize);
+  if (!key.empty() && entry_key != key) {
+    return errors::DataLoss("Key mismatch in ", path);
+  }
+  if (key.empty() &&
+      io::Basename(path) != absl::StrCat(entry_key, kEntrySuffix)) {
+    return errors::DataLoss("Entry ", path, " is not named after its key");
+  }
+  const uint64 payload_size = core::DecodeFixed64(header.data() + kKeySize);
+  StringPiece payload_fp = header.substr(kKeySize + 8);
+  StringPiece payload(contents.data() + kHeaderSize,
+                      contents.size() - kHeaderSize);
+  if (payload.size() != payload_size ||
+      PayloadFingerprint(payload) != payload_fp) {
+    return errors::DataLoss("Bad payload in ", path);
+  }
+  if (!graph->ParseFromArray(payload.data(), payload.size())) {
+    return errors::DataLoss("Cannot parse GraphDef in ", path);
+  }
+  return absl::OkStatus();
+}
+
+bool MetaOptimizerResultCache::Lookup(const string& key, GraphDef* graph) {
+  const string path = EntryPath(key);
+  if (!env_->FileExists(path).ok()) {
+    CountOutcome("miss");
+    return false;
+  }
+  Status s = ReadEntry(path, key, graph);
+  if (errors::IsNotFound(s)) {
+    // Evicted by another process since the check above.
+    CountOutcome("miss");
+    graph->Clear();
+    return false;
+  }
+  if (!s.ok()) {
+    // A concurrent writer only ever renames complete entries into place, so
+    // the entry is damaged.
+    LOG(WARNING) << "Dropping MetaOptimizer result cache entry: " << s;
+    CountOutcome("corrupt");
+    env_->DeleteFile(path).IgnoreError();
+    graph->Clear();
+    return false;
+  }
+  VLOG(1) << "MetaOptimizer result cache hit: " << path;
+  CountOutcome("hit");
+  return true;
+}
+
+void MetaOptimizerResultCache::Insert(const string& key,
+                                      const GraphDef& graph) {
+  string payload;
+  if (!SerializeToStringDeterministic(graph, &payload)) {
+    LOG(WARNING) << "Cannot serialize the optimized graph for caching";
+    CountOutcome("write_error");
+    return;
+  }
+  string contents(kMagic);
+  contents.append(key);
+  core::PutFixed64(&contents, payload.size());
+  contents.append(PayloadFingerprint(payload));
+  contents.append(payload);
+
+  const string path = EntryPath(key);
+  const string tmp_path = absl::StrCat(path, ".tmp.", random::New64());
+  Status s = env_->RecursivelyCreateDir(dir_);
+  if (s.ok()) s = WriteStringToFile(env_, tmp_path, contents);
+  if (s.ok()) s = env_->RenameFile(tmp_path, path);
+  if (!s.ok()) {
+    LOG(WARNING) << "Cannot write MetaOptimizer result cache entry " << path
+                 << ": " << s;
+    CountOutcome("write_error");
+    env_->DeleteFile(tmp_path).IgnoreError();
+    return;
+  }
+  EvictEntries(path);
+}
+
+void MetaOptimizerResultCache::EvictEntries(const string& keep_path) {
+  std::vector<string> children;
+  if (!env_->GetChildren(dir_, &children).ok()) return;
+  struct Entry {
+    int64_t mtime_nsec;
+    int64_t length;
+    string path;
+  };
+  std::vector<Entry> entries;
+  int64_t total_bytes = 0;
+  for (const string& child : children) {
+    if (!absl::EndsWith(child, kEntrySuffix)) continue;
+    Entry entry;
+    entry.path = io::JoinPath(dir_, child);
+    FileStatistics stat;
+    // Entries may be evicted concurrently by other processes.
+    if (!env_->Stat(entry.path, &stat).ok()) continue;
+    entry.mtime_nsec = stat.mtime_nsec;
+    entry.length = stat.length;
+    total_bytes += stat.length;
+    entries.push_back(std::move(entry));
+  }
+  if (total_bytes <= max_bytes_) return;
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.mtime_nsec < b.mtime_nsec;
+            });
+  for (const Entry& entry : entries) {
+    if (total_bytes <= max_bytes_) break;
+    if (entry.path == keep_path) continue;
+    total_bytes -= entry.length;
+    if (env_->DeleteFile(entry.path).ok()) CountOutcome("evicted");
+  }
+}
+
+bool MetaOptimizerResultCache::Validate(const string& key,
+                                        const GraphDef& cached,
+                                        const GraphDef& graph) {
+  string cached_serialized, serialized;
+  SerializeToStringDeterministic(cached, &cached_serialized);
+  SerializeToStringDeterministic(graph, &serialized);
+  if (cached_serialized == serialized) return true;
+  LOG(ERROR) << "MetaOptimizer result cache entry " << EntryPath(key)
+             << " differs from a fresh optimization; replacing it. The cache "
+                "key misses an input of the optimizers, or they are not "
+                "deterministic.";
+  CountOutcome("validation_mismatch");
+  Insert(key, graph);
+  return false;
+}
+
+Status MetaOptimizerResultCache::ValidateEntries(int* num_valid,
+                                                 int* num_deleted) {
+  std::vector<string> children;
+  TF_RETURN_IF_ERROR(env_->GetChildren(dir_, &children));
+  int valid = 0, deleted = 0;
+  for (const string& child : children) {
+    if (!absl::EndsWith(child, kEntrySuffix)) continue;
+    const string path = io::JoinPath(dir_, child);
+    GraphDef graph;
+    Status s = ReadEntry(path, /*key=*/"", &graph);
+    if (s.ok()) {
+      ++valid;
+      continue;
+    }
+    LOG(WARNING) << "Deleting MetaOptimizer result cache entry: " << s;
+    CountOutcome("corrupt");
+    TF_RETURN_IF_ERROR(env_->DeleteFile(path));
+    ++deleted;
+  }
+  if (num_valid != nullptr) *num_valid = valid;
+  if (num_deleted != nullptr) *num_deleted = deleted;
+  return absl::OkStatus();
+}
+
+}  // namespace grappler
+}  // namespace tensorflow
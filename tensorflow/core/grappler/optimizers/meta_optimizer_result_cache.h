@@ -0,0 +1,115 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_META_OPTIMIZER_RESULT_CACHE_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_META_OPTIMIZER_RESULT_CACHE_H_
+
+#include <string>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// A content-addressed, on-disk cache of MetaOptimizer results, shared by all
+// processes that point at the same directory.  Identical jobs, e.g. the
+// tasks of a data-parallel job or restarts of a job, then optimize each
+// graph only once.
+//
+// Entries are keyed by a fingerprint of everything the MetaOptimizer output
+// depends on: the input graph and its function library, the feeds, fetches
+// and other nodes to preserve, the optimization options, the GraphOptions of
+// the session config, the devices of the item and the cluster, the
+// registered custom optimizers and the TensorFlow version.  The oneDNN
+// rewrites, e.g. the bf16 auto mixed precision and the remapper fusions,
+// also depend on whether oneDNN is enabled (TF_ENABLE_ONEDNN_OPTS) and on
+// the data types the CPU supports, so these are part of the key too.  Other
+// environment variables read by individual optimizers are not.
+//
+// Each entry is a file named after the hex key, holding a header with the
+// key and a fingerprint of the payload followed by the optimized GraphDef.
+// Entries are written to a temporary file and renamed into place, so
+// readers never see partial entries.  Entries that fail the header check
+// are deleted and treated as misses.  Once the entries total more than
+// `max_bytes`, each insert deletes the least recently written ones.
+class MetaOptimizerResultCache {
+ public:
+  // `dir` is created on the first insert.  If `validate` is true, callers
+  // are expected to recompute the result on hits and call Validate.
+  MetaOptimizerResultCache(Env* env, const string& dir, int64_t max_bytes,
+                           bool validate);
+
+  // Returns the cache configured by
+  // `experimental_meta_optimizer_result_cache_dir` and the related fields of
+  // `cfg`, or nullptr if caching is off.  Caches are shared by all sessions
+  // with the same settings.
+  static MetaOptimizerResultCache* ForConfig(const RewriterConfig& cfg);
+
+  // Returns the key of optimizing `item` with `cfg` on `cluster`, which may
+  // be null.
+  static string ComputeKey(const GrapplerItem& item, const ConfigProto& cfg,
+                           const Cluster* cluster);
+
+  // Returns true and fills `graph` if an intact entry for `key` exists.
+  bool Lookup(const string& key, GraphDef* graph);
+
+  // Stores `graph` under `key`, replacing any existing entry.  Failures are
+  // logged and counted, never returned.
+  void Insert(const string& key, const GraphDef& graph);
+
+  // Compares a freshly computed `graph` against the hit `cached` for `key`.
+  // On mismatch, logs, counts and replaces the entry with `graph`.  Returns
+  // whether they matched.
+  bool Validate(const string& key, const GraphDef& cached,
+                const GraphDef& graph);
+
+  // Checks the header of every entry in the directory, deleting those that
+  // are corrupt.  Sets `num_valid` and `num_deleted` if not null.
+  Status ValidateEntries(int* num_valid, int* num_deleted);
+
+  bool validate() const { return validate_; }
+  const string& dir() const { return dir_; }
+  int64_t max_bytes() const { return max_bytes_; }
+
+ private:
+  string EntryPath(const string& key) const;
+
+  // Deletes the least recently written entries other than `keep_path` until
+  // the rest fit in `max_bytes_`.
+  void EvictEntries(const string& keep_path);
+
+  // Reads the entry at `path` and checks its header against `key`, or
+  // against the key in the file name if `key` is empty.
+  Status ReadEntry(const string& path, const string& key, GraphDef* graph);
+
+  Env* const env_;
+  const string dir_;
+  const int64_t max_bytes_;
+  const bool validate_;
+
+  MetaOptimizerResultCache(const MetaOptimizerResultCache&) = delete;
+  void operator=(const MetaOptimizerResultCache&) = delete;
+};
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_META_OPTIMIZER_RESULT_CACHE_H_
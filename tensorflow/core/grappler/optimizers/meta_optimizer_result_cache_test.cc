@@ -0,0 +1,209 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/meta_optimizer_result_cache.h"
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class MetaOptimizerResultCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = io::JoinPath(testing::TmpDir(),
+                        ::testing::UnitTest::GetInstance()
+                            ->current_test_info()
+                            ->name());
+    cache_ = std::make_unique<MetaOptimizerResultCache>(
+        Env::Default(), dir_, /*max_bytes=*/1 << 20, /*validate=*/false);
+    TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+    ASSERT_TRUE(fake_input.NextItem(&item_));
+  }
+
+  void TearDown() override {
+    int64_t undeleted_files, undeleted_dirs;
+    Env::Default()
+        ->DeleteRecursively(dir_, &undeleted_files, &undeleted_dirs)
+        .IgnoreError();
+  }
+
+  string dir_;
+  std::unique_ptr<MetaOptimizerResultCache> cache_;
+  GrapplerItem item_;
+};
+
+TEST_F(MetaOptimizerResultCacheTest, InsertAndLookup) {
+  const string key =
+      MetaOptimizerResultCache::ComputeKey(item_, ConfigProto(), nullptr);
+  GraphDef graph;
+  EXPECT_FALSE(cache_->Lookup(key, &graph));
+
+  cache_->Insert(key, item_.graph);
+  ASSERT_TRUE(cache_->Lookup(key, &graph));
+  EXPECT_EQ(item_.graph.DebugString(), graph.DebugString());
+
+  // Another cache on the same directory, as in another process.
+  MetaOptimizerResultCache other(Env::Default(), dir_, /*max_bytes=*/1 << 20,
+                                 /*validate=*/false);
+  GraphDef other_graph;
+  ASSERT_TRUE(other.Lookup(key, &other_graph));
+  EXPECT_EQ(item_.graph.DebugString(), other_graph.DebugString());
+}
+
+TEST_F(MetaOptimizerResultCacheTest, KeyCoversInputs) {
+  const ConfigProto cfg;
+  const string key = MetaOptimizerResultCache::ComputeKey(item_, cfg, nullptr);
+  EXPECT_EQ(32, key.size());
+  EXPECT_EQ(key, MetaOptimizerResultCache::ComputeKey(item_, cfg, nullptr));
+
+  GrapplerItem fetched = item_;
+  fetched.fetch.push_back("extra");
+  EXPECT_NE(key, MetaOptimizerResultCache::ComputeKey(fetched, cfg, nullptr));
+
+  GrapplerItem modified = item_;
+  modified.graph.mutable_node(0)->set_device("/device:CPU:1");
+  EXPECT_NE(key, MetaOptimizerResultCache::ComputeKey(modified, cfg, nullptr));
+
+  GrapplerItem placed = item_;
+  TF_ASSERT_OK(placed.AddDevice("/job:localhost/replica:0/task:0/cpu:0"));
+  EXPECT_NE(key, MetaOptimizerResultCache::ComputeKey(placed, cfg, nullptr));
+
+  GrapplerItem eager = item_;
+  eager.optimization_options().is_eager_mode = true;
+  EXPECT_NE(key, MetaOptimizerResultCache::ComputeKey(eager, cfg, nullptr));
+
+  ConfigProto rewrites;
+  rewrites.mutable_graph_options()->mutable_rewrite_options()->set_remapping(
+      RewriterConfig::OFF);
+  EXPECT_NE(key, MetaOptimizerResultCache::ComputeKey(item_, rewrites,
+                                                      nullptr));
+
+  // Settings that differ between the tasks of a job do not change the key.
+  ConfigProto filtered;
+  filtered.add_device_filters("/job:worker/task:1");
+  EXPECT_EQ(key, MetaOptimizerResultCache::ComputeKey(item_, filtered,
+                                                      nullptr));
+
+  // Nor do the settings of the cache itself.
+  ConfigProto cached;
+  RewriterConfig* cache_options =
+      cached.mutable_graph_options()->mutable_rewrite_options();
+  cache_options->set_experimental_meta_optimizer_result_cache_dir(dir_);
+  cache_options->set_experimental_meta_optimizer_result_cache_validate(true);
+  EXPECT_EQ(key, MetaOptimizerResultCache::ComputeKey(item_, cached, nullptr));
+}
+
+TEST_F(MetaOptimizerResultCacheTest, ForConfig) {
+  RewriterConfig cfg;
+  EXPECT_EQ(nullptr, MetaOptimizerResultCache::ForConfig(cfg));
+
+  cfg.set_experimental_meta_optimizer_result_cache_dir(dir_);
+  MetaOptimizerResultCache* cache = MetaOptimizerResultCache::ForConfig(cfg);
+  ASSERT_NE(nullptr, cache);
+  EXPECT_EQ(dir_, cache->dir());
+  EXPECT_EQ(1LL << 30, cache->max_bytes());
+  EXPECT_FALSE(cache->validate());
+  EXPECT_EQ(cache, MetaOptimizerResultCache::ForConfig(cfg));
+
+  cfg.set_experimental_meta_optimizer_result_cache_validate(true);
+  MetaOptimizerResultCache* validating =
+      MetaOptimizerResultCache::ForConfig(cfg);
+  EXPECT_NE(cache, validating);
+  EXPECT_TRUE(validating->validate());
+}
+
+TEST_F(MetaOptimizerResultCacheTest, EvictsOldEntries) {
+  const string key =
+      MetaOptimizerResultCache::ComputeKey(item_, ConfigProto(), nullptr);
+  cache_->Insert(key, item_.graph);
+  uint64 entry_bytes = 0;
+  TF_ASSERT_OK(Env::Default()->GetFileSize(io::JoinPath(dir_, key + ".graph"),
+                                           &entry_bytes));
+
+  // Room for a single entry.
+  MetaOptimizerResultCache small(Env::Default(), dir_, entry_bytes,
+                                 /*validate=*/false);
+  GrapplerItem other = item_;
+  other.fetch.push_back("extra");
+  const string other_key =
+      MetaOptimizerResultCache::ComputeKey(other, ConfigProto(), nullptr);
+  small.Insert(other_key, item_.graph);
+
+  GraphDef graph;
+  EXPECT_FALSE(small.Lookup(key, &graph));
+  EXPECT_TRUE(small.Lookup(other_key, &graph));
+}
+
+TEST_F(MetaOptimizerResultCacheTest, DropsCorruptEntries) {
+  const string key =
+      MetaOptimizerResultCache::ComputeKey(item_, ConfigProto(), nullptr);
+  cache_->Insert(key, item_.graph);
+  const string path = io::JoinPath(dir_, key + ".graph");
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), path, &contents));
+  contents[contents.size() - 1] ^= 0x1;
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path, contents));
+
+  GraphDef graph;
+  EXPECT_FALSE(cache_->Lookup(key, &graph));
+  EXPECT_TRUE(errors::IsNotFound(Env::Default()->FileExists(path)));
+}
+
+TEST_F(MetaOptimizerResultCacheTest, ValidateEntries) {
+  const string key =
+      MetaOptimizerResultCache::ComputeKey(item_, ConfigProto(), nullptr);
+  cache_->Insert(key, item_.graph);
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(),
+                                 io::JoinPath(dir_, "truncated.graph"),
+                                 "TFGMORC1"));
+  // An intact entry under the wrong name.
+  TF_ASSERT_OK(Env::Default()->CopyFile(
+      io::JoinPath(dir_, key + ".graph"),
+      io::JoinPath(dir_, "00000000000000000000000000000000.graph")));
+
+  int num_valid = 0, num_deleted = 0;
+  TF_ASSERT_OK(cache_->ValidateEntries(&num_valid, &num_deleted));
+  EXPECT_EQ(1, num_valid);
+  EXPECT_EQ(2, num_deleted);
+}
+
+TEST_F(MetaOptimizerResultCacheTest, ValidateReplacesMismatches) {
+  const string key =
+      MetaOptimizerResultCache::ComputeKey(item_, ConfigProto(), nullptr);
+  GraphDef stale = item_.graph;
+  stale.mutable_node()->RemoveLast();
+  cache_->Insert(key, stale);
+
+  EXPECT_TRUE(cache_->Validate(key, stale, stale));
+  EXPECT_FALSE(cache_->Validate(key, stale, item_.graph));
+  GraphDef graph;
+  ASSERT_TRUE(cache_->Lookup(key, &graph));
+  EXPECT_EQ(item_.graph.DebugString(), graph.DebugString());
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -18,6 +18,7 @@ limitations under the License.
 #include <atomic>
 
 #include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -32,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/grappler_test.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/protobuf/config.pb.h"
@@ -617,6 +619,65 @@ TEST_F(MetaOptimizerTest, OptimizeFunctionLibraryPruneFunctionBody) {
   test::ExpectTensorEqual<float>(tensors_expected[1], tensors[1]);
 }
 
+TEST_F(MetaOptimizerTest, OptimizeFunctionLibraryConcurrently) {
+  using test::function::NDef;
+
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.set_meta_optimizer_iterations(RewriterConfig::TWO);
+  rewriter_config.set_function_optimization(RewriterConfig::ON);
+  rewriter_config.add_optimizers("function");
+  rewriter_config.add_optimizers("pruning");
+  rewriter_config.set_min_graph_nodes(-1);
+
+  FunctionDef my_func = FunctionDefHelper::Create(
+      "MyFunc", {"x:T", "y:T"}, {"z1:T", "z2:T"}, {"T: {float, double}"},
+      {{{"mul1"}, "Mul", {"x", "y"}, {{"T", "$T"}}},
+       {{"mul2"}, "Mul", {"x", "y"}, {{"T", "$T"}}}},
+      /*ret_def=*/
+      {{"z1", "mul1:z:0"}, {"z2", "mul2:z:0"}});
+  (*my_func.mutable_attr())["_noinline"].set_b(true);
+
+  // Each call is specialized into its own function, and the specialized
+  // functions are then optimized concurrently.
+  std::vector<NodeDef> nodes = {
+      NDef("a", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice),
+      NDef("b", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kDevice)};
+  for (int i = 0; i < 8; ++i) {
+    const string fn = absl::StrCat("fn", i);
+    nodes.push_back(NDef(fn, "MyFunc", {"a", "b"}, {{"T", DT_FLOAT}}, kDevice));
+    nodes.push_back(NDef(absl::StrCat("out_", fn), "Identity",
+                         {absl::StrCat(fn, ":", i % 2)}, {{"T", DT_FLOAT}},
+                         kDevice));
+  }
+  GrapplerItem item;
+  item.id = "tf_graph";
+  item.graph = test::function::GDef(nodes, /*funcs=*/{my_func});
+
+  GraphDef expected;
+  MetaOptimizer sequential(nullptr, config_proto);
+  TF_EXPECT_OK(sequential.Optimize(nullptr, item, &expected));
+
+  rewriter_config.set_experimental_function_optimization_threads(4);
+  GraphDef output;
+  MetaOptimizer concurrent(nullptr, config_proto);
+  TF_EXPECT_OK(concurrent.Optimize(nullptr, item, &output));
+
+  // The functions are independent, so both modes agree.
+  EXPECT_EQ(8, output.library().function_size());
+  CompareGraphs(expected, output);
+  FunctionLibraryDefinition expected_flib(OpRegistry::Global(),
+                                          expected.library());
+  for (const FunctionDef& func : output.library().function()) {
+    const FunctionDef* expected_func =
+        expected_flib.Find(func.signature().name());
+    ASSERT_NE(expected_func, nullptr);
+    EXPECT_TRUE(FunctionDefsEqual(*expected_func, func))
+        << func.signature().name();
+  }
+}
+
 TEST_F(MetaOptimizerTest, OptimizeFunctionLibraryWithRestrictions) {
   using test::function::NDef;
   using FDH = FunctionDefHelper;
@@ -1033,6 +1094,46 @@ TEST_F(MetaOptimizerTest, CompressConstants) {
   }
 }
 
+TEST_F(MetaOptimizerTest, ConstantFoldingStore) {
+  tensorflow::Scope scope = tensorflow::Scope::NewRootScope();
+  // A 256kB non-compressible matrix, too large to fold into a Const.
+  Output mat_diag =
+      ops::Const(scope.WithOpName("mat_diag"), 3.14f, TensorShape({256}));
+  Output mat = ops::Diag(scope.WithOpName("mat"), mat_diag);
+  Output out = ops::Identity(
+      scope.WithOpName("out").WithDevice("/device:CPU:0"), mat);
+  GrapplerItem item;
+  TF_CHECK_OK(scope.ToGraphDef(&item.graph));
+  item.fetch = {"out"};
+
+  const string store_dir =
+      io::JoinPath(testing::TmpDir(), "MetaOptimizerConstantFoldingStore");
+  ConfigProto config_proto;
+  auto& rewriter_config =
+      *config_proto.mutable_graph_options()->mutable_rewrite_options();
+  rewriter_config.set_min_graph_nodes(-1);
+  rewriter_config.set_experimental_constant_folding_store_dir(store_dir);
+  MetaOptimizer optimizer(/*cpu_device=*/nullptr, config_proto);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+
+  int num_stored = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.op() == "ImmutableConst") {
+      EXPECT_TRUE(absl::StartsWith(node.attr().at("memory_region_name").s(),
+                                   store_dir));
+      ++num_stored;
+    }
+  }
+  EXPECT_EQ(num_stored, 1);
+  EXPECT_LT(output.ByteSizeLong(), 2000);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorEqual<float>(tensors_expected[0], tensors[0]);
+}
+
 TEST_F(MetaOptimizerTest, TestTFGRemoveDeadArguments) {
   using test::function::NDef;
 
@@ -25,6 +25,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
@@ -42,7 +43,10 @@ limitations under the License.
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/clusters/utils.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/op_context.h"
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/op_types.h"
 #include "tensorflow/core/grappler/optimizers/constant_folding.h"
@@ -89,6 +93,14 @@ namespace grappler {
 //
 // Sigmoid + Mul -> _MklSwish  // This fusion only works on Intel CPU.
 //
+// Unique + Gather + ... -> _FusedEmbeddingLookupSparse  // CPU only.
+//   (1) Unique + Gather + SparseSegment{Sum,Mean,SqrtN}
+//   (2) [Unique + Gather +] Gather + Mul + SegmentSum
+//
+// <Elementwise> + <Elementwise> + ... -> _FusedElementwise  // CPU only.
+//   Chains of unary and binary cwise ops on one tensor, when the cost model
+//   predicts that fusing them is faster. Enabled with AGGRESSIVE remapping.
+//
 //
 // In all cases, the supported activation functions are Relu, Relu6, and Elu.
 //
@@ -107,6 +119,8 @@ constexpr char kFusedDepthwiseConv2dNative[] = "_FusedDepthwiseConv2dNative";
 constexpr char kFusedBatchNormEx[] = "_FusedBatchNormEx";
 constexpr char kFusedBatchNormGradEx[] = "_FusedBatchNormGradEx";
 constexpr char kTensorToHashBucket[] = "_TensorToHashBucketFast";
+constexpr char kFusedEmbeddingLookupSparse[] = "_FusedEmbeddingLookupSparse";
+constexpr char kFusedElementwise[] = "_FusedElementwise";
 constexpr char kLeakyRelu[] = "LeakyRelu";
 constexpr char kMklFusedMish[] = "_MklFusedMish";
 constexpr char kRelu[] = "Relu";
@@ -125,14 +139,16 @@ struct RemapperContext {
   explicit RemapperContext(GrapplerItem* item, Status* status,
                            RewriterConfig::CpuLayout cpu_layout_conversion,
                            bool xla_auto_clustering_on,
-                           bool xla_cpu_jit_disable_fusion)
+                           bool xla_cpu_jit_disable_fusion,
+                           bool fuse_elementwise_ops)
       : nodes_to_preserve(item->NodesToPreserve()),
         graph_view(&item->graph, status),
         graph_properties(*item),
         inferred_graph_properties(false),
         cpu_layout_conversion(cpu_layout_conversion),
         xla_auto_clustering_on(xla_auto_clustering_on),
-        xla_cpu_jit_disable_fusion(xla_cpu_jit_disable_fusion) {}
+        xla_cpu_jit_disable_fusion(xla_cpu_jit_disable_fusion),
+        fuse_elementwise_ops(fuse_elementwise_ops) {}
 
   std::unordered_set<string> nodes_to_preserve;
   utils::MutableGraphView graph_view;
@@ -141,6 +157,7 @@ struct RemapperContext {
   RewriterConfig::CpuLayout cpu_layout_conversion;
   bool xla_auto_clustering_on;
   bool xla_cpu_jit_disable_fusion;
+  bool fuse_elementwise_ops;
 };
 
 // FusedBatchNorm that can be replaced with a cheaper set of primitives.
@@ -185,6 +202,40 @@ struct TensorToHashBucket {
   int string_to_hash_bucket = kMissingIndex;
 };
 
+// Sparse embedding lookup that can be computed by a single
+// _FusedEmbeddingLookupSparse without materializing the gathered rows:
+//   unweighted: SparseSegment{Sum,Mean,SqrtN}(Gather(params, unique:0),
+//                                             unique:1, segment_ids)
+//   weighted:   SegmentSum(Mul(Gather(table, ids), weights), segment_ids)
+// where for the weighted form `table` and `ids` are themselves collapsed into
+// Gather(params, unique:0) and unique:1 when possible. An Identity between the
+// first Gather and its consumer (as added by embedding_lookup) is skipped.
+struct FusedEmbeddingLookupSparse {
+  FusedEmbeddingLookupSparse() = default;
+
+  int segment_reduction = kMissingIndex;
+  int mul = kMissingIndex;
+  int weights_port = kMissingIndex;
+  int weighted_gather = kMissingIndex;
+  int identity = kMissingIndex;
+  int gather = kMissingIndex;
+  int unique = kMissingIndex;
+  bool remove_unique = false;
+  string combiner = "sum";
+};
+
+// Chain of elementwise ops in which every op reads the output of the previous
+// one, computed by a single _FusedElementwise. The other operands of the
+// binary ops become the arguments of the fused op.
+struct FusedElementwise {
+  FusedElementwise() = default;
+
+  // From the head, which reads the input of the chain, to the tail.
+  std::vector<int> chain;
+  // Port through which each op of the chain reads the previous one.
+  std::vector<int> chain_ports;
+};
+
 // Pad followed by Conv3D/FusedConv3D
 struct PadWithConv3D {
   PadWithConv3D() = default;
@@ -2732,6 +2783,412 @@ bool FindTensorToHashBucket(const RemapperContext& ctx, int node_index,
   return true;
 }
 
+// Returns true if `node_view` is a GatherV2 along axis 0 without batch
+// dimensions, i.e. a plain row lookup.
+bool IsRowGather(const utils::MutableNodeView& node_view) {
+  const auto* node_def = node_view.node();
+  if (node_def->op() != "GatherV2" || node_view.NumRegularFanins() != 3) {
+    return false;
+  }
+  int batch_dims = 0;
+  if (TryGetNodeAttr(*node_def, "batch_dims", &batch_dims) && batch_dims != 0) {
+    return false;
+  }
+  const auto* axis_node_def = node_view.GetRegularFanin(2).node_view()->node();
+  Tensor axis;
+  if (!IsConstant(*axis_node_def) ||
+      !axis.FromProto(axis_node_def->attr().at("value").tensor()) ||
+      axis.NumElements() != 1) {
+    return false;
+  }
+  if (axis.dtype() == DT_INT32) return axis.flat<int32>()(0) == 0;
+  if (axis.dtype() == DT_INT64) return axis.flat<int64_t>()(0) == 0;
+  return false;
+}
+
+// Matches `table` = [Identity] <- Gather(params, unique:0) and `ids` =
+// unique:1, so that table[ids] can be read as params[unique.x].
+bool FindUniqueRowGather(const RemapperContext& ctx,
+                         const utils::MutableFanoutView& table,
+                         const utils::MutableFanoutView& ids,
+                         FusedEmbeddingLookupSparse* matched) {
+  const auto is_removable = [&](const utils::MutableNodeView& node_view) {
+    return !HasControlFaninOrFanout(node_view) &&
+           HasAtMostOneFanoutAtPort0(node_view) &&
+           !IsInPreserveSet(ctx, node_view.node());
+  };
+
+  const auto* gather_node_view = table.node_view();
+  if (table.index() != 0) return false;
+  if (IsIdentity(*gather_node_view->node())) {
+    if (!is_removable(*gather_node_view) ||
+        gather_node_view->NumRegularFanins() < 1) {
+      return false;
+    }
+    matched->identity = gather_node_view->node_index();
+    const auto& identity_fanin = gather_node_view->GetRegularFanin(0);
+    if (identity_fanin.index() != 0) return false;
+    gather_node_view = identity_fanin.node_view();
+  }
+  if (!IsRowGather(*gather_node_view) || !is_removable(*gather_node_view)) {
+    return false;
+  }
+
+  const auto& gather_indices = gather_node_view->GetRegularFanin(1);
+  const auto* unique_node_view = gather_indices.node_view();
+  const auto* unique_node_def = unique_node_view->node();
+  if (unique_node_def->op() != "Unique" || gather_indices.index() != 0 ||
+      ids.node_view() != unique_node_view || ids.index() != 1) {
+    return false;
+  }
+  if (!HasDataType(unique_node_def, DT_INT32) &&
+      !HasDataType(unique_node_def, DT_INT64)) {
+    return false;
+  }
+
+  matched->gather = gather_node_view->node_index();
+  matched->unique = unique_node_view->node_index();
+  // The Unique only goes away with the rest of the pattern if nothing else
+  // reads either of its outputs.
+  matched->remove_unique = !HasControlFaninOrFanout(*unique_node_view) &&
+                           !IsInPreserveSet(ctx, unique_node_def) &&
+                           unique_node_view->GetRegularFanout(0).size() == 1 &&
+                           unique_node_view->GetRegularFanout(1).size() == 1;
+  return true;
+}
+
+bool FindFusedEmbeddingLookupSparse(const RemapperContext& ctx, int node_index,
+                                    FusedEmbeddingLookupSparse* matched) {
+  const auto* node_view = ctx.graph_view.GetNode(node_index);
+  const auto* node_def = node_view->node();
+  const string& op = node_def->op();
+  const bool is_sparse_segment_reduction = op == "SparseSegmentSum" ||
+                                           op == "SparseSegmentMean" ||
+                                           op == "SparseSegmentSqrtN";
+  if (!is_sparse_segment_reduction && op != "SegmentSum") return false;
+  if (HasControlFaninOrFanout(*node_view) || !NodeIsOnCpu(node_def) ||
+      node_view->NumRegularFanins() < (is_sparse_segment_reduction ? 3 : 2)) {
+    return false;
+  }
+  if (!HasDataType(node_def, DT_FLOAT) && !HasDataType(node_def, DT_DOUBLE) &&
+      !HasDataType(node_def, DT_HALF) && !HasDataType(node_def, DT_BFLOAT16)) {
+    return false;
+  }
+
+  FusedEmbeddingLookupSparse pattern;
+  pattern.segment_reduction = node_index;
+
+  if (is_sparse_segment_reduction) {
+    // Without the Unique there is nothing to fuse: SparseSegment* already
+    // reads the rows of its data input directly.
+    if (!FindUniqueRowGather(ctx, node_view->GetRegularFanin(0),
+                             node_view->GetRegularFanin(1), &pattern)) {
+      return false;
+    }
+    if (op == "SparseSegmentMean") pattern.combiner = "mean";
+    if (op == "SparseSegmentSqrtN") pattern.combiner = "sqrtn";
+    *matched = pattern;
+    return true;
+  }
+
+  // SegmentSum(Mul(Gather(table, ids), weights)).
+  const auto& segment_fanin_0 = node_view->GetRegularFanin(0);
+  const auto* mul_node_view = segment_fanin_0.node_view();
+  const auto* mul_node_def = mul_node_view->node();
+  if (!IsMul(*mul_node_def) || segment_fanin_0.index() != 0 ||
+      HasControlFaninOrFanout(*mul_node_view) ||
+      !HasAtMostOneFanoutAtPort0(*mul_node_view) ||
+      IsInPreserveSet(ctx, mul_node_def) ||
+      mul_node_view->NumRegularFanins() != 2) {
+    return false;
+  }
+  int gather_port = kMissingIndex;
+  for (int port = 0; port < 2; ++port) {
+    const auto& fanin = mul_node_view->GetRegularFanin(port);
+    if (fanin.index() == 0 && IsRowGather(*fanin.node_view())) {
+      gather_port = port;
+      break;
+    }
+  }
+  if (gather_port == kMissingIndex) return false;
+  const auto* weighted_gather_node_view =
+      mul_node_view->GetRegularFanin(gather_port).node_view();
+  if (HasControlFaninOrFanout(*weighted_gather_node_view) ||
+      !HasAtMostOneFanoutAtPort0(*weighted_gather_node_view) ||
+      IsInPreserveSet(ctx, weighted_gather_node_view->node()) ||
+      (!HasDataType(weighted_gather_node_view->node(), DT_INT32,
+                    "Tindices") &&
+       !HasDataType(weighted_gather_node_view->node(), DT_INT64,
+                    "Tindices"))) {
+    return false;
+  }
+
+  // The weights must scale whole rows: one weight per gathered row, with all
+  // the trailing dimensions of the row broadcast.
+  if (!ctx.inferred_graph_properties) return false;
+  const auto& mul_props =
+      ctx.graph_properties.GetInputProperties(mul_node_def->name());
+  if (mul_props.size() != 2) return false;
+  const TensorShapeProto& rows_shape = mul_props[gather_port].shape();
+  const TensorShapeProto& weights_shape = mul_props[1 - gather_port].shape();
+  if (rows_shape.unknown_rank() || weights_shape.unknown_rank() ||
+      rows_shape.dim_size() < 1 ||
+      weights_shape.dim_size() != rows_shape.dim_size()) {
+    return false;
+  }
+  for (int d = 1; d < weights_shape.dim_size(); ++d) {
+    if (weights_shape.dim(d).size() != 1) return false;
+  }
+
+  pattern.mul = mul_node_view->node_index();
+  pattern.weights_port = 1 - gather_port;
+  pattern.weighted_gather = weighted_gather_node_view->node_index();
+  FusedEmbeddingLookupSparse unique_pattern = pattern;
+  if (FindUniqueRowGather(ctx, weighted_gather_node_view->GetRegularFanin(0),
+                          weighted_gather_node_view->GetRegularFanin(1),
+                          &unique_pattern)) {
+    pattern = unique_pattern;
+  }
+  *matched = pattern;
+  return true;
+}
+
+bool IsElementwiseFusionUnaryOp(const NodeDef& node) {
+  static const auto* const kOps = new absl::flat_hash_set<string>{
+      "Relu", "Relu6", "Elu",  "Selu",   "Sigmoid", "Tanh",  "Exp",
+      "Log",  "Neg",   "Abs",  "Square", "Sqrt",    "Rsqrt", "Reciprocal"};
+  return kOps->contains(node.op());
+}
+
+bool IsElementwiseFusionBinaryOp(const NodeDef& node) {
+  static const auto* const kOps = new absl::flat_hash_set<string>{
+      "Add",     "AddV2",   "BiasAdd", "Sub",
+      "Mul",     "RealDiv", "Maximum", "Minimum",
+      "SquaredDifference"};
+  return kOps->contains(node.op());
+}
+
+bool IsElementwiseFusionOp(const NodeDef& node) {
+  return IsElementwiseFusionUnaryOp(node) || IsElementwiseFusionBinaryOp(node);
+}
+
+// Ops whose elementwise consumers are folded in by the other fusions of the
+// remapper. _FusedElementwise leaves those consumers alone.
+bool IsFusedByOtherPattern(const utils::MutableNodeView& node_view) {
+  const auto is_fusion_producer = [](const NodeDef& node) {
+    return IsMatMul(node) || IsConv2D(node) || IsConv3D(node) ||
+           IsDepthwiseConv2dNative(node) || IsFusedBatchNorm(node) ||
+           node.op() == kFusedMatMul || node.op() == kFusedConv2D ||
+           node.op() == kFusedConv3D ||
+           node.op() == kFusedDepthwiseConv2dNative;
+  };
+  const auto reads_fusion_producer = [&](const utils::MutableNodeView& view) {
+    for (int i = 0; i < view.NumRegularFanins(); ++i) {
+      if (is_fusion_producer(*view.GetRegularFanin(i).node_view()->node())) {
+        return true;
+      }
+    }
+    return false;
+  };
+  if (reads_fusion_producer(node_view)) return true;
+  // The activation of Contraction + BiasAdd + <Activation>.
+  if (!IsElementwiseFusionUnaryOp(*node_view.node()) ||
+      node_view.NumRegularFanins() < 1) {
+    return false;
+  }
+  const auto* fanin_view = node_view.GetRegularFanin(0).node_view();
+  return (IsBiasAdd(*fanin_view->node()) || IsAdd(*fanin_view->node())) &&
+         reads_fusion_producer(*fanin_view);
+}
+
+enum class ElementwiseFusionOperand { kScalar, kFull, kLastDim, kInvalid };
+
+// Classifies `operand` the way _FusedElementwise broadcasts its arguments
+// to the shape of the chain.
+ElementwiseFusionOperand ClassifyElementwiseFusionOperand(
+    const PartialTensorShape& operand, const PartialTensorShape& chain) {
+  if (!operand.IsFullyDefined()) return ElementwiseFusionOperand::kInvalid;
+  if (operand.num_elements() == 1) return ElementwiseFusionOperand::kScalar;
+  if (operand.IsIdenticalTo(chain)) return ElementwiseFusionOperand::kFull;
+  if (operand.dims() < 1 || operand.dims() > chain.dims() ||
+      operand.dim_size(operand.dims() - 1) !=
+          chain.dim_size(chain.dims() - 1)) {
+    return ElementwiseFusionOperand::kInvalid;
+  }
+  for (int d = 0; d + 1 < operand.dims(); ++d) {
+    if (operand.dim_size(d) != 1) return ElementwiseFusionOperand::kInvalid;
+  }
+  return ElementwiseFusionOperand::kLastDim;
+}
+
+// Returns the ports through which `node_view` can read the chain, most
+// preferred first: the chain has the static shape of the output, and the
+// other operand, if any, broadcasts the way _FusedElementwise supports.
+std::vector<int> ElementwiseFusionChainPorts(
+    const RemapperContext& ctx, const utils::MutableNodeView& node_view) {
+  const NodeDef* node_def = node_view.node();
+  const auto& input_props =
+      ctx.graph_properties.GetInputProperties(node_def->name());
+  const auto& output_props =
+      ctx.graph_properties.GetOutputProperties(node_def->name());
+  if (output_props.size() != 1) return {};
+  const PartialTensorShape output_shape(output_props[0].shape());
+  if (!output_shape.IsFullyDefined() || output_shape.dims() < 1) return {};
+
+  if (IsElementwiseFusionUnaryOp(*node_def)) {
+    if (input_props.size() != 1) return {};
+    return {0};
+  }
+  if (input_props.size() != 2) return {};
+  if (IsBiasAdd(*node_def)) {
+    const auto& data_format = node_def->attr().find(kDataFormat);
+    if (data_format != node_def->attr().end() &&
+        data_format->second.s() != "NHWC") {
+      return {};
+    }
+  }
+  std::vector<int> ports;
+  for (int port = 0; port < (IsBiasAdd(*node_def) ? 1 : 2); ++port) {
+    const PartialTensorShape chain_shape(input_props[port].shape());
+    const PartialTensorShape operand_shape(input_props[1 - port].shape());
+    if (chain_shape.IsIdenticalTo(output_shape) &&
+        ClassifyElementwiseFusionOperand(operand_shape, output_shape) !=
+            ElementwiseFusionOperand::kInvalid) {
+      ports.push_back(port);
+    }
+  }
+  // Prefer extending the chain through an elementwise op.
+  if (ports.size() == 2) {
+    const NodeDef* fanin_0 = node_view.GetRegularFanin(0).node_view()->node();
+    if (!IsElementwiseFusionOp(*fanin_0)) std::swap(ports[0], ports[1]);
+  }
+  return ports;
+}
+
+// Compares the time predicted by the analytical cost model for the ops of the
+// chain with the time of the fused op, which computes the same but moves only
+// the input of the chain, the non-scalar arguments and the output through
+// memory.
+bool IsFusedElementwiseProfitable(const RemapperContext& ctx,
+                                  const FusedElementwise& matched,
+                                  const Cluster* cluster) {
+  const GraphDef* graph = ctx.graph_view.graph();
+  const NodeDef& tail = graph->node(matched.chain.back());
+  DeviceProperties device;
+  if (cluster != nullptr && cluster->GetDevices().count(tail.device()) > 0) {
+    device = cluster->GetDevices().at(tail.device());
+  } else {
+    device = GetLocalCPUInfo();
+  }
+
+  OpLevelCostEstimator estimator;
+  double unfused_ns = 0;
+  double fused_compute_ns = 0;
+  int64_t fused_bytes = 0;
+  const auto tensor_bytes = [](const OpInfo::TensorProperties& props) {
+    return PartialTensorShape(props.shape()).num_elements() *
+           DataTypeSize(props.dtype());
+  };
+  for (int i = 0; i < matched.chain.size(); ++i) {
+    const NodeDef& node = graph->node(matched.chain[i]);
+    const auto& input_props =
+        ctx.graph_properties.GetInputProperties(node.name());
+    const auto& output_props =
+        ctx.graph_properties.GetOutputProperties(node.name());
+
+    OpContext op_context;
+    op_context.name = node.name();
+    op_context.device_name = node.device();
+    op_context.op_info.set_op(node.op());
+    *op_context.op_info.mutable_attr() = node.attr();
+    *op_context.op_info.mutable_device() = device;
+    for (const auto& props : input_props) {
+      *op_context.op_info.add_inputs() = props;
+    }
+    for (const auto& props : output_props) {
+      *op_context.op_info.add_outputs() = props;
+    }
+    // Ops missing from the cost model, e.g. Elu, come back flagged as
+    // inaccurate with a memory-only estimate, which is still the part that
+    // fusion saves.
+    const Costs costs = estimator.PredictCosts(op_context);
+    unfused_ns += costs.execution_time.count();
+    fused_compute_ns += costs.compute_time.count();
+
+    const int chain_port = matched.chain_ports[i];
+    if (i == 0) fused_bytes += tensor_bytes(input_props[chain_port]);
+    if (chain_port != kMissingIndex) {
+      const auto& operand = input_props[1 - chain_port];
+      if (PartialTensorShape(operand.shape()).num_elements() > 1) {
+        fused_bytes += tensor_bytes(operand);
+      }
+    }
+    if (i + 1 == matched.chain.size()) {
+      fused_bytes += tensor_bytes(output_props[0]);
+    }
+  }
+  const double gb_per_sec = estimator.GetDeviceInfo(device).gb_per_sec;
+  const double fused_ns = fused_compute_ns + fused_bytes / gb_per_sec;
+  VLOG(2) << "Elementwise chain ending in " << tail.name() << ": "
+          << matched.chain.size() << " ops, predicted " << unfused_ns
+          << "ns unfused and " << fused_ns << "ns fused";
+  return fused_ns < unfused_ns;
+}
+
+bool FindFusedElementwise(const RemapperContext& ctx, int node_index,
+                          const Cluster* cluster, FusedElementwise* matched) {
+  if (!ctx.fuse_elementwise_ops || ctx.xla_cpu_jit_disable_fusion ||
+      !ctx.inferred_graph_properties) {
+    return false;
+  }
+  const auto* tail_view = ctx.graph_view.GetNode(node_index);
+  const auto* tail_def = tail_view->node();
+  if (!IsElementwiseFusionOp(*tail_def) || !NodeIsOnCpu(tail_def) ||
+      HasControlFaninOrFanout(*tail_view) ||
+      IsFusedByOtherPattern(*tail_view)) {
+    return false;
+  }
+  const DataType dtype = GetDataTypeFromAttr(*tail_def, "T");
+  if (dtype != DT_FLOAT && dtype != DT_DOUBLE && dtype != DT_HALF &&
+      dtype != DT_BFLOAT16) {
+    return false;
+  }
+
+  // Walk up from the tail while the chain input is produced by an
+  // elementwise op that only the chain reads.
+  FusedElementwise pattern;
+  const auto* node_view = tail_view;
+  while (true) {
+    const std::vector<int> ports =
+        ElementwiseFusionChainPorts(ctx, *node_view);
+    if (ports.empty()) break;
+    pattern.chain.push_back(node_view->node_index());
+    pattern.chain_ports.push_back(
+        IsElementwiseFusionUnaryOp(*node_view->node()) ? kMissingIndex
+                                                       : ports[0]);
+
+    const auto& chain_fanin = node_view->GetRegularFanin(ports[0]);
+    const auto* fanin_view = chain_fanin.node_view();
+    const auto* fanin_def = fanin_view->node();
+    if (chain_fanin.index() != 0 || !IsElementwiseFusionOp(*fanin_def) ||
+        !HasDataType(fanin_def, dtype) ||
+        fanin_def->device() != tail_def->device() ||
+        HasControlFaninOrFanout(*fanin_view) ||
+        !HasAtMostOneFanoutAtPort0(*fanin_view) ||
+        IsInPreserveSet(ctx, fanin_def) || IsFusedByOtherPattern(*fanin_view)) {
+      break;
+    }
+    node_view = fanin_view;
+  }
+  if (pattern.chain.size() < 2) return false;
+  std::reverse(pattern.chain.begin(), pattern.chain.end());
+  std::reverse(pattern.chain_ports.begin(), pattern.chain_ports.end());
+
+  if (!IsFusedElementwiseProfitable(ctx, pattern, cluster)) return false;
+  *matched = std::move(pattern);
+  return true;
+}
+
 // clang-format off
 // HardSwish pattern
 //                        input     Const (value: 3)
@@ -4368,6 +4825,118 @@ Status AddTensorToHashBucketNode(RemapperContext* ctx,
   return absl::OkStatus();
 }
 
+Status AddFusedEmbeddingLookupSparseNode(
+    RemapperContext* ctx, const FusedEmbeddingLookupSparse& matched,
+    std::vector<bool>* invalidated_nodes, std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& segment_reduction = graph->node(matched.segment_reduction);
+  const bool is_weighted = matched.mul != kMissingIndex;
+  const bool has_unique = matched.unique != kMissingIndex;
+  VLOG(2) << "Fuse sparse embedding lookup:"
+          << " segment_reduction=" << segment_reduction.name()
+          << " combiner=" << matched.combiner << " weighted=" << is_weighted
+          << " unique="
+          << (has_unique ? graph->node(matched.unique).name() : "none");
+
+  NodeDef fused_op;
+  fused_op.set_name(segment_reduction.name());
+  fused_op.set_op(kFusedEmbeddingLookupSparse);
+  fused_op.set_device(segment_reduction.device());
+
+  auto* attr = fused_op.mutable_attr();
+  (*attr)["T"] = segment_reduction.attr().at("T");
+  if (has_unique) {
+    const NodeDef& gather = graph->node(matched.gather);
+    const NodeDef& unique = graph->node(matched.unique);
+    fused_op.add_input(gather.input(0));  // 0: params
+    fused_op.add_input(unique.input(0));  // 1: ids
+    (*attr)["Tidx"] = unique.attr().at("T");
+  } else {
+    const NodeDef& weighted_gather = graph->node(matched.weighted_gather);
+    fused_op.add_input(weighted_gather.input(0));  // 0: params
+    fused_op.add_input(weighted_gather.input(1));  // 1: ids
+    (*attr)["Tidx"] = weighted_gather.attr().at("Tindices");
+  }
+  if (is_weighted) {
+    const NodeDef& mul = graph->node(matched.mul);
+    fused_op.add_input(segment_reduction.input(1));  // 2: segment_ids
+    fused_op.add_input(mul.input(matched.weights_port));  // 3: weights
+    (*attr)["Tsegmentids"] = segment_reduction.attr().at("Tindices");
+    SetAttrValue(1, &(*attr)["num_weights"]);
+  } else {
+    fused_op.add_input(segment_reduction.input(2));  // 2: segment_ids
+    (*attr)["Tsegmentids"] = segment_reduction.attr().at("Tsegmentids");
+    SetAttrValue(0, &(*attr)["num_weights"]);
+  }
+  SetAttrValue(matched.combiner, &(*attr)["combiner"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  (*invalidated_nodes)[matched.segment_reduction] = true;
+  for (int node : {matched.mul, matched.weighted_gather, matched.identity,
+                   matched.gather}) {
+    if (node != kMissingIndex) (*nodes_to_delete)[node] = true;
+  }
+  if (matched.remove_unique) (*nodes_to_delete)[matched.unique] = true;
+
+  return absl::OkStatus();
+}
+
+Status AddFusedElementwiseNode(RemapperContext* ctx,
+                               const FusedElementwise& matched,
+                               std::vector<bool>* invalidated_nodes,
+                               std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& head = graph->node(matched.chain.front());
+  const NodeDef& tail = graph->node(matched.chain.back());
+  VLOG(2) << "Fuse elementwise chain:"
+          << " head=" << head.name() << " tail=" << tail.name()
+          << " num_ops=" << matched.chain.size();
+
+  NodeDef fused_op;
+  fused_op.set_name(tail.name());
+  fused_op.set_op(kFusedElementwise);
+  fused_op.set_device(tail.device());
+  // Unary ops read the chain through port 0.
+  const int head_port = std::max(matched.chain_ports.front(), 0);
+  fused_op.add_input(head.input(head_port));  // 0: x
+
+  std::vector<string> fused_ops;
+  std::vector<bool> chain_is_rhs;
+  for (int i = 0; i < matched.chain.size(); ++i) {
+    const NodeDef& node = graph->node(matched.chain[i]);
+    const int chain_port = matched.chain_ports[i];
+    fused_ops.push_back(node.op());
+    chain_is_rhs.push_back(chain_port == 1);
+    if (chain_port != kMissingIndex) {
+      fused_op.add_input(node.input(1 - chain_port));  // 1...: args
+    }
+  }
+
+  auto* attr = fused_op.mutable_attr();
+  (*attr)["T"] = tail.attr().at("T");
+  SetAttrValue(fused_op.input_size() - 1, &(*attr)["num_args"]);
+  SetAttrValue(fused_ops, &(*attr)["fused_ops"]);
+  SetAttrValue(chain_is_rhs, &(*attr)["chain_is_rhs"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  (*invalidated_nodes)[matched.chain.back()] = true;
+  for (int i = 0; i + 1 < matched.chain.size(); ++i) {
+    (*nodes_to_delete)[matched.chain[i]] = true;
+  }
+
+  return absl::OkStatus();
+}
+
 Status AddFusedBatchMatMul(RemapperContext* ctx,
                            const std::map<string, int>& matched_nodes_map,
                            const std::set<int>& remove_node_indices,
@@ -4889,19 +5458,44 @@ bool RequiresInferredShapes(const RemapperContext& ctx, int node_index,
     return true;
   };
 
+  // Candidate for a weighted _FusedEmbeddingLookupSparse fusion, which needs
+  // the shape of the weights.
+  const auto is_weighted_embedding_lookup_candidate = [&]() -> bool {
+    if (node_def->op() != "SegmentSum" || !NodeIsOnCpu(node_def)) return false;
+    if (node_view->NumRegularFanins() < 1) return false;
+    return IsMul(*node_view->GetRegularFanin(0).node_view()->node());
+  };
+
+  // Candidate for a _FusedElementwise fusion, which needs static shapes.
+  const auto is_fused_elementwise_candidate = [&]() -> bool {
+    if (!ctx.fuse_elementwise_ops || !IsElementwiseFusionOp(*node_def) ||
+        !NodeIsOnCpu(node_def)) {
+      return false;
+    }
+    for (int i = 0; i < node_view->NumRegularFanins(); ++i) {
+      const auto* fanin_def = node_view->GetRegularFanin(i).node_view()->node();
+      if (IsElementwiseFusionOp(*fanin_def)) return true;
+    }
+    return false;
+  };
+
   if (IsMKLEnabled())
     return is_batch_norm_candidate() || is_batch_norm_fusion_candidate() ||
            IsContractionWithAdd(ctx, node_index) ||
            is_act_biasadd_conv_candidate() || IsBiasAdd(*node_def) ||
            IsTranspose(*node_def) || is_maximum_add_matmul_candidate() ||
-           is_add_matmul_candidate();
+           is_add_matmul_candidate() ||
+           is_weighted_embedding_lookup_candidate() ||
+           is_fused_elementwise_candidate();
 
   return is_act_biasadd_conv_candidate() || is_batch_norm_candidate() ||
          is_batch_norm_fusion_candidate() ||
          is_batch_norm_grad_fusion_candidate() ||
          is_matmul_gelu_exact_fusion_candidate() ||
          is_act_biasadd_matmul_candidate() ||
-         is_maximum_add_matmul_candidate() || is_add_matmul_candidate();
+         is_maximum_add_matmul_candidate() || is_add_matmul_candidate() ||
+         is_weighted_embedding_lookup_candidate() ||
+         is_fused_elementwise_candidate();
 }
 
 inline bool IsXlaCpuGlobalJitOn() {
@@ -4923,7 +5517,9 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
   xla_cpu_jit_disable_fusion = false;
 #endif  // DNNL_AARCH64_USE_ACL
   RemapperContext ctx(&mutable_item, &status, cpu_layout_conversion_,
-                      xla_auto_clustering_on_, xla_cpu_jit_disable_fusion);
+                      xla_auto_clustering_on_, xla_cpu_jit_disable_fusion,
+                      /*fuse_elementwise_ops=*/opt_level_ ==
+                          RewriterConfig::AGGRESSIVE);
   TF_RETURN_IF_ERROR(status);
 
   // Processing graph in reverse-topological sorted order allows to remap
@@ -5263,6 +5859,17 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       continue;
     }
 
+    // This fusion is enabled on CPU only.
+    FusedEmbeddingLookupSparse fused_embedding_lookup_sparse;
+    if (allow_non_differentiable_rewrites &&
+        FindFusedEmbeddingLookupSparse(ctx, i,
+                                       &fused_embedding_lookup_sparse)) {
+      TF_RETURN_IF_ERROR(AddFusedEmbeddingLookupSparseNode(
+          &ctx, fused_embedding_lookup_sparse, &invalidated_nodes,
+          &nodes_to_delete));
+      continue;
+    }
+
     // During inference, most of the inputs to FusedBatchNorm are constant, and
     // we can therefore replace the op with a much cheaper set of primitives.
     FusedBatchNorm fused_batch_norm;
@@ -5270,6 +5877,16 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       TF_RETURN_IF_ERROR(AddBatchNormNodes(&ctx, fused_batch_norm));
       continue;
     }
+
+    // Runs after the other fusions, which fold the elementwise ops that follow
+    // contractions and batch norms. This fusion is enabled on CPU only.
+    FusedElementwise fused_elementwise;
+    if (allow_non_differentiable_rewrites &&
+        FindFusedElementwise(ctx, i, cluster, &fused_elementwise)) {
+      TF_RETURN_IF_ERROR(AddFusedElementwiseNode(
+          &ctx, fused_elementwise, &invalidated_nodes, &nodes_to_delete));
+      continue;
+    }
   }
 
   // Remove invalidated nodes.
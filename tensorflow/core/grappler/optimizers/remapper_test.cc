@@ -1783,6 +1783,197 @@ TEST_F(RemapperTensorToHashBucketTest, I32) { RunTest<DT_INT32>(); }
 
 TEST_F(RemapperTensorToHashBucketTest, I64) { RunTest<DT_INT64>(); }
 
+class RemapperFuseEmbeddingLookupSparseTest : public RemapperTest {
+ public:
+  // Builds the graph produced by embedding_lookup_sparse: Unique + GatherV2
+  // (+ Identity) followed either by a SparseSegment reduction, or by a second
+  // GatherV2 over the unique indices, a Mul by the weights and a SegmentSum.
+  void RunTest(const string& combiner, bool weighted) {
+    using ::tensorflow::ops::Placeholder;
+
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+    auto params = Placeholder(s.WithOpName("params"), DT_FLOAT,
+                              ops::Placeholder::Shape({10, 4}));
+    auto ids = Placeholder(s.WithOpName("ids"), DT_INT64,
+                           ops::Placeholder::Shape({6}));
+    auto weights = Placeholder(s.WithOpName("weights"), DT_FLOAT,
+                               ops::Placeholder::Shape({6, 1}));
+    auto segment_ids =
+        ops::Const(s.WithOpName("segment_ids"), {0, 0, 1, 3, 3, 3}, {6});
+    auto axis = ops::Const(s.WithOpName("axis"), 0);
+
+    auto unique = ops::Unique(s.WithOpName("unique"), ids);
+    auto gather = ops::GatherV2(s.WithOpName("gather"), params, unique.y, axis);
+    auto lookup = ops::Identity(s.WithOpName("lookup"), gather);
+
+    Output reduce;
+    if (weighted) {
+      auto expand =
+          ops::GatherV2(s.WithOpName("expand"), lookup, unique.idx, axis);
+      auto mul = ops::Mul(s.WithOpName("mul"), expand, weights);
+      reduce = ops::SegmentSum(s.WithOpName("reduce"), mul, segment_ids);
+    } else if (combiner == "sum") {
+      reduce = ops::SparseSegmentSum(s.WithOpName("reduce"), lookup,
+                                     unique.idx, segment_ids);
+    } else if (combiner == "mean") {
+      reduce = ops::SparseSegmentMean(s.WithOpName("reduce"), lookup,
+                                      unique.idx, segment_ids);
+    } else {
+      reduce = ops::SparseSegmentSqrtN(s.WithOpName("reduce"), lookup,
+                                       unique.idx, segment_ids);
+    }
+    auto fetch = ops::Identity(s.WithOpName("fetch"), reduce);
+
+    GrapplerItem item;
+    item.fetch = {"fetch"};
+    item.feed = {{"params", GenerateRandomTensor<DT_FLOAT>({10, 4})},
+                 {"ids", test::AsTensor<int64_t>({3, 1, 3, 7, 0, 1})},
+                 {"weights", GenerateRandomTensor<DT_FLOAT>({6, 1})}};
+    TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+    // The fusion is CPU only.
+    for (int i = 0; i < item.graph.node_size(); ++i) {
+      item.graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+
+    Remapper optimizer(RewriterConfig::ON);
+    GraphDef output;
+    TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+    int found = 0;
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE(node.name(), "unique");
+      EXPECT_NE(node.name(), "gather");
+      EXPECT_NE(node.name(), "lookup");
+      if (node.name() == "reduce") {
+        EXPECT_EQ(node.op(), "_FusedEmbeddingLookupSparse");
+        ASSERT_EQ(node.input_size(), weighted ? 4 : 3);
+        EXPECT_EQ(node.input(0), "params");
+        EXPECT_EQ(node.input(1), "ids");
+        EXPECT_EQ(node.input(2), "segment_ids");
+        if (weighted) EXPECT_EQ(node.input(3), "weights");
+        EXPECT_EQ(node.attr().at("num_weights").i(), weighted ? 1 : 0);
+        EXPECT_EQ(node.attr().at("combiner").s(), combiner);
+        EXPECT_EQ(node.attr().at("Tidx").type(), DT_INT64);
+        found++;
+      }
+    }
+    EXPECT_EQ(found, 1);
+
+    auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+    ASSERT_EQ(tensors_expected.size(), 1);
+    auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+    ASSERT_EQ(tensors.size(), 1);
+    test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+  }
+};
+
+TEST_F(RemapperFuseEmbeddingLookupSparseTest, Sum) { RunTest("sum", false); }
+
+TEST_F(RemapperFuseEmbeddingLookupSparseTest, Mean) { RunTest("mean", false); }
+
+TEST_F(RemapperFuseEmbeddingLookupSparseTest, SqrtN) {
+  RunTest("sqrtn", false);
+}
+
+TEST_F(RemapperFuseEmbeddingLookupSparseTest, WeightedSum) {
+  RunTest("sum", true);
+}
+
+class RemapperFuseElementwiseTest : public RemapperTest {
+ protected:
+  // MatMul + BiasAdd + Relu, followed by a chain of elementwise ops with a
+  // scalar operand and the chain on the right-hand side of a Sub.
+  void RunTest(RewriterConfig::Toggle opt_level, bool expect_fusion) {
+    using ::tensorflow::ops::Placeholder;
+
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+    auto lhs = Placeholder(s.WithOpName("lhs"), DT_FLOAT,
+                           ops::Placeholder::Shape({8, 32}));
+    auto rhs = Placeholder(s.WithOpName("rhs"), DT_FLOAT,
+                           ops::Placeholder::Shape({32, 16}));
+    auto bias = Placeholder(s.WithOpName("bias"), DT_FLOAT,
+                            ops::Placeholder::Shape({16}));
+    auto scale = ops::Const(s.WithOpName("scale"), 0.5f, {});
+    auto one = ops::Const(s.WithOpName("one"), 1.0f, {});
+
+    auto matmul = ops::MatMul(s.WithOpName("matmul"), lhs, rhs);
+    auto bias_add = ops::BiasAdd(s.WithOpName("bias_add"), matmul, bias);
+    auto relu = ops::Relu(s.WithOpName("relu"), bias_add);
+    auto mul = ops::Mul(s.WithOpName("mul"), relu, scale);
+    auto sigmoid = ops::Sigmoid(s.WithOpName("sigmoid"), mul);
+    auto sub = ops::Sub(s.WithOpName("sub"), one, sigmoid);
+    auto tanh = ops::Tanh(s.WithOpName("tanh"), sub);
+    auto fetch = ops::Identity(s.WithOpName("fetch"), tanh);
+
+    GrapplerItem item;
+    item.fetch = {"fetch"};
+    item.feed = {{"lhs", GenerateRandomTensor<DT_FLOAT>({8, 32})},
+                 {"rhs", GenerateRandomTensor<DT_FLOAT>({32, 16})},
+                 {"bias", GenerateRandomTensor<DT_FLOAT>({16})}};
+    TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+    // The fusion is CPU only.
+    for (int i = 0; i < item.graph.node_size(); ++i) {
+      item.graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+
+    Remapper optimizer(opt_level);
+    GraphDef output;
+    TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+    int found = 0;
+    for (const NodeDef& node : output.node()) {
+      if (expect_fusion) {
+        EXPECT_NE(node.name(), "mul");
+        EXPECT_NE(node.name(), "sigmoid");
+        EXPECT_NE(node.name(), "sub");
+      }
+      // The activation is left to the contraction fusion.
+      if (node.name() == "relu") EXPECT_NE(node.op(), "_FusedElementwise");
+      if (node.name() != "tanh") continue;
+      if (!expect_fusion) {
+        EXPECT_EQ(node.op(), "Tanh");
+        continue;
+      }
+      EXPECT_EQ(node.op(), "_FusedElementwise");
+      ASSERT_EQ(node.input_size(), 3);
+      EXPECT_EQ(node.input(0), "relu");
+      EXPECT_EQ(node.input(1), "scale");
+      EXPECT_EQ(node.input(2), "one");
+      EXPECT_EQ(node.attr().at("num_args").i(), 2);
+      const auto fused_ops = node.attr().at("fused_ops").list().s();
+      ASSERT_EQ(fused_ops.size(), 4);
+      EXPECT_EQ(fused_ops[0], "Mul");
+      EXPECT_EQ(fused_ops[1], "Sigmoid");
+      EXPECT_EQ(fused_ops[2], "Sub");
+      EXPECT_EQ(fused_ops[3], "Tanh");
+      const auto chain_is_rhs = node.attr().at("chain_is_rhs").list().b();
+      ASSERT_EQ(chain_is_rhs.size(), 4);
+      EXPECT_FALSE(chain_is_rhs[0]);
+      EXPECT_TRUE(chain_is_rhs[2]);
+      found++;
+    }
+    EXPECT_EQ(found, expect_fusion ? 1 : 0);
+
+    auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+    ASSERT_EQ(tensors_expected.size(), 1);
+    auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+    ASSERT_EQ(tensors.size(), 1);
+    test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+  }
+};
+
+TEST_F(RemapperFuseElementwiseTest, Aggressive) {
+  RunTest(RewriterConfig::AGGRESSIVE, /*expect_fusion=*/true);
+}
+
+TEST_F(RemapperFuseElementwiseTest, DisabledByDefault) {
+  RunTest(RewriterConfig::ON, /*expect_fusion=*/false);
+}
+
 class RemapperFuseMatMulWithBiasTest : public RemapperTest {
  public:
   template <DataType DTYPE>
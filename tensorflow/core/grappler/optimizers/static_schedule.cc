@@ -15,11 +15,19 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/static_schedule.h"
 
+#include <algorithm>
 #include <deque>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <set>
+#include <tuple>
 
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/utils.h"
 #include "tensorflow/core/grappler/costs/virtual_placer.h"
 #include "tensorflow/core/grappler/op_types.h"
 #include "tensorflow/core/grappler/utils.h"
@@ -199,5 +207,247 @@ Status EstimateRequiredTimes(
   return absl::OkStatus();
 }
 
+// The nodes of a graph, identified by their index in the GraphDef, with the
+// edges between them.
+struct ScheduleGraph {
+  std::vector<const NodeDef*> nodes;
+  // Number of inputs each node waits for before it is ready.
+  std::vector<int> num_pending;
+  // Fanouts of each node, once per data or control edge.
+  std::vector<std::vector<int>> fanouts;
+  // Distinct nodes each node reads data from, and that read its data.
+  std::vector<std::vector<int>> data_fanins;
+  std::vector<std::vector<int>> data_fanouts;
+  // Number of nodes that read the data of each node, plus one if it is
+  // fetched.
+  std::vector<int> num_consumers;
+  // Total size of the outputs of each node, if requested.
+  std::vector<int64_t> output_sizes;
+};
+
+static Status BuildScheduleGraph(const GrapplerItem& item,
+                                 bool infer_output_sizes,
+                                 ScheduleGraph* graph) {
+  const int num_nodes = item.graph.node_size();
+  std::unordered_map<string, int> name_map;
+  graph->nodes.resize(num_nodes);
+  graph->num_pending.resize(num_nodes);
+  graph->fanouts.resize(num_nodes);
+  graph->data_fanins.resize(num_nodes);
+  graph->data_fanouts.resize(num_nodes);
+  graph->num_consumers.resize(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    const NodeDef& node = item.graph.node(i);
+    name_map[node.name()] = i;
+    graph->nodes[i] = &node;
+    // Merge nodes are processed as soon as one of the input becomes available.
+    graph->num_pending[i] =
+        IsMerge(node) ? std::min(node.input_size(), 1) : node.input_size();
+  }
+
+  for (int i = 0; i < num_nodes; ++i) {
+    for (const string& input : graph->nodes[i]->input()) {
+      auto it = name_map.find(NodeName(input));
+      if (it == name_map.end()) {
+        return errors::InvalidArgument(
+            strings::StrCat("Unknown input node ", input));
+      }
+      graph->fanouts[it->second].push_back(i);
+      if (!IsControlInput(input)) {
+        graph->data_fanins[i].push_back(it->second);
+      }
+    }
+    std::vector<int>& fanins = graph->data_fanins[i];
+    std::sort(fanins.begin(), fanins.end());
+    fanins.erase(std::unique(fanins.begin(), fanins.end()), fanins.end());
+    for (int fanin : fanins) {
+      graph->data_fanouts[fanin].push_back(i);
+      ++graph->num_consumers[fanin];
+    }
+  }
+  for (const string& fetch : item.fetch) {
+    auto it = name_map.find(NodeName(fetch));
+    if (it != name_map.end()) {
+      ++graph->num_consumers[it->second];
+    }
+  }
+
+  if (infer_output_sizes) {
+    GraphProperties properties(item);
+    TF_RETURN_IF_ERROR(
+        properties.InferStatically(/*assume_valid_feeds=*/true,
+                                   /*aggressive_shape_inference=*/false,
+                                   /*include_tensor_values=*/false));
+    graph->output_sizes.resize(num_nodes);
+    for (int i = 0; i < num_nodes; ++i) {
+      for (const auto& output :
+           properties.GetOutputProperties(graph->nodes[i]->name())) {
+        graph->output_sizes[i] += CalculateTensorSize(output);
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Appends the fanouts of `node` that become ready once it has run to `ready`.
+static void ReleaseFanouts(const ScheduleGraph& graph, int node,
+                           std::vector<int>* num_pending,
+                           std::vector<int>* ready) {
+  for (int fanout : graph.fanouts[node]) {
+    int& pending = (*num_pending)[fanout];
+    if (pending == 0) {
+      // Already processed. Avoid going through loops more than once.
+      continue;
+    }
+    if (--pending == 0) {
+      ready->push_back(fanout);
+    }
+  }
+}
+
+static Status OrderByCriticalPath(const GrapplerItem& item,
+                                  const Cluster* cluster,
+                                  const ScheduleGraph& graph,
+                                  std::vector<int>* order) {
+  if (cluster == nullptr) {
+    return errors::InvalidArgument(
+        "A cluster is required to estimate the critical path");
+  }
+  std::unordered_map<const NodeDef*, Costs::NanoSeconds> completion_times;
+  TF_RETURN_IF_ERROR(
+      EstimateEarliestExecutionTimes(item, cluster, &completion_times));
+  std::unordered_map<const NodeDef*, Costs::NanoSeconds> required_times;
+  TF_RETURN_IF_ERROR(EstimateRequiredTimes(item, cluster, completion_times,
+                                           &required_times));
+
+  // Ready nodes by required time, then completion time.
+  std::set<std::tuple<int64_t, int64_t, int>> ready;
+  auto add_ready = [&](int node) {
+    const NodeDef* node_def = graph.nodes[node];
+    ready.emplace(required_times[node_def].count(),
+                  completion_times[node_def].count(), node);
+  };
+  std::vector<int> num_pending = graph.num_pending;
+  for (int i = 0; i < graph.nodes.size(); ++i) {
+    if (num_pending[i] == 0) add_ready(i);
+  }
+  std::vector<int> newly_ready;
+  while (!ready.empty()) {
+    const int node = std::get<2>(*ready.begin());
+    ready.erase(ready.begin());
+    order->push_back(node);
+    newly_ready.clear();
+    ReleaseFanouts(graph, node, &num_pending, &newly_ready);
+    for (int fanout : newly_ready) add_ready(fanout);
+  }
+  return absl::OkStatus();
+}
+
+static void OrderByMemory(const ScheduleGraph& graph,
+                          std::vector<int>* order) {
+  const int num_nodes = graph.nodes.size();
+  std::vector<int> num_pending = graph.num_pending;
+  std::vector<int> num_consumers = graph.num_consumers;
+  std::vector<bool> is_ready(num_nodes, false);
+  std::vector<bool> is_done(num_nodes, false);
+
+  // The memory allocated minus the memory freed by running each ready node
+  // next. This only decreases as the other consumers of its inputs run.
+  std::vector<int64_t> deltas(num_nodes);
+  // Ready nodes by delta. Entries with an outdated delta are skipped.
+  typedef std::pair<int64_t, int> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> ready;
+  auto add_ready = [&](int node) {
+    int64_t delta = graph.output_sizes[node];
+    for (int fanin : graph.data_fanins[node]) {
+      if (num_consumers[fanin] == 1) delta -= graph.output_sizes[fanin];
+    }
+    deltas[node] = delta;
+    is_ready[node] = true;
+    ready.emplace(delta, node);
+  };
+  for (int i = 0; i < num_nodes; ++i) {
+    if (num_pending[i] == 0) add_ready(i);
+  }
+  std::vector<int> newly_ready;
+  while (!ready.empty()) {
+    const Entry entry = ready.top();
+    ready.pop();
+    const int node = entry.second;
+    if (is_done[node] || entry.first != deltas[node]) continue;
+    is_done[node] = true;
+    order->push_back(node);
+    for (int fanin : graph.data_fanins[node]) {
+      if (--num_consumers[fanin] == 1) {
+        // The last consumer of the fanin now frees it.
+        for (int consumer : graph.data_fanouts[fanin]) {
+          if (is_ready[consumer] && !is_done[consumer]) add_ready(consumer);
+        }
+      }
+    }
+    newly_ready.clear();
+    ReleaseFanouts(graph, node, &num_pending, &newly_ready);
+    for (int fanout : newly_ready) add_ready(fanout);
+  }
+}
+
+Status ComputeSchedulePriorities(
+    const GrapplerItem& item, const Cluster* cluster, SchedulePolicy policy,
+    std::unordered_map<const NodeDef*, int>* priorities) {
+  ScheduleGraph graph;
+  TF_RETURN_IF_ERROR(BuildScheduleGraph(
+      item, /*infer_output_sizes=*/policy == SchedulePolicy::kMemory, &graph));
+  std::vector<int> order;
+  order.reserve(graph.nodes.size());
+  switch (policy) {
+    case SchedulePolicy::kCriticalPath:
+      TF_RETURN_IF_ERROR(OrderByCriticalPath(item, cluster, graph, &order));
+      break;
+    case SchedulePolicy::kMemory:
+      OrderByMemory(graph, &order);
+      break;
+  }
+
+  priorities->clear();
+  for (int node : order) {
+    const int priority = priorities->size();
+    priorities->emplace(graph.nodes[node], priority);
+  }
+  return absl::OkStatus();
+}
+
+Status EstimatePeakMemoryUsage(
+    const GrapplerItem& item,
+    const std::unordered_map<const NodeDef*, int>& priorities,
+    int64_t* peak_memory) {
+  ScheduleGraph graph;
+  TF_RETURN_IF_ERROR(
+      BuildScheduleGraph(item, /*infer_output_sizes=*/true, &graph));
+  std::vector<int> order(graph.nodes.size());
+  std::iota(order.begin(), order.end(), 0);
+  auto priority = [&](int node) {
+    auto it = priorities.find(graph.nodes[node]);
+    return it == priorities.end() ? std::numeric_limits<int>::max()
+                                  : it->second;
+  };
+  std::stable_sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+    return priority(lhs) < priority(rhs);
+  });
+
+  std::vector<int> num_consumers = graph.num_consumers;
+  int64_t memory = 0;
+  *peak_memory = 0;
+  for (int node : order) {
+    // The inputs of the node are freed once it completes.
+    memory += graph.output_sizes[node];
+    *peak_memory = std::max(*peak_memory, memory);
+    for (int fanin : graph.data_fanins[node]) {
+      if (--num_consumers[fanin] == 0) memory -= graph.output_sizes[fanin];
+    }
+    if (num_consumers[node] == 0) memory -= graph.output_sizes[node];
+  }
+  return absl::OkStatus();
+}
+
 }  // end namespace grappler
 }  // end namespace tensorflow
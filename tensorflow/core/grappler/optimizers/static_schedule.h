@@ -44,6 +44,34 @@ Status EstimateRequiredTimes(
         execution_times,
     std::unordered_map<const NodeDef*, Costs::NanoSeconds>* required_times);
 
+// The orders in which ComputeSchedulePriorities can run the nodes.
+enum class SchedulePolicy {
+  // Run first the nodes with the earliest required time, i.e. those on the
+  // longest paths to the outputs of the graph, to shorten its critical path.
+  kCriticalPath,
+  // Run first the nodes that free the most memory for the least they allocate,
+  // as estimated from the statically inferred shapes, to lower the peak memory.
+  kMemory,
+};
+
+// Compute the position of each node of the graph in a topological order chosen
+// by `policy`. These priorities can be attached to the nodes as their
+// "_schedule_priority" attrs: when several nodes are ready, the executor runs
+// first those with the lowest priority. Nodes that are never ready, i.e. in
+// loops without a Merge, get no priority, and the executor runs them last.
+// The cluster is only used by kCriticalPath, and can be null for kMemory.
+Status ComputeSchedulePriorities(
+    const GrapplerItem& item, const Cluster* cluster, SchedulePolicy policy,
+    std::unordered_map<const NodeDef*, int>* priorities);
+
+// Estimate the peak memory used by the outputs of the nodes of the graph when
+// they run one at a time in the order of their priorities. Nodes without a
+// priority run last.
+Status EstimatePeakMemoryUsage(
+    const GrapplerItem& item,
+    const std::unordered_map<const NodeDef*, int>& priorities,
+    int64_t* peak_memory);
+
 }  // namespace grappler
 }  // end namespace tensorflow
 
@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
 
 namespace tensorflow {
@@ -196,6 +197,90 @@ TEST_F(StaticScheduleTest, RequiredTimes) {
                                       "Sign_2", "Sign_3", "y"}));
 }
 
+TEST_F(StaticScheduleTest, CriticalPathPriorities) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({100, 100}));
+  Output a = ops::Sqrt(s.WithOpName("a"), x);
+  Output b1 = ops::Square(s.WithOpName("b1"), x);
+  Output b2 = ops::Square(s.WithOpName("b2"), b1);
+  Output b3 = ops::Square(s.WithOpName("b3"), b2);
+  Output y = ops::Add(s.WithOpName("y"), a, b3);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"y"};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  std::unordered_map<const NodeDef*, int> priorities;
+  TF_EXPECT_OK(ComputeSchedulePriorities(
+      item, cluster.get(), SchedulePolicy::kCriticalPath, &priorities));
+  EXPECT_EQ(item.graph.node_size(), priorities.size());
+
+  std::unordered_map<string, int> priority_by_name;
+  for (const auto& node_priority : priorities) {
+    priority_by_name[node_priority.first->name()] = node_priority.second;
+  }
+  // The long chain starts before the short one.
+  EXPECT_LT(priority_by_name["b1"], priority_by_name["a"]);
+  EXPECT_LT(priority_by_name["x"], priority_by_name["b1"]);
+  EXPECT_LT(priority_by_name["b3"], priority_by_name["y"]);
+  EXPECT_LT(priority_by_name["a"], priority_by_name["y"]);
+
+  EXPECT_FALSE(ComputeSchedulePriorities(item, /*cluster=*/nullptr,
+                                         SchedulePolicy::kCriticalPath,
+                                         &priorities)
+                   .ok());
+}
+
+TEST_F(StaticScheduleTest, MemoryPriorities) {
+  // Four 4kB tensors, each reduced to a scalar.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({1000}));
+  std::vector<Output> squares;
+  for (int i = 0; i < 4; ++i) {
+    squares.push_back(ops::Square(s.WithOpName(strings::StrCat("sq", i)), x));
+  }
+  Output axis = ops::Const(s.WithOpName("axis"), 0);
+  std::vector<Output> sums;
+  for (int i = 0; i < 4; ++i) {
+    sums.push_back(
+        ops::Sum(s.WithOpName(strings::StrCat("sum", i)), squares[i], axis));
+  }
+  Output y = ops::AddN(s.WithOpName("y"), sums);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"y"};
+
+  std::unordered_map<const NodeDef*, int> priorities;
+  TF_EXPECT_OK(ComputeSchedulePriorities(item, /*cluster=*/nullptr,
+                                         SchedulePolicy::kMemory, &priorities));
+  EXPECT_EQ(item.graph.node_size(), priorities.size());
+  std::unordered_map<string, int> priority_by_name;
+  for (const auto& node_priority : priorities) {
+    priority_by_name[node_priority.first->name()] = node_priority.second;
+  }
+  // Each tensor is reduced before the next one is computed.
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(priority_by_name[strings::StrCat("sq", i)] + 1,
+              priority_by_name[strings::StrCat("sum", i)]);
+  }
+
+  std::unordered_map<const NodeDef*, int> graph_order;
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    graph_order[&item.graph.node(i)] = i;
+  }
+  int64_t graph_order_peak_memory;
+  TF_EXPECT_OK(
+      EstimatePeakMemoryUsage(item, graph_order, &graph_order_peak_memory));
+  EXPECT_GE(graph_order_peak_memory, 5 * 4000);
+  int64_t peak_memory;
+  TF_EXPECT_OK(EstimatePeakMemoryUsage(item, priorities, &peak_memory));
+  EXPECT_LE(peak_memory, 2 * 4000 + 64);
+}
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
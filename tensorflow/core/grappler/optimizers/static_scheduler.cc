@@ -0,0 +1,64 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/static_scheduler.h"
+
+#include <unordered_map>
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+namespace grappler {
+
+Status StaticScheduler::Init(
+    const RewriterConfig_CustomGraphOptimizer* config) {
+  if (config == nullptr) return absl::OkStatus();
+  auto it = config->parameter_map().find("policy");
+  if (it == config->parameter_map().end()) return absl::OkStatus();
+  if (it->second.s() == "critical_path") {
+    policy_ = SchedulePolicy::kCriticalPath;
+  } else if (it->second.s() == "memory") {
+    policy_ = SchedulePolicy::kMemory;
+  } else {
+    return errors::InvalidArgument("Unknown schedule policy ",
+                                   it->second.s(),
+                                   ", expected critical_path or memory.");
+  }
+  return absl::OkStatus();
+}
+
+Status StaticScheduler::Optimize(Cluster* cluster, const GrapplerItem& item,
+                                 GraphDef* optimized_graph) {
+  std::unordered_map<const NodeDef*, int> priorities;
+  TF_RETURN_IF_ERROR(
+      ComputeSchedulePriorities(item, cluster, policy_, &priorities));
+  *optimized_graph = item.graph;
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    // Nodes left without a priority run after all the others.
+    auto it = priorities.find(&item.graph.node(i));
+    if (it == priorities.end()) continue;
+    (*optimized_graph->mutable_node(i)->mutable_attr())["_schedule_priority"]
+        .set_i(it->second);
+  }
+  return absl::OkStatus();
+}
+
+REGISTER_GRAPH_OPTIMIZER_AS(StaticScheduler, "static_scheduler");
+
+}  // namespace grappler
+}  // namespace tensorflow
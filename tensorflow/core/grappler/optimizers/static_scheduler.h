@@ -0,0 +1,52 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_STATIC_SCHEDULER_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_STATIC_SCHEDULER_H_
+
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/static_schedule.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Attaches to each node of the graph its priority in the order computed by
+// ComputeSchedulePriorities, as its "_schedule_priority" attr. When several
+// nodes are ready, the executor runs first those with the lowest priority.
+//
+// The "policy" param of the rewriter config selects the order: either
+// "critical_path", the default, or "memory".
+class StaticScheduler : public CustomGraphOptimizer {
+ public:
+  StaticScheduler() = default;
+  explicit StaticScheduler(SchedulePolicy policy) : policy_(policy) {}
+
+  Status Init(const RewriterConfig_CustomGraphOptimizer* config) override;
+
+  string name() const override { return "static_scheduler"; }
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+ private:
+  SchedulePolicy policy_ = SchedulePolicy::kCriticalPath;
+};
+
+}  // namespace grappler
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_STATIC_SCHEDULER_H_
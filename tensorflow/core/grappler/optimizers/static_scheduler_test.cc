@@ -0,0 +1,97 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/static_scheduler.h"
+
+#include <memory>
+#include <unordered_map>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+GrapplerItem MakeItem() {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({100, 100}));
+  Output a = ops::Sqrt(s.WithOpName("a"), x);
+  Output b = ops::Square(s.WithOpName("b"), ops::Square(s.WithOpName("c"), x));
+  Output y = ops::Add(s.WithOpName("y"), a, b);
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"y"};
+  return item;
+}
+
+// Returns the "_schedule_priority" attrs of the nodes, by name.
+std::unordered_map<string, int> GetPriorities(const GraphDef& graph) {
+  std::unordered_map<string, int> priorities;
+  for (const NodeDef& node : graph.node()) {
+    auto it = node.attr().find("_schedule_priority");
+    if (it != node.attr().end()) priorities[node.name()] = it->second.i();
+  }
+  return priorities;
+}
+
+TEST(StaticSchedulerTest, CriticalPath) {
+  const GrapplerItem item = MakeItem();
+  DeviceProperties cpu_device;
+  cpu_device.set_type("CPU");
+  cpu_device.set_frequency(1000);
+  cpu_device.set_num_cores(4);
+  cpu_device.set_bandwidth(32);
+  VirtualCluster cluster(
+      {{"/job:localhost/replica:0/task:0/cpu:0", cpu_device}});
+
+  StaticScheduler optimizer;
+  TF_ASSERT_OK(optimizer.Init(nullptr));
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(&cluster, item, &output));
+  std::unordered_map<string, int> priorities = GetPriorities(output);
+  ASSERT_EQ(item.graph.node_size(), priorities.size());
+  EXPECT_EQ(0, priorities["x"]);
+  EXPECT_LT(priorities["c"], priorities["a"]);
+  EXPECT_EQ(item.graph.node_size() - 1, priorities["y"]);
+}
+
+TEST(StaticSchedulerTest, MemoryPolicy) {
+  const GrapplerItem item = MakeItem();
+  RewriterConfig_CustomGraphOptimizer config;
+  (*config.mutable_parameter_map())["policy"].set_s("memory");
+  StaticScheduler optimizer;
+  TF_ASSERT_OK(optimizer.Init(&config));
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(/*cluster=*/nullptr, item, &output));
+  std::unordered_map<string, int> priorities = GetPriorities(output);
+  ASSERT_EQ(item.graph.node_size(), priorities.size());
+  EXPECT_LT(priorities["x"], priorities["a"]);
+  EXPECT_LT(priorities["c"], priorities["b"]);
+  EXPECT_EQ(item.graph.node_size() - 1, priorities["y"]);
+
+  (*config.mutable_parameter_map())["policy"].set_s("fastest");
+  EXPECT_FALSE(optimizer.Init(&config).ok());
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -69,6 +69,21 @@ static std::unique_ptr<OpKernel> BuildOpKernel(OpKernelConstruction* c,
   return k;
 }
 
+// Reads the optional RingReduce compression attrs of a reduction node into
+// "impl_details".
+static Status GetRingReduceCompression(OpKernelConstruction* c,
+                                       CollImplDetails* impl_details) {
+  if (c->HasAttr(kRingReduceCompressionAttr)) {
+    TF_RETURN_IF_ERROR(
+        c->GetAttr(kRingReduceCompressionAttr, &impl_details->compression));
+  }
+  if (c->HasAttr(kRingReduceCompressionTopKRatioAttr)) {
+    TF_RETURN_IF_ERROR(c->GetAttr(kRingReduceCompressionTopKRatioAttr,
+                                  &impl_details->compression_topk_ratio));
+  }
+  return absl::OkStatus();
+}
+
 class CollectiveOpV1Kernel : public AsyncOpKernel {
  public:
   explicit CollectiveOpV1Kernel(OpKernelConstruction* c)
@@ -266,6 +281,8 @@ class CollectiveReduceOpKernel : public CollectiveOpV1Kernel {
     OP_REQUIRES_OK(
         c, c->GetAttr("timeout_seconds",
                       &col_params_->instance.impl_details.timeout_seconds));
+    OP_REQUIRES_OK(c, GetRingReduceCompression(
+                          c, &col_params_->instance.impl_details));
     VLOG(2) << "CollectiveReduce instance "
             << col_params_->instance.instance_key << " merge_op "
             << merge_op_name << " final_op " << final_op_name
@@ -776,6 +793,7 @@ class CollectiveReduceV2OpKernel : public CollectiveOpV2Kernel {
     OP_REQUIRES_OK(c, c->GetAttr("final_op", &final_op_name));
     OP_REQUIRES_OK(
         c, c->GetAttr("max_subdivs_per_device", &max_subdivs_per_device_));
+    OP_REQUIRES_OK(c, GetRingReduceCompression(c, &compression_details_));
     // Prepare OpKernels for reduction and final operations.
     // The merge_op takes two inputs
     NodeDef sub_node;
@@ -806,6 +824,10 @@ class CollectiveReduceV2OpKernel : public CollectiveOpV2Kernel {
         done_with_cleanup);
     col_params->instance.impl_details.max_subdivs_per_device =
         max_subdivs_per_device_;
+    col_params->instance.impl_details.compression =
+        compression_details_.compression;
+    col_params->instance.impl_details.compression_topk_ratio =
+        compression_details_.compression_topk_ratio;
     col_params->instance.shape = c->input(0).shape();
     col_params->merge_op = merge_op_.get();
     col_params->final_op = final_op_.get();
@@ -826,6 +848,8 @@ class CollectiveReduceV2OpKernel : public CollectiveOpV2Kernel {
 
  private:
   int max_subdivs_per_device_;
+  // Only the compression fields are used.
+  CollImplDetails compression_details_;
   std::unique_ptr<OpKernel> merge_op_;
   std::unique_ptr<OpKernel> final_op_;
 };
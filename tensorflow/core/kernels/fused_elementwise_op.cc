@@ -0,0 +1,408 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Eigen/Core"  // from @eigen_archive
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Target number of elements of `x` processed per block. The block and the
+// buffer an argument is converted into take 8KiB each for float, so every op
+// of the chain runs on data in L1.
+constexpr int64_t kFusedElementwiseBlockSize = 2048;
+
+// The chain runs in float for the 16-bit types. Unlike with the unfused
+// ops, intermediate values are not rounded to 16 bits.
+template <typename T>
+struct FusedElementwiseComputeType {
+  using type = T;
+};
+template <>
+struct FusedElementwiseComputeType<Eigen::half> {
+  using type = float;
+};
+template <>
+struct FusedElementwiseComputeType<bfloat16> {
+  using type = float;
+};
+
+enum class FusedElementwiseFn {
+  // Unary.
+  kRelu,
+  kRelu6,
+  kElu,
+  kSelu,
+  kSigmoid,
+  kTanh,
+  kExp,
+  kLog,
+  kNeg,
+  kAbs,
+  kSquare,
+  kSqrt,
+  kRsqrt,
+  kReciprocal,
+  // Binary.
+  kAdd,
+  kSub,
+  kMul,
+  kDiv,
+  kMaximum,
+  kMinimum,
+  kSquaredDifference,
+};
+
+bool ParseFusedElementwiseFn(const string& name, FusedElementwiseFn* fn,
+                             bool* is_binary) {
+  static const auto* const kOps =
+      new std::vector<std::pair<string, FusedElementwiseFn>>{
+          {"Relu", FusedElementwiseFn::kRelu},
+          {"Relu6", FusedElementwiseFn::kRelu6},
+          {"Elu", FusedElementwiseFn::kElu},
+          {"Selu", FusedElementwiseFn::kSelu},
+          {"Sigmoid", FusedElementwiseFn::kSigmoid},
+          {"Tanh", FusedElementwiseFn::kTanh},
+          {"Exp", FusedElementwiseFn::kExp},
+          {"Log", FusedElementwiseFn::kLog},
+          {"Neg", FusedElementwiseFn::kNeg},
+          {"Abs", FusedElementwiseFn::kAbs},
+          {"Square", FusedElementwiseFn::kSquare},
+          {"Sqrt", FusedElementwiseFn::kSqrt},
+          {"Rsqrt", FusedElementwiseFn::kRsqrt},
+          {"Reciprocal", FusedElementwiseFn::kReciprocal},
+          {"Add", FusedElementwiseFn::kAdd},
+          {"AddV2", FusedElementwiseFn::kAdd},
+          {"BiasAdd", FusedElementwiseFn::kAdd},
+          {"Sub", FusedElementwiseFn::kSub},
+          {"Mul", FusedElementwiseFn::kMul},
+          {"RealDiv", FusedElementwiseFn::kDiv},
+          {"Maximum", FusedElementwiseFn::kMaximum},
+          {"Minimum", FusedElementwiseFn::kMinimum},
+          {"SquaredDifference", FusedElementwiseFn::kSquaredDifference},
+      };
+  for (const auto& entry : *kOps) {
+    if (entry.first == name) {
+      *fn = entry.second;
+      *is_binary = entry.second >= FusedElementwiseFn::kAdd;
+      return true;
+    }
+  }
+  return false;
+}
+
+struct FusedElementwiseStep {
+  FusedElementwiseFn fn;
+  int arg = -1;  // Index into `args` for binary ops.
+  bool chain_is_rhs = false;
+};
+
+template <typename C>
+using BlockMap = Eigen::Map<Eigen::Array<C, Eigen::Dynamic, 1>>;
+
+template <typename C>
+void ApplyUnary(FusedElementwiseFn fn, BlockMap<C>* v) {
+  BlockMap<C>& x = *v;
+  switch (fn) {
+    case FusedElementwiseFn::kRelu:
+      x = x.max(C(0));
+      break;
+    case FusedElementwiseFn::kRelu6:
+      x = x.max(C(0)).min(C(6));
+      break;
+    case FusedElementwiseFn::kElu:
+      x = (x < C(0)).select(x.exp() - C(1), x);
+      break;
+    case FusedElementwiseFn::kSelu: {
+      const C scale(1.0507009873554804934193349852946);
+      const C scale_alpha(1.7580993408473768599402175208123);
+      x = (x < C(0)).select(scale_alpha * (x.exp() - C(1)), scale * x);
+      break;
+    }
+    case FusedElementwiseFn::kSigmoid:
+      x = x.unaryExpr(Eigen::internal::scalar_logistic_op<C>());
+      break;
+    case FusedElementwiseFn::kTanh:
+      x = x.tanh();
+      break;
+    case FusedElementwiseFn::kExp:
+      x = x.exp();
+      break;
+    case FusedElementwiseFn::kLog:
+      x = x.log();
+      break;
+    case FusedElementwiseFn::kNeg:
+      x = -x;
+      break;
+    case FusedElementwiseFn::kAbs:
+      x = x.abs();
+      break;
+    case FusedElementwiseFn::kSquare:
+      x = x.square();
+      break;
+    case FusedElementwiseFn::kSqrt:
+      x = x.sqrt();
+      break;
+    case FusedElementwiseFn::kRsqrt:
+      x = x.rsqrt();
+      break;
+    case FusedElementwiseFn::kReciprocal:
+      x = x.inverse();
+      break;
+    default:
+      break;
+  }
+}
+
+// `y` is either an array of the block size or a scalar.
+template <typename C, typename Y>
+void ApplyBinary(const FusedElementwiseStep& step, BlockMap<C>* v,
+                 const Y& y) {
+  BlockMap<C>& x = *v;
+  switch (step.fn) {
+    case FusedElementwiseFn::kAdd:
+      x = x + y;
+      break;
+    case FusedElementwiseFn::kSub:
+      if (step.chain_is_rhs) {
+        x = y - x;
+      } else {
+        x = x - y;
+      }
+      break;
+    case FusedElementwiseFn::kMul:
+      x = x * y;
+      break;
+    case FusedElementwiseFn::kDiv:
+      if (step.chain_is_rhs) {
+        x = y / x;
+      } else {
+        x = x / y;
+      }
+      break;
+    case FusedElementwiseFn::kMaximum:
+      x = x.template max<Eigen::PropagateNaN>(y);
+      break;
+    case FusedElementwiseFn::kMinimum:
+      x = x.template min<Eigen::PropagateNaN>(y);
+      break;
+    case FusedElementwiseFn::kSquaredDifference:
+      x = (x - y).square();
+      break;
+    default:
+      break;
+  }
+}
+
+enum class FusedElementwiseBroadcast { kScalar, kFull, kLastDim };
+
+}  // namespace
+
+// Applies a chain of elementwise ops to `x`, as fused by the remapper. `x`
+// is processed in blocks that stay in cache while every op of the chain is
+// applied to them, so each element of `x`, of the arguments and of the
+// output crosses the memory bus once instead of once per op.
+template <typename T>
+class FusedElementwiseOp : public OpKernel {
+ public:
+  using C = typename FusedElementwiseComputeType<T>::type;
+  using Array = Eigen::Array<C, Eigen::Dynamic, 1>;
+
+  explicit FusedElementwiseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    int num_args;
+    OP_REQUIRES_OK(context, context->GetAttr("num_args", &num_args));
+    std::vector<string> fused_ops;
+    OP_REQUIRES_OK(context, context->GetAttr("fused_ops", &fused_ops));
+    std::vector<bool> chain_is_rhs;
+    OP_REQUIRES_OK(context, context->GetAttr("chain_is_rhs", &chain_is_rhs));
+    OP_REQUIRES(context,
+                chain_is_rhs.empty() || chain_is_rhs.size() == fused_ops.size(),
+                errors::InvalidArgument(
+                    "chain_is_rhs must be empty or have one entry per fused "
+                    "op, got ",
+                    chain_is_rhs.size(), " for ", fused_ops.size(), " ops"));
+    OP_REQUIRES(context, !fused_ops.empty(),
+                errors::InvalidArgument("fused_ops must not be empty"));
+    int next_arg = 0;
+    for (int i = 0; i < fused_ops.size(); ++i) {
+      FusedElementwiseStep step;
+      bool is_binary = false;
+      OP_REQUIRES(context,
+                  ParseFusedElementwiseFn(fused_ops[i], &step.fn, &is_binary),
+                  errors::Unimplemented("Unsupported fused elementwise op: ",
+                                        fused_ops[i]));
+      if (is_binary) {
+        step.arg = next_arg++;
+        step.chain_is_rhs = !chain_is_rhs.empty() && chain_is_rhs[i];
+      }
+      steps_.push_back(step);
+    }
+    OP_REQUIRES(context, next_arg == num_args,
+                errors::InvalidArgument("The fused ops take ", next_arg,
+                                        " arguments, but num_args is ",
+                                        num_args));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& x = context->input(0);
+    OpInputList args;
+    OP_REQUIRES_OK(context, context->input_list("args", &args));
+
+    const int64_t n = x.NumElements();
+    const int64_t last_dim = x.dims() > 0 ? x.dim_size(x.dims() - 1) : 1;
+    std::vector<FusedElementwiseBroadcast> broadcasts(args.size());
+    for (int i = 0; i < args.size(); ++i) {
+      const Tensor& arg = args[i];
+      if (arg.NumElements() == 1) {
+        broadcasts[i] = FusedElementwiseBroadcast::kScalar;
+      } else if (arg.shape() == x.shape()) {
+        broadcasts[i] = FusedElementwiseBroadcast::kFull;
+      } else {
+        bool is_last_dim_vector =
+            arg.dims() >= 1 && arg.dims() <= x.dims() &&
+            arg.dim_size(arg.dims() - 1) == last_dim;
+        for (int d = 0; d + 1 < arg.dims(); ++d) {
+          is_last_dim_vector &= arg.dim_size(d) == 1;
+        }
+        OP_REQUIRES(context, is_last_dim_vector,
+                    errors::InvalidArgument(
+                        "Argument ", i, " of shape ", arg.shape().DebugString(),
+                        " does not broadcast to ", x.shape().DebugString()));
+        broadcasts[i] = FusedElementwiseBroadcast::kLastDim;
+      }
+    }
+
+    Tensor* y = nullptr;
+    OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
+                                {0}, 0, x.shape(), &y));
+    if (n == 0) return;
+
+    // If the last dimension fits in a block, blocks start at multiples of
+    // `last_dim`, so the vectors over the last dimension can be tiled once to
+    // the block size. Otherwise each block reads the part of the vectors it
+    // covers, which wraps around at most once per row.
+    const bool tile_last_dim = last_dim <= kFusedElementwiseBlockSize;
+    const int64_t block_size =
+        tile_last_dim ? (kFusedElementwiseBlockSize / last_dim) * last_dim
+                      : kFusedElementwiseBlockSize;
+    const int64_t num_blocks = (n + block_size - 1) / block_size;
+
+    std::vector<C> scalars(args.size());
+    std::vector<Array> tiled(args.size());
+    for (int i = 0; i < args.size(); ++i) {
+      const T* data = args[i].flat<T>().data();
+      if (broadcasts[i] == FusedElementwiseBroadcast::kScalar) {
+        scalars[i] = static_cast<C>(data[0]);
+      } else if (broadcasts[i] == FusedElementwiseBroadcast::kLastDim &&
+                 tile_last_dim) {
+        tiled[i].resize(std::min(block_size, n));
+        for (int64_t j = 0; j < tiled[i].size(); ++j) {
+          tiled[i][j] = static_cast<C>(data[j % last_dim]);
+        }
+      }
+    }
+
+    const T* x_data = x.flat<T>().data();
+    T* y_data = y->flat<T>().data();
+    auto work = [&](int64_t begin, int64_t end) {
+      Array block(block_size);
+      Array operand(block_size);
+      for (int64_t b = begin; b < end; ++b) {
+        const int64_t offset = b * block_size;
+        const int64_t len = std::min(block_size, n - offset);
+        BlockMap<C> v(block.data(), len);
+        v = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>(
+                x_data + offset, len)
+                .template cast<C>();
+        for (const FusedElementwiseStep& step : steps_) {
+          if (step.arg < 0) {
+            ApplyUnary<C>(step.fn, &v);
+            continue;
+          }
+          switch (broadcasts[step.arg]) {
+            case FusedElementwiseBroadcast::kScalar:
+              ApplyBinary<C>(step, &v, scalars[step.arg]);
+              break;
+            case FusedElementwiseBroadcast::kLastDim: {
+              if (tile_last_dim) {
+                ApplyBinary<C>(step, &v, tiled[step.arg].head(len));
+                break;
+              }
+              const T* data = args[step.arg].flat<T>().data();
+              BlockMap<C> w(operand.data(), len);
+              int64_t pos = offset % last_dim;
+              for (int64_t j = 0; j < len;) {
+                const int64_t run = std::min(len - j, last_dim - pos);
+                w.segment(j, run) =
+                    Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>(
+                        data + pos, run)
+                        .template cast<C>();
+                j += run;
+                pos = 0;
+              }
+              ApplyBinary<C>(step, &v, w);
+              break;
+            }
+            case FusedElementwiseBroadcast::kFull: {
+              BlockMap<C> w(operand.data(), len);
+              w = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>(
+                      args[step.arg].flat<T>().data() + offset, len)
+                      .template cast<C>();
+              ApplyBinary<C>(step, &v, w);
+              break;
+            }
+          }
+        }
+        Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>>(y_data + offset, len) =
+            v.template cast<T>();
+      }
+    };
+
+    const int64_t cost_per_block =
+        block_size * (2 + 4 * static_cast<int64_t>(steps_.size()));
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          cost_per_block, work);
+  }
+
+ private:
+  std::vector<FusedElementwiseStep> steps_;
+};
+
+#define REGISTER_CPU_KERNEL(type)                                          \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("_FusedElementwise").Device(DEVICE_CPU).TypeConstraint<type>("T"), \
+      FusedElementwiseOp<type>);
+
+TF_CALL_FLOAT_TYPES(REGISTER_CPU_KERNEL);
+
+#undef REGISTER_CPU_KERNEL
+
+}  // namespace tensorflow
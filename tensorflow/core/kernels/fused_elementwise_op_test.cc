@@ -0,0 +1,185 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedElementwiseOpTest : public OpsTestBase {
+ protected:
+  Status MakeOp(const std::vector<string>& fused_ops,
+                const std::vector<bool>& chain_is_rhs, int num_args,
+                DataType dtype = DT_FLOAT) {
+    TF_RETURN_IF_ERROR(NodeDefBuilder("fused", "_FusedElementwise")
+                           .Input(FakeInput(dtype))
+                           .Input(FakeInput(num_args, dtype))
+                           .Attr("fused_ops", fused_ops)
+                           .Attr("chain_is_rhs", chain_is_rhs)
+                           .Finalize(node_def()));
+    return InitOp();
+  }
+};
+
+TEST_F(FusedElementwiseOpTest, UnaryChain) {
+  TF_ASSERT_OK(MakeOp({"Neg", "Relu", "Sqrt"}, {}, 0));
+  AddInputFromArray<float>(TensorShape({4}), {-4, -1, 0, 9});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4}));
+  test::FillValues<float>(&expected, {2, 1, 0, 0});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-6);
+}
+
+TEST_F(FusedElementwiseOpTest, Broadcasts) {
+  // 1 / (x * 2 + bias - full), with a scalar, a vector over the last
+  // dimension, a full and a single-element argument.
+  TF_ASSERT_OK(MakeOp({"Mul", "BiasAdd", "Sub", "RealDiv"},
+                      {false, false, false, true}, 4));
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({}), {2});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  AddInputFromArray<float>(TensorShape({2, 3}), {2, 4, 7, 9, 10, 14});
+  AddInputFromArray<float>(TensorShape({1}), {1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  const std::vector<float> x = {1, 2, 3, 4, 5, 6};
+  const std::vector<float> bias = {1, 2, 3};
+  const std::vector<float> full = {2, 4, 7, 9, 10, 14};
+  std::vector<float> values;
+  for (int i = 0; i < 6; ++i) {
+    values.push_back(1.0f / (x[i] * 2 + bias[i % 3] - full[i]));
+  }
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected, values);
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-6);
+}
+
+TEST_F(FusedElementwiseOpTest, MatchesUnfusedOverManyBlocks) {
+  // Larger than a block and not a multiple of the last dimension.
+  const int64_t rows = 1000, cols = 7;
+  TF_ASSERT_OK(MakeOp({"Sigmoid", "Mul", "Maximum", "Tanh"}, {}, 2));
+  std::vector<float> x(rows * cols), full(rows * cols);
+  for (int i = 0; i < x.size(); ++i) {
+    x[i] = std::sin(0.01f * i) * 4;
+    full[i] = std::cos(0.02f * i);
+  }
+  AddInputFromArray<float>(TensorShape({rows, cols}), x);
+  AddInputFromArray<float>(TensorShape({rows, cols}), full);
+  AddInputFromArray<float>(TensorShape({1, cols}),
+                           {-0.3, -0.2, -0.1, 0, 0.1, 0.2, 0.3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<float> values(x.size());
+  for (int i = 0; i < x.size(); ++i) {
+    const float sigmoid = 1.0f / (1.0f + std::exp(-x[i]));
+    const float channel = -0.3f + 0.1f * (i % cols);
+    values[i] = std::tanh(std::max(sigmoid * full[i], channel));
+  }
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({rows, cols}));
+  test::FillValues<float>(&expected, values);
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedElementwiseOpTest, LargeVector) {
+  // A single dimension spanning many blocks.
+  const int64_t size = 100000;
+  TF_ASSERT_OK(MakeOp({"Mul", "AddV2", "Relu"}, {}, 2));
+  std::vector<float> x(size), full(size);
+  for (int i = 0; i < size; ++i) {
+    x[i] = std::sin(0.01f * i);
+    full[i] = std::cos(0.03f * i);
+  }
+  AddInputFromArray<float>(TensorShape({size}), x);
+  AddInputFromArray<float>(TensorShape({}), {3});
+  AddInputFromArray<float>(TensorShape({size}), full);
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<float> values(size);
+  for (int i = 0; i < size; ++i) {
+    values[i] = std::max(x[i] * 3 + full[i], 0.0f);
+  }
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({size}));
+  test::FillValues<float>(&expected, values);
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedElementwiseOpTest, LargeLastDimension) {
+  // Rows longer than a block and not a multiple of it, so blocks start in
+  // the middle of a row and some cross into the next one.
+  const int64_t rows = 3, cols = 5000;
+  TF_ASSERT_OK(MakeOp({"BiasAdd", "Sub", "Tanh"}, {false, true, false}, 2));
+  std::vector<float> x(rows * cols), bias(cols), other(cols);
+  for (int i = 0; i < x.size(); ++i) x[i] = std::sin(0.01f * i);
+  for (int i = 0; i < cols; ++i) {
+    bias[i] = 0.001f * i;
+    other[i] = std::cos(0.02f * i);
+  }
+  AddInputFromArray<float>(TensorShape({rows, cols}), x);
+  AddInputFromArray<float>(TensorShape({cols}), bias);
+  AddInputFromArray<float>(TensorShape({1, cols}), other);
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<float> values(x.size());
+  for (int i = 0; i < x.size(); ++i) {
+    values[i] = std::tanh(other[i % cols] - (x[i] + bias[i % cols]));
+  }
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({rows, cols}));
+  test::FillValues<float>(&expected, values);
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedElementwiseOpTest, Half) {
+  TF_ASSERT_OK(MakeOp({"AddV2", "Relu6"}, {}, 1, DT_HALF));
+  AddInputFromArray<Eigen::half>(
+      TensorShape({3}),
+      {Eigen::half(-1.0f), Eigen::half(2.0f), Eigen::half(7.0f)});
+  AddInputFromArray<Eigen::half>(TensorShape({}), {Eigen::half(0.5f)});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_HALF, TensorShape({3}));
+  test::FillValues<Eigen::half>(
+      &expected, {Eigen::half(0.0f), Eigen::half(2.5f), Eigen::half(6.0f)});
+  test::ExpectTensorEqual<Eigen::half>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedElementwiseOpTest, RejectsBadArguments) {
+  TF_ASSERT_OK(MakeOp({"Add"}, {}, 1));
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(absl::StrContains(s.message(), "does not broadcast")) << s;
+}
+
+TEST_F(FusedElementwiseOpTest, RejectsBadAttributes) {
+  EXPECT_FALSE(MakeOp({"Cosh"}, {}, 0).ok());
+  EXPECT_FALSE(MakeOp({"Add", "Relu"}, {}, 0).ok());
+  EXPECT_FALSE(MakeOp({"Sub", "Relu"}, {true}, 1).ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
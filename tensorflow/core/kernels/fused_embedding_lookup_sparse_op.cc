@@ -0,0 +1,269 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "absl/base/prefetch.h"
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Number of ids ahead of the current one whose params row is prefetched.
+constexpr int64_t kEmbeddingPrefetchDistance = 4;
+
+// Rows are accumulated in float for the 16-bit types, matching the
+// precision of the unfused SparseSegmentReduction kernels.
+template <typename T>
+struct EmbeddingAccumType {
+  using type = T;
+};
+template <>
+struct EmbeddingAccumType<Eigen::half> {
+  using type = float;
+};
+template <>
+struct EmbeddingAccumType<bfloat16> {
+  using type = float;
+};
+
+enum class EmbeddingCombiner { kSum, kMean, kSqrtN };
+
+}  // namespace
+
+// Computes combiner(params[ids] * weights) per segment. This is the fusion
+// of Unique + Gather + SparseSegment{Sum,Mean,SqrtN} produced by the
+// remapper: each output row is accumulated straight from the rows of
+// `params`, so the gathered [nnz, ...] intermediate is never materialized.
+template <typename T, typename Tidx, typename Tsegmentids>
+class FusedEmbeddingLookupSparseOp : public OpKernel {
+ public:
+  using Accum = typename EmbeddingAccumType<T>::type;
+
+  explicit FusedEmbeddingLookupSparseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_weights", &num_weights_));
+    OP_REQUIRES(context, num_weights_ <= 1,
+                errors::InvalidArgument("num_weights must be 0 or 1, got ",
+                                        num_weights_));
+    string combiner;
+    OP_REQUIRES_OK(context, context->GetAttr("combiner", &combiner));
+    if (combiner == "sum") {
+      combiner_ = EmbeddingCombiner::kSum;
+    } else if (combiner == "mean") {
+      combiner_ = EmbeddingCombiner::kMean;
+    } else if (combiner == "sqrtn") {
+      combiner_ = EmbeddingCombiner::kSqrtN;
+    } else {
+      context->CtxFailure(
+          errors::InvalidArgument("Unsupported combiner: ", combiner));
+    }
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& params = context->input(0);
+    const Tensor& ids = context->input(1);
+    const Tensor& segment_ids = context->input(2);
+
+    OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(params.shape()),
+                errors::InvalidArgument("params must be at least 1-D, got ",
+                                        params.shape().DebugString()));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids should be a vector, got ",
+                                        ids.shape().DebugString()));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(segment_ids.shape()),
+                errors::InvalidArgument("segment_ids should be a vector, got ",
+                                        segment_ids.shape().DebugString()));
+    const int64_t nnz = ids.NumElements();
+    OP_REQUIRES(context, segment_ids.NumElements() == nnz,
+                errors::InvalidArgument(
+                    "segment_ids and ids should have same size: ",
+                    segment_ids.NumElements(), " vs ", nnz));
+
+    const T* weights = nullptr;
+    bool broadcast_weight = false;
+    if (num_weights_ == 1) {
+      const Tensor& weights_tensor = context->input(3);
+      const int64_t num_weight_elements = weights_tensor.NumElements();
+      OP_REQUIRES(context,
+                  num_weight_elements == nnz || num_weight_elements == 1,
+                  errors::InvalidArgument(
+                      "weights must have one element per id or a single "
+                      "element, got shape ",
+                      weights_tensor.shape().DebugString(), " for ", nnz,
+                      " ids"));
+      weights = weights_tensor.unaligned_flat<T>().data();
+      broadcast_weight = num_weight_elements == 1 && nnz != 1;
+    }
+
+    const int64_t num_params_rows = params.dim_size(0);
+    int64_t row_elems = 1;
+    for (int d = 1; d < params.dims(); ++d) {
+      row_elems *= params.dim_size(d);
+    }
+
+    const auto ids_vec = ids.vec<Tidx>();
+    const auto segment_vec = segment_ids.vec<Tsegmentids>();
+
+    // Validate the ids and the ordering of the segment ids, and count the
+    // ids per segment so that each output row knows its range of ids.
+    const int64_t num_segments =
+        nnz > 0 ? static_cast<int64_t>(segment_vec(nnz - 1)) + 1 : 0;
+    OP_REQUIRES(context, num_segments >= 0,
+                errors::InvalidArgument("segment ids must be >= 0"));
+    std::vector<int64_t> row_starts(num_segments + 1, 0);
+    for (int64_t i = 0; i < nnz; ++i) {
+      const Tidx id = ids_vec(i);
+      OP_REQUIRES(context, FastBoundsCheck(id, num_params_rows),
+                  errors::InvalidArgument("ids[", i, "] = ", id,
+                                          " is out of range [0, ",
+                                          num_params_rows, ")"));
+      const int64_t segment = static_cast<int64_t>(segment_vec(i));
+      OP_REQUIRES(context, segment >= 0,
+                  errors::InvalidArgument("segment ids must be >= 0"));
+      // A segment id past the last one means the ids decrease later on.
+      OP_REQUIRES(
+          context,
+          segment < num_segments &&
+              (i == 0 || segment >= static_cast<int64_t>(segment_vec(i - 1))),
+          errors::InvalidArgument("segment ids are not increasing"));
+      ++row_starts[segment + 1];
+    }
+    for (int64_t s = 0; s < num_segments; ++s) {
+      row_starts[s + 1] += row_starts[s];
+    }
+
+    TensorShape output_shape = params.shape();
+    OP_REQUIRES_OK(context, output_shape.SetDimWithStatus(0, num_segments));
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+
+    const T* params_base = params.flat<T>().data();
+    T* output_base = output->flat<T>().data();
+    const Tidx* id_data = ids_vec.data();
+    const size_t row_bytes = row_elems * sizeof(T);
+    const EmbeddingCombiner combiner = combiner_;
+
+    auto work = [&](int64_t begin, int64_t end) {
+      std::vector<Accum> accum(row_elems);
+      const int64_t shard_ids_end = row_starts[end];
+      for (int64_t segment = begin; segment < end; ++segment) {
+        T* out = output_base + segment * row_elems;
+        const int64_t ids_begin = row_starts[segment];
+        const int64_t ids_end = row_starts[segment + 1];
+        if (ids_begin == ids_end) {
+          std::fill(out, out + row_elems, T(0));
+          continue;
+        }
+        std::fill(accum.begin(), accum.end(), Accum(0));
+        Accum weight_sum(0);
+        Accum weight_sq_sum(0);
+        for (int64_t j = ids_begin; j < ids_end; ++j) {
+          if (j + kEmbeddingPrefetchDistance < shard_ids_end) {
+            const T* ahead =
+                params_base +
+                static_cast<int64_t>(id_data[j + kEmbeddingPrefetchDistance]) *
+                    row_elems;
+            // Only the leading cache lines of a row are worth fetching early;
+            // the hardware prefetcher picks up the rest of a contiguous row.
+            absl::PrefetchToLocalCache(ahead);
+            if (row_bytes > 64) {
+              absl::PrefetchToLocalCache(
+                  reinterpret_cast<const char*>(ahead) + 64);
+            }
+          }
+          const T* row =
+              params_base + static_cast<int64_t>(id_data[j]) * row_elems;
+          if (weights == nullptr) {
+            for (int64_t k = 0; k < row_elems; ++k) {
+              accum[k] += static_cast<Accum>(row[k]);
+            }
+            weight_sum += Accum(1);
+          } else {
+            const Accum w =
+                static_cast<Accum>(weights[broadcast_weight ? 0 : j]);
+            for (int64_t k = 0; k < row_elems; ++k) {
+              accum[k] += static_cast<Accum>(row[k]) * w;
+            }
+            weight_sum += w;
+            weight_sq_sum += w * w;
+          }
+        }
+        if (weights == nullptr) weight_sq_sum = weight_sum;
+
+        Accum scale(1);
+        if (combiner == EmbeddingCombiner::kMean) {
+          scale = weight_sum == Accum(0) ? Accum(0) : Accum(1) / weight_sum;
+        } else if (combiner == EmbeddingCombiner::kSqrtN) {
+          scale = weight_sq_sum == Accum(0)
+                      ? Accum(0)
+                      : Accum(1) / Eigen::numext::sqrt(weight_sq_sum);
+        }
+        for (int64_t k = 0; k < row_elems; ++k) {
+          out[k] = static_cast<T>(accum[k] * scale);
+        }
+      }
+    };
+
+    const int64_t ids_per_segment =
+        std::max<int64_t>(1, nnz / num_segments);
+    const int64_t cost_per_segment = ids_per_segment * row_elems * 4;
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_segments,
+          cost_per_segment, work);
+  }
+
+ private:
+  int num_weights_;
+  EmbeddingCombiner combiner_ = EmbeddingCombiner::kSum;
+};
+
+#define REGISTER_CPU_KERNEL(type, index_type, segment_ids_type)   \
+  REGISTER_KERNEL_BUILDER(                                        \
+      Name("_FusedEmbeddingLookupSparse")                         \
+          .Device(DEVICE_CPU)                                     \
+          .TypeConstraint<type>("T")                              \
+          .TypeConstraint<index_type>("Tidx")                     \
+          .TypeConstraint<segment_ids_type>("Tsegmentids"),       \
+      FusedEmbeddingLookupSparseOp<type, index_type, segment_ids_type>);
+#define REGISTER_CPU_KERNELS_FOR_EACH_SEGMENT_ID_TYPE(type, index_type) \
+  REGISTER_CPU_KERNEL(type, index_type, int32)                          \
+  REGISTER_CPU_KERNEL(type, index_type, int64_t)
+#define REGISTER_CPU_KERNELS_FOR_EACH_INDEX_TYPE(type)       \
+  REGISTER_CPU_KERNELS_FOR_EACH_SEGMENT_ID_TYPE(type, int32) \
+  REGISTER_CPU_KERNELS_FOR_EACH_SEGMENT_ID_TYPE(type, int64_t)
+
+TF_CALL_FLOAT_TYPES(REGISTER_CPU_KERNELS_FOR_EACH_INDEX_TYPE);
+
+#undef REGISTER_CPU_KERNELS_FOR_EACH_INDEX_TYPE
+#undef REGISTER_CPU_KERNELS_FOR_EACH_SEGMENT_ID_TYPE
+#undef REGISTER_CPU_KERNEL
+
+}  // namespace tensorflow
@@ -0,0 +1,188 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <string>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedEmbeddingLookupSparseOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& combiner, int num_weights,
+              DataType dtype = DT_FLOAT) {
+    NodeDefBuilder builder("fused_embedding", "_FusedEmbeddingLookupSparse");
+    builder.Input(FakeInput(dtype))
+        .Input(FakeInput(DT_INT64))
+        .Input(FakeInput(DT_INT32));
+    builder.Input(FakeInput(num_weights, dtype));
+    TF_ASSERT_OK(builder.Attr("combiner", combiner).Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // A [4, 2] table where row r holds {r + 1, 10 * (r + 1)}.
+  void AddParams() {
+    AddInputFromArray<float>(TensorShape({4, 2}),
+                             {1, 10, 2, 20, 3, 30, 4, 40});
+  }
+};
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, Sum) {
+  MakeOp("sum", 0);
+  AddParams();
+  AddInputFromArray<int64_t>(TensorShape({5}), {0, 2, 3, 3, 1});
+  AddInputFromArray<int32>(TensorShape({5}), {0, 0, 1, 1, 3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // Segment 2 has no ids and is zero-filled.
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&expected, {4, 40, 8, 80, 0, 0, 2, 20});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, Mean) {
+  MakeOp("mean", 0);
+  AddParams();
+  AddInputFromArray<int64_t>(TensorShape({4}), {0, 2, 3, 1});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 0, 2});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected, {8.0f / 3, 80.0f / 3, 0, 0, 2, 20});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, SqrtN) {
+  MakeOp("sqrtn", 0);
+  AddParams();
+  AddInputFromArray<int64_t>(TensorShape({3}), {0, 1, 3});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 0, 1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(
+      &expected, {3 / std::sqrt(2.0f), 30 / std::sqrt(2.0f), 4, 40});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, WeightedSum) {
+  MakeOp("sum", 1);
+  AddParams();
+  AddInputFromArray<int64_t>(TensorShape({3}), {0, 1, 3});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 0, 1});
+  AddInputFromArray<float>(TensorShape({3, 1}), {2, 0.5, -1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {3, 30, -4, -40});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, WeightedMean) {
+  MakeOp("mean", 1);
+  AddParams();
+  AddInputFromArray<int64_t>(TensorShape({2}), {0, 1});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 0});
+  AddInputFromArray<float>(TensorShape({2}), {1, 3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // (1 * 1 + 3 * 2) / (1 + 3)
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 2}));
+  test::FillValues<float>(&expected, {7.0f / 4, 70.0f / 4});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, BroadcastWeightSqrtN) {
+  MakeOp("sqrtn", 1);
+  AddParams();
+  AddInputFromArray<int64_t>(TensorShape({2}), {0, 1});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 0});
+  AddInputFromArray<float>(TensorShape({}), {2});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // (2 * 1 + 2 * 2) / sqrt(2^2 + 2^2)
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 2}));
+  const float scale = 1 / std::sqrt(8.0f);
+  test::FillValues<float>(&expected, {6 * scale, 60 * scale});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, HalfAccumulatesInFloat) {
+  MakeOp("mean", 0, DT_HALF);
+  AddInputFromArray<Eigen::half>(
+      TensorShape({2, 1}), {Eigen::half(2048.0f), Eigen::half(1.0f)});
+  AddInputFromArray<int64_t>(TensorShape({3}), {0, 1, 1});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 0, 0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // 2048 + 1 is not representable in half, so a half accumulator would
+  // drop both ones.
+  Tensor expected(allocator(), DT_HALF, TensorShape({1, 1}));
+  test::FillValues<Eigen::half>(&expected, {Eigen::half(2050.0f / 3)});
+  test::ExpectTensorEqual<Eigen::half>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, EmptyIds) {
+  MakeOp("sum", 0);
+  AddParams();
+  AddInputFromArray<int64_t>(TensorShape({0}), {});
+  AddInputFromArray<int32>(TensorShape({0}), {});
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(TensorShape({0, 2}), GetOutput(0)->shape());
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, Error_IdOutOfRange) {
+  MakeOp("sum", 0);
+  AddParams();
+  AddInputFromArray<int64_t>(TensorShape({2}), {0, 4});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 0});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(absl::StrContains(s.ToString(), "ids[1] = 4 is out of range"))
+      << s;
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, Error_SegmentIdsNotIncreasing) {
+  MakeOp("sum", 0);
+  AddParams();
+  AddInputFromArray<int64_t>(TensorShape({3}), {0, 1, 2});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 5, 3});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(absl::StrContains(s.ToString(), "segment ids are not increasing"))
+      << s;
+}
+
+TEST_F(FusedEmbeddingLookupSparseOpTest, Error_WeightsSizeMismatch) {
+  MakeOp("sum", 1);
+  AddParams();
+  AddInputFromArray<int64_t>(TensorShape({3}), {0, 1, 2});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 0, 1});
+  AddInputFromArray<float>(TensorShape({2}), {1, 1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(absl::StrContains(s.ToString(), "weights must have one element"))
+      << s;
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -16,7 +16,12 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_GATHER_FUNCTOR_H_
 #define TENSORFLOW_CORE_KERNELS_GATHER_FUNCTOR_H_
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "absl/base/prefetch.h"
+#include "absl/container/flat_hash_map.h"
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -108,8 +113,120 @@ SliceIndex HandleCopies(OpKernelContext* ctx,
   return result;
 }
 
+// Params at least this large are assumed not to fit in the last-level cache,
+// so random row gathers from them are bound by DRAM latency and are handled
+// by `HandleCopiesLargeParams`.
+constexpr int64_t kGatherLargeParamsBytes = 64LL << 20;
+
+// Number of indices ahead of the current one whose rows are prefetched by
+// `HandleCopiesLargeParams`.
+constexpr int kGatherPrefetchDistance = 8;
+
+// Maximum number of bytes of each row that are prefetched. Longer rows are
+// read sequentially and left to the hardware prefetcher.
+constexpr int kGatherMaxPrefetchBytes = 512;
+
+// Name of the optional bool attr of GatherV2 and ResourceGather nodes that
+// makes large-params gathers sort the indices of each shard before copying.
+// Sorting turns random DRAM accesses into mostly ascending ones, at the cost
+// of an O(n log n) sort per shard.
+constexpr char kGatherSortIndicesAttr[] = "_gather_sort_indices";
+
+// Prefetches the leading bytes of a row of `slice_bytes` bytes at `row`.
+inline void PrefetchGatherRow(const void* row, size_t slice_bytes) {
+  const char* bytes = static_cast<const char*>(row);
+  const size_t prefetch_bytes =
+      std::min<size_t>(slice_bytes, kGatherMaxPrefetchBytes);
+  for (size_t offset = 0; offset < prefetch_bytes; offset += 64) {
+    absl::PrefetchToLocalCache(bytes + offset);
+  }
+}
+
+// Copies rows of a single-batch `params` that is too large for the cache.
+// Indices are copied into a shard-local buffer and validated up front, so that
+// only valid rows are prefetched `kGatherPrefetchDistance` indices ahead of
+// the copy. Repeated indices within a shard are filled from the first output
+// row written for them instead of re-reading `params`. If `sort_indices`, each
+// shard visits its indices in ascending order.
+//
+// Returns the position of an invalid index, or -1 if all indices are valid.
+template <typename T, typename Index>
+int64_t HandleCopiesLargeParams(OpKernelContext* ctx,
+                                typename TTypes<T, 3>::ConstTensor params,
+                                typename TTypes<Index>::ConstFlat indices,
+                                int64_t slice_elems,
+                                typename TTypes<T, 3>::Tensor out,
+                                bool sort_indices) {
+  const int64_t indices_size = indices.dimension(0);
+  const Index limit = static_cast<Index>(params.dimension(1));
+  T* out_base = out.data();
+  const T* params_base = params.data();
+  const size_t slice_bytes = slice_elems * sizeof(T);
+  auto* worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+  mutex mu;
+  int64_t result = -1;
+  auto work = [&](int64_t start, int64_t end) {
+    const int64_t n = end - start;
+    // Pairs of (index, output position), in output order unless sorted.
+    std::vector<std::pair<Index, int64_t>> order;
+    order.reserve(n);
+    for (int64_t i = start; i < end; ++i) {
+      const Index index = internal::SubtleMustCopy(indices(i));
+      if (!FastBoundsCheck(index, limit)) {
+        mutex_lock l(mu);
+        result = i;
+        return;
+      }
+      order.emplace_back(index, i);
+    }
+    if (sort_indices) {
+      std::sort(order.begin(), order.end());
+    }
+    for (int64_t k = 0; k < std::min<int64_t>(n, kGatherPrefetchDistance);
+         ++k) {
+      PrefetchGatherRow(params_base + order[k].first * slice_elems,
+                        slice_bytes);
+    }
+    // Output position of the first occurrence of each index. Sorted indices
+    // only need to be compared with their predecessor.
+    absl::flat_hash_map<Index, int64_t> first_position;
+    if (!sort_indices) first_position.reserve(n);
+    for (int64_t k = 0; k < n; ++k) {
+      if (k + kGatherPrefetchDistance < n) {
+        const Index ahead = order[k + kGatherPrefetchDistance].first;
+        PrefetchGatherRow(params_base + ahead * slice_elems, slice_bytes);
+      }
+      const Index index = order[k].first;
+      int64_t copy_from = -1;
+      if (sort_indices) {
+        if (k > 0 && order[k - 1].first == index) {
+          copy_from = order[k - 1].second;
+        }
+      } else {
+        auto it = first_position.try_emplace(index, order[k].second);
+        if (!it.second) copy_from = it.first->second;
+      }
+      T* dst = out_base + order[k].second * slice_elems;
+      if (copy_from >= 0) {
+        // The row was already written for an earlier position of this shard.
+        memcpy(dst, out_base + copy_from * slice_elems, slice_bytes);
+      } else {
+        memcpy(dst, params_base + index * slice_elems, slice_bytes);
+      }
+    }
+  };
+  const int64_t cost_per_index = slice_bytes + 8 * sizeof(Index);
+  Shard(worker_threads->num_threads, worker_threads->workers, indices_size,
+        cost_per_index, work);
+  return result;
+}
+
 template <typename T, typename Index>
 struct GatherFunctorCPU {
+  // Whether large-params gathers sort their indices, see
+  // `kGatherSortIndicesAttr`.
+  bool sort_indices = false;
+
   int64_t operator()(OpKernelContext* ctx,
                      typename TTypes<T, 3>::ConstTensor params,
                      typename TTypes<Index>::ConstFlat indices,
@@ -120,6 +237,14 @@ struct GatherFunctorCPU {
 
     const int64_t batch_size = params.dimension(0);
 
+    if (is_simple_type<T>::value && batch_size == 1 &&
+        indices_size > kGatherPrefetchDistance &&
+        params.size() * static_cast<int64_t>(sizeof(T)) >=
+            kGatherLargeParamsBytes) {
+      return HandleCopiesLargeParams<T, Index>(ctx, params, indices, slice_size,
+                                               out, sort_indices);
+    }
+
     bool use_large = (slice_size > std::numeric_limits<int32>::max() ||
                       params.size() > std::numeric_limits<int32>::max() ||
                       indices_size > std::numeric_limits<int32>::max() ||
@@ -159,11 +284,16 @@ struct GatherFunctor {
 
 template <typename T, typename Index>
 struct GatherFunctor<CPUDevice, T, Index> {
+  // See `kGatherSortIndicesAttr`.
+  bool sort_indices = false;
+
   int64_t operator()(OpKernelContext* ctx,
                      typename TTypes<T, 3>::ConstTensor params,
                      typename TTypes<Index>::ConstFlat indices,
                      typename TTypes<T, 3>::Tensor out) {
-    return GatherFunctorCPU<T, Index>()(ctx, params, indices, out);
+    GatherFunctorCPU<T, Index> functor;
+    functor.sort_indices = sort_indices;
+    return functor(ctx, params, indices, out);
   }
 };
 
@@ -15,6 +15,8 @@ limitations under the License.
 
 // See docs in ../ops/array_ops.cc.
 
+#include <type_traits>
+
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -49,6 +51,10 @@ class GatherOp : public OpKernel {
     } else {
       batch_dims_ = 0;
     }
+    if (c->HasAttr(functor::kGatherSortIndicesAttr)) {
+      OP_REQUIRES_OK(
+          c, c->GetAttr(functor::kGatherSortIndicesAttr, &sort_indices_));
+    }
   }
 
   void Compute(OpKernelContext* c) override {
@@ -178,6 +184,9 @@ class GatherOp : public OpKernel {
       auto out_flat = out->shaped<T, 3>({outer_size, N, inner_size});
 
       functor::GatherFunctor<Device, T, Index> functor;
+      if constexpr (std::is_same<Device, CPUDevice>::value) {
+        functor.sort_indices = sort_indices_;
+      }
       bad_i = functor(c, params_flat, indices_flat, out_flat);
     }
     OP_REQUIRES(
@@ -191,6 +200,9 @@ class GatherOp : public OpKernel {
   // The number of batch dimensions, as passed in the batch_dims attribute.
   // It must be less than or equal to rank(indices).
   int32 batch_dims_ = 0;
+  // Whether CPU gathers from large params sort their indices, as set by the
+  // optional `functor::kGatherSortIndicesAttr` attr.
+  bool sort_indices_ = false;
 };
 
 #define REGISTER_GATHER_FULL(dev, type, index_type)                    \
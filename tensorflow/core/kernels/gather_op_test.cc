@@ -17,6 +17,7 @@ limitations under the License.
 #include <memory>
 #include <vector>
 
+#include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/fake_input.h"
@@ -26,6 +27,7 @@ limitations under the License.
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/gather_functor.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -40,15 +42,44 @@ namespace {
 
 class GatherOpTest : public OpsTestBase {
  protected:
-  void MakeOp(DataType data_type, DataType index_type, int batch_dims = 0) {
-    TF_ASSERT_OK(NodeDefBuilder("myop", "GatherV2")
-                     .Input(FakeInput(data_type))
-                     .Input(FakeInput(index_type))
-                     .Input(FakeInput(index_type))
-                     .Attr("batch_dims", batch_dims)
-                     .Finalize(node_def()));
+  void MakeOp(DataType data_type, DataType index_type, int batch_dims = 0,
+              bool sort_indices = false) {
+    NodeDefBuilder builder("myop", "GatherV2");
+    builder.Input(FakeInput(data_type))
+        .Input(FakeInput(index_type))
+        .Input(FakeInput(index_type))
+        .Attr("batch_dims", batch_dims);
+    if (sort_indices) {
+      builder.Attr(functor::kGatherSortIndicesAttr, true);
+    }
+    TF_ASSERT_OK(builder.Finalize(node_def()));
     TF_ASSERT_OK(InitOp());
   }
+
+  // Gathers repeated rows from params of 64MiB, which take the prefetching
+  // large-params path.
+  void TestLargeParamsRepeatedIndices(bool sort_indices) {
+    MakeOp(DT_FLOAT, DT_INT32, /*batch_dims=*/0, sort_indices);
+
+    const int kRows = (64 << 20) / sizeof(float) / 4;
+    AddInput<float>(TensorShape({kRows, 4}), [](int i) { return i; });
+    std::vector<int32> indices;
+    for (int i = 0; i < 1000; ++i) {
+      indices.push_back((i * 7919) % 37 * 1000003 % kRows);
+    }
+    AddInputFromArray<int32>(TensorShape({1000}), indices);
+    AddInputFromArray<int32>(TensorShape({}), {0});
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected(allocator(), DT_FLOAT, TensorShape({1000, 4}));
+    auto expected_matrix = expected.matrix<float>();
+    for (int i = 0; i < 1000; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        expected_matrix(i, j) = indices[i] * 4 + j;
+      }
+    }
+    test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+  }
 };
 
 TEST_F(GatherOpTest, ScalarIndices) {
@@ -204,6 +235,52 @@ TEST_F(GatherOpTest, Error_BatchDimsOutOfRange) {
       << s;
 }
 
+TEST_F(GatherOpTest, LargeParamsRepeatedIndices) {
+  TestLargeParamsRepeatedIndices(/*sort_indices=*/false);
+}
+
+TEST_F(GatherOpTest, LargeParamsRepeatedIndicesSorted) {
+  TestLargeParamsRepeatedIndices(/*sort_indices=*/true);
+}
+
+#if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+// The sort attr only applies to CPU gathers, and is ignored on the GPU.
+TEST_F(GatherOpTest, SortIndicesIgnoredOnGpu) {
+  SetDevice(DEVICE_GPU,
+            std::unique_ptr<tensorflow::Device>(DeviceFactory::NewDevice(
+                "GPU", {}, "/job:a/replica:0/task:0")));
+  MakeOp(DT_FLOAT, DT_INT32, /*batch_dims=*/0, /*sort_indices=*/true);
+
+  // Feed and run
+  AddInputFromArray<float>(TensorShape({5, 3}),
+                           {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 4, 0, 2});
+  AddInputFromArray<int32>(TensorShape({}), {0});
+  TF_ASSERT_OK(RunOpKernel());
+  TF_ASSERT_OK(device_->Sync());
+
+  // Check the output.
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4, 3}));
+  test::FillValues<float>(&expected, {0, 1, 2, 12, 13, 14, 0, 1, 2, 6, 7, 8});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+#endif  // GOOGLE_CUDA || TENSORFLOW_USE_ROCM
+
+TEST_F(GatherOpTest, LargeParamsError_IndexOutOfRange) {
+  MakeOp(DT_FLOAT, DT_INT32);
+
+  const int kRows = (64 << 20) / sizeof(float) / 4;
+  AddInput<float>(TensorShape({kRows, 4}), [](int i) { return i; });
+  std::vector<int32> indices(100, 3);
+  indices[42] = kRows;
+  AddInputFromArray<int32>(TensorShape({100}), indices);
+  AddInputFromArray<int32>(TensorShape({}), {0});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(absl::StrContains(
+      s.ToString(), strings::StrCat("indices[42] = ", kRows, " is not in")))
+      << s;
+}
+
 constexpr int kLookups = 2000;
 
 template <typename Index>
@@ -256,6 +333,50 @@ static Graph* Gather(int dim) {
       ->Arg(200)                                                              \
       ->Arg(1000)
 
+// Embedding-style lookups into a 1GiB table where a small set of hot ids
+// accounts for most of the lookups.
+template <typename Index>
+static Graph* GatherSkewed(int num_lookups, int dim) {
+  Graph* g = new Graph(OpRegistry::Global());
+  const int kRows = ((1 << 30) / sizeof(float)) / dim;
+  Tensor params(DT_FLOAT, TensorShape({kRows, dim}));
+  params.flat<float>().setRandom();
+
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor indices(DataTypeToEnum<Index>::value, TensorShape({num_lookups}));
+  auto indices_flat = indices.flat<Index>();
+  for (int i = 0; i < num_lookups; i++) {
+    indices_flat(i) = rnd.OneIn(2) ? rnd.Uniform(1024) : rnd.Uniform(kRows);
+  }
+
+  Tensor axis(DataTypeToEnum<Index>::value, TensorShape({}));
+  axis.scalar<Index>()() = 0;
+
+  test::graph::Gather(g, test::graph::Constant(g, params),
+                      test::graph::Constant(g, indices),
+                      test::graph::HostConstant(g, axis));
+  return g;
+}
+
+static void BM_cpu_gather_skewed(::testing::benchmark::State& state) {
+  const int num_lookups = state.range(0);
+  const int dim = state.range(1);
+  test::Benchmark("cpu", GatherSkewed<int64_t>(num_lookups, dim),
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  const int64_t tot =
+      static_cast<int64_t>(state.iterations()) * num_lookups * dim;
+  state.SetItemsProcessed(tot);
+  state.SetBytesProcessed(tot * sizeof(float));
+}
+BENCHMARK(BM_cpu_gather_skewed)
+    ->UseRealTime()
+    ->ArgPair(64 << 10, 16)
+    ->ArgPair(64 << 10, 64)
+    ->ArgPair(1 << 20, 16)
+    ->ArgPair(1 << 20, 64);
+
 BM_GATHER(cpu, int32);
 BM_GATHER(gpu, int32);
 BM_GATHER(cpu, int64_t);
@@ -1547,4 +1547,17 @@ BM_TopKCPU(128, 70000, 70000, 16, "topk_nmt_r_128_c_70000_k_70000_th_16");
 BM_TopKCPU(128, 175000, 175000, 16, "topk_nmt_r_128_c_175000_k_175000_th_16");
 BM_TopKCPU(128, 350000, 350000, 16, "topk_nmt_r_128_c_350000_k_350000_th_16");
 
+// Retrieval scoring: few rows, millions of columns, small k. These take the
+// streaming threshold-filtering path, splitting rows across threads.
+BM_TopKCPU(1, 1000000, 10, 16, "topk_retrieval_r_1_c_1M_k_10_th_16");
+BM_TopKCPU(1, 1000000, 100, 16, "topk_retrieval_r_1_c_1M_k_100_th_16");
+BM_TopKCPU(1, 1000000, 1000, 16, "topk_retrieval_r_1_c_1M_k_1000_th_16");
+BM_TopKCPU(1, 10000000, 10, 16, "topk_retrieval_r_1_c_10M_k_10_th_16");
+BM_TopKCPU(1, 10000000, 100, 16, "topk_retrieval_r_1_c_10M_k_100_th_16");
+BM_TopKCPU(1, 10000000, 1000, 16, "topk_retrieval_r_1_c_10M_k_1000_th_16");
+BM_TopKCPU(8, 1000000, 100, 16, "topk_retrieval_r_8_c_1M_k_100_th_16");
+BM_TopKCPU(8, 10000000, 100, 16, "topk_retrieval_r_8_c_10M_k_100_th_16");
+BM_TopKCPU(64, 100000, 100, 16, "topk_retrieval_r_64_c_100K_k_100_th_16");
+BM_TopKCPU(1, 10000000, 100, 1, "topk_retrieval_r_1_c_10M_k_100_th_1");
+
 }  // namespace tensorflow
@@ -715,6 +715,10 @@ class ResourceGatherOp : public OpKernel {
     OP_REQUIRES(c, batch_dims_ >= 0,
                 absl::InvalidArgumentError(absl::StrCat(
                     "batch_dims is negative (", batch_dims_, ")")));
+    if (c->HasAttr(functor::kGatherSortIndicesAttr)) {
+      OP_REQUIRES_OK(
+          c, c->GetAttr(functor::kGatherSortIndicesAttr, &sort_indices_));
+    }
   }
 
   void Compute(OpKernelContext* c) override {
@@ -800,6 +804,9 @@ class ResourceGatherOp : public OpKernel {
       auto out_flat = out->shaped<T, 3>({1, N, out->NumElements() / N});
 
       functor::GatherFunctor<Device, T, Index> functor;
+      if constexpr (std::is_same<Device, CPUDevice>::value) {
+        functor.sort_indices = sort_indices_;
+      }
       int64_t bad_i = functor(c, params_flat, indices_flat, out_flat);
 
       OP_REQUIRES(
@@ -839,6 +846,9 @@ class ResourceGatherOp : public OpKernel {
   }
 
   int32 batch_dims_ = 0;
+  // Whether CPU gathers from large params sort their indices, as set by the
+  // optional `functor::kGatherSortIndicesAttr` attr.
+  bool sort_indices_ = false;
 };
 
 #define REGISTER_GATHER_FULL(dev, type, index_type)                    \
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/save_restore_tensor.h"
 
+#include <algorithm>
 #include <memory>
 #include <numeric>
 #include <unordered_map>
@@ -22,6 +23,7 @@ limitations under the License.
 #include <vector>
 
 #include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/metrics.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
@@ -303,10 +305,25 @@ struct RestoreOp {
             << restored_full_shape.num_elements();
     Tensor* restored_tensor;
     if (shape_and_slice.empty()) {
-      // Lookup the full tensor.
-      TF_RETURN_IF_ERROR(
-          context->allocate_output(idx, restored_full_shape, &restored_tensor));
-      TF_RETURN_IF_ERROR(reader->Lookup(tensor_name, restored_tensor));
+      bool mapped = false;
+      if (map_read_only) {
+        // Alias the checkpoint data instead of copying it, when possible.
+        Tensor mapped_tensor;
+        TF_RETURN_IF_ERROR(
+            reader->LookupMapped(tensor_name, &mapped_tensor, &mapped));
+        if (mapped) {
+          metrics::RecordCheckpointRestoreMappedBytes(
+              mapped_tensor.TotalBytes());
+          context->set_output(idx, std::move(mapped_tensor));
+          restored_tensor = context->mutable_output(idx);
+        }
+      }
+      if (!mapped) {
+        // Lookup the full tensor.
+        TF_RETURN_IF_ERROR(context->allocate_output(idx, restored_full_shape,
+                                                    &restored_tensor));
+        TF_RETURN_IF_ERROR(reader->Lookup(tensor_name, restored_tensor));
+      }
     } else {
       // Lookup the slice.
       TensorShape parsed_full_shape;
@@ -356,10 +373,51 @@ struct RestoreOp {
   string shape_and_slice;
   string reader_prefix;
   DataType dtype;
+  // Whether the tensor may alias a read-only mapping of the checkpoint.
+  bool map_read_only = false;
 
   ::tensorflow::Status status;
 };
 
+// Maximum number of data files read concurrently when a restore spans several
+// of them and no explicit restore parallelism is configured.
+const int kMaxParallelRestoreShards = 16;
+
+// Restores each group of ops from its own BundleReader, one thread per group.
+// Every group holds the ops of a single data file sorted by offset, so each
+// file is read sequentially while the files are read in parallel.
+Status RestoreShardsInParallel(
+    OpKernelContext* context, const string& prefix, BundleCache* cache,
+    const std::vector<std::vector<RestoreOp*>>& ops_by_shard) {
+  int num_threads = kMaxParallelRestoreShards;
+  if (context->session_config() != nullptr &&
+      context->session_config()->intra_op_parallelism_threads() > 0) {
+    num_threads = context->session_config()->intra_op_parallelism_threads();
+  }
+  num_threads = std::min<int>(num_threads, ops_by_shard.size());
+
+  auto reader_pool = std::make_unique<thread::ThreadPool>(
+      tsl::Env::Default(), "restore_shards", num_threads);
+  for (const std::vector<RestoreOp*>& shard_ops : ops_by_shard) {
+    reader_pool->Schedule([&shard_ops, &prefix, cache]() {
+      BundleReader reader(tsl::Env::Default(), prefix, {cache, false});
+      for (RestoreOp* op : shard_ops) {
+        op->status = reader.status().ok() ? op->run(&reader) : reader.status();
+        if (!op->status.ok()) return;
+      }
+    });
+  }
+  // Wait for all scheduled work to finish.
+  reader_pool.reset();
+
+  for (const std::vector<RestoreOp*>& shard_ops : ops_by_shard) {
+    for (const RestoreOp* op : shard_ops) {
+      TF_RETURN_IF_ERROR(op->status);
+    }
+  }
+  return absl::OkStatus();
+}
+
 }  // namespace
 
 Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
@@ -371,11 +429,15 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
   const auto& tensor_names_flat = tensor_names.flat<tstring>();
   const auto& shape_and_slices_flat = shape_and_slices.flat<tstring>();
 
+  const bool map_read_only =
+      context->session_config() != nullptr &&
+      context->session_config()->experimental().mmap_restored_variables();
   std::vector<RestoreOp> restore_ops;
   restore_ops.reserve(tensor_names_flat.size());
   for (int i = 0; i < tensor_names_flat.size(); ++i) {
     restore_ops.push_back({context, i, tensor_names_flat(i),
                            shape_and_slices_flat(i), prefix_string, dtypes[i]});
+    restore_ops.back().map_read_only = map_read_only;
   }
 
   tsl::Env* const env = tsl::Env::Default();
@@ -405,67 +467,88 @@ Status RestoreTensorsV2(OpKernelContext* context, const Tensor& prefix,
     return errors::InvalidArgument(error_msg);
   }
 
-  // Split restore ops into two groups: large and small. We schedule
-  // large ops first, to prevent them from waiting on the small op.
-  std::vector<RestoreOp*> large_restore_ops;
-  std::vector<RestoreOp*> small_restore_ops;
+  // Group the sorted ops by the data file they read from. Checkpoints saved
+  // by several workers have one data file per writer; when more than one of
+  // them is involved, the files are read in parallel.
+  std::vector<std::vector<RestoreOp*>> ops_by_shard;
+  int32_t previous_shard_id = -1;
   for (RestoreOp& restore_op : restore_ops) {
-    if (restore_op.is_large_shape(&default_reader)) {
-      large_restore_ops.push_back(&restore_op);
-    } else {
-      small_restore_ops.push_back(&restore_op);
+    int32_t shard_id;
+    TF_RETURN_IF_ERROR(
+        default_reader.LookupShardId(restore_op.tensor_name, &shard_id));
+    if (ops_by_shard.empty() || shard_id != previous_shard_id) {
+      ops_by_shard.emplace_back();
+      previous_shard_id = shard_id;
     }
+    ops_by_shard.back().push_back(&restore_op);
   }
 
-  if (context->session_config() != nullptr &&
-      context->session_config()->intra_op_parallelism_threads() > 0) {
-    // If an explicit restore parallelism is specified, we use it to run
-    // run both small and large restore ops in parallel.
-    auto reader_pool = std::make_unique<thread::ThreadPool>(
-        tsl::Env::Default(), "restore_tensors",
-        context->session_config()->intra_op_parallelism_threads());
-
-    // Schedule large ops first, followed by the small.
-    for (auto* op : large_restore_ops) {
-      reader_pool->Schedule(
-          [op, &cache]() { op->run_with_new_reader(&cache); });
-    }
-    for (auto* op : small_restore_ops) {
-      reader_pool->Schedule(
-          [op, &cache]() { op->run_with_new_reader(&cache); });
+  if (ops_by_shard.size() > 1) {
+    TF_RETURN_IF_ERROR(
+        RestoreShardsInParallel(context, prefix_string, &cache, ops_by_shard));
+  } else {
+    // Split restore ops into two groups: large and small. We schedule
+    // large ops first, to prevent them from waiting on the small op.
+    std::vector<RestoreOp*> large_restore_ops;
+    std::vector<RestoreOp*> small_restore_ops;
+    for (RestoreOp& restore_op : restore_ops) {
+      if (restore_op.is_large_shape(&default_reader)) {
+        large_restore_ops.push_back(&restore_op);
+      } else {
+        small_restore_ops.push_back(&restore_op);
+      }
     }
 
-    // Wait for all scheduled work to finish and check the status of all
-    // ops that ran in the pool.
-    reader_pool.reset();
-    for (auto& op : restore_ops) {
-      TF_RETURN_IF_ERROR(op.status);
-    }
-  } else {
-    // If no restore parallelism is specified, we run large restore ops with
-    // a modest parallelism, and small restore ops serially.
-
-    // Avoid creating a pool if there are no large restore ops.
-    std::unique_ptr<thread::ThreadPool> reader_pool;
-    if (!large_restore_ops.empty()) {
-      reader_pool.reset(
-          new thread::ThreadPool(Env::Default(), "restore_tensors", 8));
+    if (context->session_config() != nullptr &&
+        context->session_config()->intra_op_parallelism_threads() > 0) {
+      // If an explicit restore parallelism is specified, we use it to run
+      // run both small and large restore ops in parallel.
+      auto reader_pool = std::make_unique<thread::ThreadPool>(
+          tsl::Env::Default(), "restore_tensors",
+          context->session_config()->intra_op_parallelism_threads());
+
+      // Schedule large ops first, followed by the small.
       for (auto* op : large_restore_ops) {
         reader_pool->Schedule(
             [op, &cache]() { op->run_with_new_reader(&cache); });
       }
-    }
+      for (auto* op : small_restore_ops) {
+        reader_pool->Schedule(
+            [op, &cache]() { op->run_with_new_reader(&cache); });
+      }
 
-    // Read small tensors from the op thread.
-    for (auto* op : small_restore_ops) {
-      TF_RETURN_IF_ERROR(op->run(&default_reader));
-    }
+      // Wait for all scheduled work to finish and check the status of all
+      // ops that ran in the pool.
+      reader_pool.reset();
+      for (auto& op : restore_ops) {
+        TF_RETURN_IF_ERROR(op.status);
+      }
+    } else {
+      // If no restore parallelism is specified, we run large restore ops with
+      // a modest parallelism, and small restore ops serially.
+
+      // Avoid creating a pool if there are no large restore ops.
+      std::unique_ptr<thread::ThreadPool> reader_pool;
+      if (!large_restore_ops.empty()) {
+        reader_pool.reset(
+            new thread::ThreadPool(Env::Default(), "restore_tensors", 8));
+        for (auto* op : large_restore_ops) {
+          reader_pool->Schedule(
+              [op, &cache]() { op->run_with_new_reader(&cache); });
+        }
+      }
 
-    // Wait for all scheduled work to finish and check the status of all
-    // ops that ran in the pool.
-    reader_pool.reset();
-    for (auto* op : large_restore_ops) {
-      TF_RETURN_IF_ERROR(op->status);
+      // Read small tensors from the op thread.
+      for (auto* op : small_restore_ops) {
+        TF_RETURN_IF_ERROR(op->run(&default_reader));
+      }
+
+      // Wait for all scheduled work to finish and check the status of all
+      // ops that ran in the pool.
+      reader_pool.reset();
+      for (auto* op : large_restore_ops) {
+        TF_RETURN_IF_ERROR(op->status);
+      }
     }
   }
 
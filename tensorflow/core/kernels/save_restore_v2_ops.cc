@@ -17,7 +17,9 @@ limitations under the License.
 
 #include <cstddef>
 #include <limits>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "tensorflow/core/framework/bounds_check.h"
@@ -93,6 +95,17 @@ void ValidateInputs(bool is_save_op, OpKernelContext* context,
 }  // namespace
 
 // Saves a list of named tensors using the tensor bundle library.
+//
+// If ConfigProto.Experimental.async_checkpoint_write is set, the tensors are
+// snapshotted into host staging memory (bounded by
+// async_checkpoint_staging_bytes) and the op returns once they are all staged,
+// while the bundle is written in the background.  MergeV2Checkpoints and
+// readers of the bundle wait for the write and return its errors.
+//
+// ConfigProto.Experimental.checkpoint_data_alignment sets the alignment of
+// the tensors in the data files.  Checkpoints of models meant to be served
+// from read-only memory mappings (see mmap_restored_variables) should use a
+// multiple of 64.
 class SaveV2 : public OpKernel {
  public:
   explicit SaveV2(OpKernelConstruction* context) : OpKernel(context) {}
@@ -111,9 +124,40 @@ class SaveV2 : public OpKernel {
     const auto& tensor_names_flat = tensor_names.flat<tstring>();
     const auto& shape_and_slices_flat = shape_and_slices.flat<tstring>();
 
-    BundleWriter writer(Env::Default(), prefix_string);
-    OP_REQUIRES_OK(context, writer.status());
-    VLOG(1) << "BundleWriter, prefix_string: " << prefix_string;
+    // A pending asynchronous save to the same prefix must not race with this
+    // one.
+    OP_REQUIRES_OK(context, WaitForPendingBundleWrites(prefix_string));
+    const ConfigProto* config = context->session_config();
+    const bool async_write =
+        config != nullptr && config->experimental().async_checkpoint_write();
+    BundleWriter::Options writer_options;
+    if (config != nullptr) {
+      const int32_t data_alignment =
+          config->experimental().checkpoint_data_alignment();
+      OP_REQUIRES(context, data_alignment >= 0,
+                  errors::InvalidArgument(
+                      "checkpoint_data_alignment must be >= 0, got ",
+                      data_alignment));
+      if (data_alignment > 0) writer_options.data_alignment = data_alignment;
+    }
+    std::unique_ptr<BundleWriter> writer;
+    std::unique_ptr<AsyncBundleWriter> async_writer;
+    if (async_write) {
+      AsyncBundleWriter::Options async_options;
+      async_options.writer_options = writer_options;
+      if (config->experimental().async_checkpoint_staging_bytes() > 0) {
+        async_options.max_staging_bytes =
+            config->experimental().async_checkpoint_staging_bytes();
+      }
+      async_writer = std::make_unique<AsyncBundleWriter>(
+          Env::Default(), prefix_string, async_options);
+    } else {
+      writer = std::make_unique<BundleWriter>(Env::Default(), prefix_string,
+                                              writer_options);
+      OP_REQUIRES_OK(context, writer->status());
+    }
+    VLOG(1) << "BundleWriter, prefix_string: " << prefix_string
+            << ", async: " << async_write;
 
     for (int i = 0; i < num_tensors; ++i) {
       const string& tensor_name = tensor_names_flat(i);
@@ -135,10 +179,15 @@ class SaveV2 : public OpKernel {
                                             shape_spec, ", tensor: ",
                                             tensor.shape().DebugString()));
 
-        OP_REQUIRES_OK(context,
-                       writer.AddSlice(tensor_name, shape, slice, tensor));
+        OP_REQUIRES_OK(
+            context,
+            async_writer
+                ? async_writer->AddSlice(tensor_name, shape, slice, tensor)
+                : writer->AddSlice(tensor_name, shape, slice, tensor));
       } else {
-        OP_REQUIRES_OK(context, writer.Add(tensor_name, tensor));
+        OP_REQUIRES_OK(context, async_writer
+                                    ? async_writer->Add(tensor_name, tensor)
+                                    : writer->Add(tensor_name, tensor));
       }
 
       if (VLOG_IS_ON(5)) {
@@ -160,7 +209,11 @@ class SaveV2 : public OpKernel {
 
       VLOG(2) << "Done save of " << tensor_name;
     }
-    OP_REQUIRES_OK(context, writer.Finish());
+    if (async_writer) {
+      AddPendingBundleWrite(prefix_string, std::move(async_writer));
+    } else {
+      OP_REQUIRES_OK(context, writer->Finish());
+    }
     VLOG(1) << "Done BundleWriter, prefix_string: " << prefix_string;
 
     ResourceMgr* resource_manager = context->resource_manager();
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include <algorithm>
+#include <cstring>
 #include <locale>
 #include <string>
 
@@ -23,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/framework/op_requires.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace text {
@@ -128,6 +130,15 @@ class StringNGramsOp : public tensorflow::OpKernel {
         num_ngrams += ngrams_or.value();
       }
       if (preserve_short_ && length > 0 && num_ngrams == 0) {
+        // If reached here, pad_width should be > 0, pad_width_ = -1,
+        // which indicates max(ngram_widths) - 1 cannot be used here since
+        // ngram_width is not known.
+        OP_REQUIRES(
+            context, pad_width_ >= 0,
+            errors::InvalidArgument("Pad width should be >= 0 when "
+                                    "preserve_short_sequences is True and "
+                                    "ngram_widths are not provided, got ",
+                                    pad_width_));
         num_ngrams = 1;
       }
       ngrams_splits_data[i] = ngrams_splits_data[i - 1] + num_ngrams;
@@ -140,49 +151,47 @@ class StringNGramsOp : public tensorflow::OpKernel {
             0, TensorShape({ngrams_splits_data[num_batch_items]}), &ngrams));
     auto ngrams_data = ngrams->flat<tstring>().data();
 
-    for (int i = 0; i < num_batch_items; ++i) {
-      auto data_start = &input_data[splits_vec(i)];
-      int output_start_idx = ngrams_splits_data[i];
-      for (int ngram_width : ngram_widths_) {
-        auto output_start = &ngrams_data[output_start_idx];
-        int length = splits_vec(i + 1) - splits_vec(i);
-        auto ngrams_or = get_num_ngrams(length, ngram_width);
-        OP_REQUIRES_OK(context, ngrams_or.status());
-        int num_ngrams = ngrams_or.value();
-        CreateNgrams(data_start, output_start, num_ngrams, ngram_width);
-        output_start_idx += num_ngrams;
-      }
-      // If we're preserving short sequences, check to see if no sequence was
-      // generated by comparing the current output start idx to the original
-      // one (ngram_splits_data). If no ngrams were generated, then they will
-      // be equal (since we increment output_start_idx by num_ngrams every
-      // time we create a set of ngrams.)
-      if (preserve_short_ && output_start_idx == ngrams_splits_data[i]) {
-        int data_length = splits_vec(i + 1) - splits_vec(i);
+    // All sizes were validated above, so the batch items can be filled in
+    // independently. Every ngram is sized exactly once and written in place.
+    auto work = [&](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        auto data_start = &input_data[splits_vec(i)];
+        int output_start_idx = ngrams_splits_data[i];
+        const int length = splits_vec(i + 1) - splits_vec(i);
+        for (int ngram_width : ngram_widths_) {
+          auto output_start = &ngrams_data[output_start_idx];
+          int num_ngrams = get_num_ngrams(length, ngram_width).value();
+          CreateNgrams(data_start, output_start, num_ngrams, ngram_width);
+          output_start_idx += num_ngrams;
+        }
+        // If we're preserving short sequences, check to see if no sequence
+        // was generated by comparing the current output start idx to the
+        // original one (ngram_splits_data). If no ngrams were generated, then
+        // they will be equal (since we increment output_start_idx by
+        // num_ngrams every time we create a set of ngrams.)
+        //
         // One legitimate reason to not have any ngrams when preserve_short_
         // is true is if the sequence itself is empty. In that case, move on.
-        if (data_length == 0) {
-          continue;
-        }
         // We don't have to worry about dynamic padding sizes here: if padding
         // was dynamic, every sequence would have had sufficient padding to
         // generate at least one ngram.
-
-        // If reached here, pad_width should be > 0, pad_width_ = -1,
-        // which indicates max(ngram_widths) - 1 cannot be used here since
-        // ngram_width is not known.
-        OP_REQUIRES(
-            context, pad_width_ >= 0,
-            errors::InvalidArgument("Pad width should be >= 0 when "
-                                    "preserve_short_sequences is True and "
-                                    "ngram_widths are not provided, got ",
-                                    pad_width_));
-        int ngram_width = data_length + 2 * pad_width_;
-        auto output_start = &ngrams_data[output_start_idx];
-        int num_ngrams = 1;
-        CreateNgrams(data_start, output_start, num_ngrams, ngram_width);
+        if (preserve_short_ && output_start_idx == ngrams_splits_data[i] &&
+            length > 0) {
+          int ngram_width = length + 2 * pad_width_;
+          auto output_start = &ngrams_data[output_start_idx];
+          CreateNgrams(data_start, output_start, /*num_ngrams=*/1,
+                       ngram_width);
+        }
       }
-    }
+    };
+    const int64_t ngrams_per_item = std::max<int64_t>(
+        1, ngrams_splits_data[num_batch_items] / std::max(1, num_batch_items));
+    const int64_t cost_per_item =
+        ngrams_per_item *
+        (50 + 10 * static_cast<int64_t>(ngram_widths_.size()));
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_batch_items,
+          cost_per_item, work);
   }
 
   void CreateNgrams(const tstring* data, tstring* output, int num_ngrams,
@@ -210,17 +219,22 @@ class StringNGramsOp : public tensorflow::OpKernel {
       int num_separators = left_padding + right_padding + num_tokens - 1;
       ngram_size += num_separators * separator_.length();
 
-      // Build the ngram.
+      // Build the ngram directly in its final buffer.
       tstring* ngram = &output[ngram_index];
-      ngram->reserve(ngram_size);
+      ngram->resize_uninitialized(ngram_size);
+      char* out = ngram->mdata();
+      const auto write = [&out](StringPiece piece) {
+        std::memcpy(out, piece.data(), piece.size());
+        out += piece.size();
+      };
       for (int n = 0; n < left_padding; ++n) {
-        ngram->append(left_pad_);
-        ngram->append(separator_);
+        write(left_pad_);
+        write(separator_);
       }
       // Only output first num_tokens - 1 pairs of data and separator
       for (int n = 0; n < num_tokens - 1; ++n) {
-        ngram->append(data[data_start_index + n]);
-        ngram->append(separator_);
+        write(data[data_start_index + n]);
+        write(separator_);
       }
       // Handle case when there are no tokens or no right padding as these can
       // result in consecutive separators.
@@ -228,10 +242,10 @@ class StringNGramsOp : public tensorflow::OpKernel {
         // If we have tokens, then output last and then pair each separator with
         // the right padding that follows, to ensure ngram ends either with the
         // token or with the right pad.
-        ngram->append(data[data_start_index + num_tokens - 1]);
+        write(data[data_start_index + num_tokens - 1]);
         for (int n = 0; n < right_padding; ++n) {
-          ngram->append(separator_);
-          ngram->append(right_pad_);
+          write(separator_);
+          write(right_pad_);
         }
       } else {
         // If we don't have tokens, then the last item inserted into the ngram
@@ -239,15 +253,15 @@ class StringNGramsOp : public tensorflow::OpKernel {
         // output right pad and separator and make sure to finish with a
         // padding, not a separator.
         for (int n = 0; n < right_padding - 1; ++n) {
-          ngram->append(right_pad_);
-          ngram->append(separator_);
+          write(right_pad_);
+          write(separator_);
         }
-        ngram->append(right_pad_);
+        write(right_pad_);
       }
 
-      // In debug mode only: validate that we've reserved enough space for the
+      // In debug mode only: validate that we've computed the exact size of the
       // ngram.
-      DCHECK_EQ(ngram_size, ngram->size());
+      DCHECK_EQ(ngram_size, static_cast<int>(out - ngram->data()));
     }
   }
 
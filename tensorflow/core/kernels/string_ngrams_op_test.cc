@@ -12,8 +12,10 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+#include <string>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/shape_inference.h"
@@ -578,6 +580,36 @@ TEST_F(NgramKernelTest, TestNoTokensNoPad) {
   assert_int64_equal(expected_splits, *GetOutput(1));
 }
 
+TEST_F(NgramKernelTest, TestManyBatchItemsWithLongTokens) {
+  MakeOp("<sep>", {2}, "", "", 0, false);
+  // Tokens longer than the inline tstring capacity, across enough batch items
+  // for the work to be sharded.
+  constexpr int kNumItems = 1000;
+  const string long_a(40, 'a');
+  const string long_b(40, 'b');
+  std::vector<tstring> data;
+  std::vector<int64_t> splits = {0};
+  std::vector<tstring> expected_values;
+  std::vector<int64_t> expected_splits = {0};
+  for (int i = 0; i < kNumItems; ++i) {
+    const string token = std::to_string(i);
+    data.push_back(long_a);
+    data.push_back(token);
+    data.push_back(long_b);
+    splits.push_back(data.size());
+    expected_values.push_back(absl::StrCat(long_a, "<sep>", token));
+    expected_values.push_back(absl::StrCat(token, "<sep>", long_b));
+    expected_splits.push_back(expected_values.size());
+  }
+  AddInputFromArray<tstring>(TensorShape({static_cast<int64_t>(data.size())}),
+                             data);
+  AddInputFromArray<int64_t>(TensorShape({kNumItems + 1}), splits);
+  TF_ASSERT_OK(RunOpKernel());
+
+  assert_string_equal(expected_values, *GetOutput(0));
+  assert_int64_equal(expected_splits, *GetOutput(1));
+}
+
 TEST_F(NgramKernelTest, ShapeFn) {
   ShapeInferenceTestOp op("StringNGrams");
   INFER_OK(op, "?;?", "[?];[?]");
@@ -16,16 +16,28 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_STRING_TO_HASH_BUCKET_FAST_OP_H_
 #define TENSORFLOW_CORE_KERNELS_STRING_TO_HASH_BUCKET_FAST_OP_H_
 
+#include <algorithm>
 #include <string>
 
+#include "absl/base/prefetch.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+// Strings are hashed in batches of this many: the character data of the next
+// batch is prefetched while the current one is hashed, and the bucket
+// reduction runs as a separate pass over the batch of hashes.
+constexpr int64_t kStringHashBatchSize = 16;
+
+// Number of leading strings whose lengths are used to estimate the per-string
+// hashing cost when sharding.
+constexpr int64_t kStringHashCostSamples = 64;
+
 template <uint64 hash(StringPiece)>
 class StringToHashBucketOp : public OpKernel {
  public:
@@ -44,15 +56,43 @@ class StringToHashBucketOp : public OpKernel {
                                             &output_tensor));
     auto output_flat = output_tensor->flat<int64_t>();
 
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64_t>(bucket_id);
+    const tstring* input = input_flat.data();
+    int64_t* output = output_flat.data();
+    const int64_t size = input_flat.size();
+    if (size == 0) return;
+    const uint64 num_buckets = num_buckets_;
+
+    auto work = [input, output, num_buckets](int64_t begin, int64_t end) {
+      uint64 hashes[kStringHashBatchSize];
+      for (int64_t start = begin; start < end; start += kStringHashBatchSize) {
+        const int64_t batch = std::min(kStringHashBatchSize, end - start);
+        const int64_t next_end = std::min(start + 2 * batch, end);
+        for (int64_t i = start + batch; i < next_end; ++i) {
+          absl::PrefetchToLocalCache(input[i].data());
+        }
+        for (int64_t i = 0; i < batch; ++i) {
+          hashes[i] = hash(input[start + i]);
+        }
+        for (int64_t i = 0; i < batch; ++i) {
+          // The number of buckets is always in the positive range of int64 so
+          // is the resulting bucket_id. Casting the bucket_id from uint64 to
+          // int64 is safe.
+          output[start + i] = static_cast<int64_t>(hashes[i] % num_buckets);
+        }
+      }
+    };
+
+    // Fingerprinting costs roughly a cycle per byte on top of a fixed
+    // per-string overhead.
+    const int64_t num_samples = std::min(size, kStringHashCostSamples);
+    int64_t sampled_bytes = 0;
+    for (int64_t i = 0; i < num_samples; ++i) {
+      sampled_bytes += input[i].size();
     }
+    const int64_t cost_per_string = 32 + sampled_bytes / num_samples;
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, size,
+          cost_per_string, work);
   }
 
  private:
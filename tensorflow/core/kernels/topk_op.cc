@@ -20,7 +20,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/topk_op.h"
 
 #include <algorithm>
+#include <memory>
 #include <numeric>
+#include <type_traits>
 #include <vector>
 
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
@@ -127,6 +129,200 @@ class TopK : public OpKernel {
   bool sorted_;
 };
 
+namespace {
+
+// Rows with at least this many columns are processed by `StreamingTopK`,
+// provided that k is small relative to the row length.
+constexpr int64_t kStreamingTopKMinCols = 16 * 1024;
+
+// Streaming is only worthwhile when most elements are rejected by the
+// threshold test, i.e. when `k * kStreamingTopKMaxKRatio <= num_cols`.
+constexpr int64_t kStreamingTopKMaxKRatio = 16;
+
+// Minimum number of columns scanned by a single task when a row is split
+// across threads.
+constexpr int64_t kStreamingTopKMinChunkCols = 8 * 1024;
+
+// Number of elements tested against the threshold at once.
+constexpr int kStreamingTopKBlockSize = 16;
+
+// Returns true if any of the `kStreamingTopKBlockSize` elements at `data` may
+// enter the top k, i.e. is not `<= threshold`. NaNs are always candidates, as
+// in the heap-based path.
+template <typename T>
+struct TopKBlockFilter {
+  static EIGEN_ALWAYS_INLINE bool HasCandidate(const T* data, T threshold) {
+    bool any = false;
+    for (int i = 0; i < kStreamingTopKBlockSize; ++i) {
+      any |= !(data[i] <= threshold);
+    }
+    return any;
+  }
+};
+
+// Vectorized filter for the types where Eigen packet comparisons are
+// available on all supported instruction sets.
+template <typename T>
+struct TopKPacketBlockFilter {
+  static EIGEN_ALWAYS_INLINE bool HasCandidate(const T* data, T threshold) {
+    using Eigen::internal::pandnot;
+    using Eigen::internal::pcmp_le;
+    using Eigen::internal::por;
+    using Eigen::internal::predux_any;
+    using Eigen::internal::ptrue;
+    using Packet = typename Eigen::internal::packet_traits<T>::type;
+    constexpr int kPacketSize = Eigen::internal::unpacket_traits<Packet>::size;
+    static_assert(kStreamingTopKBlockSize % kPacketSize == 0,
+                  "Block size must be a multiple of the packet size");
+    const Packet thresholds = Eigen::internal::pset1<Packet>(threshold);
+    const Packet all_ones = ptrue(thresholds);
+    Packet candidates = Eigen::internal::pzero(thresholds);
+    for (int i = 0; i < kStreamingTopKBlockSize; i += kPacketSize) {
+      const Packet x = Eigen::internal::ploadu<Packet>(data + i);
+      candidates = por(candidates, pandnot(all_ones, pcmp_le(x, thresholds)));
+    }
+    return predux_any(candidates);
+  }
+};
+
+template <>
+struct TopKBlockFilter<float> : TopKPacketBlockFilter<float> {};
+template <>
+struct TopKBlockFilter<double> : TopKPacketBlockFilter<double> {};
+
+// Orders indices by descending value, breaking ties by ascending index.
+template <typename T, typename Tidx>
+struct TopKStableGreater {
+  const T* data;
+  bool operator()(const Tidx a, const Tidx b) const {
+    if (data[b] < data[a]) {
+      return true;
+    } else if (data[b] > data[a]) {
+      return false;
+    } else {
+      return a < b;
+    }
+  }
+};
+
+// Returns the indices of the top `k` elements of `data[start:limit)`, in no
+// particular order.
+//
+// Once the heap is full, the value of its bottom element is a running
+// threshold: since columns are visited in increasing order, an element that
+// is `<=` the threshold loses to the bottom element and can be skipped.
+// Elements are tested a block at a time, so that the common case of a block
+// with no candidates costs a few vector compares.
+template <typename T, typename Tidx>
+std::vector<Tidx> StreamingTopKChunk(const T* data, int k, int64_t start,
+                                     int64_t limit) {
+  TopKStableGreater<T, Tidx> comp{data};
+  gtl::TopN<Tidx, TopKStableGreater<T, Tidx>> filter(k, comp);
+  filter.reserve(k + 1);
+  int64_t c = start;
+  for (; c < limit && c < start + k + 1; ++c) {
+    filter.push(static_cast<Tidx>(c));
+  }
+  if (c < limit) {
+    T threshold = data[filter.peek_bottom()];
+    for (; c + kStreamingTopKBlockSize <= limit;
+         c += kStreamingTopKBlockSize) {
+      if (!TopKBlockFilter<T>::HasCandidate(data + c, threshold)) continue;
+      for (int64_t i = c; i < c + kStreamingTopKBlockSize; ++i) {
+        if (!(data[i] <= threshold)) {
+          filter.push(static_cast<Tidx>(i));
+          threshold = data[filter.peek_bottom()];
+        }
+      }
+    }
+    for (; c < limit; ++c) {
+      if (!(data[c] <= threshold)) {
+        filter.push(static_cast<Tidx>(c));
+        threshold = data[filter.peek_bottom()];
+      }
+    }
+  }
+  std::unique_ptr<std::vector<Tidx>> top_k(filter.ExtractUnsorted());
+  return std::move(*top_k);
+}
+
+// Returns true if `StreamingTopK` should be used for the given problem size.
+inline bool UseStreamingTopK(int k, int64_t num_cols) {
+  return num_cols >= kStreamingTopKMinCols &&
+         static_cast<int64_t>(k) * kStreamingTopKMaxKRatio <= num_cols;
+}
+
+// Computes the top `k` elements of each row of `input`, for rows much longer
+// than k. When there are fewer rows than threads, each row is split into
+// chunks that are scanned concurrently, and the per-chunk candidates are
+// merged with a partial sort.
+template <typename T, typename Tidx>
+void StreamingTopK(OpKernelContext* context, int k,
+                   const typename TTypes<T, 2>::ConstTensor& input,
+                   const int64_t num_rows, const int64_t num_cols,
+                   typename TTypes<T, 2>::Tensor values,
+                   typename TTypes<Tidx, 2>::Tensor indices) {
+  auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+  int64_t chunks_per_row = 1;
+  if (num_rows < worker_threads.num_threads) {
+    const int64_t max_chunks =
+        num_cols / std::max<int64_t>(kStreamingTopKMinChunkCols,
+                                     kStreamingTopKMaxKRatio * k);
+    const int64_t threads_per_row =
+        (worker_threads.num_threads + num_rows - 1) / num_rows;
+    chunks_per_row =
+        std::max<int64_t>(1, std::min(max_chunks, threads_per_row));
+  }
+  const int64_t chunk_cols = (num_cols + chunks_per_row - 1) / chunks_per_row;
+
+  std::vector<std::vector<Tidx>> candidates(num_rows * chunks_per_row);
+  auto ScanChunks = [&](int64_t start_task, int64_t limit_task) {
+    for (int64_t task = start_task; task < limit_task; ++task) {
+      const int64_t b = task / chunks_per_row;
+      const int64_t start_col = (task % chunks_per_row) * chunk_cols;
+      const int64_t limit_col = std::min(num_cols, start_col + chunk_cols);
+      candidates[task] =
+          StreamingTopKChunk<T, Tidx>(&input(b, 0), k, start_col, limit_col);
+    }
+  };
+  const double cmp_cost = 3 * Eigen::TensorOpCost::AddCost<Tidx>() +
+                          Eigen::TensorOpCost::AddCost<T>();
+  const double log_k = Eigen::numext::log2(static_cast<float>(k + 1));
+  const int64_t scan_cost =
+      static_cast<int64_t>(chunk_cols * Eigen::TensorOpCost::AddCost<T>() +
+                           4 * k * log_k * cmp_cost);
+  Shard(worker_threads.num_threads, worker_threads.workers,
+        num_rows * chunks_per_row, scan_cost, ScanChunks);
+
+  auto MergeChunks = [&](int64_t start_batch, int64_t limit_batch) {
+    std::vector<Tidx> merged;
+    for (int64_t b = start_batch; b < limit_batch; ++b) {
+      merged.clear();
+      for (int64_t chunk = 0; chunk < chunks_per_row; ++chunk) {
+        auto& chunk_candidates = candidates[b * chunks_per_row + chunk];
+        merged.insert(merged.end(), chunk_candidates.begin(),
+                      chunk_candidates.end());
+        std::vector<Tidx>().swap(chunk_candidates);
+      }
+      // The output is sorted even if `sorted` is false: sorting the at most
+      // `chunks_per_row * k` candidates is cheap next to the scan.
+      TopKStableGreater<T, Tidx> comp{&input(b, 0)};
+      std::partial_sort(merged.begin(), merged.begin() + k, merged.end(),
+                        comp);
+      for (int i = 0; i < k; ++i) {
+        indices(b, i) = merged[i];
+        values(b, i) = input(b, merged[i]);
+      }
+    }
+  };
+  const int64_t merge_cost =
+      static_cast<int64_t>(chunks_per_row * k * (log_k + 1) * cmp_cost);
+  Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+        merge_cost, MergeChunks);
+}
+
+}  // namespace
+
 namespace functor {
 
 template <typename T, typename Tidx>
@@ -161,6 +357,12 @@ struct TopKFunctor<CPUDevice, T, Tidx> {
       return OkStatus();
     }
 
+    if (UseStreamingTopK(k, num_cols)) {
+      StreamingTopK<T, Tidx>(context, k, input, num_rows, num_cols, values,
+                             indices);
+      return OkStatus();
+    }
+
     auto SortIndices = [&](int64_t start_batch, int64_t limit_batch) {
       for (int32_t b = start_batch; b < limit_batch; ++b) {
         const T* input_data = &input(b, 0);
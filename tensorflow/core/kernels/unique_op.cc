@@ -13,9 +13,12 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/bounds_check.h"
@@ -26,6 +29,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/bfloat16.h"
+#include "tensorflow/core/platform/threadpool.h"
 
 namespace tensorflow {
 namespace {
@@ -68,6 +72,196 @@ struct UniqueOpHashMap<bfloat16, TIndex> {
   using map_type = std::unordered_map<bfloat16, TIndex>;
 };
 
+// Inputs with fewer elements than this are uniquified on the calling thread,
+// because the partitioning passes of `ParallelUnique` would dominate.
+constexpr int64_t kParallelUniqueMinElements = 64 * 1024;
+
+// Upper bound on log2 of the number of hash partitions used by
+// `ParallelUnique`.
+constexpr int kParallelUniqueMaxLog2Partitions = 8;
+
+// `UniqueOpHasParallelImpl<T>::value` is true if `ParallelUnique` can be used
+// for elements of type `T`. Only integral keys (excluding `bool`) are
+// supported, since they hash cheaply and have no `NaN`-like values.
+template <typename T>
+struct UniqueOpHasParallelImpl
+    : std::integral_constant<bool, std::is_integral<T>::value &&
+                                       !std::is_same<T, bool>::value> {};
+
+// Returns the partition of `value` from the top `log2_partitions` bits of a
+// multiplicative hash, so that runs of consecutive ids spread evenly over the
+// partitions.
+template <typename T>
+inline int UniquePartitionOf(T value, int log2_partitions) {
+  if (log2_partitions == 0) return 0;
+  const uint64 h = static_cast<uint64>(value) * 0x9E3779B97F4A7C15ULL;
+  return static_cast<int>(h >> (64 - log2_partitions));
+}
+
+// Computes the unique elements of the integral `input`, whose only
+// non-trivial dimension is `axis`, using the intra-op thread pool. Writes
+// `idx_vec` and allocates output 0 (and output 2 if `compute_counts`).
+//
+// The input is split into contiguous blocks, one per thread, and the
+// positions of each block are scattered into hash partitions. Scattering
+// blocks in order keeps the positions of every partition sorted. Each
+// partition is then uniquified independently, recording for every position
+// the position of the first occurrence of its value. A prefix sum over the
+// first occurrences assigns output ids in order of first appearance, so the
+// outputs are identical to those of the serial implementation.
+template <typename T, typename TIndex>
+void ParallelUnique(OpKernelContext* context, const Tensor& input,
+                    int64_t axis, thread::ThreadPool* workers, int num_threads,
+                    typename TTypes<TIndex>::Vec idx_vec,
+                    bool compute_counts) {
+  auto Tin = input.flat<T>();
+  const int64_t N = static_cast<int64_t>(Tin.size());
+
+  int log2_partitions = 0;
+  while ((1 << log2_partitions) < num_threads &&
+         log2_partitions < kParallelUniqueMaxLog2Partitions) {
+    ++log2_partitions;
+  }
+  const int num_partitions = 1 << log2_partitions;
+  const int64_t num_blocks = std::min<int64_t>(num_threads, N);
+  const int64_t block_size = (N + num_blocks - 1) / num_blocks;
+  auto block_limit = [block_size, N](int64_t b) {
+    return std::min(N, (b + 1) * block_size);
+  };
+  // Rough per-element costs, in cycles, of the passes below.
+  const int64_t scan_cost = block_size * 5;
+  const int64_t hash_cost = (N / num_partitions + 1) * 50;
+
+  // Count the elements of each block that fall into each partition.
+  std::vector<int64_t> offsets(num_blocks * num_partitions, 0);
+  workers->ParallelFor(num_blocks, scan_cost, [&](int64_t start, int64_t end) {
+    for (int64_t b = start; b < end; ++b) {
+      int64_t* counts = &offsets[b * num_partitions];
+      for (int64_t i = b * block_size, limit = block_limit(b); i < limit; ++i) {
+        ++counts[UniquePartitionOf(Tin(i), log2_partitions)];
+      }
+    }
+  });
+
+  // Exclusive scan in partition-major order, so that each partition's
+  // positions are contiguous and ordered by block.
+  std::vector<int64_t> partition_start(num_partitions + 1);
+  int64_t running = 0;
+  for (int p = 0; p < num_partitions; ++p) {
+    partition_start[p] = running;
+    for (int64_t b = 0; b < num_blocks; ++b) {
+      const int64_t count = offsets[b * num_partitions + p];
+      offsets[b * num_partitions + p] = running;
+      running += count;
+    }
+  }
+  partition_start[num_partitions] = running;
+
+  std::vector<int64_t> positions(N);
+  workers->ParallelFor(num_blocks, scan_cost, [&](int64_t start, int64_t end) {
+    for (int64_t b = start; b < end; ++b) {
+      int64_t* cursor = &offsets[b * num_partitions];
+      for (int64_t i = b * block_size, limit = block_limit(b); i < limit; ++i) {
+        positions[cursor[UniquePartitionOf(Tin(i), log2_partitions)]++] = i;
+      }
+    }
+  });
+
+  // Uniquify each partition. `first_pos[i]` is the position of the first
+  // occurrence of `Tin(i)`, and `uniques[p]` holds the (first position, count)
+  // pairs of partition `p` in order of first appearance.
+  std::vector<int64_t> first_pos(N);
+  std::vector<std::vector<std::pair<int64_t, int64_t>>> uniques(
+      num_partitions);
+  workers->ParallelFor(
+      num_partitions, hash_cost, [&](int64_t start, int64_t end) {
+        for (int64_t p = start; p < end; ++p) {
+          const int64_t begin = partition_start[p];
+          const int64_t limit = partition_start[p + 1];
+          auto& partition_uniques = uniques[p];
+          absl::flat_hash_map<T, int64_t> uniq;
+          uniq.reserve(limit - begin);
+          for (int64_t k = begin; k < limit; ++k) {
+            const int64_t i = positions[k];
+            auto it = uniq.emplace(Tin(i), partition_uniques.size());
+            if (it.second) {
+              partition_uniques.emplace_back(i, 0);
+            }
+            auto& entry = partition_uniques[it.first->second];
+            ++entry.second;
+            first_pos[i] = entry.first;
+          }
+        }
+      });
+
+  // Number the first occurrences of each block, then offset by the numbers of
+  // first occurrences in preceding blocks.
+  std::vector<int64_t> block_uniques(num_blocks, 0);
+  workers->ParallelFor(num_blocks, scan_cost, [&](int64_t start, int64_t end) {
+    for (int64_t b = start; b < end; ++b) {
+      int64_t count = 0;
+      for (int64_t i = b * block_size, limit = block_limit(b); i < limit; ++i) {
+        count += first_pos[i] == i;
+      }
+      block_uniques[b] = count;
+    }
+  });
+  int64_t uniq_size = 0;
+  for (int64_t b = 0; b < num_blocks; ++b) {
+    const int64_t count = block_uniques[b];
+    block_uniques[b] = uniq_size;
+    uniq_size += count;
+  }
+
+  TensorShape output_shape(input.shape());
+  output_shape.set_dim(axis, uniq_size);
+  Tensor* output = nullptr;
+  OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+  auto Tout = output->flat<T>();
+
+  workers->ParallelFor(num_blocks, scan_cost, [&](int64_t start, int64_t end) {
+    for (int64_t b = start; b < end; ++b) {
+      int64_t next_id = block_uniques[b];
+      for (int64_t i = b * block_size, limit = block_limit(b); i < limit; ++i) {
+        if (first_pos[i] == i) {
+          Tout(next_id) = Tin(i);
+          idx_vec(i) = static_cast<TIndex>(next_id);
+          ++next_id;
+        }
+      }
+    }
+  });
+  // Every first occurrence now holds its final id, so the remaining positions
+  // can be resolved independently.
+  workers->ParallelFor(num_blocks, scan_cost, [&](int64_t start, int64_t end) {
+    for (int64_t b = start; b < end; ++b) {
+      for (int64_t i = b * block_size, limit = block_limit(b); i < limit; ++i) {
+        const int64_t first = first_pos[i];
+        if (first != i) {
+          idx_vec(i) = idx_vec(first);
+        }
+      }
+    }
+  });
+
+  if (compute_counts) {
+    Tensor* count_output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                2, TensorShape({uniq_size}), &count_output));
+    auto count_output_vec = count_output->template vec<TIndex>();
+    workers->ParallelFor(
+        num_partitions, scan_cost / num_partitions + 1,
+        [&](int64_t start, int64_t end) {
+          for (int64_t p = start; p < end; ++p) {
+            for (const auto& entry : uniques[p]) {
+              count_output_vec(idx_vec(entry.first)) =
+                  static_cast<TIndex>(entry.second);
+            }
+          }
+        });
+  }
+}
+
 // `UniqueOp` computes the unique elements in the input tensor.
 //
 // * `T` is the element type.
@@ -150,6 +344,19 @@ class UniqueOp : public OpKernel {
       auto Tin = input.flat<T>();
       const int64_t N = static_cast<int64_t>(Tin.size());
 
+      if constexpr (UniqueOpHasParallelImpl<T>::value) {
+        const auto* worker_threads =
+            context->device()->tensorflow_cpu_worker_threads();
+        if (N >= kParallelUniqueMinElements && worker_threads != nullptr &&
+            worker_threads->num_threads > 1) {
+          ParallelUnique<T, TIndex>(context, input, axis,
+                                    worker_threads->workers,
+                                    worker_threads->num_threads, idx_vec,
+                                    num_outputs() > 2);
+          return;
+        }
+      }
+
       typename UniqueOpHashMap<T, TIndex>::map_type uniq;
       uniq.reserve(2 * N);
       for (Eigen::Index i = 0, j = 0; i < N; ++i) {
@@ -15,11 +15,16 @@ limitations under the License.
 
 #include <functional>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
@@ -37,6 +42,65 @@ namespace {
 
 const int kMaxStrLen = 40;
 
+class UniqueOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op_name, DataType input_type, DataType idx_type) {
+    TF_ASSERT_OK(NodeDefBuilder("unique_op", op_name)
+                     .Input(FakeInput(input_type))
+                     .Attr("out_idx", idx_type)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+// Inputs large enough to take the multi-threaded path must produce the same
+// outputs as a serial scan in order of first appearance.
+TEST_F(UniqueOpTest, LargeInt64InputMatchesSerial) {
+  MakeOp("UniqueWithCounts", DT_INT64, DT_INT32);
+  const int n = 1 << 18;
+  std::vector<int64_t> values(n);
+  for (int i = 0; i < n; ++i) {
+    values[i] = (static_cast<int64_t>(std::rand()) % 20000) * 1000003 - 7;
+  }
+  AddInputFromArray<int64_t>(TensorShape({n}), values);
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::unordered_map<int64_t, int32> ids;
+  std::vector<int64_t> expected_y;
+  std::vector<int32> expected_idx(n);
+  std::vector<int32> expected_count;
+  for (int i = 0; i < n; ++i) {
+    auto it = ids.emplace(values[i], static_cast<int32>(expected_y.size()));
+    if (it.second) {
+      expected_y.push_back(values[i]);
+      expected_count.push_back(0);
+    }
+    expected_idx[i] = it.first->second;
+    ++expected_count[it.first->second];
+  }
+  const int64_t num_unique = expected_y.size();
+  test::ExpectTensorEqual<int64_t>(
+      *GetOutput(0), test::AsTensor<int64_t>(expected_y, {num_unique}));
+  test::ExpectTensorEqual<int32>(*GetOutput(1),
+                                 test::AsTensor<int32>(expected_idx, {n}));
+  test::ExpectTensorEqual<int32>(
+      *GetOutput(2), test::AsTensor<int32>(expected_count, {num_unique}));
+}
+
+TEST_F(UniqueOpTest, LargeInt32InputAllDistinct) {
+  MakeOp("Unique", DT_INT32, DT_INT64);
+  const int n = 1 << 17;
+  AddInput<int32>(TensorShape({n}), [n](int i) { return n - i; });
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_y(allocator(), DT_INT32, TensorShape({n}));
+  test::FillFn<int32>(&expected_y, [n](int i) { return n - i; });
+  Tensor expected_idx(allocator(), DT_INT64, TensorShape({n}));
+  test::FillFn<int64_t>(&expected_idx, [](int i) { return i; });
+  test::ExpectTensorEqual<int32>(*GetOutput(0), expected_y);
+  test::ExpectTensorEqual<int64_t>(*GetOutput(1), expected_idx);
+}
+
 TensorProto GetRandomInt32TensorProto(int dim, int max_int) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_INT32);
@@ -111,6 +175,32 @@ void BM_Unique_INT32_Repeat(::testing::benchmark::State& state) {
                           sizeof(int32));
 }
 
+// Uses the default executor and the full intra-op thread pool, so that large
+// inputs take the partitioned multi-threaded path.
+void BM_Unique_INT64_MultiThreaded(::testing::benchmark::State& state) {
+  const int dim = state.range(0);
+  const int max_int = state.range(1);
+
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor input(DT_INT64, TensorShape({dim}));
+  auto input_flat = input.flat<int64_t>();
+  for (int i = 0; i < dim; ++i) {
+    input_flat(i) = std::rand() % max_int;
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Unique")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("T", DT_INT64)
+                  .Finalize(g, &node));
+  FixupSourceAndSinkEdges(g);
+
+  test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * dim *
+                          sizeof(int64_t));
+}
+
 TensorProto GetRandomStringsTensorProto(int dim, int max_str_len) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_STRING);
@@ -193,6 +283,15 @@ BENCHMARK(BM_Unique_INT32_Repeat)
     ->ArgPair(64 * 1024, 64 * 1024 * 1024)
     ->ArgPair(1024 * 1024, 64 * 1024 * 1024);
 
+BENCHMARK(BM_Unique_INT64_MultiThreaded)
+    ->UseRealTime()
+    ->ArgPair(64 * 1024, 1024 * 1024)
+    ->ArgPair(1024 * 1024, 1024 * 1024)
+    ->ArgPair(4 * 1024 * 1024, 1024 * 1024)
+    ->ArgPair(64 * 1024, 64 * 1024 * 1024)
+    ->ArgPair(1024 * 1024, 64 * 1024 * 1024)
+    ->ArgPair(4 * 1024 * 1024, 64 * 1024 * 1024);
+
 BENCHMARK(BM_Unique_STRING)
     ->UseRealTime()
     ->Arg(32)
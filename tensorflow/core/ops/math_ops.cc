@@ -1473,6 +1473,72 @@ REGISTER_OP("SparseSegmentSqrtNGradV2")
     .Attr("Tsegmentids: {int32, int64} = DT_INT32")
     .SetShapeFn(SparseSegmentReductionGradV2ShapeFn);
 
+REGISTER_OP("_FusedEmbeddingLookupSparse")
+    .Input("params: T")
+    .Input("ids: Tidx")
+    .Input("segment_ids: Tsegmentids")
+    .Input("weights: num_weights * T")
+    .Output("output: T")
+    .Attr("T: {bfloat16, half, float, double}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("Tsegmentids: {int32, int64} = DT_INT32")
+    .Attr("num_weights: int >= 0 = 0")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'} = 'sum'")
+    .SetShapeFn([](InferenceContext* c) {
+      TF_RETURN_IF_ERROR(SparseSegmentReductionShapeFn(c));
+      int num_weights;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_weights", &num_weights));
+      if (num_weights > 1) {
+        return errors::InvalidArgument("num_weights must be 0 or 1, got ",
+                                       num_weights);
+      }
+      return absl::OkStatus();
+    })
+    .Doc(R"doc(
+Internal operation which computes the sparse embedding lookup
+`combiner(params[ids] * weights)` per segment, without materializing the
+gathered rows. It is a composition of Unique, Gather and
+SparseSegment{Sum,Mean,SqrtN} (or SegmentSum over weighted rows): reserved
+for internal use.
+
+`ids` and `segment_ids` are vectors of the same length. `segment_ids` must be
+sorted, and the output has `segment_ids[-1] + 1` rows. If `num_weights` is 1,
+`weights` holds one weight per id, or a single weight shared by all ids;
+otherwise all weights are 1. The "mean" and "sqrtn" combiners divide each
+segment by the sum of its weights and the square root of the sum of its
+squared weights respectively, producing zeros for empty segments and segments
+whose divisor is zero.
+
+Do not invoke this operator directly in Python. A fusion optimization is
+expected to create these operators.
+)doc");
+
+REGISTER_OP("_FusedElementwise")
+    .Input("x: T")
+    .Input("args: num_args * T")
+    .Output("y: T")
+    .Attr("T: {bfloat16, half, float, double}")
+    .Attr("num_args: int >= 0 = 0")
+    .Attr("fused_ops: list(string) = []")
+    .Attr("chain_is_rhs: list(bool) = []")
+    .SetShapeFn(shape_inference::UnchangedShape)
+    .Doc(R"doc(
+Internal operation which applies a chain of elementwise ops to `x` in a
+single pass over memory: reserved for internal use.
+
+`fused_ops` lists the ops in order of application. Unary ops (Relu, Relu6,
+Elu, Selu, Sigmoid, Tanh, Exp, Log, Neg, Abs, Square, Sqrt, Rsqrt,
+Reciprocal) apply to the running value. Binary ops (Add, AddV2, BiasAdd,
+Sub, Mul, RealDiv, Maximum, Minimum, SquaredDifference) combine it with the
+next tensor of `args`; the running value is the second operand if the
+matching entry of `chain_is_rhs` is true, and the first otherwise. Each
+argument is a scalar, has the shape of `x`, or is a vector over the last
+dimension of `x`. The output has the shape of `x`.
+
+Do not invoke this operator directly in Python. A fusion optimization is
+expected to create these operators.
+)doc");
+
 REGISTER_OP("All")
     .Input("input: bool")
     .Input("reduction_indices: Tidx")
@@ -15,17 +15,23 @@ limitations under the License.
 
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <map>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "absl/base/call_once.h"
+#include "absl/crc/crc32c.h"
 #include "absl/synchronization/mutex.h"
 #include "xla/tsl/util/byte_swap_array.h"
+#include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/framework/variant.h"
@@ -81,9 +87,54 @@ const int64_t kLargeTensorThreshold = static_cast<int64_t>(1) << 32;
 const int kMaxFileReadThreads = 8;
 // Minimum size of a file section handled by each thread.
 const int64_t kMinSectionSize = static_cast<int64_t>(1) << 31;
+// Size of the reads issued when restoring a tensor straight into its buffer.
+// Each chunk is checksummed right after it is read, while still in cache.
+const int64_t kRestoreReadChunkSize = static_cast<int64_t>(8) << 20;
 
 namespace {
 
+// Reads file[offset, offset+size) directly into "destination", in chunks of
+// kRestoreReadChunkSize, and extends "*crc32c" over the bytes as they arrive.
+Status ReadAndChecksum(RandomAccessFile* file, int64_t offset, int64_t size,
+                       char* destination, uint32* crc32c) {
+  for (int64_t pos = 0; pos < size; pos += kRestoreReadChunkSize) {
+    const size_t chunk_size = std::min(kRestoreReadChunkSize, size - pos);
+    char* chunk = destination + pos;
+    StringPiece sp;
+    TF_RETURN_IF_ERROR(file->Read(offset + pos, chunk_size, &sp, chunk));
+    if (sp.data() != chunk) {
+      memmove(chunk, sp.data(), chunk_size);
+    }
+    *crc32c = crc32c::Extend(*crc32c, chunk, chunk_size);
+  }
+  return absl::OkStatus();
+}
+
+// Aliases a range of a read-only memory mapping of a data file.
+class MappedTensorBuffer : public TensorBuffer {
+ public:
+  MappedTensorBuffer(std::shared_ptr<ReadOnlyMemoryRegion> region,
+                     const char* data, size_t size)
+      : TensorBuffer(const_cast<char*>(data)),
+        region_(std::move(region)),
+        size_(size) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("mmap");
+  }
+  bool GetAllocatedBytes(size_t* out_bytes) const override { return false; }
+  // The mapping is read-only and may be shared with other tensors and
+  // processes, so it must never be forwarded or written in place.
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+  const size_t size_;
+};
+
 // Reads "num_elements" string elements from file[offset, offset+size) into the
 // length-N "destination".  Discards the original content of "destination".
 //
@@ -586,6 +637,180 @@ Status BundleWriter::Finish() {
   return absl::OkStatus();
 }
 
+AsyncBundleWriter::AsyncBundleWriter(Env* env, StringPiece prefix,
+                                     const Options& options)
+    : prefix_(prefix),
+      max_staging_bytes_(options.max_staging_bytes),
+      writer_(env, prefix, options.writer_options) {
+  status_ = writer_.status();
+  thread_.reset(env->StartThread(ThreadOptions(), "async_bundle_writer",
+                                 [this]() { WriteLoop(); }));
+}
+
+AsyncBundleWriter::~AsyncBundleWriter() {
+  {
+    absl::MutexLock l(&mu_);
+    if (!closed_) {
+      closed_ = true;
+      status_.Update(errors::Cancelled("AsyncBundleWriter for ", prefix_,
+                                       " was destroyed before Close()"));
+    }
+  }
+  thread_.reset();
+}
+
+Status AsyncBundleWriter::Add(StringPiece key, const Tensor& val) {
+  StagedTensor staged;
+  staged.key = string(key);
+  staged.tensor = tensor::DeepCopy(val);
+  return Stage(std::move(staged));
+}
+
+Status AsyncBundleWriter::AddSlice(StringPiece full_tensor_key,
+                                   const TensorShape& full_tensor_shape,
+                                   const TensorSlice& slice_spec,
+                                   const Tensor& slice_tensor) {
+  StagedTensor staged;
+  staged.key = string(full_tensor_key);
+  staged.tensor = tensor::DeepCopy(slice_tensor);
+  staged.is_slice = true;
+  staged.full_tensor_shape = full_tensor_shape;
+  staged.slice_spec = slice_spec;
+  return Stage(std::move(staged));
+}
+
+Status AsyncBundleWriter::Stage(StagedTensor staged) {
+  const int64_t bytes = staged.tensor.TotalBytes();
+  absl::MutexLock l(&mu_);
+  if (closed_) {
+    return errors::FailedPrecondition("AsyncBundleWriter for ", prefix_,
+                                      " is closed");
+  }
+  auto has_room = [this, bytes]() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return !status_.ok() || staged_bytes_ == 0 ||
+           staged_bytes_ + bytes <= max_staging_bytes_;
+  };
+  mu_.Await(absl::Condition(&has_room));
+  if (!status_.ok()) return status_;
+  staged_bytes_ += bytes;
+  queue_.push_back(std::move(staged));
+  return absl::OkStatus();
+}
+
+void AsyncBundleWriter::Close() {
+  absl::MutexLock l(&mu_);
+  closed_ = true;
+}
+
+Status AsyncBundleWriter::Wait() {
+  absl::MutexLock l(&mu_);
+  DCHECK(closed_);
+  mu_.Await(absl::Condition(&done_));
+  return status_;
+}
+
+Status AsyncBundleWriter::Finish() {
+  Close();
+  return Wait();
+}
+
+bool AsyncBundleWriter::IsDone() {
+  absl::MutexLock l(&mu_);
+  return done_;
+}
+
+void AsyncBundleWriter::WriteLoop() {
+  while (true) {
+    StagedTensor staged;
+    {
+      absl::MutexLock l(&mu_);
+      auto has_work = [this]() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        return closed_ || !queue_.empty();
+      };
+      mu_.Await(absl::Condition(&has_work));
+      if (queue_.empty()) break;
+      staged = std::move(queue_.front());
+      queue_.pop_front();
+      if (!status_.ok()) {
+        // Drop what is left so that blocked writers can return the error.
+        staged_bytes_ -= staged.tensor.TotalBytes();
+        continue;
+      }
+    }
+    Status status =
+        staged.is_slice
+            ? writer_.AddSlice(staged.key, staged.full_tensor_shape,
+                               staged.slice_spec, staged.tensor)
+            : writer_.Add(staged.key, staged.tensor);
+    const int64_t bytes = staged.tensor.TotalBytes();
+    staged.tensor = Tensor();
+    absl::MutexLock l(&mu_);
+    staged_bytes_ -= bytes;
+    status_.Update(status);
+  }
+  Status status;
+  {
+    absl::MutexLock l(&mu_);
+    status = status_;
+  }
+  // Only a complete write produces a metadata file.
+  if (status.ok()) status = writer_.Finish();
+  absl::MutexLock l(&mu_);
+  status_.Update(status);
+  done_ = true;
+}
+
+namespace {
+
+// Writers handed over by AddPendingBundleWrite(), keyed by prefix.
+struct PendingBundleWrites {
+  absl::Mutex mu;
+  std::multimap<string, std::unique_ptr<AsyncBundleWriter>> writers
+      TF_GUARDED_BY(mu);
+};
+
+PendingBundleWrites* GetPendingBundleWrites() {
+  static PendingBundleWrites* pending = new PendingBundleWrites;
+  return pending;
+}
+
+}  // namespace
+
+void AddPendingBundleWrite(StringPiece prefix,
+                           std::unique_ptr<AsyncBundleWriter> writer) {
+  writer->Close();
+  PendingBundleWrites* pending = GetPendingBundleWrites();
+  absl::MutexLock l(&pending->mu);
+  // Forget the writes that have succeeded; failed ones are kept until their
+  // error has been returned.
+  for (auto it = pending->writers.begin(); it != pending->writers.end();) {
+    if (it->second->IsDone() && it->second->Wait().ok()) {
+      it = pending->writers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  pending->writers.emplace(string(prefix), std::move(writer));
+}
+
+Status WaitForPendingBundleWrites(StringPiece prefix) {
+  std::vector<std::unique_ptr<AsyncBundleWriter>> writers;
+  {
+    PendingBundleWrites* pending = GetPendingBundleWrites();
+    absl::MutexLock l(&pending->mu);
+    auto range = pending->writers.equal_range(string(prefix));
+    for (auto it = range.first; it != range.second; ++it) {
+      writers.push_back(std::move(it->second));
+    }
+    pending->writers.erase(range.first, range.second);
+  }
+  Status status;
+  for (const auto& writer : writers) {
+    status.Update(writer->Wait());
+  }
+  return status;
+}
+
 // Merging tensor bundles.
 
 // Accumulator of metadata states during a merge.
@@ -716,6 +941,7 @@ Status MergeBundles(Env* env, absl::Span<const tstring> prefixes,
   if (!status.ok() && !errors::IsAlreadyExists(status)) return status;
   bool atleast_one_file_exists = false;
   for (auto& prefix : prefixes) {
+    TF_RETURN_IF_ERROR(WaitForPendingBundleWrites(prefix));
     if (!env->FileExists(MetaFilename(prefix)).ok()) {
       if (allow_missing_files) continue;
       return errors::InvalidArgument(
@@ -792,6 +1018,10 @@ BundleReader::BundleReader(Env* env, StringPiece prefix, Options options)
     cache_ = owned_cache_.get();
   }
 
+  // The bundle may still be written by a pending AsyncBundleWriter.
+  status_ = WaitForPendingBundleWrites(prefix_);
+  if (!status_.ok()) return;
+
   const string filename = MetaFilename(prefix_);
   uint64 file_size;
   status_ = env_->GetFileSize(filename, &file_size);
@@ -907,11 +1137,12 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
   }
 
   // Open the data file if it has not been opened.
+  const string data_filename =
+      DataFilename(prefix_, entry.shard_id(), num_shards_);
   io::InputBuffer* buffered_file = data_[entry.shard_id()];
   if (buffered_file == nullptr) {
     RandomAccessFile* file = nullptr;
-    TF_RETURN_IF_ERROR(cache_->GetFile(
-        DataFilename(prefix_, entry.shard_id(), num_shards_), &file));
+    TF_RETURN_IF_ERROR(cache_->GetFile(data_filename, &file));
     buffered_file = new io::InputBuffer(file, kBufferSize);
     data_[entry.shard_id()] = buffered_file;
   }
@@ -924,14 +1155,11 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
     char* backing_buffer = const_cast<char*>((ret->tensor_data().data()));
     size_t unused_bytes_read;
     if (entry.size() > kBufferSize || enable_multi_threading_for_testing_) {
-      StringPiece sp;
       if (!enable_multi_threading_for_testing_ &&
           entry.size() < kLargeTensorThreshold) {
-        TF_RETURN_IF_ERROR(buffered_file->file()->Read(
-            entry.offset(), entry.size(), &sp, backing_buffer));
-        if (sp.data() != backing_buffer) {
-          memmove(backing_buffer, sp.data(), entry.size());
-        }
+        TF_RETURN_IF_ERROR(ReadAndChecksum(buffered_file->file(),
+                                           entry.offset(), entry.size(),
+                                           backing_buffer, &actual_crc32c));
       } else {
         int64_t section_size = kMinSectionSize;
         int64_t thread_pool_size =
@@ -943,32 +1171,43 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
               (entry.size() + kMaxFileReadThreads - 1) / kMaxFileReadThreads;
         }
 
+        // Each section is checksummed as it is read; the per-section values
+        // are concatenated once all reads are done.
         std::vector<Status> statuses(thread_pool_size);
+        std::vector<uint32> section_crc32cs(thread_pool_size, 0);
+        std::vector<int64_t> section_sizes(thread_pool_size, 0);
+        // A prefetched file is in memory and shared by the sections.
+        RandomAccessFile* prefetched_file =
+            cache_->IsPrefetched(data_filename) ? buffered_file->file()
+                                                : nullptr;
         auto reader_pool = std::make_unique<thread::ThreadPool>(
             Env::Default(), "restore_large_tensor", thread_pool_size);
 
         for (int i = 0; i < thread_pool_size; ++i) {
-          reader_pool->Schedule([&, i]() {
-            int64_t offset = i * section_size;
-            int64_t size = i == thread_pool_size - 1 ? entry.size() - offset
-                                                     : section_size;
+          const int64_t offset =
+              std::min<int64_t>(i * section_size, entry.size());
+          const int64_t size = i == thread_pool_size - 1
+                                   ? entry.size() - offset
+                                   : std::min<int64_t>(section_size,
+                                                       entry.size() - offset);
+          section_sizes[i] = size;
+          reader_pool->Schedule([&, i, offset, size]() {
+            if (prefetched_file != nullptr) {
+              statuses[i] = ReadAndChecksum(
+                  prefetched_file, entry.offset() + offset, size,
+                  backing_buffer + offset, &section_crc32cs[i]);
+              return;
+            }
             std::unique_ptr<RandomAccessFile> section_reader = nullptr;
-            StringPiece sp;
-            if (auto file_status = env_->NewRandomAccessFile(
-                    DataFilename(prefix_, entry.shard_id(), num_shards_),
-                    &section_reader);
+            if (auto file_status =
+                    env_->NewRandomAccessFile(data_filename, &section_reader);
                 !file_status.ok()) {
               statuses[i] = file_status;
               return;
             }
-
-            auto backing_buffer_current_pos = backing_buffer + offset;
-            auto status = section_reader->Read(entry.offset() + offset, size,
-                                               &sp, backing_buffer_current_pos);
-            if (sp.data() != backing_buffer_current_pos) {
-              memmove(backing_buffer_current_pos, sp.data(), size);
-            }
-            statuses[i] = std::move(status);
+            statuses[i] = ReadAndChecksum(
+                section_reader.get(), entry.offset() + offset, size,
+                backing_buffer + offset, &section_crc32cs[i]);
           });
         }
         reader_pool = nullptr;  // Wait for reads to finish
@@ -976,14 +1215,19 @@ Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
         for (const auto& status : statuses) {
           TF_RETURN_IF_ERROR(status);
         }
+        for (int i = 0; i < thread_pool_size; ++i) {
+          actual_crc32c = static_cast<uint32>(absl::ConcatCrc32c(
+              absl::crc32c_t{actual_crc32c}, absl::crc32c_t{section_crc32cs[i]},
+              section_sizes[i]));
+        }
       }
     } else {
       TF_RETURN_IF_ERROR(buffered_file->ReadNBytes(entry.size(), backing_buffer,
                                                    &unused_bytes_read));
+      actual_crc32c = crc32c::Value(backing_buffer, entry.size());
     }
-    // Note that we compute the checksum *before* byte-swapping. The checksum
+    // Note that the checksum is computed *before* byte-swapping. The checksum
     // should be on the bytes in the order they appear in the file.
-    actual_crc32c = crc32c::Value(backing_buffer, entry.size());
     if (need_to_swap_bytes_) {
       TF_RETURN_IF_ERROR(ByteSwapTensor(ret));
     }
@@ -1033,6 +1277,56 @@ Status BundleReader::Lookup(StringPiece key, Tensor* val) {
   }
 }
 
+Status BundleReader::LookupMapped(StringPiece key, Tensor* val,
+                                  bool* mapped) {
+  CHECK(val != nullptr);
+  *mapped = false;
+  BundleEntryProto entry;
+  TF_RETURN_IF_ERROR(GetBundleEntryProto(key, &entry));
+  if (!entry.slices().empty() || !DataTypeCanUseMemcpy(entry.dtype()) ||
+      need_to_swap_bytes_) {
+    return absl::OkStatus();
+  }
+  const TensorShape stored_shape(entry.shape());
+  if (stored_shape.num_elements() == 0) return absl::OkStatus();
+  const int64_t expected_size =
+      stored_shape.num_elements() * DataTypeSize(entry.dtype());
+  if (entry.size() != expected_size) {
+    return errors::DataLoss("Invalid size in bundle entry: key ", key,
+                            "; stored size ", entry.size(),
+                            "; expected size ", expected_size);
+  }
+
+  auto it = mapped_data_.find(entry.shard_id());
+  if (it == mapped_data_.end()) {
+    std::unique_ptr<ReadOnlyMemoryRegion> region;
+    const Status s = env_->NewReadOnlyMemoryRegionFromFile(
+        DataFilename(prefix_, entry.shard_id(), num_shards_), &region);
+    if (!s.ok()) {
+      VLOG(1) << "Not mapping data file " << entry.shard_id() << " of "
+              << prefix_ << ": " << s;
+    }
+    it = mapped_data_.emplace(entry.shard_id(), std::move(region)).first;
+  }
+  const std::shared_ptr<ReadOnlyMemoryRegion>& region = it->second;
+  if (region == nullptr) return absl::OkStatus();
+  if (entry.offset() < 0 || entry.offset() + entry.size() > region->length()) {
+    return errors::DataLoss("Bundle entry for ", key, " at offset ",
+                            entry.offset(), " with size ", entry.size(),
+                            " is past the end of its data file");
+  }
+  const char* data = static_cast<const char*>(region->data()) + entry.offset();
+  if (reinterpret_cast<uintptr_t>(data) % EIGEN_MAX_ALIGN_BYTES != 0) {
+    return absl::OkStatus();
+  }
+
+  auto* buffer = new MappedTensorBuffer(region, data, entry.size());
+  *val = Tensor(entry.dtype(), stored_shape, buffer);
+  buffer->Unref();
+  *mapped = true;
+  return absl::OkStatus();
+}
+
 Status BundleReader::ReadCurrent(Tensor* val) {
   CHECK(val != nullptr);
   BundleEntryProto entry;
@@ -1207,6 +1501,13 @@ Status BundleReader::LookupTensorShape(StringPiece key, TensorShape* shape) {
   return LookupDtypeAndShape(key, &ignored, shape);
 }
 
+Status BundleReader::LookupShardId(StringPiece key, int32_t* shard_id) {
+  BundleEntryProto entry;
+  TF_RETURN_IF_ERROR(GetBundleEntryProto(key, &entry));
+  *shard_id = entry.shard_id();
+  return absl::OkStatus();
+}
+
 string BundleReader::DebugString() {
   // Format used below emulates that of TensorSliceReader::DebugString().
   string shape_str;
@@ -1223,6 +1524,166 @@ string BundleReader::DebugString() {
   return shape_str;
 }
 
+// A data file read, or being read, by a BundlePrefetcher.
+struct PrefetchedBundleFile {
+  std::string name;
+  uint64 size = 0;
+  // Set once a BundleCache has taken the file over.
+  std::atomic<bool> claimed{false};
+
+  absl::Mutex mu;
+  bool done TF_GUARDED_BY(mu) = false;
+  Status status TF_GUARDED_BY(mu);
+  // The contents of the file; immutable once done.
+  std::unique_ptr<char[]> data;
+
+  // Blocks until the file is read and returns the status of the read.
+  Status Wait() {
+    absl::MutexLock l(&mu);
+    mu.Await(absl::Condition(&done));
+    return status;
+  }
+};
+
+namespace {
+
+// Size of the reads issued by BundlePrefetcher.
+constexpr uint64 kPrefetchChunkBytes = 8 << 20;
+
+// Files of the live BundlePrefetchers that no BundleCache has opened yet,
+// keyed by name.
+struct PrefetchedBundleFiles {
+  absl::Mutex mu;
+  absl::flat_hash_map<string, std::shared_ptr<PrefetchedBundleFile>> files
+      TF_GUARDED_BY(mu);
+};
+
+PrefetchedBundleFiles* GetPrefetchedBundleFiles() {
+  static PrefetchedBundleFiles* prefetched = new PrefetchedBundleFiles;
+  return prefetched;
+}
+
+// Takes the prefetched file named "fname" over, or returns nullptr if there is
+// none.
+std::shared_ptr<PrefetchedBundleFile> ClaimPrefetchedBundleFile(
+    const string& fname) {
+  PrefetchedBundleFiles* prefetched = GetPrefetchedBundleFiles();
+  absl::MutexLock l(&prefetched->mu);
+  auto it = prefetched->files.find(fname);
+  if (it == prefetched->files.end()) return nullptr;
+  std::shared_ptr<PrefetchedBundleFile> file = std::move(it->second);
+  prefetched->files.erase(it);
+  file->claimed = true;
+  return file;
+}
+
+// Reads a file prefetched by a BundlePrefetcher.
+class PrefetchedRandomAccessFile : public RandomAccessFile {
+ public:
+  explicit PrefetchedRandomAccessFile(
+      std::shared_ptr<PrefetchedBundleFile> file)
+      : file_(std::move(file)) {}
+
+  Status Name(StringPiece* result) const override {
+    *result = file_->name;
+    return absl::OkStatus();
+  }
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override {
+    if (offset >= file_->size) {
+      *result = StringPiece(scratch, 0);
+      return errors::OutOfRange("Read after file end");
+    }
+    const uint64 available = std::min<uint64>(file_->size - offset, n);
+    *result = StringPiece(file_->data.get() + offset, available);
+    return available == n
+               ? absl::OkStatus()
+               : errors::OutOfRange("Read less bytes than requested");
+  }
+
+ private:
+  const std::shared_ptr<PrefetchedBundleFile> file_;
+};
+
+}  // namespace
+
+BundlePrefetcher::BundlePrefetcher(Env* env, StringPiece prefix,
+                                   int64_t max_bytes)
+    : env_(env) {
+  std::vector<string> data_files;
+  if (max_bytes <= 0 ||
+      !env->GetMatchingPaths(strings::StrCat(prefix, ".data-*"), &data_files)
+           .ok()) {
+    return;
+  }
+  std::sort(data_files.begin(), data_files.end());
+  int64_t total_bytes = 0;
+  PrefetchedBundleFiles* prefetched = GetPrefetchedBundleFiles();
+  for (const string& data_file : data_files) {
+    uint64 size;
+    if (!env->GetFileSize(data_file, &size).ok()) continue;
+    if (total_bytes + static_cast<int64_t>(size) > max_bytes) continue;
+    auto file = std::make_shared<PrefetchedBundleFile>();
+    // Named as DataFilename() names it for "prefix", which is how readers
+    // of the bundle look it up.
+    file->name =
+        strings::StrCat(prefix, data_file.substr(data_file.rfind(".data-")));
+    file->size = size;
+    absl::MutexLock l(&prefetched->mu);
+    // Another BundlePrefetcher may be reading the same file already.
+    if (!prefetched->files.emplace(file->name, file).second) continue;
+    total_bytes += size;
+    files_.push_back(std::move(file));
+  }
+  if (!files_.empty()) {
+    thread_.reset(env->StartThread(ThreadOptions(), "bundle_prefetch",
+                                   [this]() { ReadFiles(); }));
+  }
+}
+
+BundlePrefetcher::~BundlePrefetcher() {
+  cancelled_ = true;
+  thread_.reset();
+  PrefetchedBundleFiles* prefetched = GetPrefetchedBundleFiles();
+  absl::MutexLock l(&prefetched->mu);
+  for (const auto& file : files_) {
+    auto it = prefetched->files.find(file->name);
+    if (it != prefetched->files.end() && it->second == file) {
+      prefetched->files.erase(it);
+    }
+  }
+}
+
+void BundlePrefetcher::ReadFiles() {
+  for (const auto& file : files_) {
+    Status status;
+    std::unique_ptr<char[]> data;
+    if (cancelled_ && !file->claimed) {
+      status = errors::Cancelled("BundlePrefetcher was destroyed");
+    } else {
+      std::unique_ptr<RandomAccessFile> reader;
+      status = env_->NewRandomAccessFile(file->name, &reader);
+      if (status.ok()) data.reset(new char[file->size]);
+      for (uint64 pos = 0; status.ok() && pos < file->size;
+           pos += kPrefetchChunkBytes) {
+        const size_t chunk_size =
+            std::min<uint64>(kPrefetchChunkBytes, file->size - pos);
+        char* chunk = data.get() + pos;
+        StringPiece result;
+        status = reader->Read(pos, chunk_size, &result, chunk);
+        if (status.ok() && result.data() != chunk) {
+          memmove(chunk, result.data(), chunk_size);
+        }
+      }
+    }
+    absl::MutexLock l(&file->mu);
+    if (status.ok()) file->data = std::move(data);
+    file->status = status;
+    file->done = true;
+  }
+}
+
 BundleCache::BundleCache(Env* env) : env_(env) {}
 
 BundleCache::FileState* BundleCache::EnsureOpened(std::string name) {
@@ -1240,6 +1701,15 @@ BundleCache::FileState* BundleCache::EnsureOpened(std::string name) {
   // Open the file or wait for a concurrent open to complete. We do not hold
   // mu_ here to avoid blocking threads reading from other files.
   absl::call_once(f->once, [this, name = std::move(name), f] {
+    std::shared_ptr<PrefetchedBundleFile> prefetched =
+        ClaimPrefetchedBundleFile(name);
+    // A file that failed to be prefetched is read from the file system.
+    if (prefetched != nullptr && prefetched->Wait().ok()) {
+      f->file = std::make_unique<PrefetchedRandomAccessFile>(
+          std::move(prefetched));
+      f->prefetched = true;
+      return;
+    }
     f->open_status = env_->NewRandomAccessFile(name, &f->file);
   });
 
@@ -1252,6 +1722,10 @@ Status BundleCache::GetFile(const std::string& fname, RandomAccessFile** file) {
   return f->open_status;
 }
 
+bool BundleCache::IsPrefetched(const std::string& fname) {
+  return EnsureOpened(fname)->prefetched;
+}
+
 namespace {
 inline char* AlignedMalloc(size_t size) {
   char* buffer = static_cast<char*>(port::AlignedMalloc(size, 64));
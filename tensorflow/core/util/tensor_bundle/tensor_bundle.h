@@ -61,7 +61,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_TENSOR_BUNDLE_H_
 #define TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_TENSOR_BUNDLE_H_
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <map>
 #include <memory>
 #include <string>
@@ -72,6 +74,7 @@ limitations under the License.
 #include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_slice.h"
@@ -168,6 +171,98 @@ class BundleWriter {
   void operator=(const BundleWriter&) = delete;
 };
 
+// Writes a bundle from a background thread so that the caller does not wait
+// on file I/O.
+//
+// Add() and AddSlice() take a snapshot of the tensor in host staging memory
+// and return; the snapshots are handed to a BundleWriter, in the order they
+// were added, by a thread owned by this object.  The staging memory is
+// bounded by Options::max_staging_bytes: Add() blocks while the snapshots not
+// yet written would exceed it.  A tensor larger than the bound is accepted
+// once everything staged before it has been written.
+//
+// Errors of the background writes are reported by the following Add(), by
+// Finish() and by Wait().
+//
+// All threads accessing the same AsyncBundleWriter must synchronize.
+class AsyncBundleWriter {
+ public:
+  struct Options {
+    Options() {}
+    BundleWriter::Options writer_options;
+    // Upper bound, in bytes, of the tensor snapshots waiting to be written.
+    int64_t max_staging_bytes{static_cast<int64_t>(1) << 30};
+  };
+  AsyncBundleWriter(Env* env, absl::string_view prefix,
+                    const Options& options = Options());
+
+  // Blocks until the background thread is done.  If Close() has not been
+  // called, the write is abandoned and no metadata file is produced.
+  ~AsyncBundleWriter();
+
+  // Same contracts as BundleWriter::Add() and BundleWriter::AddSlice().  The
+  // tensor is copied, so the caller may modify it as soon as these return.
+  Status Add(absl::string_view key, const Tensor& val);
+  Status AddSlice(absl::string_view full_tensor_key,
+                  const TensorShape& full_tensor_shape,
+                  const TensorSlice& slice_spec, const Tensor& slice_tensor);
+
+  // Stops accepting tensors.  The bundle is finished in the background once
+  // every staged tensor has been written.  Does not block.
+  void Close();
+
+  // Blocks until the bundle is finished and returns the overall status.
+  // REQUIRES: Close() has been called.
+  Status Wait() TF_MUST_USE_RESULT;
+
+  // Close() followed by Wait().
+  Status Finish() TF_MUST_USE_RESULT;
+
+  // Returns true once the bundle is finished or has failed.
+  bool IsDone();
+
+ private:
+  struct StagedTensor {
+    std::string key;
+    Tensor tensor;
+    bool is_slice = false;
+    TensorShape full_tensor_shape;
+    TensorSlice slice_spec;
+  };
+
+  Status Stage(StagedTensor staged);
+  void WriteLoop();
+
+  const std::string prefix_;
+  const int64_t max_staging_bytes_;
+  BundleWriter writer_;  // Only used from the background thread.
+
+  absl::Mutex mu_;
+  std::deque<StagedTensor> queue_ TF_GUARDED_BY(mu_);
+  int64_t staged_bytes_ TF_GUARDED_BY(mu_) = 0;
+  bool closed_ TF_GUARDED_BY(mu_) = false;
+  bool done_ TF_GUARDED_BY(mu_) = false;
+  Status status_ TF_GUARDED_BY(mu_);
+
+  // Declared last so that it is started after, and joined before, the
+  // members above are destroyed.
+  std::unique_ptr<Thread> thread_;
+
+  AsyncBundleWriter(const AsyncBundleWriter&) = delete;
+  void operator=(const AsyncBundleWriter&) = delete;
+};
+
+// Closes "writer" and keeps it alive until the bundle at "prefix" is
+// finished, so that the caller can return once its tensors are staged.
+// MergeBundles(), BundleReader and later writes to "prefix" call
+// WaitForPendingBundleWrites() first.
+void AddPendingBundleWrite(absl::string_view prefix,
+                           std::unique_ptr<AsyncBundleWriter> writer);
+
+// Blocks until every pending write to "prefix" is done.  Returns the first
+// error of any of them; an error is only returned once.
+Status WaitForPendingBundleWrites(absl::string_view prefix);
+
 // Merges a set of bundles (given their prefixes) into a single bundle with the
 // given "merged_prefix".  The merged metadata is guaranteed to be consistent.
 //
@@ -250,6 +345,13 @@ class BundleReader {
   Status LookupTensorShape(absl::string_view key,
                            TensorShape* shape) TF_MUST_USE_RESULT;
 
+  // Looks up the index of the data file that holds the tensor keyed by "key".
+  // The slices of a partitioned tensor may be spread over several data files;
+  // for those the shard of the metadata entry is returned.
+  // REQUIRES: status().ok()
+  Status LookupShardId(absl::string_view key,
+                       int32_t* shard_id) TF_MUST_USE_RESULT;
+
   // Looks up the tensor keyed by "key".  If "key" refers to a partitioned
   // tensor, attempts to look up the full contents using all stored slices.
   //
@@ -264,6 +366,24 @@ class BundleReader {
   // REQUIRES: status().ok()
   Status Lookup(absl::string_view key, Tensor* val) TF_MUST_USE_RESULT;
 
+  // Looks up the tensor keyed by "key" without copying its contents.  If the
+  // tensor is stored whole, has a dtype that can be memcpy'd, needs no byte
+  // swapping, and starts at a suitably aligned offset of a data file that can
+  // be memory-mapped, sets "val" to a tensor whose buffer aliases a read-only
+  // mapping of that file and sets "*mapped" to true.  Otherwise sets "*mapped"
+  // to false and leaves "val" untouched, so that the caller can fall back to
+  // Lookup().
+  //
+  // The mapping lives as long as any tensor refers to it.  Since the buffer
+  // does not own its memory, kernels never forward it or update it in place.
+  //
+  // Unlike Lookup(), does not validate the crc32c checksum, as that would fault
+  // in every page of the tensor.  Bundles meant to be mapped should be written
+  // with BundleWriter::Options::data_alignment >= EIGEN_MAX_ALIGN_BYTES.
+  // REQUIRES: status().ok()
+  Status LookupMapped(absl::string_view key, Tensor* val,
+                      bool* mapped) TF_MUST_USE_RESULT;
+
   // Looks up the tensor pointed to by the internal iterator.
   //
   // On error, "val" may contain nonsense data.
@@ -344,6 +464,11 @@ class BundleReader {
   // Owned InputBuffer objects. cache_ owns the underlying RandomAccessFiles.
   std::unordered_map<int32_t, io::InputBuffer*> data_;
 
+  // Read-only mappings of the data files used by LookupMapped(), shared with
+  // the tensors aliasing them.  Null for files that cannot be mapped.
+  std::unordered_map<int32_t, std::shared_ptr<ReadOnlyMemoryRegion>>
+      mapped_data_;
+
   // Maps each partitioned tensor's key to its stored slices (represented in a
   // TensorSliceSet).  Populated on-demand.
   std::unordered_map<std::string, checkpoint::TensorSliceSet*> tensor_slices_;
@@ -393,6 +518,7 @@ Status BundleReader::SortForSequentialAccess(
 // BundleCache provides cached opening of files.
 // Used internally by BundleReader.
 // Safe for concurrent uses by multiple threads and BundleReaders.
+// Files read by a BundlePrefetcher are read from its memory.
 class BundleCache {
  public:
   explicit BundleCache(Env* env);
@@ -401,6 +527,9 @@ class BundleCache {
   // while the BundleCache lives.
   Status GetFile(const std::string& fname, RandomAccessFile** file);
 
+  // Returns true if fname is read from the memory of a BundlePrefetcher.
+  bool IsPrefetched(const std::string& fname);
+
  private:
   // State for each opened file (opened on first read).
   struct FileState {
@@ -408,6 +537,7 @@ class BundleCache {
 
     std::unique_ptr<RandomAccessFile> file;
     Status open_status;  // Records any error encountered on open
+    bool prefetched = false;
   };
 
   FileState* EnsureOpened(std::string name);
@@ -418,6 +548,41 @@ class BundleCache {
       TF_GUARDED_BY(mu_);
 };
 
+struct PrefetchedBundleFile;
+
+// Reads the data files of the bundle at "prefix" into memory from a
+// background thread, so that a restore of the bundle that follows reads them
+// from there.  This overlaps the file I/O of the restore with the work that
+// precedes it, such as importing the graph that runs it.
+//
+// Data files are read whole, in shard order, as long as their total size
+// stays within "max_bytes"; the others are left to the file system.  The
+// first BundleCache that opens a prefetched file takes it over, waiting for
+// it to be read if needed, and frees it when destroyed.  The files that no
+// BundleCache has opened are freed with the BundlePrefetcher.
+class BundlePrefetcher {
+ public:
+  BundlePrefetcher(Env* env, absl::string_view prefix, int64_t max_bytes);
+
+  // Stops reading the files that no BundleCache has opened and waits for the
+  // background thread.
+  ~BundlePrefetcher();
+
+ private:
+  void ReadFiles();
+
+  Env* const env_;
+  std::vector<std::shared_ptr<PrefetchedBundleFile>> files_;
+  std::atomic<bool> cancelled_{false};
+
+  // Declared last so that it is joined before the members above are
+  // destroyed.
+  std::unique_ptr<Thread> thread_;
+
+  BundlePrefetcher(const BundlePrefetcher&) = delete;
+  void operator=(const BundlePrefetcher&) = delete;
+};
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_UTIL_TENSOR_BUNDLE_TENSOR_BUNDLE_H_
@@ -15,8 +15,10 @@ limitations under the License.
 
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
+#include <memory>
 #include <random>
 #include <string>
+#include <utility>
 #include <vector>
 
 #if defined(_WIN32)
@@ -954,6 +956,30 @@ TEST(TensorBundleTest, SortForSequentialAccess) {
                           "tensor-1-2", "tensor-1-1", "tensor-1-0"));
 }
 
+TEST(TensorBundleTest, LookupShardId) {
+  Env* env = Env::Default();
+  const std::vector<string> kBundlePrefixes = {Prefix("worker0"),
+                                               Prefix("worker1")};
+  for (int i = 0; i < 2; ++i) {
+    BundleWriter writer(env, kBundlePrefixes[i]);
+    TF_EXPECT_OK(
+        writer.Add(strings::StrCat("tensor", i), Constant_2x3<float>(0.)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  const string kMerged = Prefix("merged");
+  TF_ASSERT_OK(
+      MergeBundles(env, {kBundlePrefixes[0], kBundlePrefixes[1]}, kMerged));
+
+  BundleReader reader(env, kMerged);
+  TF_ASSERT_OK(reader.status());
+  int32_t shard_id = -1;
+  TF_ASSERT_OK(reader.LookupShardId("tensor0", &shard_id));
+  EXPECT_EQ(0, shard_id);
+  TF_ASSERT_OK(reader.LookupShardId("tensor1", &shard_id));
+  EXPECT_EQ(1, shard_id);
+  EXPECT_TRUE(errors::IsNotFound(reader.LookupShardId("tensor2", &shard_id)));
+}
+
 TEST(TensorBundleTest, Error) {
   {  // Dup keys.
     BundleWriter writer(Env::Default(), Prefix("dup"));
@@ -1041,6 +1067,42 @@ TEST(TensorBundleTest, Checksum) {
   }
 }
 
+TEST(TensorBundleTest, ChunkedReadChecksum) {
+  // Large enough to be read in several chunks straight into the tensor.
+  const int64_t kNumElements = 5 << 20;
+  Tensor expected(DT_FLOAT, TensorShape({kNumElements}));
+  auto expected_flat = expected.flat<float>();
+  for (int64_t i = 0; i < kNumElements; ++i) {
+    expected_flat(i) = static_cast<float>(i % 1000);
+  }
+  {
+    BundleWriter writer(Env::Default(), Prefix("chunked"));
+    TF_EXPECT_OK(writer.Add("foo", expected));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  {
+    BundleReader reader(Env::Default(), Prefix("chunked"));
+    TF_ASSERT_OK(reader.status());
+    Tensor val(DT_FLOAT, TensorShape({kNumElements}));
+    TF_ASSERT_OK(reader.Lookup("foo", &val));
+    test::ExpectTensorEqual<float>(val, expected);
+  }
+
+  // Corrupts a byte in the last chunk.
+  const string datafile = DataFilename(Prefix("chunked"), 0, 1);
+  string data;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), datafile, &data));
+  data[data.size() - 3] = ~data[data.size() - 3];
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), datafile, data));
+
+  BundleReader reader(Env::Default(), Prefix("chunked"));
+  TF_ASSERT_OK(reader.status());
+  Tensor val(DT_FLOAT, TensorShape({kNumElements}));
+  Status status = reader.Lookup("foo", &val);
+  EXPECT_TRUE(errors::IsDataLoss(status));
+  EXPECT_TRUE(absl::StrContains(status.ToString(), "Checksum does not match"));
+}
+
 TEST(TensorBundleTest, TruncatedTensorContents) {
   Env* env = Env::Default();
   BundleWriter writer(env, Prefix("end"));
@@ -1128,6 +1190,146 @@ TEST(TensorBundleTest, VersionTest) {
   }
 }
 
+TEST(AsyncBundleWriterTest, Basic) {
+  AsyncBundleWriter::Options options;
+  // Smaller than one tensor, so every Add() waits for the previous write.
+  options.max_staging_bytes = 1000;
+  AsyncBundleWriter writer(Env::Default(), Prefix("async"), options);
+  Tensor tensor = Constant_100x100<float>(0);
+  for (int i = 0; i < 4; ++i) {
+    tensor.flat<float>().setConstant(i);
+    // The writer keeps a snapshot, so the tensor may be modified right away.
+    TF_EXPECT_OK(writer.Add(strings::StrCat("foo_00", i), tensor));
+  }
+  TF_ASSERT_OK(writer.Finish());
+
+  BundleReader reader(Env::Default(), Prefix("async"));
+  TF_ASSERT_OK(reader.status());
+  for (int i = 0; i < 4; ++i) {
+    Expect<float>(&reader, strings::StrCat("foo_00", i),
+                  Constant_100x100<float>(i));
+  }
+}
+
+TEST(AsyncBundleWriterTest, Slices) {
+  AsyncBundleWriter writer(Env::Default(), Prefix("async_slices"));
+  TF_EXPECT_OK(writer.Add("foo", Constant_2x3<float>(1.)));
+  TF_EXPECT_OK(writer.AddSlice("bar", TensorShape({4, 3}),
+                               TensorSlice::ParseOrDie("0,2:-"),
+                               Constant_2x3<float>(2.)));
+  TF_ASSERT_OK(writer.Finish());
+
+  BundleReader reader(Env::Default(), Prefix("async_slices"));
+  TF_ASSERT_OK(reader.status());
+  Expect<float>(&reader, "foo", Constant_2x3<float>(1.));
+  Tensor slice(DT_FLOAT, TensorShape({2, 3}));
+  TF_ASSERT_OK(
+      reader.LookupSlice("bar", TensorSlice::ParseOrDie("0,2:-"), &slice));
+  test::ExpectTensorEqual<float>(slice, Constant_2x3<float>(2.));
+}
+
+TEST(AsyncBundleWriterTest, PendingWriteIsVisibleToMergesAndReaders) {
+  auto writer =
+      std::make_unique<AsyncBundleWriter>(Env::Default(), Prefix("pending"));
+  TF_EXPECT_OK(writer->Add("foo", Constant_2x3<float>(1.)));
+  AddPendingBundleWrite(Prefix("pending"), std::move(writer));
+  TF_ASSERT_OK(MergeBundles(Env::Default(), {Prefix("pending")},
+                            Prefix("pending_merged")));
+
+  writer = std::make_unique<AsyncBundleWriter>(Env::Default(),
+                                               Prefix("pending_read"));
+  TF_EXPECT_OK(writer->Add("bar", Constant_2x3<float>(2.)));
+  AddPendingBundleWrite(Prefix("pending_read"), std::move(writer));
+  BundleReader reader(Env::Default(), Prefix("pending_read"));
+  TF_ASSERT_OK(reader.status());
+  Expect<float>(&reader, "bar", Constant_2x3<float>(2.));
+
+  BundleReader merged_reader(Env::Default(), Prefix("pending_merged"));
+  TF_ASSERT_OK(merged_reader.status());
+  Expect<float>(&merged_reader, "foo", Constant_2x3<float>(1.));
+}
+
+TEST(AsyncBundleWriterTest, Errors) {
+  {  // Dup keys are reported once the background write fails.
+    AsyncBundleWriter writer(Env::Default(), Prefix("async_dup"));
+    TF_EXPECT_OK(writer.Add("foo", Constant_2x3(1.f)));
+    TF_EXPECT_OK(writer.Add("foo", Constant_2x3(2.f)));
+    Status status = writer.Finish();
+    EXPECT_TRUE(absl::StrContains(status.ToString(), "duplicate key"));
+    EXPECT_FALSE(
+        Env::Default()->FileExists(MetaFilename(Prefix("async_dup"))).ok());
+  }
+  {  // Pending errors are returned by the next merge, and only once.
+    auto writer = std::make_unique<AsyncBundleWriter>(Env::Default(),
+                                                      Prefix("async_dup2"));
+    TF_EXPECT_OK(writer->Add("foo", Constant_2x3(1.f)));
+    TF_EXPECT_OK(writer->Add("foo", Constant_2x3(2.f)));
+    AddPendingBundleWrite(Prefix("async_dup2"), std::move(writer));
+    Status status = MergeBundles(Env::Default(), {Prefix("async_dup2")},
+                                 Prefix("async_dup2_merged"));
+    EXPECT_TRUE(absl::StrContains(status.ToString(), "duplicate key"));
+    TF_EXPECT_OK(WaitForPendingBundleWrites(Prefix("async_dup2")));
+    EXPECT_FALSE(
+        Env::Default()->FileExists(MetaFilename(Prefix("async_dup2"))).ok());
+  }
+  {  // An abandoned write does not produce a bundle.
+    {
+      AsyncBundleWriter writer(Env::Default(), Prefix("abandoned"));
+      TF_EXPECT_OK(writer.Add("foo", Constant_2x3(1.f)));
+    }
+    EXPECT_FALSE(
+        Env::Default()->FileExists(MetaFilename(Prefix("abandoned"))).ok());
+  }
+  {  // No adds after Close().
+    AsyncBundleWriter writer(Env::Default(), Prefix("async_closed"));
+    writer.Close();
+    EXPECT_TRUE(errors::IsFailedPrecondition(
+        writer.Add("foo", Constant_2x3(1.f))));
+    TF_EXPECT_OK(writer.Wait());
+  }
+}
+
+TEST(BundlePrefetcherTest, ReadersUsePrefetchedFiles) {
+  {
+    BundleWriter writer(Env::Default(), Prefix("prefetched"));
+    TF_EXPECT_OK(writer.Add("foo", Constant_100x100<float>(1)));
+    TF_EXPECT_OK(writer.Add("bar", Constant_2x3<float>(2)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  const string data_file = DataFilename(Prefix("prefetched"), 0, 1);
+  BundleCache cache(Env::Default());
+  {
+    BundlePrefetcher prefetcher(Env::Default(), Prefix("prefetched"),
+                                /*max_bytes=*/1 << 20);
+    RandomAccessFile* file;
+    TF_ASSERT_OK(cache.GetFile(data_file, &file));
+    EXPECT_TRUE(cache.IsPrefetched(data_file));
+  }
+  // The file is read from memory from now on.
+  TF_ASSERT_OK(Env::Default()->DeleteFile(data_file));
+  BundleReader reader(Env::Default(), Prefix("prefetched"), {&cache, false});
+  TF_ASSERT_OK(reader.status());
+  Expect<float>(&reader, "foo", Constant_100x100<float>(1));
+  Expect<float>(&reader, "bar", Constant_2x3<float>(2));
+}
+
+TEST(BundlePrefetcherTest, FilesOverBudgetAreNotPrefetched) {
+  {
+    BundleWriter writer(Env::Default(), Prefix("not_prefetched"));
+    TF_EXPECT_OK(writer.Add("foo", Constant_100x100<float>(1)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  BundlePrefetcher prefetcher(Env::Default(), Prefix("not_prefetched"),
+                              /*max_bytes=*/1000);
+  BundleCache cache(Env::Default());
+  BundleReader reader(Env::Default(), Prefix("not_prefetched"),
+                      {&cache, false});
+  TF_ASSERT_OK(reader.status());
+  Expect<float>(&reader, "foo", Constant_100x100<float>(1));
+  EXPECT_FALSE(
+      cache.IsPrefetched(DataFilename(Prefix("not_prefetched"), 0, 1)));
+}
+
 TEST(TensorBundleTest, LargeVariableLoadingTest) {
   {
     BundleWriter writer(Env::Default(), Prefix("foo"));
@@ -1270,6 +1472,56 @@ TEST_F(TensorBundleAlignmentTest, AlignmentTest) {
   }
 }
 
+TEST(TensorBundleTest, LookupMapped) {
+  {
+    BundleWriter::Options opts;
+    opts.data_alignment = EIGEN_MAX_ALIGN_BYTES;
+    BundleWriter writer(Env::Default(), Prefix("mapped"), opts);
+    TF_EXPECT_OK(writer.Add("flag", Constant(true, TensorShape({1}))));
+    TF_EXPECT_OK(writer.Add("table", Constant_100x100<float>(7)));
+    TF_EXPECT_OK(writer.Add("strings", test::AsTensor<tstring>({"a", "b"})));
+    TF_EXPECT_OK(writer.AddSlice("part", TensorShape({4, 3}),
+                                 TensorSlice::ParseOrDie("0,2:-"),
+                                 Constant_2x3<float>(1.)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  BundleReader reader(Env::Default(), Prefix("mapped"));
+  TF_ASSERT_OK(reader.status());
+
+  Tensor table;
+  bool mapped = false;
+  TF_ASSERT_OK(reader.LookupMapped("table", &table, &mapped));
+  ASSERT_TRUE(mapped);
+  test::ExpectTensorEqual<float>(table, Constant_100x100<float>(7));
+  // The mapping is never handed out for in-place updates.
+  EXPECT_FALSE(table.RefCountIsOne());
+
+  // Strings and partitioned tensors have to be copied.
+  Tensor val;
+  TF_ASSERT_OK(reader.LookupMapped("strings", &val, &mapped));
+  EXPECT_FALSE(mapped);
+  TF_ASSERT_OK(reader.LookupMapped("part", &val, &mapped));
+  EXPECT_FALSE(mapped);
+  EXPECT_TRUE(
+      errors::IsNotFound(reader.LookupMapped("missing", &val, &mapped)));
+}
+
+TEST(TensorBundleTest, LookupMappedUnaligned) {
+  {
+    BundleWriter writer(Env::Default(), Prefix("unaligned"));
+    TF_EXPECT_OK(writer.Add("a_flag", Constant(true, TensorShape({1}))));
+    TF_EXPECT_OK(writer.Add("b_table", Constant_2x3<float>(2.)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  BundleReader reader(Env::Default(), Prefix("unaligned"));
+  TF_ASSERT_OK(reader.status());
+  // "b_table" follows a single byte, so it cannot be aliased.
+  Tensor val;
+  bool mapped = true;
+  TF_ASSERT_OK(reader.LookupMapped("b_table", &val, &mapped));
+  EXPECT_FALSE(mapped);
+}
+
 static void BM_BundleAlignment(::testing::benchmark::State& state) {
   {
     const int alignment = state.range(0);
@@ -195,6 +195,36 @@ class TopKTest(test.TestCase):
       values = -np.sort(-inputs, axis=1)[:, :k]
       self._validateTopK(inputs, k, values, indices)
 
+  def _testStreamingTopK(self, dtype, sorted):  # pylint: disable=redefined-builtin
+    # Long rows with small k use the streaming threshold-filtering kernel,
+    # which may split a row across threads.
+    b = 3
+    n = 100000
+    for k in [2, 17, 100]:
+      inputs = np.random.permutation(
+          np.linspace(0, 100, b * n, dtype=dtype)).reshape(b, n)
+      indices = np.argsort(-inputs, axis=1, kind="mergesort")[:, :k]
+      values = -np.sort(-inputs, axis=1)[:, :k]
+      self._validateTopK(inputs, k, values, indices, sorted=sorted)
+
+  def testStreamingTopK(self):
+    for sorted in [True, False]:  # pylint: disable=redefined-builtin
+      self._testStreamingTopK(np.float32, sorted)
+      self._testStreamingTopK(np.float64, sorted)
+      self._testStreamingTopK(np.int32, sorted)
+
+  def testStreamingTopKStableSort(self):
+    b = 2
+    n = 70000
+    for k in [5, 100, 1000]:
+      # Lots of repeated integers taking values in [0, 3], so that the k-th
+      # value ties with elements in every chunk of the row.
+      inputs = np.random.permutation(
+          np.linspace(0, 3, b * n, dtype=np.int32)).reshape(b, n)
+      indices = np.argsort(-inputs, axis=1, kind="mergesort")[:, :k]
+      values = -np.sort(-inputs, axis=1)[:, :k]
+      self._validateTopK(inputs, k, values, indices)
+
   def testTopAll(self):
     inputs = [[0.1, 0.3, 0.2, 0.4], [0.1, 0.3, 0.3, 0.2]]
     self._validateTopK(inputs, 4, [[0.4, 0.3, 0.2, 0.1], [0.3, 0.3, 0.2, 0.1]],
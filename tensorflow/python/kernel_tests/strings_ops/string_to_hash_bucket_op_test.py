@@ -45,6 +45,19 @@ class StringToHashBucketOpTest(test.TestCase):
       # Fingerprint64('d') -> 4470636696479570465 -> mod 10 -> 5
       self.assertAllEqual([9, 2, 2, 5], result)
 
+  def testStringToHashBucketsFastLargeBatch(self):
+    # Enough strings, of mixed lengths, for the op to hash in several batches
+    # and shards. Each element must bucket the same as when hashed alone.
+    strings = [('%d' % i) * (i % 7 + 1) for i in range(5000)]
+    batched = self.evaluate(string_ops.string_to_hash_bucket_fast(strings, 97))
+    for i in range(0, len(strings), 499):
+      single = self.evaluate(
+          string_ops.string_to_hash_bucket_fast(strings[i:i + 1], 97))
+      self.assertEqual(single[0], batched[i])
+    self.assertAllEqual(
+        batched[:4],
+        self.evaluate(string_ops.string_to_hash_bucket_fast(strings[:4], 97)))
+
   @test_util.run_deprecated_v1
   def testStringToOneHashBucketLegacyHash(self):
     with self.cached_session():
@@ -0,0 +1,311 @@
+/* Copyright 2024 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Calibrates a frozen float graph on a representative dataset, quantizes it
+// to int8 with the grappler Int8Quantizer, and reports how much the outputs
+// of the quantized graph differ from the float ones and how fast both graphs
+// run. To use it, run something like this:
+//
+// bazel build tensorflow/tools/graph_transforms:int8_quantization_report
+// bazel-bin/tensorflow/tools/graph_transforms/int8_quantization_report \
+//   --in_graph=model.pb --calibration_data=samples.tfrecord \
+//   --eval_data=held_out.tfrecord --outputs=softmax --out_graph=model_int8.pb
+//
+// The datasets are TFRecord files of serialized CalibrationSample protos, each
+// holding the tensors to feed to the graph for one run. The errors are
+// measured on --eval_data, which should not overlap the calibration samples:
+// the ranges are fitted to those, so they understate the error on new inputs.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/optimizers/inference/int8_quantizer.h"
+#include "tensorflow/core/grappler/optimizers/inference/int8_quantizer.pb.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/public/session.h"
+#include "tensorflow/core/util/command_line_flags.h"
+#include "tensorflow/tools/graph_transforms/file_utils.h"
+
+namespace tensorflow {
+namespace graph_transforms {
+namespace {
+
+using Feeds = std::vector<std::pair<string, Tensor>>;
+
+Status ReadSamples(const string& path, std::vector<Feeds>* samples) {
+  std::unique_ptr<RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(Env::Default()->NewRandomAccessFile(path, &file));
+  io::RecordReader reader(file.get());
+  uint64 offset = 0;
+  tstring record;
+  while (true) {
+    Status s = reader.ReadRecord(&offset, &record);
+    if (errors::IsOutOfRange(s)) break;
+    TF_RETURN_IF_ERROR(s);
+    grappler::CalibrationSample sample;
+    if (!sample.ParseFromString(record)) {
+      return errors::DataLoss("Failed to parse sample ", samples->size(),
+                              " of ", path);
+    }
+    Feeds feeds;
+    for (const NamedTensorProto& feed : sample.feeds()) {
+      Tensor tensor;
+      if (!tensor.FromProto(feed.tensor())) {
+        return errors::DataLoss("Invalid tensor ", feed.name(), " in sample ",
+                                samples->size(), " of ", path);
+      }
+      feeds.emplace_back(feed.name(), std::move(tensor));
+    }
+    samples->push_back(std::move(feeds));
+  }
+  if (samples->empty()) {
+    return errors::InvalidArgument("No samples in ", path);
+  }
+  return absl::OkStatus();
+}
+
+Status CreateSession(const GraphDef& graph, std::unique_ptr<Session>* session) {
+  session->reset(NewSession(SessionOptions()));
+  return (*session)->Create(graph);
+}
+
+// Runs every sample through `session`, `num_runs` times after a warm-up run,
+// and returns the average time of a run over all samples in milliseconds.
+Status MeasureLatency(Session* session, const std::vector<Feeds>& samples,
+                      const std::vector<string>& outputs, int num_runs,
+                      double* latency_ms) {
+  std::vector<Tensor> values;
+  for (const Feeds& feeds : samples) {
+    TF_RETURN_IF_ERROR(session->Run(feeds, outputs, {}, &values));
+  }
+  const uint64 start_us = Env::Default()->NowMicros();
+  for (int run = 0; run < num_runs; ++run) {
+    for (const Feeds& feeds : samples) {
+      TF_RETURN_IF_ERROR(session->Run(feeds, outputs, {}, &values));
+    }
+  }
+  const uint64 elapsed_us = Env::Default()->NowMicros() - start_us;
+  *latency_ms = elapsed_us / 1000.0 / std::max(1, num_runs);
+  return absl::OkStatus();
+}
+
+// Differences between the float and the quantized values of an output.
+struct OutputError {
+  double max_abs_error = 0;
+  double sum_abs_error = 0;
+  int64_t num_values = 0;
+  // For outputs of rank 2, the rows whose largest value is at the same index.
+  int64_t num_rows = 0;
+  int64_t num_matching_rows = 0;
+};
+
+Status AddError(const Tensor& expected, const Tensor& actual,
+                OutputError* error) {
+  if (expected.dtype() != DT_FLOAT || actual.dtype() != DT_FLOAT ||
+      expected.shape() != actual.shape()) {
+    return errors::InvalidArgument("Cannot compare ",
+                                   expected.DebugString(), " with ",
+                                   actual.DebugString());
+  }
+  auto x = expected.flat<float>();
+  auto y = actual.flat<float>();
+  for (int64_t i = 0; i < x.size(); ++i) {
+    const double diff = std::fabs(static_cast<double>(x(i)) - y(i));
+    error->max_abs_error = std::max(error->max_abs_error, diff);
+    error->sum_abs_error += diff;
+  }
+  error->num_values += x.size();
+  if (expected.dims() == 2 && expected.dim_size(1) > 0) {
+    auto x_rows = expected.matrix<float>();
+    auto y_rows = actual.matrix<float>();
+    for (int64_t row = 0; row < expected.dim_size(0); ++row) {
+      int64_t x_max = 0;
+      int64_t y_max = 0;
+      for (int64_t col = 1; col < expected.dim_size(1); ++col) {
+        if (x_rows(row, col) > x_rows(row, x_max)) x_max = col;
+        if (y_rows(row, col) > y_rows(row, y_max)) y_max = col;
+      }
+      ++error->num_rows;
+      if (x_max == y_max) ++error->num_matching_rows;
+    }
+  }
+  return absl::OkStatus();
+}
+
+Status Run(const string& in_graph, const string& calibration_data,
+           const string& eval_data, const std::vector<string>& outputs,
+           const string& out_graph, const string& calibration_out,
+           bool disable_per_channel, int num_runs) {
+  GraphDef graph;
+  TF_RETURN_IF_ERROR(LoadTextOrBinaryGraphFile(in_graph, &graph));
+  std::vector<Feeds> samples;
+  TF_RETURN_IF_ERROR(ReadSamples(calibration_data, &samples));
+  std::vector<Feeds> eval_samples;
+  if (eval_data.empty()) {
+    LOG(WARNING) << "No --eval_data given, measuring the error on the "
+                    "calibration samples. This understates the error on "
+                    "inputs the ranges were not fitted to.";
+  } else {
+    TF_RETURN_IF_ERROR(ReadSamples(eval_data, &eval_samples));
+  }
+  const std::vector<Feeds>& eval = eval_data.empty() ? samples : eval_samples;
+
+  // Calibrate.
+  const std::vector<string> tensors =
+      grappler::GetInt8CalibrationTensors(graph);
+  std::unique_ptr<Session> float_session;
+  TF_RETURN_IF_ERROR(CreateSession(graph, &float_session));
+  grappler::Int8QuantizerConfig config;
+  for (const Feeds& feeds : samples) {
+    // Without candidate nodes there is nothing to fetch.
+    if (tensors.empty()) break;
+    std::vector<Tensor> values;
+    TF_RETURN_IF_ERROR(float_session->Run(feeds, tensors, {}, &values));
+    TF_RETURN_IF_ERROR(grappler::UpdateInt8Calibration(
+        tensors, values, config.mutable_calibration()));
+  }
+  if (!calibration_out.empty()) {
+    TF_RETURN_IF_ERROR(WriteBinaryProto(Env::Default(), calibration_out,
+                                        config.calibration()));
+  }
+
+  config.set_disable_per_channel(disable_per_channel);
+  grappler::Int8Quantizer quantizer(config);
+  grappler::GrapplerItem item;
+  item.id = in_graph;
+  item.graph = graph;
+  item.fetch = outputs;
+  GraphDef quantized_graph;
+  TF_RETURN_IF_ERROR(quantizer.Optimize(nullptr, item, &quantized_graph));
+  int num_quantized = 0;
+  for (const NodeDef& node : quantized_graph.node()) {
+    if (absl::EndsWith(node.name(), "/int8/quantize")) ++num_quantized;
+  }
+  if (!out_graph.empty()) {
+    TF_RETURN_IF_ERROR(
+        WriteBinaryProto(Env::Default(), out_graph, quantized_graph));
+  }
+
+  std::unique_ptr<Session> quantized_session;
+  TF_RETURN_IF_ERROR(CreateSession(quantized_graph, &quantized_session));
+  std::vector<OutputError> output_errors(outputs.size());
+  for (const Feeds& feeds : eval) {
+    std::vector<Tensor> expected;
+    TF_RETURN_IF_ERROR(float_session->Run(feeds, outputs, {}, &expected));
+    std::vector<Tensor> values;
+    TF_RETURN_IF_ERROR(quantized_session->Run(feeds, outputs, {}, &values));
+    for (int j = 0, num_outputs = outputs.size(); j < num_outputs; ++j) {
+      TF_RETURN_IF_ERROR(AddError(expected[j], values[j], &output_errors[j]));
+    }
+  }
+
+  double float_latency_ms = 0;
+  double quantized_latency_ms = 0;
+  TF_RETURN_IF_ERROR(MeasureLatency(float_session.get(), eval, outputs,
+                                    num_runs, &float_latency_ms));
+  TF_RETURN_IF_ERROR(MeasureLatency(quantized_session.get(), eval, outputs,
+                                    num_runs, &quantized_latency_ms));
+
+  std::cout << "Quantized " << num_quantized << " of " << tensors.size() / 2
+            << " candidate MatMul/Conv2D nodes, calibrated on "
+            << samples.size() << " samples, evaluated on " << eval.size()
+            << (eval_data.empty() ? " calibration" : " held-out")
+            << " samples." << std::endl;
+  for (int j = 0, num_outputs = outputs.size(); j < num_outputs; ++j) {
+    const OutputError& error = output_errors[j];
+    std::cout << "Output " << outputs[j]
+              << ": max abs error=" << error.max_abs_error
+              << " mean abs error="
+              << error.sum_abs_error / std::max<int64_t>(1, error.num_values);
+    if (error.num_rows > 0) {
+      std::cout << " top-1 agreement="
+                << 100.0 * error.num_matching_rows / error.num_rows << "%";
+    }
+    std::cout << std::endl;
+  }
+  std::cout << "Latency over all samples: float=" << float_latency_ms
+            << "ms int8=" << quantized_latency_ms << "ms speedup="
+            << float_latency_ms / std::max(quantized_latency_ms, 1e-9) << "x"
+            << std::endl;
+  return absl::OkStatus();
+}
+
+int ParseFlagsAndRun(int argc, char* argv[]) {
+  string in_graph;
+  string calibration_data;
+  string eval_data;
+  string outputs_string;
+  string out_graph;
+  string calibration_out;
+  bool disable_per_channel = false;
+  int32_t num_runs = 10;
+  std::vector<Flag> flag_list = {
+      Flag("in_graph", &in_graph, "frozen float graph file name"),
+      Flag("calibration_data", &calibration_data,
+           "TFRecord file of CalibrationSample protos"),
+      Flag("eval_data", &eval_data,
+           "TFRecord file of CalibrationSample protos to measure the error "
+           "on, defaults to --calibration_data"),
+      Flag("outputs", &outputs_string, "comma-separated output tensors"),
+      Flag("out_graph", &out_graph, "where to write the quantized graph"),
+      Flag("calibration_out", &calibration_out,
+           "where to write the QuantizationCalibration"),
+      Flag("disable_per_channel", &disable_per_channel,
+           "quantize Conv2D filters as a whole"),
+      Flag("num_runs", &num_runs,
+           "number of passes over the samples to measure latency"),
+  };
+  string usage = Flags::Usage(argv[0], flag_list);
+  const bool parse_result = Flags::Parse(&argc, argv, flag_list);
+  // We need to call this to set up global state for TensorFlow.
+  port::InitMain(argv[0], &argc, &argv);
+  if (!parse_result || argc > 1 || in_graph.empty() ||
+      calibration_data.empty() || outputs_string.empty()) {
+    LOG(ERROR) << usage;
+    return -1;
+  }
+
+  const std::vector<string> outputs =
+      absl::StrSplit(outputs_string, ',', absl::SkipEmpty());
+  Status s = Run(in_graph, calibration_data, eval_data, outputs, out_graph,
+                 calibration_out, disable_per_channel, num_runs);
+  if (!s.ok()) {
+    LOG(ERROR) << "int8_quantization_report failed: " << s;
+    return -1;
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace graph_transforms
+}  // namespace tensorflow
+
+int main(int argc, char* argv[]) {
+  return tensorflow::graph_transforms::ParseFlagsAndRun(argc, argv);
+}